@@ -0,0 +1,627 @@
+/**
+ * @file antientropy.c
+ * @brief Implementation of antientropy.h
+ *
+ * @date 18.10.2026
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h> // for htonl
+
+#include "antientropy.h"
+#include "protocol.h"
+#include "util.h"
+
+#define INDEX_SIZE 4 // index of a node in a request, big endian
+#define HASH_SIZE PROTOCOL_STAMP_SIZE // hash of a node in a reply, big endian as the versions
+
+/**
+ * @brief keys of the differing leaves, collected by store_for_each
+ */
+typedef struct {
+    const antientropy_t *ae;
+    const antientropy_peer_t *peer;
+    const uint8_t *differ; // bit i set if leaf i differs
+    char *keys;            // <version1><key1><version2><key2>... (see PROTOCOL_DIFF)
+    size_t size;
+    size_t capacity;
+    size_t count;
+    error_code err;
+} candidates_t;
+
+/**
+ * @brief a multi-put being filled with the values a peer lacks
+ */
+typedef struct {
+    char *pairs; // <version1><key1><value1>... (see PROTOCOL_MPUT), PROTOCOL_MAX_PAYLOAD bytes
+    size_t used;
+} push_t;
+
+/**
+ * @brief whether two addresses are the same server
+ * @param a the first address
+ * @param b the second address
+ * @return 1 if they are
+ */
+static int same_server(const struct sockaddr_in *a, const struct sockaddr_in *b);
+
+/**
+ * @brief peer of an address
+ * @param ae the anti-entropy
+ * @param addr the address
+ * @param add whether to add the peer if it is not known yet
+ * @return the peer, NULL if it is unknown (or could not be added)
+ */
+static antientropy_peer_t *find_peer(antientropy_t *ae, const struct sockaddr_in *addr, int add);
+
+/**
+ * @brief mark the leaves and the parts of a range of the ring, the one before a node
+ * @param peer the peer that replicates the range
+ * @param index the ring
+ * @param node the node at the end of the range
+ */
+static void mark_range(antientropy_peer_t *peer, const struct ring_index *index, size_t node);
+
+/**
+ * @brief send a request to a peer and wait for its reply
+ * @param transport socket to the peers
+ * @param addr address of the peer
+ * @param opcode the operation
+ * @param payload the payload
+ * @param size size of the payload
+ * @param reply where to store the reply, to be forgotten by the caller
+ * @param id where to store the ID of the request
+ * @return ERR_NONE if the peer answered PROTOCOL_OK, ERR_NETWORK otherwise
+ */
+static error_code ask(transport_t *transport, const struct sockaddr_in *addr, protocol_opcode_t opcode,
+                      const char *payload, size_t size, const transport_request_t **reply, uint32_t *id);
+
+/**
+ * @brief go down the trees of the server and of a peer where they differ
+ * @param ae the anti-entropy
+ * @param peer the peer
+ * @param transport socket to the peers
+ * @param tree the tree of the server over the leaves shared with the peer
+ * @param differ where to set the bits of the differing leaves
+ * @param nb_differ where to store the number of differing leaves
+ * @return an error code
+ */
+static error_code compare_trees(const antientropy_t *ae, const antientropy_peer_t *peer, transport_t *transport,
+                                const uint64_t *tree, uint8_t *differ, size_t *nb_differ);
+
+/**
+ * @brief keep the version of a key of a differing leaf that the peer replicates (visitor of store_for_each)
+ * @param arg the candidates_t
+ * @param key the key
+ * @param key_len length of the key
+ * @param value unused
+ * @param value_len unused
+ * @param version its version
+ * @return 0 once out of memory, 1 otherwise
+ */
+static int collect_key(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version);
+
+/**
+ * @brief send the versions of keys to a peer, and push the values it lacks
+ * @param ae the anti-entropy
+ * @param peer the peer
+ * @param transport socket to the peers
+ * @param keys <version1><key1><version2><key2>...
+ * @param size size of the keys
+ * @param stats where to count the bytes and values pushed
+ * @return an error code
+ */
+static error_code push_keys(const antientropy_t *ae, const antientropy_peer_t *peer, transport_t *transport,
+                            const char *keys, size_t size, antientropy_stats_t *stats);
+
+/**
+ * @brief add the value of a key to a multi-put, sent first if it is full
+ * @param ae the anti-entropy
+ * @param peer the peer
+ * @param transport socket to the peers
+ * @param push the multi-put
+ * @param key the key
+ * @param key_len length of the key
+ * @param stats where to count the values pushed
+ * @return an error code
+ */
+static error_code push_pair(const antientropy_t *ae, const antientropy_peer_t *peer, transport_t *transport,
+                            push_t *push, pps_key_t key, size_t key_len, antientropy_stats_t *stats);
+
+/**
+ * @brief send a multi-put to a peer and empty it
+ * @param peer the peer
+ * @param transport socket to the peers
+ * @param push the multi-put
+ * @param stats where to count the values pushed
+ * @return an error code
+ */
+static error_code push_flush(const antientropy_peer_t *peer, transport_t *transport, push_t *push,
+                             antientropy_stats_t *stats);
+
+// =====================================================================
+
+antientropy_t *antientropy_new(store_t *store, const ring_t *ring, size_t N, const struct sockaddr_in *self)
+{
+    if (store == NULL || ring == NULL || ring->index == NULL || self == NULL) return NULL;
+
+    antientropy_t *ae = calloc(1, sizeof(antientropy_t));
+    if (ae == NULL) return NULL;
+
+    ae->store = store;
+    ae->ring = ring;
+    ae->N = N;
+    ae->self = *self;
+
+    const struct ring_index *index = ring->index;
+    size_t wanted = N < index->nb_successors ? N : index->nb_successors;
+
+    //the ranges end at the nodes, inside the leaves
+    if (merkle_cut(store->merkle, index->prefixes, index->nb_nodes) != ERR_NONE) {
+        free(ae);
+        return NULL;
+    }
+
+    //the range before each node of the ring goes to the first servers after it
+    for (size_t j = 0; j < index->nb_nodes; ++j) {
+        const uint32_t *succ = &index->successors[j * index->nb_successors];
+
+        int mine = 0;
+        for (size_t k = 0; k < wanted; ++k) {
+            mine |= same_server(&index->nodes[succ[k]].srv_addr, self);
+        }
+        if (!mine) continue;
+
+        for (size_t k = 0; k < wanted; ++k) {
+            const struct sockaddr_in *addr = &index->nodes[succ[k]].srv_addr;
+            if (same_server(addr, self)) continue;
+
+            antientropy_peer_t *peer = find_peer(ae, addr, 1);
+            if (peer != NULL && peer->parts == NULL) peer->parts = calloc((index->nb_nodes + 7) / 8, 1);
+            if (peer == NULL || peer->parts == NULL) {
+                for (size_t p = 0; p < ae->nb_peers; ++p) {
+                    free(ae->peers[p].parts);
+                }
+                free(ae->peers);
+                free(ae);
+                return NULL;
+            }
+            mark_range(peer, index, j);
+        }
+    }
+
+    //once the array does not move anymore
+    for (size_t p = 0; p < ae->nb_peers; ++p) {
+        pthread_mutex_init(&ae->peers[p].lock, NULL);
+    }
+
+    return ae;
+}
+
+// =====================================================================
+
+void antientropy_free(antientropy_t *ae)
+{
+    if (ae == NULL) return;
+
+    for (size_t p = 0; p < ae->nb_peers; ++p) {
+        pthread_mutex_destroy(&ae->peers[p].lock);
+        free(ae->peers[p].tree);
+        free(ae->peers[p].parts);
+    }
+    free(ae->peers);
+    free(ae);
+}
+
+// =====================================================================
+
+error_code antientropy_round(antientropy_t *ae, transport_t *transport, antientropy_stats_t *stats)
+{
+    M_REQUIRE_NON_NULL(ae);
+    M_REQUIRE_NON_NULL(transport);
+    M_REQUIRE_NON_NULL(stats);
+
+    memset(stats, 0, sizeof(antientropy_stats_t));
+    if (ae->nb_peers == 0) return ERR_NONE;
+
+    const antientropy_peer_t *peer = &ae->peers[ae->next];
+    ae->next = (ae->next + 1) % ae->nb_peers;
+
+    size_t bytes = transport->bytes_sent + transport->bytes_received;
+    uint64_t *tree = malloc(MERKLE_NODES * sizeof(uint64_t));
+    uint8_t *differ = calloc(MERKLE_LEAVES / 8, 1);
+    candidates_t candidates = {ae, peer, differ, NULL, 0, 0, 0, ERR_NONE};
+
+    error_code err = tree == NULL || differ == NULL ? ERR_NOMEM : ERR_NONE;
+    if (err == ERR_NONE) {
+        merkle_build(ae->store->merkle, peer->shared, peer->parts, tree);
+        err = compare_trees(ae, peer, transport, tree, differ, &stats->leaves);
+    }
+
+    //only the keys of the differing leaves are compared
+    if (err == ERR_NONE && stats->leaves > 0) {
+        err = store_for_each(ae->store, collect_key, &candidates);
+        if (err == ERR_NONE) err = candidates.err;
+    }
+
+    if (err == ERR_NONE && candidates.size > 0) {
+        err = push_keys(ae, peer, transport, candidates.keys, candidates.size, stats);
+    }
+
+    stats->compared = candidates.count;
+    stats->bytes = transport->bytes_sent + transport->bytes_received - bytes;
+
+    free(candidates.keys);
+    free(differ);
+    free(tree);
+    return err;
+}
+
+// =====================================================================
+
+protocol_status_t antientropy_reply_tree(antientropy_t *ae, const char *payload, size_t size, char *reply,
+                                         size_t *reply_size)
+{
+    *reply_size = 0;
+    if (ae == NULL || size < PROTOCOL_ADDR_SIZE + 1 || (size - PROTOCOL_ADDR_SIZE - 1) % INDEX_SIZE != 0) {
+        return PROTOCOL_ERROR;
+    }
+
+    struct sockaddr_in addr;
+    protocol_read_addr(payload, &addr);
+    size_t level = (uint8_t) payload[PROTOCOL_ADDR_SIZE];
+    size_t nb_nodes = (size - PROTOCOL_ADDR_SIZE - 1) / INDEX_SIZE;
+
+    antientropy_peer_t *peer = find_peer(ae, &addr, 0);
+    if (peer == NULL || level >= MERKLE_DEPTH || nb_nodes > ANTIENTROPY_MAX_NODES) return PROTOCOL_ERROR;
+
+    pthread_mutex_lock(&peer->lock);
+
+    //a round starts at the root: the whole descent sees the same tree
+    if (level == 0 || peer->tree == NULL) {
+        if (peer->tree == NULL) peer->tree = malloc(MERKLE_NODES * sizeof(uint64_t));
+        if (peer->tree == NULL) {
+            pthread_mutex_unlock(&peer->lock);
+            return PROTOCOL_ERROR;
+        }
+        merkle_build(ae->store->merkle, peer->shared, peer->parts, peer->tree);
+    }
+
+    const uint64_t *children = peer->tree + merkle_level_start(level + 1);
+    size_t count = (size_t) 1 << (MERKLE_FANOUT_BITS * level);
+    protocol_status_t status = PROTOCOL_OK;
+
+    for (size_t i = 0; i < nb_nodes && status == PROTOCOL_OK; ++i) {
+        uint32_t node = 0;
+        memcpy(&node, payload + PROTOCOL_ADDR_SIZE + 1 + i * INDEX_SIZE, INDEX_SIZE);
+        node = ntohl(node);
+
+        if (node >= count) {
+            status = PROTOCOL_ERROR;
+            continue;
+        }
+
+        for (size_t c = 0; c < MERKLE_FANOUT; ++c) {
+            protocol_write_stamp(reply + *reply_size, children[node * MERKLE_FANOUT + c]);
+            *reply_size += HASH_SIZE;
+        }
+    }
+
+    pthread_mutex_unlock(&peer->lock);
+    return status;
+}
+
+// =====================================================================
+
+size_t antientropy_reply_diff(store_t *store, const char *payload, size_t size, char *reply)
+{
+    size_t nb_keys = 0;
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, payload, size);
+
+    uint64_t version = 0;
+    const char *key = NULL;
+    size_t key_len = 0;
+    while (protocol_next_stamp(&reader, &version) && protocol_next_field(&reader, &key, &key_len)) {
+        //an equal version is the same write
+        store_view_t view;
+        int held = key_len > 0 && store_get_view(store, key, key_len, &view) == ERR_NONE;
+        if (held) {
+            held = view.view.version >= version;
+            store_release_view(store, &view);
+        }
+
+        reply[nb_keys++] = held ? PROTOCOL_OK : PROTOCOL_NOT_FOUND;
+    }
+
+    return nb_keys;
+}
+
+// =====================================================================
+
+static int same_server(const struct sockaddr_in *a, const struct sockaddr_in *b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// =====================================================================
+
+static antientropy_peer_t *find_peer(antientropy_t *ae, const struct sockaddr_in *addr, int add)
+{
+    for (size_t p = 0; p < ae->nb_peers; ++p) {
+        if (same_server(&ae->peers[p].addr, addr)) return &ae->peers[p];
+    }
+
+    if (!add) return NULL;
+
+    antientropy_peer_t *peers = realloc(ae->peers, (ae->nb_peers + 1) * sizeof(antientropy_peer_t));
+    if (peers == NULL) return NULL;
+
+    ae->peers = peers;
+    antientropy_peer_t *peer = &ae->peers[ae->nb_peers++];
+    memset(peer, 0, sizeof(antientropy_peer_t));
+    peer->addr = *addr;
+    return peer;
+}
+
+// =====================================================================
+
+static void mark_range(antientropy_peer_t *peer, const struct ring_index *index, size_t node)
+{
+    //the range is (from, to]: the part after the cut at from, then the leaves up to the one of to
+    size_t cut = (node + index->nb_nodes - 1) % index->nb_nodes;
+    uint64_t from = index->prefixes[cut];
+    uint64_t to = index->prefixes[node];
+
+    //two nodes at the same position leave an empty range, but a single node holds the whole ring
+    if (from == to && index->nb_nodes > 1) return;
+
+    peer->parts[cut / 8] |= (uint8_t) (1 << (cut % 8));
+
+    //a range that goes over the end of the ring restarts at the first leaf
+    size_t first = MERKLE_LEAF_OF(from);
+    size_t count = (MERKLE_LEAF_OF(to) + MERKLE_LEAVES - first) % MERKLE_LEAVES;
+    if (count == 0 && from >= to) count = MERKLE_LEAVES;
+
+    for (size_t i = 1; i <= count; ++i) {
+        size_t leaf = (first + i) % MERKLE_LEAVES;
+        peer->shared[leaf / 8] |= (uint8_t) (1 << (leaf % 8));
+    }
+}
+
+// =====================================================================
+
+static error_code ask(transport_t *transport, const struct sockaddr_in *addr, protocol_opcode_t opcode,
+                      const char *payload, size_t size, const transport_request_t **reply, uint32_t *id)
+{
+    *reply = NULL;
+    if (transport_request(transport, addr, opcode, payload, size, id) != ERR_NONE) return ERR_NETWORK;
+
+    //one request in flight: any other reply is a late one of an earlier round
+    uint32_t replied = 0;
+    error_code err = ERR_NONE;
+    while ((err = transport_wait(transport, ANTIENTROPY_TIMEOUT_MS, &replied)) == ERR_NONE && replied != *id) {
+        transport_forget(transport, replied);
+    }
+
+    *reply = err == ERR_NONE ? transport_reply(transport, *id) : NULL;
+    if (*reply == NULL || (*reply)->status != PROTOCOL_OK) {
+        transport_forget(transport, *id);
+        *reply = NULL;
+        return ERR_NETWORK;
+    }
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code compare_trees(const antientropy_t *ae, const antientropy_peer_t *peer, transport_t *transport,
+                                const uint64_t *tree, uint8_t *differ, size_t *nb_differ)
+{
+    //the nodes of a level that differ, the root first
+    uint32_t *todo = malloc(MERKLE_LEAVES * sizeof(uint32_t));
+    uint32_t *next = malloc(MERKLE_LEAVES * sizeof(uint32_t));
+    error_code err = todo == NULL || next == NULL ? ERR_NOMEM : ERR_NONE;
+    size_t nb_todo = 1;
+    if (todo != NULL) todo[0] = 0;
+
+    char payload[PROTOCOL_ADDR_SIZE + 1 + ANTIENTROPY_MAX_NODES * INDEX_SIZE];
+    protocol_write_addr(payload, &ae->self);
+
+    size_t level = 0;
+    for (; err == ERR_NONE && level < MERKLE_DEPTH && nb_todo > 0; ++level) {
+        payload[PROTOCOL_ADDR_SIZE] = (char) level;
+        const uint64_t *children = tree + merkle_level_start(level + 1);
+        size_t nb_next = 0;
+
+        for (size_t first = 0; err == ERR_NONE && first < nb_todo; first += ANTIENTROPY_MAX_NODES) {
+            size_t count = nb_todo - first < ANTIENTROPY_MAX_NODES ? nb_todo - first : ANTIENTROPY_MAX_NODES;
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t node = htonl(todo[first + i]);
+                memcpy(payload + PROTOCOL_ADDR_SIZE + 1 + i * INDEX_SIZE, &node, INDEX_SIZE);
+            }
+
+            const transport_request_t *reply = NULL;
+            uint32_t id = 0;
+            err = ask(transport, &peer->addr, PROTOCOL_MERKLE, payload, PROTOCOL_ADDR_SIZE + 1 + count * INDEX_SIZE,
+                      &reply, &id);
+            if (err != ERR_NONE) break;
+
+            if (reply->reply_size != count * MERKLE_FANOUT * HASH_SIZE) {
+                err = ERR_NETWORK;
+            }
+
+            for (size_t i = 0; err == ERR_NONE && i < count; ++i) {
+                for (size_t c = 0; c < MERKLE_FANOUT; ++c) {
+                    uint32_t child = todo[first + i] * MERKLE_FANOUT + (uint32_t) c;
+                    if (protocol_read_stamp(reply->reply + (i * MERKLE_FANOUT + c) * HASH_SIZE) != children[child]) {
+                        next[nb_next++] = child;
+                    }
+                }
+            }
+            transport_forget(transport, id);
+        }
+
+        uint32_t *swap = todo;
+        todo = next;
+        next = swap;
+        nb_todo = nb_next;
+    }
+
+    //what is left differs at the last level, the leaves
+    *nb_differ = 0;
+    for (size_t i = 0; err == ERR_NONE && level == MERKLE_DEPTH && i < nb_todo; ++i) {
+        differ[todo[i] / 8] |= (uint8_t) (1 << (todo[i] % 8));
+        ++(*nb_differ);
+    }
+
+    free(todo);
+    free(next);
+    return err;
+}
+
+// =====================================================================
+
+static int collect_key(void *arg, pps_key_t key, size_t key_len, pps_value_t _unused value,
+                       size_t _unused value_len, uint64_t version)
+{
+    candidates_t *candidates = arg;
+
+    uint64_t key_hash = 0;
+    size_t leaf = MERKLE_LEAF_OF(merkle_position_of(key, key_len, &key_hash));
+    if (((candidates->differ[leaf / 8] >> (leaf % 8)) & 1) == 0) return 1;
+
+    //a key of a shared leaf may be in a range the peer does not replicate (or a hint)
+    const node_t *servers[candidates->ae->N];
+    size_t nb_servers = ring_get_preference_list(candidates->ae->ring, key, key_len, candidates->ae->N, servers);
+    int replica = 0;
+    for (size_t s = 0; !replica && s < nb_servers; ++s) {
+        replica = same_server(&servers[s]->srv_addr, &candidates->peer->addr);
+    }
+    if (!replica) return 1;
+
+    size_t length = PROTOCOL_STAMP_SIZE + protocol_field_size(key_len);
+    if (candidates->size + length > candidates->capacity) {
+        size_t capacity = 2 * candidates->capacity + length + ANTIENTROPY_BATCH_SIZE;
+        char *keys = realloc(candidates->keys, capacity);
+        if (keys == NULL) {
+            candidates->err = ERR_NOMEM;
+            return 0;
+        }
+        candidates->keys = keys;
+        candidates->capacity = capacity;
+    }
+
+    protocol_write_stamp(candidates->keys + candidates->size, version);
+    protocol_write_field(candidates->keys + candidates->size + PROTOCOL_STAMP_SIZE, key, key_len);
+    candidates->size += length;
+    ++(candidates->count);
+    return 1;
+}
+
+// =====================================================================
+
+static error_code push_keys(const antientropy_t *ae, const antientropy_peer_t *peer, transport_t *transport,
+                            const char *keys, size_t size, antientropy_stats_t *stats)
+{
+    push_t push = {malloc(PROTOCOL_MAX_PAYLOAD), 0};
+    M_EXIT_IF_NULL(push.pairs, PROTOCOL_MAX_PAYLOAD, "push_keys");
+
+    char needed[ANTIENTROPY_BATCH_SIZE];
+    error_code err = ERR_NONE;
+
+    for (size_t first = 0; err == ERR_NONE && first < size; ) {
+        //as many versions as fit in a datagram, or a single longer one
+        protocol_reader_t reader;
+        protocol_reader_init(&reader, keys + first, size - first);
+
+        const char *key = NULL;
+        size_t key_len = 0;
+        size_t end = first;
+        while (protocol_next_bytes(&reader, PROTOCOL_STAMP_SIZE) != NULL
+               && protocol_next_field(&reader, &key, &key_len)) {
+            size_t next = (size_t) (reader.pos - keys);
+            if (end > first && next - first > ANTIENTROPY_BATCH_SIZE) break;
+            end = next;
+        }
+
+        const transport_request_t *reply = NULL;
+        uint32_t id = 0;
+        err = ask(transport, &peer->addr, PROTOCOL_DIFF, keys + first, end - first, &reply, &id);
+        if (err != ERR_NONE) break;
+
+        //the reply is copied: the pushes below send other requests
+        size_t nb_needed = reply->reply_size < sizeof(needed) ? reply->reply_size : sizeof(needed);
+        memcpy(needed, reply->reply, nb_needed);
+        transport_forget(transport, id);
+
+        protocol_reader_init(&reader, keys + first, end - first);
+        for (size_t k = 0; err == ERR_NONE && protocol_next_bytes(&reader, PROTOCOL_STAMP_SIZE) != NULL
+                           && protocol_next_field(&reader, &key, &key_len); ++k) {
+            if (k < nb_needed && needed[k] == PROTOCOL_NOT_FOUND) {
+                err = push_pair(ae, peer, transport, &push, key, key_len, stats);
+            }
+        }
+
+        first = end;
+    }
+
+    if (err == ERR_NONE && push.used > 0) {
+        err = push_flush(peer, transport, &push, stats);
+    }
+
+    free(push.pairs);
+    return err;
+}
+
+// =====================================================================
+
+static error_code push_pair(const antientropy_t *ae, const antientropy_peer_t *peer, transport_t *transport,
+                            push_t *push, pps_key_t key, size_t key_len, antientropy_stats_t *stats)
+{
+    //the value of now, which may be newer than the version compared
+    store_view_t view;
+    if (store_get_view(ae->store, key, key_len, &view) != ERR_NONE) return ERR_NONE;
+
+    size_t length = PROTOCOL_STAMP_SIZE + protocol_field_size(key_len) + protocol_field_size(view.view.length);
+    error_code err = ERR_NONE;
+
+    if (push->used > 0 && push->used + length > ANTIENTROPY_BATCH_SIZE) {
+        err = push_flush(peer, transport, push, stats);
+    }
+
+    if (err == ERR_NONE && length <= PROTOCOL_MAX_PAYLOAD) {
+        protocol_write_stamp(push->pairs + push->used, view.view.version);
+        push->used += PROTOCOL_STAMP_SIZE;
+        push->used += protocol_write_field(push->pairs + push->used, key, key_len);
+        push->used += protocol_write_field(push->pairs + push->used, view.view.value, view.view.length);
+    }
+
+    store_release_view(ae->store, &view);
+    return err;
+}
+
+// =====================================================================
+
+static error_code push_flush(const antientropy_peer_t *peer, transport_t *transport, push_t *push,
+                             antientropy_stats_t *stats)
+{
+    const transport_request_t *reply = NULL;
+    uint32_t id = 0;
+    error_code err = ask(transport, &peer->addr, PROTOCOL_MPUT, push->pairs, push->used, &reply, &id);
+    push->used = 0;
+    if (err != ERR_NONE) return err;
+
+    for (size_t i = 0; i < reply->reply_size; ++i) {
+        stats->pushed += reply->reply[i] == PROTOCOL_OK;
+    }
+
+    transport_forget(transport, id);
+    return ERR_NONE;
+}
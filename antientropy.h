@@ -0,0 +1,132 @@
+#pragma once
+
+/**
+ * @file antientropy.h
+ * @brief Anti-entropy between the replicas: every ANTIENTROPY_PERIOD_MS, a
+ *        server compares its hash tree (see merkle.h) with the one of its
+ *        next peer (a server that replicates some ranges of the ring with
+ *        it), over the leaves they both replicate. It goes down the tree
+ *        only where the hashes differ, then sends the versions of its keys
+ *        of the differing leaves and pushes the values the peer lacks or
+ *        holds older. The peer does the same in its own rounds, so the
+ *        values go both ways.
+ *
+ *        A leaf cut by the end of a range the two servers do not share is
+ *        compared over its parts they both replicate (see merkle_cut): once
+ *        the replicas agree no leaf differs, and a round does not walk the store.
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h> // for struct sockaddr_in
+
+#include "error.h"
+#include "ring.h"
+#include "store.h"
+#include "merkle.h"
+#include "protocol.h"
+#include "transport.h"
+
+/**
+ * @brief time between two rounds, each with one peer
+ */
+#define ANTIENTROPY_PERIOD_MS 30000
+
+/**
+ * @brief how long a peer has to answer a request of a round
+ */
+#define ANTIENTROPY_TIMEOUT_MS 500
+
+/**
+ * @brief nodes of the tree asked per request (the reply holds their children)
+ */
+#define ANTIENTROPY_MAX_NODES 256
+
+/**
+ * @brief bytes of versions or pairs per datagram (as the multi-puts of the clients)
+ */
+#define ANTIENTROPY_BATCH_SIZE 8192
+
+/**
+ * @brief a server that replicates some ranges of the ring with this one
+ */
+typedef struct {
+    struct sockaddr_in addr;
+    uint8_t shared[MERKLE_LEAVES / 8]; // bit i set if both replicate the keys of leaf i before its first cut
+    uint8_t *parts;                    // bit c set if both replicate the keys after cut c (see merkle_t)
+    pthread_mutex_t lock;
+    uint64_t *tree;                    // the tree over the shared leaves, built when the peer starts a round
+} antientropy_peer_t;
+
+/**
+ * @brief what a round did
+ */
+typedef struct {
+    size_t leaves;   // leaves that differ
+    size_t compared; // keys whose versions were sent
+    size_t pushed;   // values written on the peer
+    size_t bytes;    // sent and received, headers included
+} antientropy_stats_t;
+
+/**
+ * @brief the anti-entropy of a server
+ */
+typedef struct {
+    store_t *store;
+    const ring_t *ring;
+    size_t N;                    // number of servers of a key
+    struct sockaddr_in self;
+    antientropy_peer_t *peers;
+    size_t nb_peers;
+    size_t next;                 // peer of the next round
+} antientropy_t;
+
+/**
+ * @brief find the peers of a server on the ring, and cut the tree of the store at its nodes
+ * @param store the content of the server, still empty (opened once the tree is cut)
+ * @param ring the ring, which must outlive the anti-entropy
+ * @param N number of servers of a key
+ * @param self address of the server
+ * @return the anti-entropy (without peer if the server is not on the ring), NULL on error
+ */
+antientropy_t *antientropy_new(store_t *store, const ring_t *ring, size_t N, const struct sockaddr_in *self);
+
+/**
+ * @brief free an anti-entropy
+ * @param ae the anti-entropy, may be NULL
+ */
+void antientropy_free(antientropy_t *ae);
+
+/**
+ * @brief compare the tree of the server with the one of its next peer, and
+ *        push the values the peer lacks
+ * @param ae the anti-entropy
+ * @param transport socket to the peers
+ * @param stats where to store what the round did
+ * @return ERR_NONE, ERR_NETWORK if the peer did not answer, or another error code
+ */
+error_code antientropy_round(antientropy_t *ae, transport_t *transport, antientropy_stats_t *stats);
+
+/**
+ * @brief answer PROTOCOL_MERKLE: the children of some nodes of the tree
+ *        over the leaves shared with the server asking
+ * @param ae the anti-entropy
+ * @param payload the request, <peer><level><index1>...
+ * @param size size of the request
+ * @param reply where to write the reply, of PROTOCOL_MAX_PAYLOAD bytes
+ * @param reply_size where to store the size of the reply
+ * @return the status of the reply
+ */
+protocol_status_t antientropy_reply_tree(antientropy_t *ae, const char *payload, size_t size, char *reply,
+                                         size_t *reply_size);
+
+/**
+ * @brief answer PROTOCOL_DIFF: which versions of keys the server already holds
+ * @param store the content of the server
+ * @param payload the request, <version1><key1><version2><key2>... (see PROTOCOL_DIFF)
+ * @param size size of the request
+ * @param reply where to write a status byte per key
+ * @return number of keys (size of the reply)
+ */
+size_t antientropy_reply_diff(store_t *store, const char *payload, size_t size, char *reply);
@@ -57,7 +57,7 @@ args_t *parse_opt_args(size_t supported_args, char ***rem_argv) {
     if (supported_args != 0) {
 
         //while we have arguments
-        while (strncmp((*rem_argv)[0], "--", 2) != 0) {
+        while ((*rem_argv)[0] != NULL && strncmp((*rem_argv)[0], "--", 2) != 0) {
             //Check for -n
             if (strncmp((*rem_argv)[0], "-n", 2) == 0) {
                 //Check for the flag and if we already have a -n
@@ -138,8 +138,8 @@ args_t *parse_opt_args(size_t supported_args, char ***rem_argv) {
             }
 
         }
-        //Found a [--]
-        ++(*rem_argv);
+        //Found a [--] (or no argument after the optional ones)
+        if ((*rem_argv)[0] != NULL) ++(*rem_argv);
     }
     return parsedArgs;
 
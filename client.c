@@ -44,6 +44,8 @@ void client_end(client_t *client) {
         free(client->parsedOpt);
         client->parsedOpt = NULL;
         delete_Htable_and_content(&client -> nodes_status);
+        transport_free(client->transport);
+        client->transport = NULL;
     }
 }
 
@@ -54,6 +56,7 @@ error_code client_init(client_init_args_t *client_args) {
     M_EXIT_IF_NULL(client_args->client, sizeof(client_args->client), "client.c/client_init");
     
     client_args->client -> name = *(client_args->argv)[0];
+    client_args->client -> transport = NULL;
 
 	//Removing the first args(name) before computing
     *(client_args->argv) += 1;
@@ -115,6 +118,17 @@ error_code client_init(client_init_args_t *client_args) {
         fprintf(stderr, "Can't get the nodes from the file\n");
         return ERR_IO;
     }
+
+    //the sockets are opened once for all the operations of the client
+    client_args->client->transport = transport_new(ring, PPS_HEALTH_FILENAME);
+
+    if (client_args->client->transport == NULL) {
+        free(args);
+        args = NULL;
+        ring_free(ring);
+        fprintf(stderr, "Could not open the sockets to the servers\n");
+        return ERR_NETWORK;
+    }
     
     //Adapt W and R if N = 1
     if(client_args -> client -> parsedOpt -> N == 1){
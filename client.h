@@ -14,6 +14,7 @@
 #include "node_list.h" // weeks 6 to 10
 #include "args.h"      // weeks 10 and after
 #include "ring.h"      // weeks 11 and after
+#include "transport.h"
 
 /**
  * @brief client state
@@ -23,6 +24,7 @@ typedef struct{
 	ring_t* node;
 	args_t* parsedOpt;
 	Htable_t nodes_status;
+	transport_t* transport; // sockets to the servers, shared by the copies of the client
 } client_t;
 
 /**
@@ -27,6 +27,11 @@
  */
 #define PPS_SERVERS_LIST_FILENAME "servers.txt"
 
+/**
+ * @brief local file where the clients share the health of the servers
+ */
+#define PPS_HEALTH_FILENAME ".pps-health"
+
 /**
  * @brief maximum number of bytes in a key or a value in messages without '\0'
  */
@@ -17,139 +17,441 @@
 #include "hashtable.h"
 #include "util.h"
 
+#define HTABLE_MIN_SIZE 8
+#define HTABLE_MAX_SIZE ((size_t) 1 << 31)
+#define HTABLE_OVERFLOW_SLOTS 64 // slots after the last home slot
+#define HTABLE_MIGRATE_STEP 32 // slots moved by each operation during a resize
+#define HTABLE_MAX_PROBE 128 // longer runs make the table grow, whatever its load
+
 /**
- * @brief free all the allocated space of a linked list starting with head
- * @param head first element of the list
+ * @brief entry of the hashtable: metadata, key and value in one slab chunk
+ * @var htable_entry::chunk_size
+ * Member 'chunk_size' contains the usable size of the chunk, as given by the slab
+ * @var htable_entry::refs
+ * Member 'refs' counts the table itself (while the entry is in a slot) plus the pinning views
+ * @var htable_entry::key_len
+ * Member 'key_len' contains the length of the key (without the final '\0')
+ * @var htable_entry::value_len
+ * Member 'value_len' contains the length of the value (without the final '\0')
+ * @var htable_entry::data
+ * Member 'data' contains the key, a '\0', the value and a '\0'
  */
-static void delete_bucket_list(bucket_t **head);
+typedef struct htable_entry {
+    uint32_t chunk_size;
+    uint32_t refs;
+    uint32_t key_len;
+    uint32_t value_len;
+    uint64_t version; // see hlc.h, 0 if the value is not versioned
+    char data[];
+} htable_entry_t;
 
 /**
- * @brief get the bucket corresponding to a given key
- * @param key
- * @param table
- * @return Null if the key is not in the table or the bucket
+ * @brief slot of the hashtable
+ * @var bucket::entry
+ * Member 'entry' points to the key and value stored in the slot
  */
-static bucket_t *get_bucket(pps_key_t key, Htable_t table);
+struct bucket {
+    htable_entry_t *entry;
+};
 
-//======================================================================
+#define ENTRY_SIZE(key_len, value_len) (sizeof(htable_entry_t) + (key_len) + (value_len) + 2)
+#define ENTRY_KEY(e) ((e)->data)
+#define ENTRY_VALUE(e) ((e)->data + (e)->key_len + 1)
 
 /**
- * @brief node for the hashtable
- * @var bucket::pair
- * Member 'pair' contains the pair of key and value of the node
- * @var bucket::next
- * Member 'next' contains a pointer to the successor of the node in the linked list
+ * @brief compute the full hash of a key (used to place it in the table)
+ * @param key the key to hash
+ * @param len length of the key
+ * @return the 32 bits hash of the key
  */
-struct bucket {
-    kv_pair_t pair;
-    struct bucket *next;
-};
+static uint32_t hash_key(pps_key_t key, size_t len);
+
+/**
+ * @brief allocate a new entry in the slab of a table
+ * @param table the table owning the entry
+ * @param key the key
+ * @param key_len length of the key
+ * @param value the value
+ * @param value_len length of the value
+ * @param version version of the value
+ * @return the new entry or NULL if there is no memory left
+ */
+static htable_entry_t *entry_new(Htable_t table, pps_key_t key, size_t key_len,
+                                 pps_value_t value, size_t value_len, uint64_t version);
+
+/**
+ * @brief give back an entry to the slab of its table
+ * @param table the table owning the entry
+ * @param entry the entry to free
+ */
+static void entry_free(Htable_t table, htable_entry_t *entry);
+
+/**
+ * @brief drop a reference to an entry, freeing it once it is neither in
+ *        the table nor pinned by a view
+ * @param table the table owning the entry
+ * @param entry the entry to release
+ */
+static void entry_unref(Htable_t table, htable_entry_t *entry);
+
+/**
+ * @brief allocate the slots of an array
+ * @param array the array to initialize
+ * @param size number of home slots, a power of two
+ * @return ERR_NONE or ERR_NOMEM
+ */
+static error_code array_init(htable_array_t *array, size_t size);
+
+/**
+ * @brief free the slots of an array (not the content of the buckets)
+ * @param array the array to free
+ */
+static void array_free(htable_array_t *array);
+
+/**
+ * @brief find the slot holding a key in an array
+ * @param array the array to search into
+ * @param hash the hash of the key
+ * @param key the key
+ * @param len length of the key
+ * @return the index of the slot or SIZE_MAX if the key is not there
+ */
+static size_t array_find(const htable_array_t *array, uint32_t hash, pps_key_t key, size_t len);
+
+/**
+ * @brief insert a new entry in an array, keeping the Robin Hood invariant
+ * @param array the array where to insert
+ * @param hash the hash of the key
+ * @param bucket the entry to insert
+ * @return the largest distance to its home slot of the entries moved
+ *         (at least 1), 0 if the entry does not fit before the end of the array
+ */
+static size_t array_insert(htable_array_t *array, uint32_t hash, const bucket_t *bucket);
+
+/**
+ * @brief remove the entry of a slot, shifting back the following ones
+ * @param array the array where to remove
+ * @param pos the slot to empty
+ */
+static void array_remove(htable_array_t *array, size_t pos);
+
+/**
+ * @brief move some slots of the old array into the current one
+ * @param table the table being resized
+ * @param slots maximum number of slots to move
+ * @return ERR_NONE or ERR_NOMEM
+ */
+static error_code migrate(Htable_t table, size_t slots);
+
+/**
+ * @brief start a resize: the current array becomes the old one
+ * @param table the table to grow
+ * @return ERR_NONE or ERR_NOMEM
+ */
+static error_code grow(Htable_t table);
+
+/**
+ * @brief synchronously move every entry into a new array of at least the given size
+ *        (only used when an array overflows, which should be very rare)
+ * @param table the table to rebuild
+ * @param size minimum number of home slots
+ * @return ERR_NONE or ERR_NOMEM
+ */
+static error_code rebuild(Htable_t table, size_t size);
+
+/**
+ * @brief free the entries of an array
+ * @param table the table owning the entries
+ * @param array the array to empty
+ */
+static void delete_array_content(Htable_t table, htable_array_t *array);
+
+/**
+ * @brief an entry met by a scan, with its hash
+ */
+typedef struct {
+    uint32_t hash;
+    const htable_entry_t *entry;
+} scan_item_t;
+
+/**
+ * @brief gather the live entries of an array whose hash is in a range
+ * @param array the array
+ * @param from first hash of the range
+ * @param to end of the range (excluded), a multiple of the home slots of the array
+ * @param items where to add the entries (grown as needed)
+ * @param nb_items number of entries already there, updated
+ * @param capacity number of entries items can hold, updated
+ * @return ERR_NONE or ERR_NOMEM
+ */
+static error_code gather_range(const htable_array_t *array, uint64_t from, uint64_t to,
+                               scan_item_t **items, size_t *nb_items, size_t *capacity);
+
+/**
+ * @brief order of the entries of a scan
+ * @param a the first scan_item_t
+ * @param b the second one
+ * @return <0, 0 or >0 as their hashes compare
+ */
+static int cmp_items(const void *a, const void *b);
 
 //======================================================================
 
+/**
+ * @brief location of an entry
+ */
+typedef struct {
+    htable_array_t *array;
+    size_t pos;
+} slot_ref_t;
+
+/**
+ * @brief find the slot holding a key, in the current array or in the old one
+ * @param table the table where to search
+ * @param key the key
+ * @param hash hash of the key
+ * @param len length of the key
+ * @return the location, with array NULL if the key is not in the table
+ */
+static slot_ref_t find_slot(Htable_t table, pps_key_t key, uint32_t hash, size_t len)
+{
+    slot_ref_t ref = {NULL, SIZE_MAX};
+
+    ref.pos = array_find(&table->current, hash, key, len);
+    if (ref.pos != SIZE_MAX) {
+        ref.array = &table->current;
+    } else if (table->old.meta != NULL) {
+        ref.pos = array_find(&table->old, hash, key, len);
+        if (ref.pos != SIZE_MAX) ref.array = &table->old;
+    }
+
+    return ref;
+}
+
+//======================================================================
 
 error_code add_Htable_value(Htable_t table, pps_key_t key, pps_value_t value)
+{
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(value);
+
+    return add_Htable_versioned_value(table, key, strlen(key), value, strlen(value), 0);
+}
+
+//======================================================================
+
+error_code add_Htable_versioned_value(Htable_t table, pps_key_t key, size_t len,
+                                      pps_value_t value, size_t value_len, uint64_t version)
 {
 
     //test that the arguments are valid
     M_REQUIRE_NON_NULL(table);
-    M_REQUIRE_NON_NULL(table->table);
+    M_REQUIRE_NON_NULL(table->current.meta);
     M_REQUIRE_NON_NULL(key);
     M_REQUIRE_NON_NULL(value);
 
-    //copy key and value
-    pps_value_t copied_key = strdup(key);
-    M_REQUIRE_NON_NULL_CUSTOM_ERR(copied_key, ERR_NOMEM);
-    pps_value_t copied_value = strdup(value);
-    M_REQUIRE_NON_NULL_CUSTOM_ERR(copied_value, ERR_NOMEM);
-
-    bucket_t *b = get_bucket(key, table);
+    //move a few slots if a resize is in progress
+    error_code err = migrate(table, HTABLE_MIGRATE_STEP);
+    if (err != ERR_NONE) return err;
+
+    uint32_t hash = hash_key(key, len);
+    slot_ref_t ref = find_slot(table, key, hash, len);
+
+    if (ref.array != NULL) {
+        //the key is already in the hashtable
+        bucket_t *b = &ref.array->buckets[ref.pos];
+        htable_entry_t *e = b->entry;
+
+        if (e->refs == 1 && ENTRY_SIZE(len, value_len) <= e->chunk_size) {
+            //nobody borrows the value and the new one fits: overwrite in place
+            slab_resize(&table->slab, e->chunk_size, ENTRY_SIZE(len, e->value_len), ENTRY_SIZE(len, value_len));
+            memcpy(ENTRY_VALUE(e), value, value_len);
+            ENTRY_VALUE(e)[value_len] = '\0';
+            e->value_len = (uint32_t) value_len;
+            e->version = version;
+            return ERR_NONE;
+        }
 
-    if (b != NULL) {
-        //the key is already associated with a bucket in the hashtable
-        free_const_ptr(b->pair.value);
-        b->pair.value = copied_value;
+        htable_entry_t *replacement = entry_new(table, key, len, value, value_len, version);
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(replacement, ERR_NOMEM);
+        entry_unref(table, e);
+        b->entry = replacement;
         return ERR_NONE;
-    } else {
-        //create a new bucket for the new key
+    }
+
+    //new key: make sure there is room for it
+    if (table->nbr_elems + 1 > table->current.size - table->current.size / 8) {
+        err = grow(table);
+        if (err != ERR_NONE) return err;
+    }
 
-        bucket_t *new_bucket = NULL;
-        new_bucket = malloc(sizeof(bucket_t));
+    bucket_t new_bucket = {entry_new(table, key, len, value, value_len, version)};
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(new_bucket.entry, ERR_NOMEM);
 
-        if(new_bucket == NULL) {
+    size_t probe = 0;
+    while ((probe = array_insert(&table->current, hash, &new_bucket)) == 0) {
+        err = rebuild(table, 2 * table->current.size);
+        if (err != ERR_NONE) {
             fprintf(stderr, "Error whilst adding a value to the hashtable in %s", __FILE__);
-            free_const_ptr(copied_key);
-            free_const_ptr(copied_value);
-            return ERR_NOMEM;
+            entry_free(table, new_bucket.entry);
+            return err;
         }
+    }
 
-        //initialize new bucket
-        new_bucket->pair.value = copied_value;
-        new_bucket->pair.key = copied_key;
-        size_t hashed_key = hash_function(copied_key, table->size);
-        new_bucket->next = table->table[hashed_key];
-
-        //modify entry of the hashtable
-        ++(table->nbr_elems);
-        table->table[hashed_key] = new_bucket;
+    ++(table->nbr_elems);
 
-        return ERR_NONE;
+    //keys packed in a part of the hash space (e.g. inserted in hash order, as when
+    //loading a snapshot) make long runs at any load: spread them over more slots
+    if (probe > HTABLE_MAX_PROBE && table->nbr_elems > table->current.size / 64
+        && table->current.size < HTABLE_MAX_SIZE && grow(table) != ERR_NONE) {
+        fprintf(stderr, "Could not grow the hashtable, lookups may be slow\n");
     }
 
+    return ERR_NONE;
+
 }
 
 //======================================================================
 
-static bucket_t *get_bucket(pps_key_t key, Htable_t table)
+pps_value_t get_Htable_value(Htable_t table, pps_key_t key)
 {
 
-    size_t hashed_key = hash_function(key, table->size);
-    size_t n = strlen(key);
+    if (table == NULL || table->current.meta == NULL || key == NULL) {
+        fprintf(stderr, "Null pointer in get_Htable_value\n");
+        return NULL;
+    }
 
-    if (table->table[hashed_key] == NULL) return NULL;
+    if (migrate(table, HTABLE_MIGRATE_STEP) != ERR_NONE) {
+        return NULL;
+    }
 
-    bucket_t *curr = table->table[hashed_key];
+    size_t len = strlen(key);
+    uint32_t hash = hash_key(key, len);
+    slot_ref_t ref = find_slot(table, key, hash, len);
 
-    while (curr != NULL) {
-        if (strlen(curr->pair.key) == n && strncmp(curr->pair.key, key, n) == 0) {
-            return curr;
-        }
-        curr = curr->next;
+    if (ref.array == NULL) {
+        return NULL;
     }
 
-    return NULL;
+    const htable_entry_t *e = ref.array->buckets[ref.pos].entry;
+    char *copy = malloc(e->value_len + 1);
+    if (copy != NULL) {
+        memcpy(copy, ENTRY_VALUE(e), e->value_len + 1);
+    }
+
+    return copy;
 
 }
 
 //======================================================================
 
-pps_value_t get_Htable_value(Htable_t table, pps_key_t key)
+error_code get_Htable_view(Htable_t table, pps_key_t key, size_t len, Htable_view_t *view)
 {
+    M_REQUIRE_NON_NULL(table);
+    M_REQUIRE_NON_NULL(table->current.meta);
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(view);
 
-    if (table->table == NULL || key == NULL) {
-        fprintf(stderr, "Null pointer in get_Htable_value\n");
-        return NULL;
-    } else {
-        bucket_t *b = get_bucket(key, table);
+    error_code err = migrate(table, HTABLE_MIGRATE_STEP);
+    if (err != ERR_NONE) return err;
 
-        if (b == NULL) {
-            return NULL;
-        } else {
-            return strdup(b->pair.value);
-        }
+    uint32_t hash = hash_key(key, len);
+    slot_ref_t ref = find_slot(table, key, hash, len);
+
+    if (ref.array == NULL) {
+        return ERR_NOT_FOUND;
+    }
+
+    htable_entry_t *e = ref.array->buckets[ref.pos].entry;
+    ++(e->refs);
+
+    view->value = ENTRY_VALUE(e);
+    view->length = e->value_len;
+    view->version = e->version;
+    view->pin = e;
+
+    return ERR_NONE;
+}
+
+//======================================================================
+
+void release_Htable_view(Htable_t table, Htable_view_t *view)
+{
+    if (table == NULL || view == NULL || view->pin == NULL) return;
+
+    entry_unref(table, view->pin);
+    view->value = NULL;
+    view->length = 0;
+    view->pin = NULL;
+}
+
+//======================================================================
+
+int has_Htable_key(Htable_t table, pps_key_t key, size_t len)
+{
+    if (table == NULL || table->current.meta == NULL || key == NULL) return 0;
+
+    return find_slot(table, key, hash_key(key, len), len).array != NULL;
+}
+
+//======================================================================
+
+error_code settle_Htable(Htable_t table)
+{
+    M_REQUIRE_NON_NULL(table);
+
+    return migrate(table, SIZE_MAX);
+}
+
+//======================================================================
+
+error_code del_Htable_key(Htable_t table, pps_key_t key, size_t len)
+{
+    M_REQUIRE_NON_NULL(table);
+    M_REQUIRE_NON_NULL(table->current.meta);
+    M_REQUIRE_NON_NULL(key);
+
+    error_code err = migrate(table, HTABLE_MIGRATE_STEP);
+    if (err != ERR_NONE) return err;
+
+    uint32_t hash = hash_key(key, len);
+    slot_ref_t ref = find_slot(table, key, hash, len);
+
+    if (ref.array == NULL) {
+        return ERR_NOT_FOUND;
+    }
+
+    entry_unref(table, ref.array->buckets[ref.pos].entry);
+
+    if (ref.array == &table->old) {
+        //the old array is only read until it is drained: leave a tombstone
+        table->old.meta[ref.pos].dead = 1;
+        --(table->old.nbr_elems);
+    } else {
+        array_remove(&table->current, ref.pos);
     }
 
+    --(table->nbr_elems);
+    return ERR_NONE;
 }
 
 //======================================================================
 
 size_t hash_function(pps_key_t key, size_t table_size)
+{
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(key, SIZE_MAX);
+
+    return hash_bytes(key, strlen(key), table_size);
+}
+
+//======================================================================
+
+size_t hash_bytes(pps_key_t key, size_t key_len, size_t table_size)
 {
     M_REQUIRE(table_size != 0, SIZE_MAX, "size == %d", 0);
     M_REQUIRE_NON_NULL_CUSTOM_ERR(key, SIZE_MAX);
 
     size_t hash = 0;
-    const size_t key_len = strlen(key);
     for (size_t i = 0; i < key_len; ++i) {
         hash += (unsigned char) key[i];
         hash += (hash << 10);
@@ -163,35 +465,62 @@ size_t hash_function(pps_key_t key, size_t table_size)
 
 //======================================================================
 
-Htable_t construct_Htable(size_t size)
+static uint32_t hash_key(pps_key_t key, size_t len)
 {
-    if (size == 0) {
-        fprintf(stderr, "Size is 0 in construct_Htable\n");
-        return NO_HTABLE;
+    //same mixing as hash_function
+    size_t hash = 0;
+    for (size_t i = 0; i < len; ++i) {
+        hash += (unsigned char) key[i];
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
     }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
 
-    bucket_t **tab = calloc(size, sizeof(bucket_t *));
+    //fold and finalize (murmur3) so that the top bits are well distributed
+    uint32_t h = (uint32_t) (hash ^ (hash >> 32));
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
 
-    if (tab == NULL) {
-        fprintf(stderr, "Memory error in construct_Htable\n");
+//======================================================================
+
+Htable_t construct_Htable(size_t size)
+{
+    if (size == 0) {
+        fprintf(stderr, "Size is 0 in construct_Htable\n");
         return NO_HTABLE;
     }
 
-    //initialize all bucket* to NULL
-    for (size_t i = 0; i < size; i++) {
-        tab[i] = NULL;
+    //the number of home slots has to be a power of two
+    size_t slots = HTABLE_MIN_SIZE;
+    while (slots < size && slots < HTABLE_MAX_SIZE) {
+        slots *= 2;
     }
 
-    Htable_t new_htable = malloc(sizeof(Htable));
+    Htable_t new_htable = calloc(1, sizeof(Htable));
 
     if (new_htable == NULL) {
         fprintf(stderr, "Memory error when allocating memory for new_htable\n");
         return NO_HTABLE;
     }
 
-    new_htable->size = size;
+    if (array_init(&new_htable->current, slots) != ERR_NONE) {
+        fprintf(stderr, "Memory error in construct_Htable\n");
+        free(new_htable);
+        return NO_HTABLE;
+    }
+
+    slab_init(&new_htable->slab);
+    new_htable->size = slots;
     new_htable->nbr_elems = 0;
-    new_htable->table = tab;
+    new_htable->old.meta = NULL;
+    new_htable->migrated = 0;
     return new_htable;
 }
 
@@ -201,39 +530,400 @@ void delete_Htable_and_content(Htable_t *table)
 {
 
     if (table != NULL && *table != NULL) {
-        for (size_t i = 0; i < (*table)->size; i++) {
-            if((*table)->table[i] != NULL){
-                delete_bucket_list(&(*table)->table[i]);
-                free((*table)->table[i]);
-                (*table)->table[i] = NULL;
+        delete_array_content(*table, &(*table)->current);
+        array_free(&(*table)->current);
+        delete_array_content(*table, &(*table)->old);
+        array_free(&(*table)->old);
+        slab_destroy(&(*table)->slab);
+
+        free(*table);
+        *table = NULL;
+    }
+
+}
+
+//======================================================================
+
+void clear_Htable(Htable_t table)
+{
+    if (table == NULL || table->current.meta == NULL) return;
+
+    //the entries still pinned by a view are freed on its release
+    htable_array_t *arrays[] = {&table->current, &table->old};
+    for (size_t a = 0; a < 2; ++a) {
+        htable_array_t *array = arrays[a];
+        for (size_t i = 0; array->meta != NULL && i < array->capacity; ++i) {
+            if (array->meta[i].dist != 0 && !array->meta[i].dead) {
+                entry_unref(table, array->buckets[i].entry);
             }
         }
+    }
 
-        free((*table)->table);
-        free(*table);
-        table = NULL;
+    //the current array keeps its size, the table is likely to fill up again
+    array_free(&table->old);
+    memset(table->current.meta, 0, table->current.capacity * sizeof(slot_meta_t));
+    table->current.nbr_elems = 0;
+    table->nbr_elems = 0;
+    table->migrated = 0;
+}
+
+//======================================================================
+
+static void delete_array_content(Htable_t table, htable_array_t *array)
+{
+    if (array->meta == NULL) return;
+
+    for (size_t i = 0; i < array->capacity; ++i) {
+        if (array->meta[i].dist != 0 && !array->meta[i].dead) {
+            entry_free(table, array->buckets[i].entry);
+        }
+    }
+}
+
+//======================================================================
+
+static htable_entry_t *entry_new(Htable_t table, pps_key_t key, size_t key_len,
+                                 pps_value_t value, size_t value_len, uint64_t version)
+{
+    size_t usable = 0;
+    htable_entry_t *e = slab_alloc(&table->slab, ENTRY_SIZE(key_len, value_len), &usable);
+
+    if (e == NULL) {
+        fprintf(stderr, "Could not allocate a new entry in %s\n", __FILE__);
+        return NULL;
+    }
+
+    e->chunk_size = (uint32_t) usable;
+    e->refs = 1;
+    e->key_len = (uint32_t) key_len;
+    e->value_len = (uint32_t) value_len;
+    e->version = version;
+    memcpy(ENTRY_KEY(e), key, key_len);
+    ENTRY_KEY(e)[key_len] = '\0';
+    memcpy(ENTRY_VALUE(e), value, value_len);
+    ENTRY_VALUE(e)[value_len] = '\0';
+
+    return e;
+}
+
+//======================================================================
+
+static void entry_free(Htable_t table, htable_entry_t *entry)
+{
+    slab_free(&table->slab, entry, entry->chunk_size, ENTRY_SIZE(entry->key_len, entry->value_len));
+}
+
+//======================================================================
+
+static void entry_unref(Htable_t table, htable_entry_t *entry)
+{
+    if (--(entry->refs) == 0) {
+        entry_free(table, entry);
+    }
+}
+
+//======================================================================
+
+static error_code array_init(htable_array_t *array, size_t size)
+{
+    unsigned bits = 0;
+    while (((size_t) 1 << bits) < size) {
+        ++bits;
+    }
+
+    array->size = size;
+    array->capacity = size + HTABLE_OVERFLOW_SLOTS;
+    array->shift = 32 - bits;
+    array->nbr_elems = 0;
+    array->meta = calloc(array->capacity, sizeof(slot_meta_t));
+    array->buckets = calloc(array->capacity, sizeof(bucket_t));
+
+    if (array->meta == NULL || array->buckets == NULL) {
+        array_free(array);
+        return ERR_NOMEM;
+    }
+
+    return ERR_NONE;
+}
+
+//======================================================================
+
+static void array_free(htable_array_t *array)
+{
+    free(array->meta);
+    free(array->buckets);
+    array->meta = NULL;
+    array->buckets = NULL;
+    array->nbr_elems = 0;
+}
+
+//======================================================================
+
+static size_t array_find(const htable_array_t *array, uint32_t hash, pps_key_t key, size_t len)
+{
+    size_t pos = (size_t) ((uint64_t) hash >> array->shift);
+
+    //Robin Hood: stop as soon as a slot is closer to its home than we would be
+    for (uint16_t dist = 1; pos < array->capacity && array->meta[pos].dist >= dist; ++pos, ++dist) {
+        const slot_meta_t *m = &array->meta[pos];
+        if (m->hash == hash && !m->dead) {
+            const htable_entry_t *e = array->buckets[pos].entry;
+            if (e->key_len == len && memcmp(ENTRY_KEY(e), key, len) == 0) {
+                return pos;
+            }
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+//======================================================================
+
+static size_t array_insert(htable_array_t *array, uint32_t hash, const bucket_t *bucket)
+{
+    size_t pos = (size_t) ((uint64_t) hash >> array->shift);
+    uint16_t dist = 1;
+
+    //find where the entry goes: first slot that is poorer than us
+    while (pos < array->capacity && array->meta[pos].dist >= dist) {
+        ++pos;
+        ++dist;
+        if (dist == UINT16_MAX) return 0;
+    }
+
+    //find the first empty slot from there
+    size_t empty = pos;
+    while (empty < array->capacity && array->meta[empty].dist != 0) {
+        if (array->meta[empty].dist == UINT16_MAX - 1) return 0;
+        ++empty;
     }
 
+    if (empty == array->capacity) return 0;
 
+    //shift the run by one slot to make room
+    memmove(&array->meta[pos + 1], &array->meta[pos], (empty - pos) * sizeof(slot_meta_t));
+    memmove(&array->buckets[pos + 1], &array->buckets[pos], (empty - pos) * sizeof(bucket_t));
+    for (size_t i = pos + 1; i <= empty; ++i) {
+        ++(array->meta[i].dist);
+    }
+
+    slot_meta_t m = {hash, dist, 0};
+    array->meta[pos] = m;
+    array->buckets[pos] = *bucket;
+    ++(array->nbr_elems);
+
+    return array->meta[empty].dist;
+}
+
+//======================================================================
+
+static void array_remove(htable_array_t *array, size_t pos)
+{
+    //backward shift the entries that are not at their home slot
+    size_t end = pos + 1;
+    while (end < array->capacity && array->meta[end].dist > 1) {
+        ++end;
+    }
+
+    memmove(&array->meta[pos], &array->meta[pos + 1], (end - pos - 1) * sizeof(slot_meta_t));
+    memmove(&array->buckets[pos], &array->buckets[pos + 1], (end - pos - 1) * sizeof(bucket_t));
+    for (size_t i = pos; i + 1 < end; ++i) {
+        --(array->meta[i].dist);
+    }
+
+    memset(&array->meta[end - 1], 0, sizeof(slot_meta_t));
+    memset(&array->buckets[end - 1], 0, sizeof(bucket_t));
+    --(array->nbr_elems);
+}
+
+//======================================================================
+
+static error_code migrate(Htable_t table, size_t slots)
+{
+    if (table->old.meta == NULL) return ERR_NONE;
+
+    htable_array_t *old = &table->old;
+
+    for (; slots > 0 && table->migrated < old->capacity; --slots, ++(table->migrated)) {
+        slot_meta_t *m = &old->meta[table->migrated];
+
+        if (m->dist != 0 && !m->dead) {
+            if (!array_insert(&table->current, m->hash, &old->buckets[table->migrated])) {
+                //current array overflowed: move everything at once
+                return rebuild(table, 2 * table->current.size);
+            }
+            //keep the slot as a tombstone so that lookups in old still work
+            m->dead = 1;
+            --(old->nbr_elems);
+        }
+    }
+
+    if (table->migrated == old->capacity) {
+        array_free(old);
+        table->migrated = 0;
+    }
+
+    return ERR_NONE;
+}
+
+//======================================================================
+
+static error_code grow(Htable_t table)
+{
+    //finish the previous resize first
+    error_code err = migrate(table, SIZE_MAX);
+    if (err != ERR_NONE) return err;
+
+    if (table->current.size >= HTABLE_MAX_SIZE) {
+        return ERR_NOMEM;
+    }
+
+    htable_array_t bigger;
+    err = array_init(&bigger, 2 * table->current.size);
+    if (err != ERR_NONE) return err;
+
+    table->old = table->current;
+    table->current = bigger;
+    table->size = bigger.size;
+    table->migrated = 0;
+
+    return ERR_NONE;
+}
+
+//======================================================================
+
+static error_code rebuild(Htable_t table, size_t size)
+{
+    for (; size <= HTABLE_MAX_SIZE; size *= 2) {
+        htable_array_t fresh;
+        error_code err = array_init(&fresh, size);
+        if (err != ERR_NONE) return err;
+
+        int fits = 1;
+        htable_array_t *arrays[] = {&table->current, &table->old};
+
+        for (size_t a = 0; fits && a < 2; ++a) {
+            htable_array_t *array = arrays[a];
+            for (size_t i = 0; fits && array->meta != NULL && i < array->capacity; ++i) {
+                if (array->meta[i].dist != 0 && !array->meta[i].dead) {
+                    fits = array_insert(&fresh, array->meta[i].hash, &array->buckets[i]);
+                }
+            }
+        }
+
+        if (fits) {
+            array_free(&table->current);
+            array_free(&table->old);
+            table->current = fresh;
+            table->size = fresh.size;
+            table->migrated = 0;
+            return ERR_NONE;
+        }
+
+        array_free(&fresh);
+    }
+
+    return ERR_NOMEM;
 }
 
 //======================================================================
 
+void print_Htable_stats(Htable_t table, FILE *out)
+{
+    if (table == NULL || out == NULL) return;
+
+    fprintf(out, "%zu entries, %zu slots%s\n", table->nbr_elems, table->current.capacity,
+            table->old.meta != NULL ? " (resizing)" : "");
+    slab_print_stats(&table->slab, out);
+}
+
+//======================================================================
 
-static void delete_bucket_list(bucket_t **head)
+error_code scan_Htable(Htable_t table, uint64_t *position, Htable_visitor_t visit, void *arg)
 {
+    M_REQUIRE_NON_NULL(table);
+    M_REQUIRE_NON_NULL(position);
+    M_REQUIRE_NON_NULL(visit);
+
+    //range by range of hashes, a home slot of the smaller array (whole home slots of
+    //the other one during a resize): its entries are gathered from both, then sorted
+    unsigned shift = table->current.shift;
+    if (table->old.meta != NULL && table->old.shift > shift) shift = table->old.shift;
+
+    scan_item_t *items = NULL;
+    size_t capacity = 0;
+    error_code err = ERR_NONE;
+
+    while (err == ERR_NONE && *position < HTABLE_SCAN_END) {
+        uint64_t to = ((*position >> shift) + 1) << shift;
+        size_t nb_items = 0;
 
-    if (head != NULL) {
+        err = gather_range(&table->current, *position, to, &items, &nb_items, &capacity);
+        if (err == ERR_NONE && table->old.meta != NULL) {
+            err = gather_range(&table->old, *position, to, &items, &nb_items, &capacity);
+        }
+        if (err != ERR_NONE) break;
+
+        if (nb_items > 1) qsort(items, nb_items, sizeof(scan_item_t), cmp_items);
+
+        size_t i = 0;
+        for (; i < nb_items; ++i) {
+            const htable_entry_t *e = items[i].entry;
+            if (!visit(arg, ENTRY_KEY(e), e->key_len, ENTRY_VALUE(e), e->value_len, e->version)) break;
+        }
+
+        if (i < nb_items) {
+            *position = items[i].hash;
+            break;
+        }
+        *position = to;
+    }
+
+    free(items);
+    return err;
+}
+
+//======================================================================
 
-        while (*head != NULL) {
-            bucket_t *next = (*head)->next;
-            free_const_ptr((*head)->pair.key);
-            free_const_ptr((*head)->pair.value);
-            free(*head);
-            *head = next;
+static error_code gather_range(const htable_array_t *array, uint64_t from, uint64_t to,
+                               scan_item_t **items, size_t *nb_items, size_t *capacity)
+{
+    size_t first = (size_t) (from >> array->shift);
+    size_t last = (size_t) (to >> array->shift);
+
+    //entries are ordered by home slot and a run has no hole: past the range,
+    //an empty slot or an entry of a later home slot ends it
+    for (size_t pos = first; pos < array->capacity; ++pos) {
+        const slot_meta_t *m = &array->meta[pos];
+        if (m->dist == 0) {
+            if (pos >= last) break;
+            continue;
+        }
+        if (((uint64_t) m->hash >> array->shift) >= last) break;
+        if (m->dead || m->hash < from) continue;
+
+        if (*nb_items == *capacity) {
+            size_t grown = *capacity == 0 ? 16 : 2 * *capacity;
+            scan_item_t *bigger = realloc(*items, grown * sizeof(scan_item_t));
+            if (bigger == NULL) return ERR_NOMEM;
+            *items = bigger;
+            *capacity = grown;
         }
+
+        scan_item_t item = {m->hash, array->buckets[pos].entry};
+        (*items)[(*nb_items)++] = item;
     }
 
+    return ERR_NONE;
+}
+
+//======================================================================
+
+static int cmp_items(const void *a, const void *b)
+{
+    uint32_t x = ((const scan_item_t *) a)->hash;
+    uint32_t y = ((const scan_item_t *) b)->hash;
+    return (x > y) - (x < y);
 }
 
 //======================================================================
@@ -259,12 +949,14 @@ kv_list_t *get_Htable_content(Htable_t table)
     list->size = table->nbr_elems;
     size_t index = 0;
 
-    //loop through all elements of the hashtable
-    for (size_t i = 0; i < table->size; ++i) {
-        if (table->table[i] != NULL) {
-            //go through the linked list and add the pair to the new list
-            for (bucket_t *b = table->table[i]; b != NULL; b = b->next) {
-                kv_pair_t newPair = {strdup(b->pair.key), strdup(b->pair.value)};
+    //loop through all live slots of both arrays
+    htable_array_t *arrays[] = {&table->current, &table->old};
+    for (size_t a = 0; a < 2; ++a) {
+        htable_array_t *array = arrays[a];
+        for (size_t i = 0; array->meta != NULL && i < array->capacity; ++i) {
+            if (array->meta[i].dist != 0 && !array->meta[i].dead) {
+                const htable_entry_t *e = array->buckets[i].entry;
+                kv_pair_t newPair = {strdup(ENTRY_KEY(e)), strdup(ENTRY_VALUE(e))};
                 pairs[index++] = newPair;
             }
         }
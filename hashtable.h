@@ -17,6 +17,7 @@
 
 #include "error.h" // for error_code
 #include "util.h"
+#include "slab.h" // for slab_t
 
 
 
@@ -45,6 +46,43 @@ typedef struct{
  */
 typedef struct bucket bucket_t;
 
+/*
+ * Borrowed (zero-copy) view on a value of a hash-table.
+ * The entry is pinned: it is neither overwritten nor freed until the view
+ * is released, even if the key is updated or deleted in the meantime.
+ */
+typedef struct{
+	const char* value;        // the value, followed by a '\0' (it may hold others)
+	size_t length;            // length of the value
+	uint64_t version;         // version of the value (see hlc.h), 0 if it is not versioned
+	struct htable_entry* pin; // pinned entry, NULL if the view is empty
+} Htable_view_t;
+
+
+/*
+ * Metadata of a slot, kept in its own contiguous array so that probing
+ * only touches 8 bytes per slot and never the keys themselves
+ */
+typedef struct{
+	uint32_t hash; // 32 bits of the key hash, its top bits give the home slot
+	uint16_t dist; // probe distance + 1, 0 if the slot is empty
+	uint16_t dead; // 1 if the entry has already been migrated (old array only)
+} slot_meta_t;
+
+/*
+ * Open-addressing array of slots (Robin Hood hashing).
+ * Slots are ordered by hash: the home slot of a key is given by the top bits
+ * of its hash and entries never wrap around, they go to the overflow slots
+ * at the end of the array instead.
+ */
+typedef struct{
+	size_t size;      // number of home slots (power of two)
+	size_t capacity;  // size + overflow slots
+	unsigned shift;   // home slot is hash >> shift
+	size_t nbr_elems;
+	slot_meta_t* meta;
+	bucket_t* buckets;
+} htable_array_t;
 
 /*
  * Definition of local hash-table type
@@ -52,9 +90,12 @@ typedef struct bucket bucket_t;
 #define HTABLE_SIZE 256
 
 typedef struct{
-	size_t size;
+	size_t size;            // number of home slots of the current array
 	size_t nbr_elems;
-	bucket_t** table;
+	htable_array_t current;
+	htable_array_t old;     // array being drained by a resize, old.meta == NULL otherwise
+	size_t migrated;        // next slot of old to be moved into current
+	slab_t slab;            // storage of the entries
 }Htable;
 
 typedef Htable* Htable_t;
@@ -73,7 +114,8 @@ typedef struct{
 
 /**
  * @brief construct a hash-table of the given size.
- * @param size number of buckets in the new hash-table
+ *    The table grows on its own (incrementally) once it gets too full.
+ * @param size initial number of buckets in the new hash-table
  * @return the newly allocated hash-table
  */
 Htable_t construct_Htable(size_t size);
@@ -85,6 +127,13 @@ Htable_t construct_Htable(size_t size);
  */
 void delete_Htable_and_content(Htable_t* table);
 
+/**
+ * @brief remove every key:value pair of a hash-table, in place
+ *    (the values pinned by a view stay valid until it is released)
+ * @param table the table to empty
+ */
+void clear_Htable(Htable_t table);
+
 /**
  * @brief add a key:value pair to hash-table
  * @param table the table where to add
@@ -94,6 +143,20 @@ void delete_Htable_and_content(Htable_t* table);
  */
 error_code add_Htable_value(Htable_t table, pps_key_t key, pps_value_t value);
 
+/**
+ * @brief add a key:value pair to hash-table, with the version of the value
+ *    (the key and the value may hold '\0')
+ * @param table the table where to add
+ * @param key the key to which the value shall be associated
+ * @param key_len length of the key
+ * @param value the value to be added
+ * @param value_len length of the value
+ * @param version version of the value (see hlc.h), replaces the one of the previous value
+ * @return 0 on success; error code on errror (see error.h)
+ */
+error_code add_Htable_versioned_value(Htable_t table, pps_key_t key, size_t key_len,
+                                      pps_value_t value, size_t value_len, uint64_t version);
+
 /**
  * @brief get a value for a given in the given hash-table
  * @param table the table where to get
@@ -102,6 +165,43 @@ error_code add_Htable_value(Htable_t table, pps_key_t key, pps_value_t value);
  */
 pps_value_t get_Htable_value(Htable_t table, pps_key_t key);
 
+/**
+ * @brief borrow the value associated to a key, without copying it
+ *    Note: the view has to be released with release_Htable_view (before deleting the table).
+ * @param table the table where to get
+ * @param key the key associated to the wanted value
+ * @param key_len length of the key
+ * @param view where to store the view on the value
+ * @return ERR_NONE, ERR_NOT_FOUND if the key is not in the table, or another error code
+ */
+error_code get_Htable_view(Htable_t table, pps_key_t key, size_t key_len, Htable_view_t *view);
+
+/**
+ * @brief release a view obtained from get_Htable_view
+ * @param table the table the view comes from
+ * @param view the view to release (emptied)
+ */
+void release_Htable_view(Htable_t table, Htable_view_t *view);
+
+/**
+ * @brief whether a key is in a hash-table, without pinning its entry nor moving
+ *    slots: once the table is settled (see settle_Htable) and no longer written,
+ *    a thread may call it while others take views on the table
+ * @param table the table to search into
+ * @param key the key
+ * @param key_len length of the key
+ * @return 1 if the key is in the table
+ */
+int has_Htable_key(Htable_t table, pps_key_t key, size_t key_len);
+
+/**
+ * @brief finish a resize in progress: until the table is written again, its
+ *    lookups and scans only read its slots
+ * @param table the table
+ * @return ERR_NONE or another error code
+ */
+error_code settle_Htable(Htable_t table);
+
 /**
  * @brief compute the hash for the given key and size of hash-table.
  *      Note: although this is a local function, it is exposed here
@@ -113,20 +213,64 @@ pps_value_t get_Htable_value(Htable_t table, pps_key_t key);
 size_t hash_function(pps_key_t key, size_t table_size);
 
 /**
- * @brief get the content of the table
- *    Note: does NOTHING until week 08.
+ * @brief same hash as hash_function, for a key that may hold '\0'
+ * @param key the key onto compute the hash
+ * @param key_len length of the key
+ * @param table_size size of the containing table
+ * @return a hash value in range [0..table_size-1], or SIZE_MAX if error
+ */
+size_t hash_bytes(pps_key_t key, size_t key_len, size_t table_size);
+
+/*
+ * Visitor of the entries of a hash-table (see scan_Htable): the key and the
+ * value are only valid during the call, which must not modify the table.
+ * Returns 0 to stop the scan before the entry.
+ */
+typedef int (*Htable_visitor_t)(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                                uint64_t version);
+
+/*
+ * Position of a scan once every entry was visited
+ */
+#define HTABLE_SCAN_END ((uint64_t) 1 << 32)
+
+/**
+ * @brief visit the entries of a table in place, by increasing hash, from a position.
+ *    The order does not depend on the size of the table: a scan resumed after
+ *    inserts, deletions or a resize visits the entries present all along once
+ *    (twice for the rare keys of the same hash, when a stop falls between them).
+ * @param table the table to visit
+ * @param position where to start, 0 or the value left by a previous scan; where to
+ *    resume once the visitor stopped, HTABLE_SCAN_END once every entry was visited
+ * @param visit the visitor
+ * @param arg its argument
+ * @return ERR_NONE or another error code
+ */
+error_code scan_Htable(Htable_t table, uint64_t *position, Htable_visitor_t visit, void *arg);
+
+/**
+ * @brief get a copy of the content of the table
+ *    Note: every key and value is copied, scan_Htable visits them in place.
  * @param table table to read from
  * @return the list of key values from the given table, NULL if a failure occured
  */
 kv_list_t *get_Htable_content(Htable_t table);
 
+/**
+ * @brief print the memory usage of the table (per size class of its allocator)
+ * @param table the table to inspect
+ * @param out where to print
+ */
+void print_Htable_stats(Htable_t table, FILE *out);
+
 /**
  * @brief delete a key:value pair from the hash-table
  * @param table the table where to delete
  * @param key the key which is to be delete
+ * @param key_len length of the key
  * @return 0 on success; error code on errror (see error.h)
  */
-error_code del_Htable_key(Htable_t table, pps_key_t key);
+error_code del_Htable_key(Htable_t table, pps_key_t key, size_t key_len);
 
 /**
  * @brief free a key-value pair content (both of them)
@@ -0,0 +1,184 @@
+/**
+ * @file health.c
+ * @brief Implementation of health.h
+ *
+ * @date 18.10.2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // for clock_gettime
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "health.h"
+
+#define HEALTH_MAGIC "PPSHLTH2"
+#define HEALTH_HEADER 8
+#define HEALTH_SIZE (HEALTH_HEADER + HEALTH_MAX_SERVERS * sizeof(health_entry_t))
+
+/**
+ * @brief map the table of a file
+ * @param path the file
+ * @param health where to store the mapping
+ * @return 1 on success, 0 if the file can not be used
+ */
+static int map_file(const char *path, health_t *health);
+
+/**
+ * @brief current time
+ * @return milliseconds since the epoch (the processes sharing the table do not share a monotonic clock origin)
+ */
+static uint64_t now_ms(void);
+
+// =====================================================================
+
+health_t *health_open(const char *path)
+{
+    health_t *health = calloc(1, sizeof(health_t));
+    if (health == NULL) return NULL;
+
+    if (path == NULL || !map_file(path, health)) {
+        health->base = calloc(1, HEALTH_SIZE);
+        if (health->base == NULL) {
+            free(health);
+            return NULL;
+        }
+        health->size = HEALTH_SIZE;
+        health->mapped = 0;
+    }
+
+    health->entries = (health_entry_t *) ((char *) health->base + HEALTH_HEADER);
+    return health;
+}
+
+// =====================================================================
+
+void health_close(health_t *health)
+{
+    if (health == NULL) return;
+
+    if (health->mapped) {
+        munmap(health->base, health->size);
+    } else {
+        free(health->base);
+    }
+    free(health);
+}
+
+// =====================================================================
+
+size_t health_find(health_t *health, const struct sockaddr_in *addr)
+{
+    if (health == NULL || addr == NULL) return HEALTH_MAX_SERVERS;
+
+    size_t free_entry = HEALTH_MAX_SERVERS;
+    for (size_t i = 0; i < HEALTH_MAX_SERVERS; ++i) {
+        const health_entry_t *entry = &health->entries[i];
+        if (entry->ip == addr->sin_addr.s_addr && entry->port == addr->sin_port) return i;
+        if (entry->ip == 0 && free_entry == HEALTH_MAX_SERVERS) free_entry = i;
+    }
+
+    if (free_entry < HEALTH_MAX_SERVERS) {
+        health_entry_t *entry = &health->entries[free_entry];
+        memset(entry, 0, sizeof(health_entry_t));
+        entry->port = addr->sin_port;
+        entry->ip = addr->sin_addr.s_addr;
+    }
+
+    return free_entry;
+}
+
+// =====================================================================
+
+void health_reply(health_t *health, size_t entry, double srtt, double rttvar)
+{
+    if (health == NULL || entry >= HEALTH_MAX_SERVERS) return;
+
+    health_entry_t *e = &health->entries[entry];
+    e->misses = 0;
+    e->last_reply = now_ms();
+    e->srtt = srtt;
+    e->rttvar = rttvar;
+}
+
+// =====================================================================
+
+void health_rtt(const health_t *health, size_t entry, double *srtt, double *rttvar)
+{
+    *srtt = 0;
+    *rttvar = 0;
+    if (health == NULL || entry >= HEALTH_MAX_SERVERS) return;
+
+    *srtt = health->entries[entry].srtt;
+    *rttvar = health->entries[entry].rttvar;
+}
+
+// =====================================================================
+
+void health_miss(health_t *health, size_t entry, int refused)
+{
+    if (health == NULL || entry >= HEALTH_MAX_SERVERS) return;
+
+    health_entry_t *e = &health->entries[entry];
+    if (refused && e->misses < HEALTH_SUSPECT_MISSES) {
+        e->misses = HEALTH_SUSPECT_MISSES;
+    } else if (e->misses < UINT16_MAX) {
+        ++(e->misses);
+    }
+    e->last_miss = now_ms();
+}
+
+// =====================================================================
+
+int health_suspected(const health_t *health, size_t entry)
+{
+    if (health == NULL || entry >= HEALTH_MAX_SERVERS) return 0;
+
+    const health_entry_t *e = &health->entries[entry];
+    return e->misses >= HEALTH_SUSPECT_MISSES && now_ms() < e->last_miss + HEALTH_RETRY_MS;
+}
+
+// =====================================================================
+
+static int map_file(const char *path, health_t *health)
+{
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t) st.st_size != HEALTH_SIZE && ftruncate(fd, HEALTH_SIZE) != 0)) {
+        close(fd);
+        return 0;
+    }
+
+    void *base = mmap(NULL, HEALTH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+
+    //a new file, or one of another format: start from an empty table
+    if (memcmp(base, HEALTH_MAGIC, HEALTH_HEADER) != 0) {
+        memset(base, 0, HEALTH_SIZE);
+        memcpy(base, HEALTH_MAGIC, HEALTH_HEADER);
+    }
+
+    health->base = base;
+    health->size = HEALTH_SIZE;
+    health->mapped = 1;
+    return 1;
+}
+
+// =====================================================================
+
+static uint64_t now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t) t.tv_sec * 1000 + (uint64_t) t.tv_nsec / 1000000;
+}
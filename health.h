@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+ * @file health.h
+ * @brief Health of the servers as seen by the clients: every request is a
+ *        heartbeat, a server that missed HEALTH_SUSPECT_MISSES of them in a
+ *        row (or refused one) is suspected and skipped for HEALTH_RETRY_MS,
+ *        then asked again.
+ *
+ *        The table is a small file mapped in memory, so that the clients
+ *        (which only live for one command) share what they learnt, round-trip
+ *        times included. It is a cache: concurrent updates are not locked,
+ *        a lost update only costs a request to a dead server.
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h>
+#include <netinet/in.h> // for struct sockaddr_in
+
+/**
+ * @brief number of servers in the table
+ */
+#define HEALTH_MAX_SERVERS 256
+
+/**
+ * @brief requests in a row without reply before a server is suspected
+ */
+#define HEALTH_SUSPECT_MISSES 2
+
+/**
+ * @brief how long a suspected server is skipped
+ */
+#define HEALTH_RETRY_MS 5000
+
+/**
+ * @brief what the clients know of a server
+ */
+typedef struct {
+    uint32_t ip;         // network order, 0 if the entry is free
+    uint16_t port;       // network order
+    uint16_t misses;     // requests in a row that got no reply
+    uint64_t last_reply; // in ms since the epoch
+    uint64_t last_miss;
+    double srtt;         // smoothed round-trip time in ms, 0 if unknown
+    double rttvar;       // its mean deviation
+} health_entry_t;
+
+/**
+ * @brief the table, mapped from its file (or in memory only)
+ */
+typedef struct {
+    void *base;
+    size_t size;
+    int mapped;              // 1 if base is mapped from the file
+    health_entry_t *entries; // HEALTH_MAX_SERVERS entries
+} health_t;
+
+/**
+ * @brief map the table of a file, created if needed
+ * @param path the file, NULL to keep the table in memory
+ * @return the table (in memory only if the file can not be used), NULL on error
+ */
+health_t *health_open(const char *path);
+
+/**
+ * @brief unmap a table and free it
+ * @param health the table, may be NULL
+ */
+void health_close(health_t *health);
+
+/**
+ * @brief entry of a server, added if it is not in the table yet
+ * @param health the table
+ * @param addr address of the server
+ * @return its index, HEALTH_MAX_SERVERS if the table is full
+ */
+size_t health_find(health_t *health, const struct sockaddr_in *addr);
+
+/**
+ * @brief record that a server replied
+ * @param health the table
+ * @param entry index of the server
+ * @param srtt its smoothed round-trip time, in ms
+ * @param rttvar its mean deviation
+ */
+void health_reply(health_t *health, size_t entry, double srtt, double rttvar);
+
+/**
+ * @brief round-trip time of a server measured by the clients
+ * @param health the table
+ * @param entry index of the server
+ * @param srtt where to store its smoothed round-trip time in ms, 0 if unknown
+ * @param rttvar where to store its mean deviation
+ */
+void health_rtt(const health_t *health, size_t entry, double *srtt, double *rttvar);
+
+/**
+ * @brief record that a server did not reply in time
+ * @param health the table
+ * @param entry index of the server
+ * @param refused whether the server is known to be down (ICMP error), it is then suspected at once
+ */
+void health_miss(health_t *health, size_t entry, int refused);
+
+/**
+ * @brief whether a server should be skipped
+ * @param health the table
+ * @param entry index of the server
+ * @return 1 if it missed its last requests and was not retried since
+ */
+int health_suspected(const health_t *health, size_t entry);
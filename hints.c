@@ -0,0 +1,312 @@
+/**
+ * @file hints.c
+ * @brief Implementation of hints.h
+ *
+ * @date 18.10.2026
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hints.h"
+#include "protocol.h"
+#include "config.h"
+#include "util.h"
+
+#define HINTS_INITIAL_SIZE 1024
+#define HINTS_REPLAY_KEYS 256 // keys copied at a time from the hints of an owner
+
+/**
+ * @brief a hinted key copied out of the hints of an owner
+ */
+typedef struct {
+    char *key;
+    size_t key_len;
+    uint64_t generation;
+} hint_t;
+
+/**
+ * @brief hinted keys copied at a time, at most HINTS_REPLAY_KEYS
+ */
+typedef struct {
+    hint_t *hints;
+    size_t size;
+} hint_page_t;
+
+/**
+ * @brief hand a batch of hinted keys over to their owner
+ * @param hints the hints
+ * @param owner index of the owner
+ * @param addr address of the owner
+ * @param store the store holding the values
+ * @param transport sockets to the owners
+ * @param page the hinted keys and their generation
+ * @param first where to start in the page, updated to the first key not sent
+ * @param payload buffer of PROTOCOL_MAX_PAYLOAD bytes
+ * @param sent buffer of HINTS_REPLAY_KEYS indices
+ * @return the number of keys acknowledged, -1 if the owner did not answer
+ */
+static long replay_batch(hints_t *hints, size_t owner, const struct sockaddr_in *addr, store_t *store,
+                         transport_t *transport, const hint_page_t *page, size_t *first, char *payload,
+                         size_t *sent);
+
+/**
+ * @brief copy a hinted key and its generation (visitor of scan_Htable)
+ * @param arg the hint_page_t where to add them
+ * @param key the key
+ * @param key_len length of the key
+ * @param value unused
+ * @param value_len unused
+ * @param version generation of the hint
+ * @return 0 once the page is full (or out of memory), 1 otherwise
+ */
+static int copy_hint(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                     uint64_t version);
+
+/**
+ * @brief forget a hint, unless it was renewed since it was handed over
+ * @param hints the hints
+ * @param owner index of the owner
+ * @param hint the hint handed over
+ */
+static void forget_hint(hints_t *hints, size_t owner, const hint_t *hint);
+
+// =====================================================================
+
+hints_t *hints_new(void)
+{
+    hints_t *hints = calloc(1, sizeof(hints_t));
+    if (hints == NULL) return NULL;
+
+    if (pthread_mutex_init(&hints->lock, NULL) != 0) {
+        free(hints);
+        return NULL;
+    }
+
+    return hints;
+}
+
+// =====================================================================
+
+void hints_free(hints_t *hints)
+{
+    if (hints == NULL) return;
+
+    for (size_t o = 0; o < hints->nb_owners; ++o) {
+        delete_Htable_and_content(&hints->owners[o].keys);
+    }
+
+    pthread_mutex_destroy(&hints->lock);
+    free(hints->owners);
+    free(hints);
+}
+
+// =====================================================================
+
+error_code hints_add(hints_t *hints, const struct sockaddr_in *owner, pps_key_t key, size_t key_len)
+{
+    M_REQUIRE_NON_NULL(hints);
+    M_REQUIRE_NON_NULL(owner);
+    M_REQUIRE_NON_NULL(key);
+
+    pthread_mutex_lock(&hints->lock);
+
+    size_t o = 0;
+    while (o < hints->nb_owners && (hints->owners[o].owner.sin_addr.s_addr != owner->sin_addr.s_addr
+                                    || hints->owners[o].owner.sin_port != owner->sin_port)) {
+        ++o;
+    }
+
+    //first hint for this owner
+    if (o == hints->nb_owners) {
+        hints_owner_t *owners = realloc(hints->owners, (hints->nb_owners + 1) * sizeof(hints_owner_t));
+        Htable_t keys = construct_Htable(HINTS_INITIAL_SIZE);
+        if (owners == NULL || keys == NULL) {
+            if (owners != NULL) hints->owners = owners;
+            delete_Htable_and_content(&keys);
+            pthread_mutex_unlock(&hints->lock);
+            return ERR_NOMEM;
+        }
+
+        hints->owners = owners;
+        memset(&hints->owners[o], 0, sizeof(hints_owner_t));
+        hints->owners[o].owner = *owner;
+        hints->owners[o].keys = keys;
+        ++(hints->nb_owners);
+    }
+
+    //the generation is kept as the version of an empty value
+    Htable_view_t previous;
+    int renewed = get_Htable_view(hints->owners[o].keys, key, key_len, &previous) == ERR_NONE;
+    if (renewed) release_Htable_view(hints->owners[o].keys, &previous);
+
+    error_code err = add_Htable_versioned_value(hints->owners[o].keys, key, key_len, "", 0, ++(hints->generation));
+    if (err == ERR_NONE && !renewed) ++(hints->nb_hints);
+
+    pthread_mutex_unlock(&hints->lock);
+    return err;
+}
+
+// =====================================================================
+
+size_t hints_replay(hints_t *hints, store_t *store, transport_t *transport)
+{
+    if (hints == NULL || store == NULL || transport == NULL) return 0;
+
+    pthread_mutex_lock(&hints->lock);
+    size_t nb_owners = hints->nb_owners;
+    size_t nb_hints = hints->nb_hints;
+    pthread_mutex_unlock(&hints->lock);
+
+    if (nb_hints == 0) return 0;
+
+    char *payload = malloc(PROTOCOL_MAX_PAYLOAD);
+    hint_t *copies = calloc(HINTS_REPLAY_KEYS, sizeof(hint_t));
+    size_t *sent = calloc(HINTS_REPLAY_KEYS, sizeof(size_t));
+
+    size_t handed = 0;
+    for (size_t o = 0; payload != NULL && copies != NULL && sent != NULL && o < nb_owners; ++o) {
+        //the keys are copied a page at a time: the workers keep adding hints meanwhile
+        uint64_t position = 0;
+        int down = 0;
+
+        while (!down && position < HTABLE_SCAN_END) {
+            hint_page_t page = {copies, 0};
+
+            pthread_mutex_lock(&hints->lock);
+            struct sockaddr_in addr = hints->owners[o].owner;
+            error_code err = scan_Htable(hints->owners[o].keys, &position, copy_hint, &page);
+            pthread_mutex_unlock(&hints->lock);
+
+            size_t first = 0;
+            while (first < page.size) {
+                long acknowledged = replay_batch(hints, o, &addr, store, transport, &page, &first, payload, sent);
+                if (acknowledged < 0) { // still down, next time
+                    down = 1;
+                    break;
+                }
+
+                handed += (size_t) acknowledged;
+            }
+
+            for (size_t k = 0; k < page.size; ++k) {
+                free(copies[k].key);
+            }
+
+            //nothing copied before the end: out of memory
+            if (err != ERR_NONE || page.size == 0) break;
+        }
+    }
+
+    free(sent);
+    free(copies);
+    free(payload);
+    return handed;
+}
+
+// =====================================================================
+
+static long replay_batch(hints_t *hints, size_t owner, const struct sockaddr_in *addr, store_t *store,
+                         transport_t *transport, const hint_page_t *page, size_t *first, char *payload,
+                         size_t *sent)
+{
+    size_t used = 0;
+    size_t nb_sent = 0;
+
+    //HINTS_BATCH_SIZE bytes of pairs, or a single larger pair
+    size_t k = *first;
+    for (; k < page->size && used < HINTS_BATCH_SIZE; ++k) {
+        const hint_t *hint = &page->hints[k];
+
+        store_view_t view;
+        if (store_get_view(store, hint->key, hint->key_len, &view) != ERR_NONE) {
+            //nothing to hand over
+            forget_hint(hints, owner, hint);
+            continue;
+        }
+
+        size_t length = PROTOCOL_STAMP_SIZE + protocol_field_size(hint->key_len)
+                        + protocol_field_size(view.view.length);
+        if (used > 0 && used + length > HINTS_BATCH_SIZE) {
+            store_release_view(store, &view);
+            break;
+        }
+
+        //with its version: the owner keeps a newer value written since
+        if (length <= PROTOCOL_MAX_PAYLOAD) {
+            protocol_write_stamp(payload + used, view.view.version);
+            used += PROTOCOL_STAMP_SIZE;
+            used += protocol_write_field(payload + used, hint->key, hint->key_len);
+            used += protocol_write_field(payload + used, view.view.value, view.view.length);
+            sent[nb_sent++] = k;
+        } else {
+            forget_hint(hints, owner, hint);
+        }
+        store_release_view(store, &view);
+    }
+
+    *first = k;
+    if (nb_sent == 0) return 0;
+
+    uint32_t id = 0;
+    if (transport_request(transport, addr, PROTOCOL_MPUT, payload, used, &id) != ERR_NONE) return -1;
+
+    //one batch in flight: the reply is the one of this batch
+    uint32_t replied = 0;
+    long acknowledged = -1;
+    if (transport_wait(transport, HINTS_TIMEOUT_MS, &replied) == ERR_NONE) {
+        const transport_request_t *request = transport_reply(transport, replied);
+
+        if (request != NULL && request->status == PROTOCOL_OK) {
+            acknowledged = 0;
+            for (size_t i = 0; i < nb_sent && i < request->reply_size; ++i) {
+                if (request->reply[i] == PROTOCOL_OK) {
+                    forget_hint(hints, owner, &page->hints[sent[i]]);
+                    ++acknowledged;
+                }
+            }
+        }
+    }
+
+    transport_forget(transport, id);
+    return acknowledged;
+}
+
+// =====================================================================
+
+static int copy_hint(void *arg, pps_key_t key, size_t key_len, pps_value_t _unused value,
+                     size_t _unused value_len, uint64_t version)
+{
+    hint_page_t *page = arg;
+    if (page->size == HINTS_REPLAY_KEYS) return 0;
+
+    hint_t hint = {malloc(key_len + 1), key_len, version};
+    if (hint.key == NULL) return 0;
+    memcpy(hint.key, key, key_len);
+
+    page->hints[page->size++] = hint;
+    return 1;
+}
+
+// =====================================================================
+
+static void forget_hint(hints_t *hints, size_t owner, const hint_t *hint)
+{
+    pthread_mutex_lock(&hints->lock);
+
+    Htable_t table = hints->owners[owner].keys;
+    Htable_view_t current;
+    if (get_Htable_view(table, hint->key, hint->key_len, &current) == ERR_NONE) {
+        uint64_t generation = current.version;
+        release_Htable_view(table, &current);
+
+        if (generation == hint->generation && del_Htable_key(table, hint->key, hint->key_len) == ERR_NONE) {
+            --(hints->nb_hints);
+        }
+    }
+
+    pthread_mutex_unlock(&hints->lock);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * @file hints.h
+ * @brief Hinted handoff: the writes a server accepted in place of another
+ *        one (its owner) that was down or late. The server keeps the keys
+ *        of every owner and hands their values over to it, many pairs per
+ *        datagram, once it answers again.
+ *
+ *        Only the keys are kept: the value handed over is the one in the
+ *        store at that time, so a key written many times is sent once.
+ *        The hints live in memory only.
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h> // for struct sockaddr_in
+
+#include "error.h"
+#include "hashtable.h"
+#include "store.h"
+#include "transport.h"
+
+/**
+ * @brief how often the hints are handed over
+ */
+#define HINTS_REPLAY_MS 1000
+
+/**
+ * @brief how long an owner has to acknowledge a batch of hints
+ */
+#define HINTS_TIMEOUT_MS 200
+
+/**
+ * @brief bytes of pairs per datagram handed over (as the multi-puts of the clients)
+ */
+#define HINTS_BATCH_SIZE 8192
+
+/**
+ * @brief the keys written in place of one server
+ */
+typedef struct {
+    struct sockaddr_in owner;
+    Htable_t keys; // key -> generation of its last hint (the version of an empty value), to not drop
+                   // a hint that came during the handoff
+} hints_owner_t;
+
+/**
+ * @brief all the hints of a server
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    hints_owner_t *owners;
+    size_t nb_owners;
+    size_t nb_hints;
+    uint64_t generation;
+} hints_t;
+
+/**
+ * @brief create an empty set of hints
+ * @return the hints, NULL on error
+ */
+hints_t *hints_new(void);
+
+/**
+ * @brief free a set of hints
+ * @param hints the hints, may be NULL
+ */
+void hints_free(hints_t *hints);
+
+/**
+ * @brief record that a key was written in place of its owner
+ * @param hints the hints
+ * @param owner address of the owner
+ * @param key the key
+ * @param key_len length of the key
+ * @return some error_code
+ */
+error_code hints_add(hints_t *hints, const struct sockaddr_in *owner, pps_key_t key, size_t key_len);
+
+/**
+ * @brief hand the values of the hinted keys over to their owners, and
+ *        forget the hints they acknowledged (an owner that does not
+ *        answer is tried again next time)
+ * @param hints the hints
+ * @param store the store holding the values
+ * @param transport sockets to the owners
+ * @return the number of keys handed over
+ */
+size_t hints_replay(hints_t *hints, store_t *store, transport_t *transport);
@@ -0,0 +1,71 @@
+/**
+ * @file hlc.c
+ * @brief Implementation of hlc.h
+ *
+ * @date 18.10.2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // for clock_gettime
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "hlc.h"
+
+/**
+ * @brief the local time, as a version with a zero counter
+ * @return the time in ms since the epoch, shifted left by HLC_LOGICAL_BITS
+ */
+static uint64_t physical_now(void);
+
+// =====================================================================
+
+static uint64_t physical_now(void)
+{
+    //the processes of the writers do not share a monotonic clock origin
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return ((uint64_t) t.tv_sec * 1000 + (uint64_t) t.tv_nsec / 1000000) << HLC_LOGICAL_BITS;
+}
+
+// =====================================================================
+
+uint64_t hlc_now(hlc_t *clock)
+{
+    uint64_t physical = physical_now();
+
+    pthread_mutex_lock(&clock->lock);
+    clock->last = physical > clock->last ? physical : clock->last + 1;
+    uint64_t version = clock->last;
+    pthread_mutex_unlock(&clock->lock);
+
+    return version;
+}
+
+// =====================================================================
+
+int hlc_observe(hlc_t *clock, uint64_t version)
+{
+    if (version > physical_now() + ((uint64_t) HLC_MAX_OFFSET_MS << HLC_LOGICAL_BITS)) return 0;
+
+    pthread_mutex_lock(&clock->lock);
+    if (version > clock->last) clock->last = version;
+    pthread_mutex_unlock(&clock->lock);
+
+    return 1;
+}
+
+// =====================================================================
+
+int hlc_newer(uint64_t version, const char *value, size_t length,
+              uint64_t other, const char *other_value, size_t other_length)
+{
+    if (version != other) return version > other;
+
+    //the order of strcmp, extended to the values holding '\0'
+    int cmp = memcmp(value, other_value, length < other_length ? length : other_length);
+    if (cmp != 0) return cmp > 0;
+    return length > other_length;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+/**
+ * @file hlc.h
+ * @brief Hybrid logical clock: the versions of the values.
+ *        A version is the time of the write in ms since the epoch, shifted
+ *        left by HLC_LOGICAL_BITS, plus a counter that orders the writes of
+ *        the same ms and those stamped by a clock that lags behind the
+ *        versions it has seen. The writer stamps the value, so all the
+ *        replicas of a write hold the same version; the newest one wins.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * @brief bits of the counter, in the low bits of a version
+ */
+#define HLC_LOGICAL_BITS 16
+
+/**
+ * @brief how far ahead of the local clock a version may be, in ms: the
+ *        bound on the offset between the clocks of the processes.
+ *        A version further ahead would win over every write of the next
+ *        hours (or years), and one near UINT64_MAX would wrap the clock
+ */
+#define HLC_MAX_OFFSET_MS 500
+
+/**
+ * @brief a clock, shared by the threads of a process
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t last; // the last version stamped or seen
+} hlc_t;
+
+/**
+ * @brief a clock that has seen nothing yet
+ */
+#define HLC_INITIALIZER {PTHREAD_MUTEX_INITIALIZER, 0}
+
+
+/**
+ * @brief stamp a write
+ * @param clock the clock
+ * @return a version newer than all those stamped or seen by the clock
+ */
+uint64_t hlc_now(hlc_t *clock);
+
+/**
+ * @brief move a clock past a version read or received, unless it is more
+ *        than HLC_MAX_OFFSET_MS ahead of the local clock
+ * @param clock the clock
+ * @param version the version
+ * @return 1 if the version was within the bound, 0 if it was ignored
+ */
+int hlc_observe(hlc_t *clock, uint64_t version);
+
+/**
+ * @brief which of two versions of a value wins, the values breaking the
+ *        ties so that all the replicas keep the same one
+ * @param version the first version
+ * @param value its value
+ * @param length length of the value
+ * @param other the second version
+ * @param other_value its value
+ * @param other_length length of that value
+ * @return 1 if the first one is newer, 0 otherwise (equal included)
+ */
+int hlc_newer(uint64_t version, const char *value, size_t length,
+              uint64_t other, const char *other_value, size_t other_length);
@@ -0,0 +1,210 @@
+/**
+ * @file merkle.c
+ * @brief Implementation of merkle.h
+ *
+ * @date 18.10.2026
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <openssl/sha.h>
+
+#include "merkle.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/**
+ * @brief mix the bits of a word (finalizer of splitmix64)
+ * @param x the word
+ * @return the mixed word
+ */
+static uint64_t mix64(uint64_t x);
+
+/**
+ * @brief part of a position, cut off its leaf
+ * @param tree the tree
+ * @param position the position
+ * @return the cut the part starts after, tree->nb_cuts if the position is before the first cut of its leaf
+ */
+static size_t part_of(const merkle_t *tree, uint64_t position);
+
+// =====================================================================
+
+merkle_t *merkle_new(void)
+{
+    merkle_t *tree = malloc(sizeof(merkle_t));
+    if (tree == NULL) return NULL;
+
+    for (size_t i = 0; i < MERKLE_LEAVES; ++i) {
+        atomic_init(&tree->leaves[i], 0);
+    }
+    tree->cuts = NULL;
+    tree->nb_cuts = 0;
+    tree->parts = NULL;
+    return tree;
+}
+
+// =====================================================================
+
+void merkle_free(merkle_t *tree)
+{
+    if (tree == NULL) return;
+
+    free(tree->cuts);
+    free(tree->parts);
+    free(tree);
+}
+
+// =====================================================================
+
+error_code merkle_cut(merkle_t *tree, const uint64_t *positions, size_t nb_positions)
+{
+    M_REQUIRE_NON_NULL(tree);
+    M_REQUIRE_NON_NULL(positions);
+    M_REQUIRE(tree->cuts == NULL, ERR_BAD_PARAMETER, "tree already cut in %zu", tree->nb_cuts);
+
+    //the parts of the entries already added are not known
+    for (size_t i = 0; i < MERKLE_LEAVES; ++i) {
+        M_REQUIRE(atomic_load_explicit(&tree->leaves[i], memory_order_relaxed) == 0, ERR_BAD_PARAMETER,
+                  "leaf %zu not empty", i);
+    }
+
+    tree->cuts = malloc(nb_positions * sizeof(uint64_t));
+    tree->parts = malloc(nb_positions * sizeof(_Atomic uint64_t));
+    if (tree->cuts == NULL || tree->parts == NULL) {
+        free(tree->cuts);
+        free(tree->parts);
+        tree->cuts = NULL;
+        tree->parts = NULL;
+        return ERR_NOMEM;
+    }
+
+    memcpy(tree->cuts, positions, nb_positions * sizeof(uint64_t));
+    for (size_t c = 0; c < nb_positions; ++c) {
+        atomic_init(&tree->parts[c], 0);
+    }
+    tree->nb_cuts = nb_positions;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+uint64_t merkle_position_of(pps_key_t key, size_t key_len, uint64_t *key_hash)
+{
+    unsigned char sha[SHA_DIGEST_LENGTH];
+    SHA1((const unsigned char *) key, key_len, sha);
+
+    //the first bytes are the position on the ring, the next ones identify the key
+    uint64_t prefix = 0, rest = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        prefix = (prefix << 8) | sha[i];
+        rest = (rest << 8) | sha[sizeof(uint64_t) + i];
+    }
+
+    *key_hash = rest;
+    return prefix;
+}
+
+// =====================================================================
+
+uint64_t merkle_entry_hash(uint64_t key_hash, pps_value_t value, size_t value_len, uint64_t version)
+{
+    const unsigned char *bytes = (const unsigned char *) value;
+
+    uint64_t h = FNV_OFFSET;
+    for (size_t i = 0; i < value_len; ++i) {
+        h = (h ^ bytes[i]) * FNV_PRIME;
+    }
+
+    return mix64(key_hash ^ mix64(h ^ mix64(version)));
+}
+
+// =====================================================================
+
+void merkle_toggle(merkle_t *tree, uint64_t position, uint64_t hash)
+{
+    atomic_fetch_xor_explicit(&tree->leaves[MERKLE_LEAF_OF(position)], hash, memory_order_relaxed);
+
+    size_t part = part_of(tree, position);
+    if (part < tree->nb_cuts) {
+        atomic_fetch_xor_explicit(&tree->parts[part], hash, memory_order_relaxed);
+    }
+}
+
+// =====================================================================
+
+size_t merkle_level_start(size_t level)
+{
+    return (((size_t) 1 << (MERKLE_FANOUT_BITS * level)) - 1) / (MERKLE_FANOUT - 1);
+}
+
+// =====================================================================
+
+void merkle_build(const merkle_t *tree, const uint8_t *mask, const uint8_t *parts, uint64_t *nodes)
+{
+    uint64_t *leaves = nodes + merkle_level_start(MERKLE_DEPTH);
+    size_t c = 0;
+    for (size_t i = 0; i < MERKLE_LEAVES; ++i) {
+        uint64_t first = atomic_load_explicit(&tree->leaves[i], memory_order_relaxed);
+        uint64_t kept = 0;
+
+        //the leaf without its parts is what comes before its first cut
+        for (; c < tree->nb_cuts && MERKLE_LEAF_OF(tree->cuts[c]) == i; ++c) {
+            uint64_t part = atomic_load_explicit(&tree->parts[c], memory_order_relaxed);
+            first ^= part;
+            if (mask == NULL || (parts[c / 8] >> (c % 8)) & 1) kept ^= part;
+        }
+
+        leaves[i] = mask == NULL || (mask[i / 8] >> (i % 8)) & 1 ? first ^ kept : kept;
+    }
+
+    //bottom up: a node hashes its children in order
+    for (size_t level = MERKLE_DEPTH; level-- > 0; ) {
+        uint64_t *parents = nodes + merkle_level_start(level);
+        const uint64_t *children = nodes + merkle_level_start(level + 1);
+        size_t count = (size_t) 1 << (MERKLE_FANOUT_BITS * level);
+
+        for (size_t p = 0; p < count; ++p) {
+            uint64_t h = 0;
+            for (size_t c = 0; c < MERKLE_FANOUT; ++c) {
+                h = mix64(h ^ children[p * MERKLE_FANOUT + c]);
+            }
+            parents[p] = h;
+        }
+    }
+}
+
+// =====================================================================
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// =====================================================================
+
+static size_t part_of(const merkle_t *tree, uint64_t position)
+{
+    //the last cut before the position: a position equal to a cut ends the range of its node
+    size_t low = 0, high = tree->nb_cuts;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (tree->cuts[mid] < position) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low == 0 || MERKLE_LEAF_OF(tree->cuts[low - 1]) != MERKLE_LEAF_OF(position)) return tree->nb_cuts;
+    return low - 1;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+/**
+ * @file merkle.h
+ * @brief Hash tree over the content of a server, compared between the
+ *        replicas by the anti-entropy (see antientropy.h).
+ *
+ *        The leaves split the ring in MERKLE_LEAVES ranges, by the top bits
+ *        of the SHA-1 of the keys (their position on the ring). A leaf is the
+ *        XOR of the hashes of its entries (key, value and version), so that a
+ *        write updates it in place, without reading the other entries.
+ *        The inner nodes, MERKLE_FANOUT children each, are only computed
+ *        when a tree is compared, over the keys two servers both replicate.
+ *
+ *        The nodes of the ring (the cuts) end the ranges of the servers
+ *        inside some leaves: such a leaf also keeps the XOR of the entries
+ *        after each of its cuts (the parts), so that two servers compare
+ *        only the parts of the leaf they both replicate.
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "error.h"
+#include "hashtable.h"
+
+/**
+ * @brief number of leaves (bits of the ring position)
+ */
+#define MERKLE_LEAF_BITS 16
+#define MERKLE_LEAVES ((size_t) 1 << MERKLE_LEAF_BITS)
+
+/**
+ * @brief children of an inner node
+ */
+#define MERKLE_FANOUT_BITS 4
+#define MERKLE_FANOUT ((size_t) 1 << MERKLE_FANOUT_BITS)
+
+/**
+ * @brief levels below the root, the last one is the leaves
+ */
+#define MERKLE_DEPTH (MERKLE_LEAF_BITS / MERKLE_FANOUT_BITS)
+
+/**
+ * @brief nodes of a whole tree, root included: 1 + 16 + ... + 65536
+ */
+#define MERKLE_NODES ((MERKLE_LEAVES * MERKLE_FANOUT - 1) / (MERKLE_FANOUT - 1))
+
+_Static_assert(MERKLE_LEAF_BITS % MERKLE_FANOUT_BITS == 0, "the leaves are a whole level of the tree");
+
+/**
+ * @brief leaf of a position on the ring
+ */
+#define MERKLE_LEAF_OF(position) ((size_t) ((position) >> (64 - MERKLE_LEAF_BITS)))
+
+/**
+ * @brief the leaves of a tree, updated concurrently by the writes
+ */
+typedef struct {
+    _Atomic uint64_t leaves[MERKLE_LEAVES];
+    uint64_t *cuts;          // positions of the nodes of the ring, sorted, set before the first write
+    size_t nb_cuts;
+    _Atomic uint64_t *parts; // for each cut, XOR of the entries after it in its leaf, up to the next cut
+} merkle_t;
+
+/**
+ * @brief create a tree of an empty store
+ * @return the tree, NULL on error
+ */
+merkle_t *merkle_new(void);
+
+/**
+ * @brief free a tree
+ * @param tree the tree, may be NULL
+ */
+void merkle_free(merkle_t *tree);
+
+/**
+ * @brief cut the leaves at the nodes of the ring, where the ranges of the servers end
+ * @param tree the tree, still empty
+ * @param positions positions of the nodes (see ring.h), sorted
+ * @param nb_positions number of nodes
+ * @return an error code
+ */
+error_code merkle_cut(merkle_t *tree, const uint64_t *positions, size_t nb_positions);
+
+/**
+ * @brief position of a key on the ring
+ * @param key the key
+ * @param key_len its length
+ * @param key_hash where to store a hash of the key, for merkle_entry_hash
+ * @return its position, the first 8 bytes of its SHA-1 (see MERKLE_LEAF_OF)
+ */
+uint64_t merkle_position_of(pps_key_t key, size_t key_len, uint64_t *key_hash);
+
+/**
+ * @brief hash of an entry
+ * @param key_hash hash of the key (see merkle_leaf_of)
+ * @param value the value
+ * @param value_len its length
+ * @param version its version
+ * @return the hash
+ */
+uint64_t merkle_entry_hash(uint64_t key_hash, pps_value_t value, size_t value_len, uint64_t version);
+
+/**
+ * @brief add an entry to its leaf (and part), or remove it (the hashes are XORed)
+ * @param tree the tree
+ * @param position position of the key of the entry
+ * @param hash hash of the entry, or the XOR of the hashes of the entry removed and of the one added
+ */
+void merkle_toggle(merkle_t *tree, uint64_t position, uint64_t hash);
+
+/**
+ * @brief offset of a level in a whole tree
+ * @param level the level, 0 for the root and MERKLE_DEPTH for the leaves
+ * @return index of its first node (the level has MERKLE_FANOUT^level nodes)
+ */
+size_t merkle_level_start(size_t level);
+
+/**
+ * @brief compute a whole tree from the current leaves, over some of their parts
+ *        (the other ones count as empty)
+ * @param tree the tree
+ * @param mask bit i set if leaf i is kept up to its first cut, NULL to keep all the leaves whole
+ * @param parts bit c set if the part after cut c is kept (ignored if mask is NULL)
+ * @param nodes where to store the MERKLE_NODES nodes, level by level from the root
+ */
+void merkle_build(const merkle_t *tree, const uint8_t *mask, const uint8_t *parts, uint64_t *nodes);
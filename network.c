@@ -5,587 +5,2359 @@
  * @date 21.03.2018
  */
 
+#define _POSIX_C_SOURCE 200809L // for clock_gettime
+
 // for sockets
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <limits.h>
 #include <errno.h>
+#include <time.h>
 
 #include "network.h"
 #include "error.h"
 #include "util.h"
+#include "hlc.h"
+
+#define MAX_HEDGES 1 // servers beyond the N of a key asked when replies are late
+#define QUORUM_SLOTS(N) (2 * (N) + MAX_HEDGES) // servers of a quorum: N, as many to replace the suspected ones, the hedges
+#define DUMP_TRIES 3 // times a page of a dump is asked before giving up
+#define MPUT_BATCH_SIZE 8192 // bytes of pairs per datagram, small enough to not overflow the socket buffers of the servers
+#define CHUNK_SUFFIX_SIZE (1 + PROTOCOL_STAMP_SIZE + PROTOCOL_VARINT_MAX) // after the key of a value in the keys of its chunks
+#define MANIFEST_SIZE (1 + 2 * PROTOCOL_VARINT_MAX) // '\0', size of the value and size of its chunks
+
+/**
+ * @brief one datagram of a multi-key operation: keys of one server
+ */
+typedef struct {
+    uint32_t id;  // 0 once answered
+    size_t first; // its (key, replica) pairs are order[first..first+count-1]
+    size_t count;
+    double sent;  // when it was sent, in seconds
+} multi_batch_t;
+
+/**
+ * @brief state of a multi-get
+ */
+typedef struct {
+    client_t client;
+    const pps_key_t *keys;
+    size_t nb_keys;
+    size_t N;
+    const node_t **nodes;      // the preference list of every key, N slots per key
+    size_t *nb_nodes;
+    char **newest;             // newest value received for every key, NULL if none yet
+    uint64_t *versions;        // and its version
+    size_t *lengths;           // and its length
+    size_t *nb_received;       // replies received for every key, found or not
+    pps_value_t *values;       // the values read on R servers
+    size_t *todo;              // (key * N + replica) pairs to ask in this round
+    size_t nb_todo;
+    size_t *next;              // pairs to ask again in the next round
+    size_t nb_next;
+    size_t *order;             // pairs of the round, grouped by server
+    multi_batch_t *batches;
+    size_t nb_batches;
+    size_t nb_inflight;
+} mget_t;
+
+/**
+ * @brief state of a multi-put
+ */
+typedef struct {
+    client_t client;
+    const kv_list_t *pairs;
+    size_t N;
+    size_t window;             // maximum number of datagrams in flight
+    const node_t **nodes;      // the preference list of every key, N slots per key
+    uint64_t *versions;        // version of every pair, the same on all its servers
+    size_t *written;           // number of servers that wrote every pair
+    size_t *order;             // (pair * N + replica), grouped by server
+    multi_batch_t *batches;
+    size_t nb_batches;
+    size_t nb_inflight;
+    double *latencies;         // latency of every datagram, may be NULL
+    size_t nb_latencies;
+} mput_t;
+
+/**
+ * @brief requests of an operation to the servers of a key, and the hedges
+ *        sent to the next servers of the ring when replies are late
+ */
+typedef struct {
+    client_t client;
+    pps_key_t key;
+    protocol_opcode_t opcode;
+    const struct iovec *parts; // the payload, gathered when sent
+    size_t nb_parts;
+    size_t size;               // its size
+    const node_t **nodes;      // the N servers of the key, then the ones to hedge on
+    size_t nb_nodes;
+    size_t nb_asked;           // nodes[0..nb_asked-1] were sent the request
+    uint32_t *ids;             // their requests, 0 if it could not be sent
+    size_t nb_waiting;         // requests sent and not answered yet
+    size_t nb_first;           // servers asked before any hedge
+    double start;              // when they were asked, in seconds
+    double hedge_at;           // when to ask the next server
+    double deadline;           // when to give up
+    uint64_t hinted;           // servers of the key (bit of their rank) a hedge of a PUT already stands in for
+} quorum_t;
 
-#define UDP_SIZE 65507
+/**
+ * @brief a stream of a dump (see PROTOCOL_SCAN_STREAMS) and its page in flight
+ */
+typedef struct {
+    uint64_t cursor; // of the page asked
+    uint32_t id;     // its request, 0 if none
+    double sent;     // when it was asked, in seconds
+    size_t tries;    // times it was asked
+} dump_stream_t;
+
+/**
+ * @brief what a server replied to a quorum read
+ */
+typedef struct {
+    uint32_t id;      // the request, a GET or a PROTOCOL_DIGEST
+    int found;
+    uint64_t version; // of its value, if found
+    uint64_t digest;  // of its value (see protocol_digest), if found
+} read_reply_t;
+
+/**
+ * @brief a chunk of a large value in flight (see network_put_stream)
+ */
+typedef struct {
+    size_t index;              // position of the chunk in the value
+    char *data;                // its bytes, for a put: NETWORK_CHUNK_SIZE at most
+    size_t size;               // their number
+    const node_t **nodes;      // the N servers of the chunk, the suspected ones last
+    size_t nb_nodes;
+    uint32_t *ids;             // requests sent to nodes[0..nb_asked-1], 0 if it could not be sent
+    size_t nb_asked;
+    size_t nb_waiting;         // requests not answered yet
+    size_t nb_written;         // servers that wrote it, for a put
+    uint32_t found;            // request whose reply holds it, for a get, 0 until then
+    double start;              // when it was first asked, in seconds
+    double hedge_at;           // when to ask the next server, for a get
+} chunk_t;
+
+/**
+ * @brief a window of the chunks of a large value
+ */
+typedef struct {
+    client_t client;
+    pps_key_t key;             // key of the value
+    size_t key_len;
+    uint64_t version;          // of the value, in the keys of its chunks
+    protocol_opcode_t opcode;  // PUT or GET
+    chunk_t chunks[NETWORK_CHUNK_WINDOW]; // chunk i in chunks[i % NETWORK_CHUNK_WINDOW]
+    size_t head;               // first chunk not done
+    size_t next;               // first chunk not asked
+} chunk_stream_t;
+
+/**
+ * @brief versions of the writes of the client (see hlc.h)
+ */
+static hlc_t client_clock = HLC_INITIALIZER;
 
 // =====================================================================
 
 /**
- * @brief send a request to a server
+ * @brief send a request to a server, on its socket of the client's pool
+ * @param client client to use
+ * @param node the node of the server
+ * @param opcode the operation
+ * @param parts payload of the request, gathered when sent (see transport_request_parts)
+ * @param nb_parts their number
+ * @param id where to store the ID of the request
+ * @return some error_code
+ */
+static error_code send_to_server(client_t client, const node_t *node, protocol_opcode_t opcode,
+                                 const struct iovec *parts, size_t nb_parts, uint32_t *id);
+
+/**
+ * @brief send a request to the N servers of a key, the suspected ones
+ *        being replaced by the next healthy servers of the ring
+ * @param quorum where to store the state of the requests
+ * @param client client to use
+ * @param key the key
+ * @param opcode the operation
+ * @param parts payload of the requests, in parts that must outlive the quorum
+ * @param nb_parts their number
+ * @param hedges how many more servers may be asked when replies are late
+ * @param nodes where to store the servers, QUORUM_SLOTS(N) slots
+ * @param ids where to store the requests, QUORUM_SLOTS(N) slots
+ * @return ERR_NONE, ERR_NETWORK if no request could be sent
+ */
+static error_code quorum_start(quorum_t *quorum, client_t client, pps_key_t key, protocol_opcode_t opcode,
+                               const struct iovec *parts, size_t nb_parts, size_t hedges, const node_t **nodes,
+                               uint32_t *ids);
+
+/**
+ * @brief wait for the next reply of the servers of a key; once the replies are
+ *        later than the round-trip times of the servers predict, or a server
+ *        is unreachable, the request is also sent to the next server of the ring
+ * @param quorum the requests
+ * @param id where to store the ID of the request answered, see transport_reply
+ * @return ERR_NONE, ERR_NETWORK once no reply can come anymore
+ */
+static error_code quorum_wait(quorum_t *quorum, uint32_t *id);
+
+/**
+ * @brief when the replies of the first servers of a quorum are late
+ * @param quorum the requests
+ * @return the time, in seconds
+ */
+static double quorum_late(const quorum_t *quorum);
+
+/**
+ * @brief send the request to the next server of a quorum; a PUT to a server
+ *        that does not hold the key is sent as a hint, for the server of the
+ *        key it stands in for (sloppy quorum, see hints.h)
+ * @param quorum the requests
+ */
+static void quorum_ask(quorum_t *quorum);
+
+/**
+ * @brief the server of the key a server asked by a quorum stands in for
+ * @param quorum the requests
+ * @param node the server asked
+ * @return the first server of the key that did not write it yet and has no
+ *         stand-in, NULL if there is none or if node is a server of the key
+ */
+static const node_t *stand_in_for(quorum_t *quorum, const node_t *node);
+
+/**
+ * @brief give up the requests of a quorum, whether answered or not
+ * @param quorum the requests
+ */
+static void quorum_end(quorum_t *quorum);
+
+/**
+ * @brief send a write to the N servers of a key and wait for W of them to succeed
+ * @param client client to use
+ * @param key the key written
+ * @param opcode the operation (PUT or a value operation)
+ * @param parts payload of the requests, in parts
+ * @param nb_parts their number
+ * @return some error_code
+ */
+static error_code write_on_replicas(client_t client, pps_key_t key, protocol_opcode_t opcode,
+                                    const struct iovec *parts, size_t nb_parts);
+
+/**
+ * @brief read the newest value of a key on R servers, and repair the stale ones
+ * @param client client to use
+ * @param key the key
+ * @param key_len its length
+ * @param value where to store the value (to be freed), followed by a '\0'
+ * @param length where to store its length (it may hold '\0')
+ * @param version where to store its version
+ * @return some error_code
+ */
+static error_code quorum_read(client_t client, pps_key_t key, size_t key_len, char **value, size_t *length,
+                              uint64_t *version);
+
+/**
+ * @brief write a value on W servers, sent from the buffers of the caller
+ * @param client client to use
+ * @param key the key
+ * @param key_len its length
+ * @param value the value (it may hold '\0')
+ * @param value_len its length
+ * @param version its version
+ * @return some error_code
+ */
+static error_code put_bytes(client_t client, pps_key_t key, size_t key_len, const char *value, size_t value_len,
+                            uint64_t version);
+
+/**
+ * @brief whether all the servers of a key also hold some other keys
+ * @param client client to use
+ * @param key the key
+ * @param keys the other keys
+ * @param nb_keys number of other keys
+ * @return 1 if they do
+ */
+static int colocated(client_t client, pps_key_t key, const pps_key_t *keys, size_t nb_keys);
+
+/**
+ * @brief write fields, each prefixed by its length, in a payload
+ * @param buffer where to write
+ * @param size size of the buffer
+ * @param fields the fields
+ * @param nb_fields number of fields
+ * @return size of the payload, 0 if they do not fit
+ */
+static size_t join_fields(char *buffer, size_t size, const char **fields, size_t nb_fields);
+
+/**
+ * @brief the versions of some keys on the servers of another key which hold them (see colocated):
+ *        these compute an operation alike only if they hold the same values
+ * @param client client to use
+ * @param key the key whose servers are asked
+ * @param keys the keys read by the operation
+ * @param nb_keys number of keys read
+ * @param versions where to store the version of each key read
+ * @return 1 if max(R, W) servers replied with the same versions and digests, and no server with others
+ */
+static int in_sync(client_t client, pps_key_t key, const pps_key_t *keys, size_t nb_keys, uint64_t *versions);
+
+/**
+ * @brief write the keys of an operation of the servers, <dest><version1><key1>...<versionK><keyK>
+ * @param buffer where to write
+ * @param size size of the buffer
+ * @param dest the key written
+ * @param keys the keys read
+ * @param versions the version of each key read
+ * @param nb_keys number of keys read
+ * @return size of the payload, 0 if they do not fit
+ */
+static size_t join_sources(char *buffer, size_t size, pps_key_t dest, const pps_key_t *keys,
+                           const uint64_t *versions, size_t nb_keys);
+
+/**
+ * @brief whether the reply of a GET holds a newer value than another one
+ * @param reply the reply, <version><value>
+ * @param other the other reply, NULL if there is none
+ * @return 1 if reply is newer
+ */
+static int newer_reply(const transport_request_t *reply, const transport_request_t *other);
+
+/**
+ * @brief decode the reply of a server to a quorum read
+ * @param request the request, a GET or a PROTOCOL_DIGEST
+ * @param reply where to store what the server replied
+ * @return 1 if the server replied, with the key or without it, 0 otherwise
+ */
+static int read_reply(const transport_request_t *request, read_reply_t *reply);
+
+/**
+ * @brief the newest value of a quorum read: the servers that only sent the
+ *        digest of the newest version are asked for their value, unless a
+ *        GET already brought a value of that digest
+ * @param client client to use
+ * @param request the GET, <key>
+ * @param size its size
+ * @param replies the replies of the servers, at least one with the key
+ * @param nb_replies number of replies
+ * @param ids where to store the IDs of the GETs sent, nb_replies at most
+ * @param nb_ids where to store their number
+ * @param newest where to store the reply holding the newest value, <version><value>
+ * @return ERR_NONE, or ERR_NETWORK if a server did not send its value
+ */
+static error_code fetch_newest(client_t client, const char *request, size_t size, const read_reply_t *replies,
+                               size_t nb_replies, uint32_t *ids, size_t *nb_ids, const transport_request_t **newest);
+
+/**
+ * @brief write the newest value of a key back on the servers of the key
+ *        that replied an older one (or none), without waiting for them
  * @param client client to use
- * @param toSend request to send
- * @param size size of the request
- * @return an error code
+ * @param key the key
+ * @param newest reply holding the newest value, <version><value>
+ * @param replies the replies of the servers
+ * @param nb_replies number of replies
+ * @return the number of servers repaired
  */
-static error_code send_to_server(node_t node, char **toSend, size_t size, int socket);
+static size_t read_repair(client_t client, pps_key_t key, const transport_request_t *newest,
+                          const read_reply_t *replies, size_t nb_replies);
 
 /**
- * @brief get a response  from a server
+ * @brief give up the requests of an operation, whether answered or not
  * @param client client to use
- * @param response value that will be modifiy
- * @param size size of the response
- * @return -1 if there is an error or the number of bytes recieves
+ * @param ids IDs of the requests, 0 for the requests that were not sent
+ * @param nbr_ids number of IDs
+ */
+static void forget_requests(client_t client, const uint32_t *ids, size_t nbr_ids);
+
+/**
+ * @brief ask the next page of a stream of a dump, or the same one again
+ * @param client client to use
+ * @param server the server dumped
+ * @param stream the stream, whose request in flight (if any) is given up
+ * @return ERR_NONE, ERR_NETWORK once the page was asked DUMP_TRIES times
+ */
+static error_code dump_ask(client_t client, const node_t *server, dump_stream_t *stream);
+
+/**
+ * @brief visit the pairs of a page of a dump
+ * @param reply the reply, <next cursor><version><key>\0<value>\0...
+ * @param visit the function called on every pair
+ * @param arg its first argument
+ * @param next where to store the cursor of the next page of the stream
+ * @return ERR_NONE, ERR_NETWORK if the page is malformed
  */
-static ssize_t get_response_from_server(struct sockaddr *server_addr, char **response, size_t size, int socket);
+static error_code dump_page(const transport_request_t *reply, network_visitor_t visit, void *arg, uint64_t *next);
 
 /**
- * @param client client that asked to get the content of its node
- * @param key '\0'
- * @param result string composed of the keys and values
+ * @brief ping every server of the client once and record which ones answered
+ * @param client client whose nodes_status is updated
  * @return some error_code
  */
+static error_code list_nodes(client_t client);
+
+/**
+ * @brief group (key, replica) pairs by server: counting sort on the index of the server in the pool
+ * @param transport the transport of the client
+ * @param nodes the preference list of every key
+ * @param todo the pairs, as key * N + replica
+ * @param nb_todo number of pairs
+ * @param start where to store the first pair of every server in order (nb_peers + 1 entries)
+ * @param order where to store the pairs, grouped by server
+ */
+static void group_by_server(const transport_t *transport, const node_t **nodes, const size_t *todo, size_t nb_todo,
+                            size_t *start, size_t *order);
+
+/**
+ * @brief send the pairs of a multi-put to their servers and count the replies
+ * @param mput the multi-put
+ * @return some error_code
+ */
+static error_code mput_send_all(mput_t *mput);
+
+/**
+ * @brief wait for the reply of a batch of a multi-put and count the pairs written
+ * @param mput the multi-put
+ * @return ERR_NONE, ERR_NETWORK on timeout (all the batches in flight are then given up)
+ */
+static error_code mput_receive(mput_t *mput);
+
+/**
+ * @brief current time
+ * @return the time of a monotonic clock, in seconds
+ */
+static double now(void);
+
+/**
+ * @brief start a window of chunks
+ * @param stream the window
+ * @param client client to use
+ * @param key key of the value
+ * @param key_len its length
+ * @param opcode PROTOCOL_PUT or PROTOCOL_GET
+ * @param version version of the value
+ * @param nodes room for the servers of the chunks, N per chunk
+ * @param ids room for their requests, N per chunk
+ * @param buffer the bytes of the chunks, NETWORK_CHUNK_SIZE per chunk, NULL for a get
+ */
+static void chunk_stream_init(chunk_stream_t *stream, client_t client, pps_key_t key, size_t key_len,
+                              protocol_opcode_t opcode, uint64_t version, const node_t **nodes, uint32_t *ids,
+                              char *buffer);
+
+/**
+ * @brief what follows the key of a value in the key of one of its chunks
+ * @param suffix where to write it, CHUNK_SUFFIX_SIZE bytes
+ * @param version version of the value
+ * @param index index of the chunk
+ * @return its size: '\0', the version and the index
+ */
+static size_t chunk_suffix(char *suffix, uint64_t version, size_t index);
+
+/**
+ * @brief find the servers of the next chunk of a window and ask them for
+ *        it (all of them for a put, the first one for a get)
+ * @param stream the window, not full; the bytes of the chunk are set for a put
+ * @return ERR_NONE, ERR_NETWORK if no server could be asked
+ */
+static error_code chunk_start(chunk_stream_t *stream);
+
+/**
+ * @brief send a chunk to its next server, or ask it for it
+ * @param stream the window
+ * @param chunk the chunk
+ */
+static void chunk_ask(chunk_stream_t *stream, chunk_t *chunk);
+
+/**
+ * @brief whether a chunk is written on W servers, or read
+ * @param stream the window
+ * @param chunk the chunk
+ * @return 1 if it is
+ */
+static int chunk_done(const chunk_stream_t *stream, const chunk_t *chunk);
+
+/**
+ * @brief wait for the next reply to the chunks of a window; a chunk to read
+ *        is asked to its next server once its server is late or does not
+ *        hold its version
+ * @param stream the window
+ * @return ERR_NONE, ERR_NETWORK if a chunk could not be written or read in time
+ */
+static error_code chunk_wait(chunk_stream_t *stream);
+
+/**
+ * @brief release the first chunk of a window (and its reply)
+ * @param stream the window
+ */
+static void chunk_release(chunk_stream_t *stream);
+
+/**
+ * @brief ask the (key, replica) pairs of mget->todo to their servers and handle the replies
+ * @param mget the multi-get
+ * @return some error_code
+ */
+static error_code mget_round(mget_t *mget);
+
+/**
+ * @brief send the keys of a batch of a multi-get
+ * @param mget the multi-get
+ * @param peer the server, index in the transport pool
+ * @param first first pair of the batch in mget->order
+ * @param count number of pairs
+ * @param payload the keys, one field each
+ * @param size size of the payload
+ * @return some error_code
+ */
+static error_code mget_send(mget_t *mget, size_t peer, size_t first, size_t count, const char *payload, size_t size);
+
+/**
+ * @brief wait for the reply of a batch of a multi-get and record its values
+ * @param mget the multi-get
+ * @return ERR_NONE, ERR_NETWORK on timeout
+ */
+static error_code mget_receive(mget_t *mget);
+
+/**
+ * @brief record a reply for a key, and keep the newest value once R servers replied
+ * @param mget the multi-get
+ * @param key index of the key
+ * @param value the value, NULL if the server does not hold the key
+ * @param length its length
+ * @param version its version
+ * @return some error_code
+ */
+static error_code mget_record(mget_t *mget, size_t key, const char *value, size_t length, uint64_t version);
+
+// =====================================================================
+
+error_code network_get(client_t client, pps_key_t key, pps_value_t *value)
+{
+    size_t sizeKey = 0;
+    if (key != NULL) {
+        sizeKey = strlen(key);
+        if(sizeKey > MAX_MSG_ELEM_SIZE) {
+            fprintf(stderr, "The key is too long in %s\n", __FILE__);
+            return ERR_BAD_PARAMETER;
+        }
+    }
+
+    //Look for servers
+    if (client.node == NULL) {
+        printf("FAIL\n");
+        M_EXIT(ERR_IO, "Unable to read PPS_SERVERS_LIST_FILENAME");
+    }
+
+    //Handle list node
+    if (key == NULL) {
+        return list_nodes(client);
+    }
+
+    //the content of a server is read with network_dump
+    if (key[0] == '\0') {
+        fprintf(stderr, "Empty key in network_get\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    char *copy = NULL;
+    size_t length = 0;
+    uint64_t version = 0;
+    error_code err = quorum_read(client, key, sizeKey, &copy, &length, &version);
+
+    //a manifest starts with a '\0', which no value of network_put holds
+    if (err == ERR_NONE && length > 0 && copy[0] == '\0') {
+        fprintf(stderr, "%s is a large value, read it with network_get_stream\n", key);
+        free(copy);
+        return ERR_BAD_PARAMETER;
+    }
+
+    if (err == ERR_NONE) *value = copy;
+    return err;
+}
+
+// =====================================================================
+
+static error_code quorum_read(client_t client, pps_key_t key, size_t key_len, char **value, size_t *length,
+                              uint64_t *version)
+{
+    //Try to get the key in N servers (and more if they are late), the replies are matched by request ID:
+    //the first one sends the value, the others its digest
+    size_t R = client.parsedOpt->R;
+    const node_t *sublist[QUORUM_SLOTS(client.parsedOpt->N)];
+    uint32_t ids[QUORUM_SLOTS(client.parsedOpt->N)];
+    quorum_t quorum;
+
+    //<key>, asked for its value or its digest
+    char payload[PROTOCOL_VARINT_MAX + MAX_MSG_ELEM_SIZE];
+    size_t size = protocol_write_field(payload, key, key_len);
+
+    struct iovec part = {payload, size};
+    if (quorum_start(&quorum, client, key, PROTOCOL_GET, &part, 1, MAX_HEDGES, sublist, ids) != ERR_NONE) {
+        fprintf(stderr, "Could not ask the N nodes in network-get\n");
+        quorum_end(&quorum);
+        return ERR_NETWORK;
+    }
+
+    //the newest value of R replies, a server without the key replies too;
+    //the digests come before the value, which is waited for rather than asked again
+    read_reply_t replies[QUORUM_SLOTS(client.parsedOpt->N)];
+    size_t nb_replies = 0;
+    size_t nb_found = 0;
+    int valued = 0;
+
+    uint32_t id = 0;
+    while ((nb_replies < R || (nb_found > 0 && !valued)) && quorum_wait(&quorum, &id) == ERR_NONE) {
+        const transport_request_t *request = transport_reply(client.transport, id);
+        if (read_reply(request, &replies[nb_replies])) {
+            nb_found += replies[nb_replies++].found;
+            valued = valued || request->opcode == PROTOCOL_GET;
+        }
+    }
+
+    uint32_t fetched[QUORUM_SLOTS(client.parsedOpt->N)];
+    size_t nb_fetched = 0;
+    const transport_request_t *newest = NULL;
+
+    error_code err = nb_replies < R ? ERR_NETWORK : nb_found == 0 ? ERR_NOT_FOUND
+                     : fetch_newest(client, payload, size, replies, nb_replies, fetched, &nb_fetched, &newest);
+    if (err == ERR_NONE) {
+        //the reply is followed by a '\0' (see transport_reply)
+        *length = newest->reply_size - PROTOCOL_STAMP_SIZE;
+        *version = protocol_read_stamp(newest->reply);
+        *value = malloc(*length + 1);
+        if (*value != NULL) memcpy(*value, newest->reply + PROTOCOL_STAMP_SIZE, *length + 1);
+        err = *value == NULL ? ERR_NOMEM : ERR_NONE;
+    }
+
+    if (err == ERR_NONE) {
+        //the writes of this client come after what it read
+        hlc_observe(&client_clock, protocol_read_stamp(newest->reply));
+        read_repair(client, key, newest, replies, nb_replies);
+    }
+
+    forget_requests(client, fetched, nb_fetched);
+    quorum_end(&quorum);
+    return err;
+}
+
+// =====================================================================
+
+error_code network_dump(client_t client, const node_t *server, size_t window, network_visitor_t visit, void *arg)
+{
+    M_REQUIRE_NON_NULL(server);
+    M_REQUIRE_NON_NULL(visit);
+    M_REQUIRE(window > 0, ERR_BAD_PARAMETER, "window == %d", 0);
+
+    dump_stream_t streams[PROTOCOL_SCAN_STREAMS];
+    size_t nb_started = 0;
+    size_t in_flight = 0;
+    error_code err = ERR_NONE;
+
+    while (err == ERR_NONE) {
+        //one page in flight per credit of the window: a stream done gives its credit to the next one
+        while (err == ERR_NONE && in_flight < window && nb_started < PROTOCOL_SCAN_STREAMS) {
+            dump_stream_t stream = {PROTOCOL_SCAN_START(nb_started), 0, 0, 0};
+            streams[nb_started] = stream;
+            err = dump_ask(client, server, &streams[nb_started++]);
+            ++in_flight;
+        }
+        if (err != ERR_NONE || in_flight == 0) break;
+
+        //until the oldest page is late
+        double late = -1;
+        for (size_t s = 0; s < nb_started; s++) {
+            double at = streams[s].sent + TRANSPORT_TIMEOUT_MS / 1e3;
+            if (streams[s].id != 0 && (late < 0 || at < late)) late = at;
+        }
+
+        uint32_t id = 0;
+        double t = now();
+        if (late <= t || transport_wait(client.transport, (int) ((late - t) * 1e3) + 1, &id) != ERR_NONE) {
+            //the late pages are asked again, with the same cursor
+            t = now();
+            for (size_t s = 0; err == ERR_NONE && s < nb_started; s++) {
+                if (streams[s].id != 0 && streams[s].sent + TRANSPORT_TIMEOUT_MS / 1e3 <= t) {
+                    err = dump_ask(client, server, &streams[s]);
+                }
+            }
+            continue;
+        }
+
+        size_t s = 0;
+        while (s < nb_started && streams[s].id != id) s++;
+        if (s == nb_started) continue;
+
+        const transport_request_t *reply = transport_reply(client.transport, id);
+        if (reply->status == PROTOCOL_UNREACHABLE) {
+            err = dump_ask(client, server, &streams[s]);
+            continue;
+        }
+
+        uint64_t next = PROTOCOL_SCAN_END;
+        err = reply->status == PROTOCOL_OK ? dump_page(reply, visit, arg, &next) : ERR_NETWORK;
+        transport_forget(client.transport, id);
+        streams[s].id = 0;
+
+        if (err == ERR_NONE && next == PROTOCOL_SCAN_END) {
+            --in_flight;
+        } else if (err == ERR_NONE) {
+            streams[s].cursor = next;
+            streams[s].tries = 0;
+            err = dump_ask(client, server, &streams[s]);
+        }
+    }
+
+    for (size_t s = 0; s < nb_started; s++) {
+        if (streams[s].id != 0) transport_forget(client.transport, streams[s].id);
+    }
+
+    return err;
+}
+
+// =====================================================================
+
+error_code network_mget(client_t client, const pps_key_t *keys, size_t nb_keys, pps_value_t *values)
+{
+    M_REQUIRE_NON_NULL(keys);
+    M_REQUIRE_NON_NULL(values);
+    M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
+
+    for (size_t k = 0; k < nb_keys; k++) {
+        values[k] = NULL;
+        M_REQUIRE_NON_NULL(keys[k]);
+        if (keys[k][0] == '\0' || strlen(keys[k]) > MAX_MSG_ELEM_SIZE) {
+            fprintf(stderr, "Invalid key in network_mget\n");
+            return ERR_BAD_PARAMETER;
+        }
+    }
+
+    if (nb_keys == 0) return ERR_NONE;
+
+    size_t N = client.parsedOpt->N;
+    mget_t mget = {client, keys, nb_keys, N, NULL, NULL, NULL, NULL, NULL, NULL, values, NULL, 0, NULL, 0, NULL, NULL,
+                   0, 0};
+
+    mget.nodes = calloc(nb_keys * N, sizeof(node_t *));
+    mget.nb_nodes = calloc(nb_keys, sizeof(size_t));
+    mget.newest = calloc(nb_keys, sizeof(char *));
+    mget.versions = calloc(nb_keys, sizeof(uint64_t));
+    mget.lengths = calloc(nb_keys, sizeof(size_t));
+    mget.nb_received = calloc(nb_keys, sizeof(size_t));
+    mget.todo = calloc(nb_keys * N, sizeof(size_t));
+    mget.next = calloc(nb_keys * N, sizeof(size_t));
+    mget.order = calloc(nb_keys * N, sizeof(size_t));
+    mget.batches = calloc(nb_keys * N, sizeof(multi_batch_t));
+
+    error_code err = ERR_NONE;
+    if (mget.nodes == NULL || mget.nb_nodes == NULL || mget.newest == NULL || mget.versions == NULL
+        || mget.lengths == NULL || mget.nb_received == NULL
+        || mget.todo == NULL || mget.next == NULL || mget.order == NULL || mget.batches == NULL) {
+        fprintf(stderr, "Could not allocate memory in network_mget\n");
+        err = ERR_NOMEM;
+    }
+
+    //every key is asked to the N servers of its preference list
+    for (size_t k = 0; err == ERR_NONE && k < nb_keys; k++) {
+        mget.nb_nodes[k] = ring_get_preference_list(client.node, keys[k], strlen(keys[k]), N, mget.nodes + k * N);
+        for (size_t j = 0; j < mget.nb_nodes[k]; j++) {
+            mget.todo[mget.nb_todo++] = k * N + j;
+        }
+    }
+
+    //the keys left out of full replies are asked again
+    while (err == ERR_NONE && mget.nb_todo > 0) {
+        err = mget_round(&mget);
+
+        size_t *swap = mget.todo;
+        mget.todo = mget.next;
+        mget.next = swap;
+        mget.nb_todo = mget.nb_next;
+        mget.nb_next = 0;
+    }
+
+    //a manifest starts with a '\0', which no value of network_put holds
+    for (size_t k = 0; err == ERR_NONE && k < nb_keys; k++) {
+        if (values[k] != NULL && mget.lengths[k] > 0 && values[k][0] == '\0') {
+            fprintf(stderr, "%s is a large value, read it with network_get_stream\n", keys[k]);
+            err = ERR_BAD_PARAMETER;
+        }
+    }
+
+    for (size_t k = 0; mget.newest != NULL && k < nb_keys; k++) {
+        free(mget.newest[k]);
+    }
+
+    free(mget.nodes);
+    free(mget.nb_nodes);
+    free(mget.newest);
+    free(mget.versions);
+    free(mget.lengths);
+    free(mget.nb_received);
+    free(mget.todo);
+    free(mget.next);
+    free(mget.order);
+    free(mget.batches);
+
+    if (err != ERR_NONE) {
+        for (size_t k = 0; k < nb_keys; k++) {
+            free_const_ptr(values[k]);
+            values[k] = NULL;
+        }
+        return err;
+    }
+
+    size_t found = 0;
+    for (size_t k = 0; k < nb_keys; k++) {
+        found += values[k] != NULL;
+    }
+
+    return found == nb_keys ? ERR_NONE : found == 0 ? ERR_NETWORK : ERR_NOT_FOUND;
+}
+
+// =====================================================================
+
+error_code network_put(client_t client, pps_key_t key, pps_value_t value)
+{
+    M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(value);
+
+    //the key and the value end at their first '\n', as the tools read them
+    size_t key_len = strcspn(key, "\n");
+    size_t value_len = strcspn(value, "\n");
+
+    if (!protocol_pair_fits(key_len, value_len)) {
+        fprintf(stderr, "The key or the value is to long\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    return put_bytes(client, key, key_len, value, value_len, hlc_now(&client_clock));
+}
+
+// =====================================================================
+
+static error_code put_bytes(client_t client, pps_key_t key, size_t key_len, const char *value, size_t value_len,
+                            uint64_t version)
+{
+    //<version><key><value>: only the version and the lengths are written, on
+    //the stack, the key and the value are sent from the buffers of the caller
+    char prefix[PROTOCOL_STAMP_SIZE + PROTOCOL_VARINT_MAX];
+    char value_prefix[PROTOCOL_VARINT_MAX];
+    protocol_write_stamp(prefix, version);
+
+    struct iovec parts[4] = {
+        {prefix, PROTOCOL_STAMP_SIZE + protocol_write_varint(prefix + PROTOCOL_STAMP_SIZE, key_len)},
+        {(void *) key, key_len},
+        {value_prefix, protocol_write_varint(value_prefix, value_len)},
+        {(void *) value, value_len}
+    };
+
+    if (parts[0].iov_len + key_len + parts[2].iov_len + value_len > PROTOCOL_MAX_PAYLOAD) {
+        fprintf(stderr, "Invalid size of packet %s\n", __FILE__);
+        return ERR_BAD_PARAMETER;
+    }
+
+    //Put the pair in all servers, fails if one server could not add it to its Htable
+    return write_on_replicas(client, key, PROTOCOL_PUT, parts, 4);
+}
+
+// =====================================================================
+
+error_code network_concat(client_t client, const pps_key_t *keys, size_t nb_keys, pps_key_t dest)
+{
+    M_REQUIRE_NON_NULL(keys);
+    M_REQUIRE_NON_NULL(dest);
+    M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
+
+    if (nb_keys == 0) return ERR_BAD_PARAMETER;
+
+    //the servers of dest compute the value themselves when they hold the same values of all the keys
+    uint64_t versions[MAX_OPERATION_KEYS];
+    if (nb_keys < MAX_OPERATION_KEYS && colocated(client, dest, keys, nb_keys)
+        && in_sync(client, dest, keys, nb_keys, versions)) {
+        //<version><dest><version1><src1>...: all the servers stamp the new value alike
+        char payload[PROTOCOL_MAX_PAYLOAD];
+        protocol_write_stamp(payload, hlc_now(&client_clock));
+        size_t size = join_sources(payload + PROTOCOL_STAMP_SIZE, PROTOCOL_MAX_PAYLOAD - PROTOCOL_STAMP_SIZE,
+                                   dest, keys, versions, nb_keys);
+
+        //a server whose values changed since refuses it, then the value is written as below, newer
+        struct iovec part = {payload, PROTOCOL_STAMP_SIZE + size};
+        if (size > 0 && write_on_replicas(client, dest, PROTOCOL_CONCAT, &part, 1) == ERR_NONE) return ERR_NONE;
+    }
+
+    //otherwise all the values are read at once, concatenated and written back
+    pps_value_t *values = calloc(nb_keys, sizeof(pps_value_t));
+    M_EXIT_IF_NULL(values, nb_keys * sizeof(pps_value_t), "network.c/network_concat");
+
+    error_code err = network_mget(client, keys, nb_keys, values);
+
+    size_t length = 0;
+    for (size_t k = 0; err == ERR_NONE && k < nb_keys; k++) {
+        length += strlen(values[k]);
+        if (length > MAX_MSG_ELEM_SIZE) {
+            fprintf(stderr, "New value too long in network_concat\n");
+            err = ERR_BAD_PARAMETER;
+        }
+    }
+
+    char *value = NULL;
+    if (err == ERR_NONE) {
+        value = malloc(length + 1);
+        err = value == NULL ? ERR_NOMEM : ERR_NONE;
+    }
+
+    //in the order of the keys, whatever the order of the replies
+    if (err == ERR_NONE) {
+        char *end = value;
+        for (size_t k = 0; k < nb_keys; k++) {
+            size_t value_length = strlen(values[k]);
+            memcpy(end, values[k], value_length);
+            end += value_length;
+        }
+        *end = '\0';
+
+        err = network_put(client, dest, value);
+    }
+
+    for (size_t k = 0; k < nb_keys; k++) {
+        free_const_ptr(values[k]);
+    }
+    free(values);
+    free(value);
+
+    return err;
+}
+
+// =====================================================================
+
+error_code network_substr(client_t client, pps_key_t key, long start, size_t length, pps_key_t dest)
+{
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(dest);
+    M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
+
+    uint64_t version = 0;
+    if (colocated(client, dest, &key, 1) && in_sync(client, dest, &key, 1, &version)) {
+        //<version><dest><version1><src><start><length>
+        char payload[PROTOCOL_MAX_PAYLOAD];
+        protocol_write_stamp(payload, hlc_now(&client_clock));
+        size_t size = join_sources(payload + PROTOCOL_STAMP_SIZE,
+                                   PROTOCOL_MAX_PAYLOAD - PROTOCOL_STAMP_SIZE - 2 * PROTOCOL_VARINT_MAX,
+                                   dest, &key, &version, 1);
+        if (size > 0) {
+            size += PROTOCOL_STAMP_SIZE;
+            size += protocol_write_varint(payload + size, PROTOCOL_ZIGZAG(start));
+            size += protocol_write_varint(payload + size, length);
+            struct iovec part = {payload, size};
+            if (write_on_replicas(client, dest, PROTOCOL_SUBSTR, &part, 1) == ERR_NONE) return ERR_NONE;
+        }
+    }
+
+    pps_value_t value = NULL;
+    error_code err = network_get(client, key, &value);
+
+    size_t offset = 0;
+    if (err == ERR_NONE) {
+        err = substring_offset(strlen(value), start, length, &offset);
+    }
+
+    char *new_value = NULL;
+    if (err == ERR_NONE) {
+        new_value = calloc(length + 1, sizeof(char));
+        err = new_value == NULL ? ERR_NOMEM : ERR_NONE;
+    }
+
+    if (err == ERR_NONE) {
+        memcpy(new_value, value + offset, length);
+        err = network_put(client, dest, new_value);
+    }
+
+    free(new_value);
+    free_const_ptr(value);
+    return err;
+}
+
+// =====================================================================
+
+error_code network_find(client_t client, pps_key_t key1, pps_key_t key2, long *index)
+{
+    M_REQUIRE_NON_NULL(key1);
+    M_REQUIRE_NON_NULL(key2);
+    M_REQUIRE_NON_NULL(index);
+    M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
+
+    //the servers of key1 search themselves when they also hold key2
+    const char *fields[2] = {key1, key2};
+    char payload[PROTOCOL_MAX_PAYLOAD];
+    size_t size = join_fields(payload, sizeof(payload), fields, 2);
+
+    if (size > 0 && colocated(client, key1, &key2, 1)) {
+        //not hedged: the next servers may not hold key2
+        const node_t *sublist[QUORUM_SLOTS(client.parsedOpt->N)];
+        uint32_t ids[QUORUM_SLOTS(client.parsedOpt->N)];
+        quorum_t quorum;
+        struct iovec part = {payload, size};
+        quorum_start(&quorum, client, key1, PROTOCOL_FIND, &part, 1, 0, sublist, ids);
+
+        //R equal indices
+        long indices[client.parsedOpt->N];
+        size_t nbr_indices = 0;
+        uint32_t id = 0;
+        while (quorum_wait(&quorum, &id) == ERR_NONE) {
+
+            const transport_request_t *request = transport_reply(client.transport, id);
+            protocol_reader_t reader;
+            protocol_reader_init(&reader, request->reply, request->reply_size);
+            uint64_t found = 0;
+            if (request->status != PROTOCOL_OK || !protocol_next_varint(&reader, &found)) continue;
+            indices[nbr_indices] = (long) PROTOCOL_UNZIGZAG(found);
+
+            size_t count = 0;
+            for (size_t j = 0; j <= nbr_indices; j++) {
+                count += indices[j] == indices[nbr_indices];
+            }
+
+            if (count >= client.parsedOpt->R) {
+                *index = indices[nbr_indices];
+                quorum_end(&quorum);
+                return ERR_NONE;
+            }
+            nbr_indices++;
+        }
+
+        quorum_end(&quorum);
+        return ERR_NETWORK;
+    }
+
+    pps_value_t values[2];
+    error_code err = network_mget(client, fields, 2, values);
+
+    if (err == ERR_NONE) {
+        const char *found = strstr(values[0], values[1]);
+        *index = found == NULL ? -1 : (long) (found - values[0]);
+    }
+
+    free_const_ptr(values[0]);
+    free_const_ptr(values[1]);
+    return err;
+}
+
+// =====================================================================
+
+static error_code write_on_replicas(client_t client, pps_key_t key, protocol_opcode_t opcode,
+                                    const struct iovec *parts, size_t nb_parts)
+{
+    //only a PUT can be hedged, on as many servers as the key has (sloppy quorum):
+    //the next servers may not hold the values of an operation
+    size_t hedges = opcode == PROTOCOL_PUT ? client.parsedOpt->N : 0;
+    const node_t *sublist[QUORUM_SLOTS(client.parsedOpt->N)];
+    uint32_t ids[QUORUM_SLOTS(client.parsedOpt->N)];
+    quorum_t quorum;
+
+    if (quorum_start(&quorum, client, key, opcode, parts, nb_parts, hedges, sublist, ids) != ERR_NONE) {
+        fprintf(stderr, "Error while sending requests in network put\n");
+        quorum_end(&quorum);
+        return ERR_NETWORK;
+    }
+
+    //done as soon as W servers wrote it
+    size_t written = 0;
+    uint32_t id = 0;
+    while (written < client.parsedOpt->W && quorum_wait(&quorum, &id) == ERR_NONE) {
+        if (transport_reply(client.transport, id)->status == PROTOCOL_OK) {
+            written++;
+        }
+    }
+
+    quorum_end(&quorum);
+    M_EXIT_IF(written < client.parsedOpt->W, ERR_NETWORK, "network.c/network_put",
+              "Could not put the new value on enough servers\n");
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code quorum_start(quorum_t *quorum, client_t client, pps_key_t key, protocol_opcode_t opcode,
+                               const struct iovec *parts, size_t nb_parts, size_t hedges, const node_t **nodes,
+                               uint32_t *ids)
+{
+    size_t N = client.parsedOpt->N;
+    size_t size = 0;
+    for (size_t p = 0; p < nb_parts; p++) {
+        size += parts[p].iov_len;
+    }
+
+    quorum_t q = {client, key, opcode, parts, nb_parts, size, nodes, 0, 0, ids, 0, 0, now(), 0, 0, 0};
+    size_t nb_nodes = ring_get_preference_list(client.node, key, strlen(key), QUORUM_SLOTS(N), nodes);
+
+    //the healthy servers first, in the order of the ring
+    const node_t *suspected[QUORUM_SLOTS(N)];
+    size_t nb_suspected = 0;
+    for (size_t i = 0; i < nb_nodes; i++) {
+        if (transport_suspected(client.transport, &nodes[i]->srv_addr)) {
+            suspected[nb_suspected++] = nodes[i];
+        } else {
+            nodes[q.nb_nodes++] = nodes[i];
+        }
+    }
+    memcpy(nodes + q.nb_nodes, suspected, nb_suspected * sizeof(node_t *));
+    q.nb_nodes = nb_nodes < N + hedges ? nb_nodes : N + hedges;
+
+    while (q.nb_asked < q.nb_nodes && q.nb_asked < N) {
+        quorum_ask(&q);
+    }
+
+    q.nb_first = q.nb_asked;
+    q.hedge_at = quorum_late(&q);
+    q.deadline = q.start + TRANSPORT_TIMEOUT_MS / 1e3;
+    *quorum = q;
+
+    return q.nb_waiting > 0 ? ERR_NONE : ERR_NETWORK;
+}
+
+// =====================================================================
+
+static error_code quorum_wait(quorum_t *quorum, uint32_t *id)
+{
+    while (1) {
+        double t = now();
+
+        //the first replies tell how long the others should take, even from servers never heard of
+        if (quorum->nb_asked == quorum->nb_first) {
+            double late = quorum_late(quorum);
+            quorum->hedge_at = late < quorum->hedge_at ? late : quorum->hedge_at;
+        }
+
+        if (quorum->nb_asked < quorum->nb_nodes && quorum->hedge_at < quorum->deadline
+            && (t >= quorum->hedge_at || quorum->nb_waiting == 0)) {
+            const node_t *node = quorum->nodes[quorum->nb_asked];
+            quorum_ask(quorum);
+            quorum->hedge_at = t + transport_timeout_ms(quorum->client.transport, &node->srv_addr) / 1e3;
+            continue;
+        }
+
+        if (quorum->nb_waiting == 0 || t >= quorum->deadline) return ERR_NETWORK;
+
+        double until = quorum->nb_asked < quorum->nb_nodes && quorum->hedge_at < quorum->deadline
+                       ? quorum->hedge_at : quorum->deadline;
+        if (until <= t) until = t;
+
+        //no reply in time: hedge or give up
+        if (transport_wait(quorum->client.transport, (int) ((until - t) * 1e3) + 1, id) != ERR_NONE) continue;
+
+        --(quorum->nb_waiting);
+        if (transport_reply(quorum->client.transport, *id)->status == PROTOCOL_UNREACHABLE) {
+            quorum->hedge_at = t;
+        }
+        return ERR_NONE;
+    }
+}
+
+// =====================================================================
+
+static double quorum_late(const quorum_t *quorum)
+{
+    //a reply is late once it took longer than the round-trip times of its servers predict
+    int late_ms = 0;
+    for (size_t i = 0; i < quorum->nb_first; i++) {
+        int timeout_ms = transport_timeout_ms(quorum->client.transport, &quorum->nodes[i]->srv_addr);
+        late_ms = timeout_ms > late_ms ? timeout_ms : late_ms;
+    }
+
+    return quorum->start + late_ms / 1e3;
+}
+
+// =====================================================================
+
+static void quorum_ask(quorum_t *quorum)
+{
+    size_t i = quorum->nb_asked++;
+
+    //a read asks one server for the value and the others for its digest, but a hedge
+    //(asked once the first servers are, see quorum_start) replaces a late value
+    protocol_opcode_t opcode = quorum->opcode;
+    if (opcode == PROTOCOL_GET && i > 0) {
+        const transport_request_t *first = transport_reply(quorum->client.transport, quorum->ids[0]);
+        int late = quorum->nb_first > 0 && (first == NULL || !first->done || first->status != PROTOCOL_OK);
+        opcode = late ? PROTOCOL_GET : PROTOCOL_DIGEST;
+    }
+
+    const node_t *owner = quorum->opcode == PROTOCOL_PUT ? stand_in_for(quorum, quorum->nodes[i]) : NULL;
+
+    error_code err = ERR_NONE;
+    if (owner != NULL && PROTOCOL_ADDR_SIZE + quorum->size <= PROTOCOL_MAX_PAYLOAD
+        && quorum->nb_parts < TRANSPORT_MAX_PARTS) {
+        //<owner><version><key><value>: the owner before the parts of the PUT
+        char addr[PROTOCOL_ADDR_SIZE];
+        protocol_write_addr(addr, &owner->srv_addr);
+
+        struct iovec parts[TRANSPORT_MAX_PARTS] = {{addr, PROTOCOL_ADDR_SIZE}};
+        memcpy(parts + 1, quorum->parts, quorum->nb_parts * sizeof(struct iovec));
+        err = send_to_server(quorum->client, quorum->nodes[i], PROTOCOL_HINT, parts, 1 + quorum->nb_parts,
+                             &quorum->ids[i]);
+    } else {
+        err = send_to_server(quorum->client, quorum->nodes[i], opcode, quorum->parts, quorum->nb_parts,
+                             &quorum->ids[i]);
+    }
+
+    if (err == ERR_NONE) {
+        ++(quorum->nb_waiting);
+    } else {
+        quorum->ids[i] = 0;
+    }
+}
+
+// =====================================================================
+
+static void quorum_end(quorum_t *quorum)
+{
+    forget_requests(quorum->client, quorum->ids, quorum->nb_asked);
+}
+
+// =====================================================================
+
+static const node_t *stand_in_for(quorum_t *quorum, const node_t *node)
+{
+    size_t N = quorum->client.parsedOpt->N;
+    const node_t *owners[N];
+    size_t nb_owners = ring_get_preference_list(quorum->client.node, quorum->key, strlen(quorum->key), N, owners);
+
+    for (size_t o = 0; o < nb_owners; o++) {
+        if (memcmp(&owners[o]->srv_addr, &node->srv_addr, sizeof(node->srv_addr)) == 0) return NULL;
+    }
+
+    for (size_t o = 0; o < nb_owners && o < 64; o++) {
+        if (quorum->hinted & ((uint64_t) 1 << o)) continue;
+
+        //a server of the key that already wrote it needs no stand-in
+        int written = 0;
+        for (size_t i = 0; !written && i + 1 < quorum->nb_asked; i++) {
+            const transport_request_t *request = transport_reply(quorum->client.transport, quorum->ids[i]);
+            written = memcmp(&quorum->nodes[i]->srv_addr, &owners[o]->srv_addr, sizeof(node->srv_addr)) == 0
+                      && request != NULL && request->done && request->status == PROTOCOL_OK;
+        }
+
+        if (!written) {
+            quorum->hinted |= (uint64_t) 1 << o;
+            return owners[o];
+        }
+    }
+
+    return NULL;
+}
+
+// =====================================================================
+
+static int newer_reply(const transport_request_t *reply, const transport_request_t *other)
+{
+    if (other == NULL) return 1;
+
+    return hlc_newer(protocol_read_stamp(reply->reply), reply->reply + PROTOCOL_STAMP_SIZE,
+                     reply->reply_size - PROTOCOL_STAMP_SIZE, protocol_read_stamp(other->reply),
+                     other->reply + PROTOCOL_STAMP_SIZE, other->reply_size - PROTOCOL_STAMP_SIZE);
+}
+
+// =====================================================================
+
+static int read_reply(const transport_request_t *request, read_reply_t *reply)
+{
+    if (request == NULL) return 0;
+
+    reply->id = request->id;
+    reply->found = request->status == PROTOCOL_OK;
+    if (request->status == PROTOCOL_NOT_FOUND) return 1;
+    if (request->status != PROTOCOL_OK) return 0;
+
+    if (request->opcode == PROTOCOL_DIGEST) {
+        if (request->reply_size != PROTOCOL_STAMP_SIZE + PROTOCOL_DIGEST_SIZE) return 0;
+        reply->version = protocol_read_stamp(request->reply);
+        reply->digest = protocol_read_stamp(request->reply + PROTOCOL_STAMP_SIZE);
+        return 1;
+    }
+
+    if (request->reply_size < PROTOCOL_STAMP_SIZE) return 0;
+    reply->version = protocol_read_stamp(request->reply);
+    reply->digest = protocol_digest(request->reply + PROTOCOL_STAMP_SIZE, request->reply_size - PROTOCOL_STAMP_SIZE);
+    return 1;
+}
+
+// =====================================================================
+
+static error_code fetch_newest(client_t client, const char *request, size_t size, const read_reply_t *replies,
+                               size_t nb_replies, uint32_t *ids, size_t *nb_ids, const transport_request_t **newest)
+{
+    uint64_t version = 0;
+    for (size_t r = 0; r < nb_replies; r++) {
+        if (replies[r].found && replies[r].version > version) version = replies[r].version;
+    }
+
+    //a value per digest of the newest version: usually one, sent by the first server
+    *nb_ids = 0;
+    *newest = NULL;
+    for (size_t r = 0; r < nb_replies; r++) {
+        if (!replies[r].found || replies[r].version != version) continue;
+
+        const transport_request_t *holder = NULL;
+        int first = 1;
+        for (size_t o = 0; o < nb_replies; o++) {
+            if (!replies[o].found || replies[o].version != version || replies[o].digest != replies[r].digest) continue;
+
+            const transport_request_t *request = transport_reply(client.transport, replies[o].id);
+            if (request->opcode == PROTOCOL_GET) holder = request;
+            first = first && o >= r;
+        }
+        if (!first) continue;
+
+        if (holder != NULL) {
+            if (newer_reply(holder, *newest)) *newest = holder;
+        } else if (transport_request(client.transport, &transport_reply(client.transport, replies[r].id)->addr,
+                                     PROTOCOL_GET, request, size, &ids[*nb_ids]) == ERR_NONE) {
+            ++(*nb_ids);
+        } else {
+            return ERR_NETWORK;
+        }
+    }
+
+    //the digests that did not match: their values break the tie
+    size_t waiting = *nb_ids;
+    double deadline = now() + TRANSPORT_TIMEOUT_MS / 1e3;
+    uint32_t id = 0;
 
-static error_code dump(client_t client, struct sockaddr *server_addr, pps_key_t key, char **result, int socket);
+    while (waiting > 0 && now() < deadline) {
+        if (transport_wait(client.transport, (int) ((deadline - now()) * 1e3) + 1, &id) != ERR_NONE) continue;
 
-/**
- * @brief prepare the packet before it is sent to the server in put
- * @param key
- * @param value
- * @param toSend the packet that is being prepared
- * @return -1 if there is a memory error, the size of the whole message otherwise
- */
-static int prepare_put_packet(pps_key_t key, pps_value_t value, char **toSend);
+        for (size_t i = 0; i < *nb_ids; i++) {
+            if (ids[i] != id) continue;
+
+            const transport_request_t *request = transport_reply(client.transport, id);
+            if (request->status != PROTOCOL_OK || request->reply_size < PROTOCOL_STAMP_SIZE) return ERR_NETWORK;
+            if (newer_reply(request, *newest)) *newest = request;
+            --waiting;
+        }
+    }
 
+    return waiting == 0 && *newest != NULL ? ERR_NONE : ERR_NETWORK;
+}
 
 // =====================================================================
 
-error_code network_get(client_t client, pps_key_t key, pps_value_t *value)
+static size_t read_repair(client_t client, pps_key_t key, const transport_request_t *newest,
+                          const read_reply_t *replies, size_t nb_replies)
 {
-    size_t sizeKey = 0;
-    if (key != NULL) {
-        sizeKey = strlen(key);
-        if(sizeKey > MAX_MSG_ELEM_SIZE) {
-            fprintf(stderr, "The key is too long in %s\n", __FILE__);
-            return ERR_BAD_PARAMETER;
+    size_t N = client.parsedOpt->N;
+    const node_t *servers[N];
+    size_t nb_servers = ring_get_preference_list(client.node, key, strlen(key), N, servers);
+
+    //<version><key><value>: the PUT of the value read, its version included
+    size_t key_size = strlen(key);
+    size_t value_size = newest->reply_size - PROTOCOL_STAMP_SIZE;
+    size_t size = PROTOCOL_STAMP_SIZE + protocol_field_size(key_size) + protocol_field_size(value_size);
+    if (size > PROTOCOL_MAX_PAYLOAD) return 0;
+
+    uint64_t version = protocol_read_stamp(newest->reply);
+    uint64_t digest = protocol_digest(newest->reply + PROTOCOL_STAMP_SIZE, value_size);
+
+    char *payload = NULL;
+    size_t repaired = 0;
+
+    for (size_t r = 0; r < nb_replies; r++) {
+        const transport_request_t *reply = transport_reply(client.transport, replies[r].id);
+        if (reply == NULL || (replies[r].found && replies[r].version == version && replies[r].digest == digest)) continue;
+
+        //only the servers of the key, not the ones that stood in for them
+        int holder = 0;
+        for (size_t s = 0; !holder && s < nb_servers; s++) {
+            holder = memcmp(&servers[s]->srv_addr, &reply->addr, sizeof(reply->addr)) == 0;
+        }
+        if (!holder) continue;
+
+        if (payload == NULL) {
+            payload = malloc(size);
+            if (payload == NULL) return repaired;
+            memcpy(payload, newest->reply, PROTOCOL_STAMP_SIZE);
+            size_t used = PROTOCOL_STAMP_SIZE + protocol_write_field(payload + PROTOCOL_STAMP_SIZE, key, key_size);
+            protocol_write_field(payload + used, newest->reply + PROTOCOL_STAMP_SIZE, value_size);
+        }
+
+        //not waited for: the ack is dropped with the request
+        uint32_t id = 0;
+        if (transport_request(client.transport, &reply->addr, PROTOCOL_PUT, payload, size, &id) == ERR_NONE) {
+            transport_forget(client.transport, id);
+            ++repaired;
         }
     }
 
-    //Look for servers
-    if (client.node == NULL) {
-        printf("FAIL\n");
-        M_EXIT(ERR_IO, "Unable to read PPS_SERVERS_LIST_FILENAME");
-    } else {
-        struct sockaddr server_addr_rcv_from;
+    free(payload);
+    return repaired;
+}
 
-        int socket = get_socket(1);
-        if (socket == -1) {
-            return ERR_NETWORK;
-        }
+// =====================================================================
 
-        //Handle list node
-        if (key == NULL) {
+static int colocated(client_t client, pps_key_t key, const pps_key_t *keys, size_t nb_keys)
+{
+    size_t N = client.parsedOpt->N;
+    const node_t *servers[N];
+    size_t nb_servers = ring_get_preference_list(client.node, key, strlen(key), N, servers);
+
+    for (size_t k = 0; k < nb_keys; k++) {
+        const node_t *holders[N];
+        size_t nb_holders = ring_get_preference_list(client.node, keys[k], strlen(keys[k]), N, holders);
+
+        for (size_t s = 0; s < nb_servers; s++) {
+            int found = 0;
+            for (size_t h = 0; !found && h < nb_holders; h++) {
+                found = memcmp(&servers[s]->srv_addr, &holders[h]->srv_addr, sizeof(holders[h]->srv_addr)) == 0;
+            }
+            if (!found) return 0;
+        }
+    }
 
-            char FAIL[] = "FAIL";
-            char OK[] = "OK";
+    return nb_servers > 0;
+}
 
-            for (size_t i = 0; i < client.node->size; i++) {
+// =====================================================================
 
-                //try to reach each node of the ring
-                if (send_to_server(client.node->nodes[i], &key, sizeKey, socket) != ERR_NONE) {
-                    if (add_Htable_value(client.nodes_status, client.node->nodes[i].SHA, FAIL) != ERR_NONE) {
-                        fprintf(stderr, "Could not add a new status to the hashtable at line %d in %s\n", __LINE__,
-                                __FILE__);
-                        return ERR_NOMEM;
-                    }
-                }
-            }
+static size_t join_fields(char *buffer, size_t size, const char **fields, size_t nb_fields)
+{
+    size_t used = 0;
 
-            int size = -1;
-            size_t nbrNodes = 0;
+    for (size_t f = 0; f < nb_fields; f++) {
+        size_t length = strlen(fields[f]);
+        if (used + protocol_field_size(length) > size) return 0;
 
-            do {
-                char *response = calloc(MAX_MSG_ELEM_SIZE + 1, sizeof(char));
+        used += protocol_write_field(buffer + used, fields[f], length);
+    }
 
-                if (response == NULL) {
-                    fprintf(stderr, "Could not allocate memory for response at line %d in %s\n", __LINE__, __FILE__);
-                    free(response);
-                    return ERR_NOMEM;
-                }
+    return used;
+}
 
-                size = get_response_from_server(&server_addr_rcv_from, &response, MAX_MSG_SIZE, socket);
-
-                for (size_t j = 0; size != -1 && j < client.node->size; j++) {
-                    if (memcmp(&(client.node->nodes[j].srv_addr), &server_addr_rcv_from,
-                               sizeof(server_addr_rcv_from)) == 0) {
-                        if (add_Htable_value(client.nodes_status, client.node->nodes[j].server_SHA, OK) != ERR_NONE) {
-                            fprintf(stderr, "Could not add a new status to the hashtable at line %d in %s\n", __LINE__,
-                                    __FILE__);
-                            free(response);
-                            return ERR_NOMEM;
-                        }
-                        nbrNodes++;
-                        break;
-                    }
-                }
-                free(response);
-            } while (size != -1 && nbrNodes < client.node->size);
+// =====================================================================
 
+static int in_sync(client_t client, pps_key_t key, const pps_key_t *keys, size_t nb_keys, uint64_t *versions)
+{
+    size_t N = client.parsedOpt->N;
+    const node_t *servers[N];
+    size_t nb_servers = ring_get_preference_list(client.node, key, strlen(key), N, servers);
+    size_t quorum = client.parsedOpt->R > client.parsedOpt->W ? client.parsedOpt->R : client.parsedOpt->W;
+
+    size_t nb_requests = nb_servers * nb_keys;
+    if (nb_servers < quorum || nb_requests > TRANSPORT_MAX_INFLIGHT / 2) return 0;
+
+    //the digest of each key on each server, request s * nb_keys + k
+    uint32_t ids[nb_requests];
+    for (size_t r = 0; r < nb_requests; r++) {
+        const char *field = keys[r % nb_keys];
+        char request[PROTOCOL_MAX_PAYLOAD];
+        size_t size = join_fields(request, sizeof(request), &field, 1);
+        struct iovec part = {request, size};
+        if (size == 0 || send_to_server(client, servers[r / nb_keys], PROTOCOL_DIGEST, &part, 1, &ids[r]) != ERR_NONE) {
+            ids[r] = 0;
+        }
+    }
 
-            return ERR_NONE;
+    //until enough servers replied for all the keys
+    size_t answers[nb_servers];
+    memset(answers, 0, sizeof(answers));
+    size_t nb_replied = 0;
+    double deadline = now() + TRANSPORT_TIMEOUT_MS / 1e3;
+    uint32_t id = 0;
+
+    while (nb_replied < quorum && now() < deadline) {
+        if (transport_wait(client.transport, (int) ((deadline - now()) * 1e3) + 1, &id) != ERR_NONE) continue;
+
+        size_t r = 0;
+        while (r < nb_requests && ids[r] != id) ++r;
+        if (r == nb_requests) {
+            //the reply of a request given up on before
+            transport_forget(client.transport, id);
+        } else if (++answers[r / nb_keys] == nb_keys) {
+            ++nb_replied;
         }
+    }
 
-        //dump the content of the hashtable
-        if (key != NULL && key[0] == '\0') {
-            if(dump(client, &server_addr_rcv_from, key, value, socket) != ERR_NONE) {
-                fprintf(stderr, "Error when dumping content of the hashtable\n");
-                return ERR_NETWORK;
+    //the same version and digest of each key on every server that replied, even partly
+    uint64_t digests[nb_keys];
+    int same = nb_replied >= quorum;
+    for (size_t k = 0; same && k < nb_keys; k++) {
+        int known = 0;
+        for (size_t s = 0; same && s < nb_servers; s++) {
+            const transport_request_t *request = transport_reply(client.transport, ids[s * nb_keys + k]);
+            read_reply_t reply;
+            if (request == NULL || !request->done || !read_reply(request, &reply)) continue;
+
+            if (!reply.found) {
+                same = 0;
+            } else if (!known) {
+                versions[k] = reply.version;
+                digests[k] = reply.digest;
+                known = 1;
+            } else {
+                same = versions[k] == reply.version && digests[k] == reply.digest;
             }
-
-            return ERR_NONE;
         }
+    }
+
+    forget_requests(client, ids, nb_requests);
+    return same;
+}
 
-        Htable_t table = construct_Htable(client.parsedOpt->N);
-        M_EXIT_IF_NULL(table, sizeof(Htable_t),
-                       "Memory error in network get while constructing the internal hashtable\n");
+// =====================================================================
 
+static size_t join_sources(char *buffer, size_t size, pps_key_t dest, const pps_key_t *keys,
+                           const uint64_t *versions, size_t nb_keys)
+{
+    size_t used = join_fields(buffer, size, &dest, 1);
 
-        //get the sublist corresponding to the key
-        node_list_t *sublist = ring_get_nodes_for_key(client.node, client.parsedOpt->N, key);
+    for (size_t k = 0; used > 0 && k < nb_keys; k++) {
+        size_t length = strlen(keys[k]);
+        if (used + PROTOCOL_STAMP_SIZE + protocol_field_size(length) > size) return 0;
 
-        if (sublist == NULL) {
-            delete_Htable_and_content(&table);
-            fprintf(stderr, "Could not get the N nodes in network-get\n");
-            return ERR_NOMEM;
-        }
+        protocol_write_stamp(buffer + used, versions[k]);
+        used += PROTOCOL_STAMP_SIZE;
+        used += protocol_write_field(buffer + used, keys[k], length);
+    }
 
+    return used;
+}
 
+// =====================================================================
 
-        //Try to get the key in N servers
-        for (size_t i = 0; i < client.parsedOpt->N; i++) {
+error_code network_mput(client_t client, const kv_list_t *pairs, size_t window, size_t *nb_written,
+                        double *latencies, size_t *nb_latencies)
+{
+    M_REQUIRE_NON_NULL(pairs);
+    M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
 
-            //send the key to the server
-            send_to_server(sublist->nodes[i], &key, sizeKey, socket);
+    for (size_t k = 0; k < pairs->size; k++) {
+        M_REQUIRE_NON_NULL(pairs->pairs[k].key);
+        M_REQUIRE_NON_NULL(pairs->pairs[k].value);
+        if (pairs->pairs[k].key[0] == '\0'
+            || !protocol_pair_fits(strlen(pairs->pairs[k].key), strlen(pairs->pairs[k].value))) {
+            fprintf(stderr, "Invalid pair in network_mput\n");
+            return ERR_BAD_PARAMETER;
         }
-        ssize_t nbr_bytes = -1;
-        size_t i = 0;
-        do {
-
-            //get the response from the server
-            char *response = calloc(MAX_MSG_ELEM_SIZE + 1, sizeof(char));
-            nbr_bytes = get_response_from_server(&server_addr_rcv_from, &response, MAX_MSG_SIZE, socket);
-            response[nbr_bytes] = '\0';
-            //check that the response is valid
-            if ((nbr_bytes >= 0 && nbr_bytes != 1) || (nbr_bytes == 1 && response[0] != '\0')) {
+    }
 
-                char *count = get_Htable_value(table, response);
+    if (nb_latencies != NULL) *nb_latencies = 0;
+    if (nb_written != NULL) *nb_written = 0;
+    if (pairs->size == 0) return ERR_NONE;
+
+    size_t N = client.parsedOpt->N;
+    size_t nb_todo = pairs->size * N;
+    mput_t mput = {client, pairs, N, window > 0 ? window : 1, NULL, NULL, NULL, NULL, NULL, 0, 0, latencies, 0};
+
+    mput.nodes = calloc(nb_todo, sizeof(node_t *));
+    mput.versions = calloc(pairs->size, sizeof(uint64_t));
+    mput.written = calloc(pairs->size, sizeof(size_t));
+    mput.order = calloc(nb_todo, sizeof(size_t));
+    mput.batches = calloc(nb_todo, sizeof(multi_batch_t));
+
+    error_code err = ERR_NONE;
+    if (mput.nodes == NULL || mput.versions == NULL || mput.written == NULL || mput.order == NULL
+        || mput.batches == NULL) {
+        fprintf(stderr, "Could not allocate memory in network_mput\n");
+        err = ERR_NOMEM;
+    }
 
-                //first time that a value is received
-                if (count == NULL && client.parsedOpt->R > 1) {
+    for (size_t k = 0; err == ERR_NONE && k < pairs->size; k++) {
+        ring_get_preference_list(client.node, pairs->pairs[k].key, strlen(pairs->pairs[k].key), N,
+                                 mput.nodes + k * N);
+        mput.versions[k] = hlc_now(&client_clock);
+    }
 
-                    char *newCount = calloc(2, sizeof(char));
-                    strncpy(newCount, "\x01", 1);
-                    if(add_Htable_value(table, response, newCount) != ERR_NONE) {
-                        fprintf(stderr, "Memory error when adding a new value in the hashtable");
-                        free(response);
-                        delete_Htable_and_content(&table);
-                        free(count);
-                        return ERR_NETWORK;
-                    }
+    if (err == ERR_NONE) {
+        err = mput_send_all(&mput);
+    }
 
+    //W is checked for every pair
+    size_t written = 0;
+    for (size_t k = 0; err == ERR_NONE && k < pairs->size; k++) {
+        written += mput.written[k] >= client.parsedOpt->W;
+    }
 
-                    free(count);
-                    count = NULL;
-                    //first time that a value is received and R = 1
-                } else if (count == NULL && client.parsedOpt->R == 1) {
-                    *value = strdup(response);
+    if (nb_written != NULL) *nb_written = written;
+    if (nb_latencies != NULL) *nb_latencies = mput.nb_latencies;
 
-                    //frees
-                    free(response);
-                    response = NULL;
-                    free(count);
-                    count = NULL;
-                    delete_Htable_and_content(&table);
+    free(mput.nodes);
+    free(mput.versions);
+    free(mput.written);
+    free(mput.order);
+    free(mput.batches);
 
-                    return ERR_NONE;
-                    //the value has already been received
-                } else {
-                    //increment the counter by one and check if the new counter equals R
-                    ++count[0];
-                    if (count[0] == client.parsedOpt->R) {
-                        *value = strdup(response);
+    if (err != ERR_NONE) return err;
+    return written == pairs->size ? ERR_NONE : ERR_NETWORK;
+}
 
-                        //frees
-                        free(response);
-                        response = NULL;
-                        free(count);
-                        count = NULL;
-                        delete_Htable_and_content(&table);
+// =====================================================================
 
-                        return ERR_NONE;
-                    }
+error_code network_put_stream(client_t client, pps_key_t key, network_source_t read, void *arg, size_t *size)
+{
+    M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(read);
 
-                    //add the new value of the counter to the hashtable (to override the previous value)
-                    if(add_Htable_value(table, response, count) != ERR_NONE) {
-                        fprintf(stderr, "Memory error when adding a new value in the hashtable");
-                        free(response);
-                        response = NULL;
-                        free(count);
-                        count = NULL;
-                        delete_Htable_and_content(&table);
-                        return ERR_NETWORK;
-                    }
-                    free(count);
-                    count = NULL;
+    size_t key_len = strlen(key);
+    if (key_len == 0 || key_len + CHUNK_SUFFIX_SIZE > MAX_MSG_ELEM_SIZE) {
+        fprintf(stderr, "Invalid key in network_put_stream\n");
+        return ERR_BAD_PARAMETER;
+    }
 
-                }
+    char *buffer = malloc(NETWORK_CHUNK_WINDOW * NETWORK_CHUNK_SIZE);
+    M_EXIT_IF_NULL(buffer, NETWORK_CHUNK_WINDOW * NETWORK_CHUNK_SIZE, "network.c/network_put_stream");
+
+    size_t N = client.parsedOpt->N;
+    const node_t *nodes[NETWORK_CHUNK_WINDOW * N];
+    uint32_t ids[NETWORK_CHUNK_WINDOW * N];
+    chunk_stream_t stream;
+    chunk_stream_init(&stream, client, key, key_len, PROTOCOL_PUT, hlc_now(&client_clock), nodes, ids, buffer);
+
+    //the value is read as the window moves on, the last chunk is shorter (not written if empty)
+    size_t total = 0;
+    int end = 0;
+    error_code err = ERR_NONE;
+    while (err == ERR_NONE && (!end || stream.head < stream.next)) {
+        chunk_t *chunk = &stream.chunks[stream.next % NETWORK_CHUNK_WINDOW];
+
+        if (!end && stream.next - stream.head < NETWORK_CHUNK_WINDOW) {
+            size_t got = 1;
+            chunk->size = 0;
+            while (err == ERR_NONE && got > 0 && chunk->size < NETWORK_CHUNK_SIZE) {
+                got = 0;
+                err = read(arg, chunk->data + chunk->size, NETWORK_CHUNK_SIZE - chunk->size, &got);
+                chunk->size += got;
             }
 
-            free(response);
-            response = NULL;
-
-        } while(nbr_bytes != -1 && ++i < client.parsedOpt->N);
+            end = chunk->size < NETWORK_CHUNK_SIZE;
+            total += chunk->size;
+            if (err == ERR_NONE && chunk->size > 0) err = chunk_start(&stream);
+        } else if (chunk_done(&stream, &stream.chunks[stream.head % NETWORK_CHUNK_WINDOW])) {
+            chunk_release(&stream);
+        } else {
+            err = chunk_wait(&stream);
+        }
+    }
 
-        //frees
-        delete_Htable_and_content(&table);
-        return ERR_NETWORK;
+    while (stream.head < stream.next) {
+        chunk_release(&stream);
+    }
+    free(buffer);
 
+    //the manifest last, so that the value is never read before all its chunks are written
+    if (err == ERR_NONE) {
+        char manifest[MANIFEST_SIZE] = {'\0'};
+        size_t manifest_size = 1 + protocol_write_varint(manifest + 1, total);
+        manifest_size += protocol_write_varint(manifest + manifest_size, NETWORK_CHUNK_SIZE);
+        err = put_bytes(client, key, key_len, manifest, manifest_size, stream.version);
     }
 
+    if (size != NULL) *size = total;
+    return err;
 }
 
 // =====================================================================
 
-error_code network_put(client_t client, pps_key_t key, pps_value_t value)
+error_code network_get_stream(client_t client, pps_key_t key, network_sink_t write, void *arg, size_t *size)
 {
     M_EXIT_IF_NULL(client.node, sizeof(client.node), "Unable to read PPS_SERVERS_LIST_FILENAME\n");
     M_REQUIRE_NON_NULL(key);
-    M_REQUIRE_NON_NULL(value);
+    M_REQUIRE_NON_NULL(write);
 
-    if (strlen(key) > MAX_MSG_ELEM_SIZE || strlen(value) > MAX_MSG_ELEM_SIZE) {
-        fprintf(stderr, "The key or the value is to long\n");
+    size_t key_len = strlen(key);
+    if (key_len == 0 || key_len + CHUNK_SUFFIX_SIZE > MAX_MSG_ELEM_SIZE) {
+        fprintf(stderr, "Invalid key in network_get_stream\n");
         return ERR_BAD_PARAMETER;
     }
 
-    char *response = calloc(1, sizeof(char));
-    M_EXIT_IF_NULL(response, sizeof(response), "network_put, response in network.c\n");
-
-    int written = 0;
+    char *manifest = NULL;
+    size_t length = 0;
+    uint64_t version = 0;
+    error_code err = quorum_read(client, key, key_len, &manifest, &length, &version);
+    if (err != ERR_NONE) return err;
+
+    //a value of network_put is given at once
+    if (length == 0 || manifest[0] != '\0') {
+        err = write(arg, manifest, length);
+        free(manifest);
+        if (size != NULL) *size = err == ERR_NONE ? length : 0;
+        return err;
+    }
 
-    char **toSend = malloc(sizeof(char *));
-    if(toSend == NULL) {
-        fprintf(stderr,"toSend in network_put\n");
-        free(response);
+    //'\0', size of the value, size of its chunks
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, manifest + 1, length - 1);
+    uint64_t total = 0;
+    uint64_t chunk_size = 0;
+    int valid = protocol_next_varint(&reader, &total) && protocol_next_varint(&reader, &chunk_size)
+                && chunk_size > 0 && chunk_size <= MAX_MSG_ELEM_SIZE;
+    free(manifest);
+
+    if (!valid) {
+        fprintf(stderr, "Invalid manifest for %s\n", key);
         return ERR_NETWORK;
     }
 
-    int sizeToSend = prepare_put_packet(key, value, toSend);
-
-    if(sizeToSend == -1 || sizeToSend > MAX_MSG_SIZE) {
-        fprintf(stderr, "Invalid size of packet %s\n", __FILE__);
-        free(response);
-        free(*toSend);
-        free(toSend);
+    size_t N = client.parsedOpt->N;
+    const node_t *nodes[NETWORK_CHUNK_WINDOW * N];
+    uint32_t ids[NETWORK_CHUNK_WINDOW * N];
+    chunk_stream_t stream;
+    chunk_stream_init(&stream, client, key, key_len, PROTOCOL_GET, version, nodes, ids, NULL);
+
+    size_t nb_chunks = (size_t) ((total + chunk_size - 1) / chunk_size);
+    size_t given = 0;
+    while (err == ERR_NONE && stream.head < nb_chunks) {
+        chunk_t *chunk = &stream.chunks[stream.head % NETWORK_CHUNK_WINDOW];
+
+        if (stream.next < nb_chunks && stream.next - stream.head < NETWORK_CHUNK_WINDOW) {
+            err = chunk_start(&stream);
+        } else if (chunk_done(&stream, chunk)) {
+            //in order, from the reply itself
+            const transport_request_t *request = transport_reply(client.transport, chunk->found);
+            size_t expected = stream.head + 1 < nb_chunks ? chunk_size : total - stream.head * chunk_size;
+
+            if (request->reply_size - PROTOCOL_STAMP_SIZE != expected) {
+                fprintf(stderr, "Chunk %zu of %s has the wrong size\n", stream.head, key);
+                err = ERR_NETWORK;
+            } else {
+                err = write(arg, request->reply + PROTOCOL_STAMP_SIZE, expected);
+                given += err == ERR_NONE ? expected : 0;
+            }
+            chunk_release(&stream);
+        } else {
+            err = chunk_wait(&stream);
+        }
+    }
 
+    while (stream.head < stream.next) {
+        chunk_release(&stream);
     }
 
-    //get the sublist corresponding to the key
-    node_list_t *sublist = ring_get_nodes_for_key(client.node, client.parsedOpt->N, key);
+    if (size != NULL) *size = given;
+    return err;
+}
 
-    if (sublist == NULL) {
-        fprintf(stderr, "Could not get the N nodes in network-get\n");
-        free(response);
-        free(*toSend);
-        free(toSend);
-        return ERR_NOMEM;
-    }
+// =====================================================================
 
-    int socket = get_socket(1);
-    if (socket == -1) {
-        free(response);
-        free(*toSend);
-        free(toSend);
-        return ERR_NETWORK;
+static error_code send_to_server(client_t client, const node_t *node, protocol_opcode_t opcode,
+                                 const struct iovec *parts, size_t nb_parts, uint32_t *id)
+{
+    error_code err = transport_request_parts(client.transport, &node->srv_addr, opcode, parts, nb_parts, id);
+
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Error when sending a message to the server %s %hu\n", node->ip, node->port);
     }
 
-    //Put the pair in all servers, fails if one server could not add it to its Htable
-    for (size_t i = 0; i < client.parsedOpt->N; i++) {
-        if (send_to_server(sublist->nodes[i], toSend, sizeToSend, socket) != ERR_NONE) {
-            fprintf(stderr, "Error while sending requests in network put\n");
-            free(response);
-            free(*toSend);
-            free(toSend);
-            return ERR_NETWORK;
-        }
+    return err;
+}
+
+// =====================================================================
+
+static void forget_requests(client_t client, const uint32_t *ids, size_t nbr_ids)
+{
+    for (size_t i = 0; i < nbr_ids; i++) {
+        transport_forget(client.transport, ids[i]);
     }
+}
 
-    struct sockaddr server_addr_rcv_from;
-    int size = -1;
-    size_t nbServsSeen = 0;
-    do {
+// =====================================================================
+
+static error_code list_nodes(client_t client)
+{
+    char OK[] = "OK";
+    uint32_t ids[client.node->size];
+    size_t nbr_ids = 0;
 
-        size = get_response_from_server(&server_addr_rcv_from, &response, 1, socket);
-        nbServsSeen++;
+    //try to reach each server of the ring once, whatever its number of nodes
+    for (size_t i = 0; i < client.node->size; i++) {
+        const struct sockaddr_in *addr = &client.node->nodes[i].srv_addr;
 
-        size_t j = 0;
-        int cmp = -1;
-        while (cmp != 0 && j++ < client.node->size) {
-            cmp = memcmp(&(client.node->nodes[j].srv_addr), &server_addr_rcv_from, sizeof(server_addr_rcv_from));
+        int seen = 0;
+        for (size_t k = 0; !seen && k < nbr_ids; k++) {
+            seen = memcmp(&transport_reply(client.transport, ids[k])->addr, addr, sizeof(*addr)) == 0;
         }
 
-        if (size == 0 && cmp == 0) {
-            written++;
+        if (!seen && send_to_server(client, &client.node->nodes[i], PROTOCOL_PING, NULL, 0, &ids[nbr_ids]) == ERR_NONE) {
+            nbr_ids++;
         }
-    } while (size != -1 && nbServsSeen < client.parsedOpt->N);
+    }
 
-    free(response);
-    free(*toSend);
-    free(toSend);
-    M_EXIT_IF(written < client.parsedOpt->W, ERR_NETWORK, "network.c/network_put",
-              "Could not put the new value on enough servers\n");
+    for (size_t i = 0; i < nbr_ids; i++) {
+        uint32_t id = 0;
+        if (transport_wait(client.transport, TRANSPORT_TIMEOUT_MS, &id) != ERR_NONE) break;
+
+        const transport_request_t *request = transport_reply(client.transport, id);
+
+        //all the nodes of that server are up
+        for (size_t j = 0; request->status == PROTOCOL_OK && j < client.node->size; j++) {
+            if (memcmp(&client.node->nodes[j].srv_addr, &request->addr, sizeof(request->addr)) == 0
+                && add_Htable_value(client.nodes_status, client.node->nodes[j].server_SHA, OK) != ERR_NONE) {
+                fprintf(stderr, "Could not add a new status to the hashtable at line %d in %s\n", __LINE__,
+                        __FILE__);
+                forget_requests(client, ids, nbr_ids);
+                return ERR_NOMEM;
+            }
+        }
+    }
+
+    forget_requests(client, ids, nbr_ids);
     return ERR_NONE;
+}
+
+// =====================================================================
 
+static error_code dump_ask(client_t client, const node_t *server, dump_stream_t *stream)
+{
+    if (stream->id != 0) transport_forget(client.transport, stream->id);
+    stream->id = 0;
+
+    if (stream->tries++ == DUMP_TRIES) {
+        fprintf(stderr, "No reply to a page of the dump after %d tries\n", DUMP_TRIES);
+        return ERR_NETWORK;
+    }
+
+    char cursor[PROTOCOL_STAMP_SIZE];
+    protocol_write_stamp(cursor, stream->cursor);
+    stream->sent = now();
+    return transport_request(client.transport, &server->srv_addr, PROTOCOL_SCAN, cursor, sizeof(cursor), &stream->id);
 }
 
 // =====================================================================
 
-static error_code send_to_server(node_t node, char **toSend, size_t size, int socket)
+static error_code dump_page(const transport_request_t *reply, network_visitor_t visit, void *arg, uint64_t *next)
 {
+    if (reply->reply_size < PROTOCOL_STAMP_SIZE) return ERR_NETWORK;
+    *next = protocol_read_stamp(reply->reply);
+
+    //<version><key><value>..., read in place
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, reply->reply + PROTOCOL_STAMP_SIZE, reply->reply_size - PROTOCOL_STAMP_SIZE);
 
-    //initialize parameters for the method sendto
-    struct sockaddr *server_addr = (struct sockaddr *) &node.srv_addr;
-    socklen_t addrlen = sizeof(*server_addr);
+    while (!protocol_reader_done(&reader)) {
+        uint64_t version = 0;
+        const char *key = NULL, *value = NULL;
+        size_t key_len = 0, value_len = 0;
+
+        if (!protocol_next_stamp(&reader, &version) || !protocol_next_field(&reader, &key, &key_len)
+            || !protocol_next_field(&reader, &value, &value_len)) {
+            return ERR_NETWORK;
+        }
 
-    ssize_t sent = 0;
-    //send the request to the server
-    M_EXIT_IF((sent = sendto(socket, *toSend, size, 0,
-                             server_addr,
-                             addrlen)) == -1 && sent != size,
-              ERR_NETWORK, "newtwork.c", "Error when sending a message to the server\n");
+        visit(arg, key, key_len, value, value_len, version);
+    }
 
     return ERR_NONE;
 }
 
 // =====================================================================
 
-static ssize_t get_response_from_server(struct sockaddr *server_addr, char **response, size_t size, int socket)
+static error_code mget_round(mget_t *mget)
 {
-    //initialize parameters for the method recvfrom
-    socklen_t addrlen = sizeof(*server_addr);
+    transport_t *transport = mget->client.transport;
+    size_t nb_peers = transport->nb_peers;
+
+    size_t start[nb_peers + 1];
+    group_by_server(transport, mget->nodes, mget->todo, mget->nb_todo, start, mget->order);
+
+    char *payload = malloc(PROTOCOL_MAX_PAYLOAD);
+    M_EXIT_IF_NULL(payload, PROTOCOL_MAX_PAYLOAD, "network_mget");
+
+    //one datagram for as many keys of a server as fit
+    mget->nb_batches = 0;
+    error_code err = ERR_NONE;
+    for (size_t p = 0; err == ERR_NONE && p < nb_peers; p++) {
+        size_t first = start[p];
+        size_t used = 0;
+
+        for (size_t o = start[p]; err == ERR_NONE && o <= start[p + 1]; o++) {
+            size_t key = o < start[p + 1] ? mget->order[o] / mget->N : 0;
+            size_t key_len = o < start[p + 1] ? strlen(mget->keys[key]) : 0;
+
+            //last pair of the server or full datagram
+            if (o > first && (o == start[p + 1] || used + protocol_field_size(key_len) > PROTOCOL_MAX_PAYLOAD)) {
+                err = mget_send(mget, p, first, o - first, payload, used);
+                first = o;
+                used = 0;
+            }
+
+            if (o < start[p + 1]) {
+                used += protocol_write_field(payload + used, mget->keys[key], key_len);
+            }
+        }
+    }
+
+    free(payload);
 
-    //get the response
+    while (err == ERR_NONE && mget->nb_inflight > 0) {
+        err = mget_receive(mget);
+    }
 
-    ssize_t i = recvfrom(socket, *response, size, 0,
-                         server_addr, &addrlen);
+    //the replies that did not come are given up
+    for (size_t b = 0; b < mget->nb_batches; b++) {
+        transport_forget(transport, mget->batches[b].id);
+    }
+    mget->nb_inflight = 0;
 
-    return i;
+    return err == ERR_NETWORK ? ERR_NONE : err;
 }
 
 // =====================================================================
 
-static error_code dump(client_t client, struct sockaddr *server_addr, pps_key_t key, char **result, int socket)
+static void group_by_server(const transport_t *transport, const node_t **nodes, const size_t *todo, size_t nb_todo,
+                            size_t *start, size_t *order)
 {
+    size_t nb_peers = transport->nb_peers;
 
-    //alloc resources
-    char *val = calloc(UDP_SIZE, sizeof(char));
-    M_EXIT_IF_NULL(val, UDP_SIZE * sizeof(char), "Could not allocate memory for val in dump of network\n");
-    size_t allocs = 1;
-    size_t used = 0;
+    memset(start, 0, (nb_peers + 1) * sizeof(size_t));
+    for (size_t t = 0; t < nb_todo; t++) {
+        size_t peer = transport_peer_index(transport, &nodes[todo[t]]->srv_addr);
+        if (peer < nb_peers) {
+            ++start[peer + 1];
+        }
+    }
+    for (size_t p = 0; p < nb_peers; p++) {
+        start[p + 1] += start[p];
+    }
 
+    size_t fill[nb_peers > 0 ? nb_peers : 1];
+    memcpy(fill, start, nb_peers * sizeof(size_t));
+    for (size_t t = 0; t < nb_todo; t++) {
+        size_t peer = transport_peer_index(transport, &nodes[todo[t]]->srv_addr);
+        if (peer < nb_peers) {
+            order[fill[peer]++] = todo[t];
+        }
+    }
+}
 
-    error_code err = send_to_server(client.node->nodes[0], &key, sizeof(char), socket);
+// =====================================================================
 
+static error_code mget_send(mget_t *mget, size_t peer, size_t first, size_t count, const char *payload, size_t size)
+{
+    //bounded number of requests in flight
+    if (mget->nb_inflight == TRANSPORT_MAX_INFLIGHT) {
+        error_code err = mget_receive(mget);
+        if (err != ERR_NONE) return err;
+    }
 
-    if (err == ERR_NONE) {
+    multi_batch_t *batch = &mget->batches[mget->nb_batches];
+    transport_t *transport = mget->client.transport;
 
-        //allocate a buffer to get the response of the server
-        char **buffer = malloc(sizeof(char *));
-        *buffer = calloc(UDP_SIZE, sizeof(char));
-        if(buffer == NULL || *buffer == NULL) {
-            fprintf(stderr, "Could not allocate memory in dump of network\n");
-            free(val);
-            return ERR_NETWORK;
-        }
+    if (transport_request(transport, &transport->peers[peer].addr, PROTOCOL_MGET, payload, size, &batch->id) != ERR_NONE) {
+        //the keys of that batch will be missing
+        return ERR_NONE;
+    }
 
-        //get the response of the server
-        ssize_t nbr_bytes = get_response_from_server(server_addr, buffer, UDP_SIZE, socket);
+    batch->first = first;
+    batch->count = count;
+    ++(mget->nb_batches);
+    ++(mget->nb_inflight);
 
-        if(nbr_bytes == -1) {
-            fprintf(stderr, "Could not get a response from the server in dump of network\n");
-            free(val);
-            free(*buffer);
-            free(buffer);
-            return ERR_NETWORK;
-        }
+    return ERR_NONE;
+}
 
-        //compute number corresponding to the 4 first bytes
-        size_t nbr_pairs_exp = 0;
-        memcpy(&nbr_pairs_exp, *buffer, sizeof(int));
-        nbr_pairs_exp = ntohl(nbr_pairs_exp);
+// =====================================================================
 
-        if(nbr_pairs_exp == 0) {
+static error_code mget_receive(mget_t *mget)
+{
+    transport_t *transport = mget->client.transport;
 
-            *result = malloc(sizeof(int));
+    uint32_t id = 0;
+    if (transport_wait(transport, TRANSPORT_TIMEOUT_MS, &id) != ERR_NONE) return ERR_NETWORK;
 
-            if(*result == NULL) {
-                free(val);
-                free(*buffer);
-                free(buffer);
-                return ERR_NETWORK;
-            }
+    multi_batch_t *batch = NULL;
+    for (size_t b = 0; batch == NULL && b < mget->nb_batches; b++) {
+        if (mget->batches[b].id == id) batch = &mget->batches[b];
+    }
+
+    const transport_request_t *request = transport_reply(transport, id);
+    if (batch == NULL || request == NULL) {
+        transport_forget(transport, id);
+        return ERR_NONE;
+    }
 
-            for(size_t i = 0; i < sizeof(int); i++) {
-                (*result)[i] = (*buffer)[i];
+    //for every key: status, then <version><value>
+    error_code err = ERR_NONE;
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, request->reply, request->reply_size);
+
+    for (size_t i = 0; err == ERR_NONE && request->status == PROTOCOL_OK && i < batch->count; i++) {
+        size_t pair = mget->order[batch->first + i];
+        const char *status = protocol_next_bytes(&reader, 1);
+
+        if (status == NULL) {
+            //not in the reply (full), nor already read on R servers
+            if (mget->values[pair / mget->N] == NULL) {
+                mget->next[mget->nb_next++] = pair;
             }
+            continue;
+        }
 
-            free(result);
-            free(*buffer);
-            free(buffer);
-            free(val);
-            buffer = NULL;
-            return ERR_NONE;
+        uint64_t version = 0;
+        const char *value = NULL;
+        size_t length = 0;
+        if (*status != PROTOCOL_OK) {
+            err = mget_record(mget, pair / mget->N, NULL, 0, 0);
+        } else if (protocol_next_stamp(&reader, &version) && protocol_next_field(&reader, &value, &length)) {
+            err = mget_record(mget, pair / mget->N, value, length, version);
         }
+    }
 
-        size_t nbr_pairs_act = 0;
+    transport_forget(transport, id);
+    batch->id = 0;
+    --(mget->nb_inflight);
 
-        used += nbr_bytes;
+    return err;
+}
 
-        //copy and count the number of zeros
-        size_t nbr_0 = 0;
-        for (size_t i = 0; i < nbr_bytes; i++) {
-            val[i] = (*buffer)[i];
-            if (i > sizeof(int) && val[i] == '\0') nbr_0++;
-        }
-        nbr_pairs_act = (nbr_0 / 2) + 1;
+// =====================================================================
 
+static error_code mget_record(mget_t *mget, size_t key, const char *value, size_t length, uint64_t version)
+{
+    if (mget->values[key] != NULL) return ERR_NONE;
+
+    ++(mget->nb_received[key]);
+    if (value != NULL && (mget->newest[key] == NULL || hlc_newer(version, value, length, mget->versions[key],
+                                                                 mget->newest[key], mget->lengths[key]))) {
+        char *copy = malloc(length + 1);
+        if (copy == NULL) return ERR_NOMEM;
+        memcpy(copy, value, length);
+        copy[length] = '\0';
+
+        free(mget->newest[key]);
+        mget->newest[key] = copy;
+        mget->versions[key] = version;
+        mget->lengths[key] = length;
+        hlc_observe(&client_clock, version);
+    }
 
-        //when the server sends more than one message
-        while (nbr_pairs_exp != nbr_pairs_act) {
-            //reset memory
-            val[used] = '\0';
-            used++;
-            memset(*buffer, 0, UDP_SIZE * sizeof(char));
+    //the value is kept once R servers replied; if none had it, a later reply may
+    if (mget->nb_received[key] >= mget->client.parsedOpt->R && mget->newest[key] != NULL) {
+        mget->values[key] = mget->newest[key];
+        mget->newest[key] = NULL;
+    }
 
-            //get the response of the server
-            nbr_bytes = get_response_from_server(server_addr, buffer, UDP_SIZE, socket);
-            if(nbr_bytes == -1) {
-                fprintf(stderr, "Could not get a response from the server in dump of network\n");
-                free(val);
-                free(*buffer);
-                free(buffer);
-                return ERR_NETWORK;
-            }
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code mput_send_all(mput_t *mput)
+{
+    transport_t *transport = mput->client.transport;
+    size_t nb_peers = transport->nb_peers;
+    size_t nb_todo = mput->pairs->size * mput->N;
+
+    size_t *todo = calloc(nb_todo, sizeof(size_t));
+    char *payload = malloc(PROTOCOL_MAX_PAYLOAD);
+    if (todo == NULL || payload == NULL) {
+        free(todo);
+        free(payload);
+        return ERR_NOMEM;
+    }
+
+    //every pair is written on the N servers of its preference list
+    size_t nb = 0;
+    for (size_t t = 0; t < nb_todo; t++) {
+        if (mput->nodes[t] != NULL) todo[nb++] = t;
+    }
 
-            //check if it needs to be reallocated
-            if (used % UDP_SIZE + nbr_bytes > UDP_SIZE) {
-                allocs++;
-                val = realloc(val, allocs * UDP_SIZE * sizeof(char));
-                if(val == NULL) {
-                    free(val);
-                    free(*buffer);
-                    free(buffer);
-
-                    fprintf(stderr, "Could not realloc memory for val in dump of network\n");
-                    return ERR_NETWORK;
+    size_t start[nb_peers + 1];
+    group_by_server(transport, mput->nodes, todo, nb, start, mput->order);
+    free(todo);
+
+    //one datagram for as many pairs of a server as fit, <version><key><value>...
+    for (size_t p = 0; p < nb_peers; p++) {
+        size_t first = start[p];
+        size_t used = 0;
+
+        for (size_t o = start[p]; o <= start[p + 1]; o++) {
+            size_t k = o < start[p + 1] ? mput->order[o] / mput->N : 0;
+            const kv_pair_t *pair = o < start[p + 1] ? &mput->pairs->pairs[k] : NULL;
+            size_t key_size = pair != NULL ? strlen(pair->key) : 0;
+            size_t value_size = pair != NULL ? strlen(pair->value) : 0;
+            size_t size = PROTOCOL_STAMP_SIZE + protocol_field_size(key_size) + protocol_field_size(value_size);
+
+            //last pair of the server or full datagram
+            if (o > first && (pair == NULL || used + size > MPUT_BATCH_SIZE)) {
+                //bounded window of datagrams in flight
+                while (mput->nb_inflight >= mput->window) {
+                    mput_receive(mput);
                 }
-            }
 
-            //count the number of new pairs
-            nbr_0 = 0;
-            for (size_t i = 0; i < nbr_bytes; ++i) {
-                if ((*buffer)[i] == '\0') nbr_0++;
-            }
-            nbr_pairs_act += nbr_0 / 2 + 1;
+                multi_batch_t *batch = &mput->batches[mput->nb_batches];
+                if (transport_request(transport, &transport->peers[p].addr, PROTOCOL_MPUT,
+                                                          payload, used, &batch->id) == ERR_NONE) {
+                    batch->first = first;
+                    batch->count = o - first;
+                    batch->sent = now();
+                    ++(mput->nb_batches);
+                    ++(mput->nb_inflight);
+                }
 
-            //copy
-            for (size_t i = 0; i < nbr_bytes; i++) {
-                val[used + i] = (*buffer)[i];
+                first = o;
+                used = 0;
             }
 
-            used += nbr_bytes;
+            if (pair != NULL) {
+                protocol_write_stamp(payload + used, mput->versions[k]);
+                used += PROTOCOL_STAMP_SIZE;
+                used += protocol_write_field(payload + used, pair->key, key_size);
+                used += protocol_write_field(payload + used, pair->value, value_size);
+            }
         }
+    }
 
-        *result = calloc(used + 1, sizeof(char));
-        if(*result == NULL) {
-            fprintf(stderr, "Could not reallocate result in %s\n", __FILE__);
-            free(val);
-            free(*buffer);
-            free(buffer);
-            return ERR_NETWORK;
-        }
+    free(payload);
 
-        //copy
-        for (size_t i = 0; i < used; ++i) {
-            (*result)[i] = val[i];
+    while (mput->nb_inflight > 0) {
+        mput_receive(mput);
+    }
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code mput_receive(mput_t *mput)
+{
+    transport_t *transport = mput->client.transport;
+
+    uint32_t id = 0;
+    if (transport_wait(transport, TRANSPORT_TIMEOUT_MS, &id) != ERR_NONE) {
+        //the datagrams in flight are lost, their pairs are not counted
+        for (size_t b = 0; b < mput->nb_batches; b++) {
+            transport_forget(transport, mput->batches[b].id);
+            mput->batches[b].id = 0;
         }
+        mput->nb_inflight = 0;
+        return ERR_NETWORK;
+    }
 
-        //frees
-        free(*buffer);
-        free(buffer);
-        free(val);
-        buffer = NULL;
+    //the latest batches are the most likely to be answered
+    multi_batch_t *batch = NULL;
+    for (size_t b = mput->nb_batches; batch == NULL && b > 0; b--) {
+        if (mput->batches[b - 1].id == id) batch = &mput->batches[b - 1];
+    }
 
+    const transport_request_t *request = transport_reply(transport, id);
+    if (batch == NULL || request == NULL) {
+        transport_forget(transport, id);
         return ERR_NONE;
     }
-    fprintf(stderr, "Could not send first message in dump\n");
-    free(val);
-    return ERR_NETWORK;
 
+    if (mput->latencies != NULL) {
+        mput->latencies[mput->nb_latencies++] = now() - batch->sent;
+    }
+
+    //one status byte per pair
+    for (size_t i = 0; request->status == PROTOCOL_OK && i < batch->count && i < request->reply_size; i++) {
+        if (request->reply[i] == PROTOCOL_OK) {
+            ++(mput->written[mput->order[batch->first + i] / mput->N]);
+        }
+    }
+
+    transport_forget(transport, id);
+    batch->id = 0;
+    --(mput->nb_inflight);
+
+    return ERR_NONE;
 }
 
 // =====================================================================
 
-static int prepare_put_packet(pps_key_t key, pps_value_t value, char **toSend)
+static double now(void)
 {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
 
-    //Compute the size of the key
-    size_t sizeKey = 0;
-    while (sizeKey < strlen(key) && key[sizeKey] != '\n' && key[sizeKey] != '\0') {
-        sizeKey++;
-    }
+// =====================================================================
 
-    char *tempKey = calloc(sizeKey + 1, sizeof(char));
-    if (tempKey == NULL) {
-        fprintf(stderr, "Memory error: tempKey of prepare_put_packet");
-        return -1;
+static void chunk_stream_init(chunk_stream_t *stream, client_t client, pps_key_t key, size_t key_len,
+                              protocol_opcode_t opcode, uint64_t version, const node_t **nodes, uint32_t *ids,
+                              char *buffer)
+{
+    memset(stream, 0, sizeof(chunk_stream_t));
+    stream->client = client;
+    stream->key = key;
+    stream->key_len = key_len;
+    stream->version = version;
+    stream->opcode = opcode;
+
+    size_t N = client.parsedOpt->N;
+    for (size_t c = 0; c < NETWORK_CHUNK_WINDOW; c++) {
+        stream->chunks[c].nodes = nodes + c * N;
+        stream->chunks[c].ids = ids + c * N;
+        stream->chunks[c].data = buffer != NULL ? buffer + c * NETWORK_CHUNK_SIZE : NULL;
     }
+}
 
-    //Extract the wanted part of the key
-    strncpy(tempKey, key, sizeKey);
+// =====================================================================
+
+static size_t chunk_suffix(char *suffix, uint64_t version, size_t index)
+{
+    //no key of the clients holds a '\0'
+    suffix[0] = '\0';
+    protocol_write_stamp(suffix + 1, version);
+    return 1 + PROTOCOL_STAMP_SIZE + protocol_write_varint(suffix + 1 + PROTOCOL_STAMP_SIZE, index);
+}
+
+// =====================================================================
+
+static error_code chunk_start(chunk_stream_t *stream)
+{
+    size_t N = stream->client.parsedOpt->N;
+    chunk_t *chunk = &stream->chunks[stream->next % NETWORK_CHUNK_WINDOW];
+    chunk->index = stream->next++;
+    chunk->nb_asked = 0;
+    chunk->nb_waiting = 0;
+    chunk->nb_written = 0;
+    chunk->found = 0;
+    chunk->start = now();
+
+    //the chunks are spread over the ring by their keys
+    char key[stream->key_len + CHUNK_SUFFIX_SIZE];
+    memcpy(key, stream->key, stream->key_len);
+    size_t key_len = stream->key_len + chunk_suffix(key + stream->key_len, stream->version, chunk->index);
+    size_t nb_nodes = ring_get_preference_list(stream->client.node, key, key_len, N, chunk->nodes);
+
+    //the healthy servers first, in the order of the ring
+    const node_t *suspected[N];
+    size_t nb_suspected = 0;
+    chunk->nb_nodes = 0;
+    for (size_t i = 0; i < nb_nodes; i++) {
+        if (transport_suspected(stream->client.transport, &chunk->nodes[i]->srv_addr)) {
+            suspected[nb_suspected++] = chunk->nodes[i];
+        } else {
+            chunk->nodes[chunk->nb_nodes++] = chunk->nodes[i];
+        }
+    }
+    memcpy(chunk->nodes + chunk->nb_nodes, suspected, nb_suspected * sizeof(node_t *));
+    chunk->nb_nodes = nb_nodes;
 
-    //Compute the size of the value
-    size_t sizeValue = 0;
-    while (sizeValue < strlen(value) && value[sizeValue] != '\n' && value[sizeValue] != '\0') {
-        sizeValue++;
+    //a put is written on all of them, a get read from the first one that answers
+    while (chunk->nb_asked < chunk->nb_nodes && (stream->opcode == PROTOCOL_PUT || chunk->nb_waiting == 0)) {
+        chunk_ask(stream, chunk);
     }
 
-    char *tempValue = calloc(sizeValue, sizeof(char));
+    return chunk->nb_waiting > 0 ? ERR_NONE : ERR_NETWORK;
+}
+
+// =====================================================================
+
+static void chunk_ask(chunk_stream_t *stream, chunk_t *chunk)
+{
+    size_t i = chunk->nb_asked++;
+
+    //PUT <version><key><value> or GET <key>, the key of the chunk being the key of the value and its suffix:
+    //only the prefixes are written, the key and the bytes are sent from where they are
+    char prefix[PROTOCOL_STAMP_SIZE + PROTOCOL_VARINT_MAX];
+    char suffix[CHUNK_SUFFIX_SIZE];
+    char value_prefix[PROTOCOL_VARINT_MAX];
+    size_t suffix_size = chunk_suffix(suffix, stream->version, chunk->index);
 
-    if (tempValue == NULL) {
-        fprintf(stderr, "Memory error: tempKey of prepare_put_packet");
-        free(tempKey);
-        return -1;
+    size_t used = 0;
+    if (stream->opcode == PROTOCOL_PUT) {
+        protocol_write_stamp(prefix, stream->version);
+        used = PROTOCOL_STAMP_SIZE;
+    }
+    used += protocol_write_varint(prefix + used, stream->key_len + suffix_size);
+
+    struct iovec parts[5] = {
+        {prefix, used},
+        {(void *) stream->key, stream->key_len},
+        {suffix, suffix_size},
+        {value_prefix, protocol_write_varint(value_prefix, chunk->size)},
+        {chunk->data, chunk->size}
+    };
+    size_t nb_parts = stream->opcode == PROTOCOL_PUT ? 5 : 3;
+
+    if (send_to_server(stream->client, chunk->nodes[i], stream->opcode, parts, nb_parts, &chunk->ids[i]) == ERR_NONE) {
+        ++(chunk->nb_waiting);
+    } else {
+        chunk->ids[i] = 0;
     }
 
-    //Extract the wanted part of value
-    strncpy(tempValue, value, sizeValue);
+    int timeout_ms = transport_timeout_ms(stream->client.transport, &chunk->nodes[i]->srv_addr);
+    chunk->hedge_at = now() + timeout_ms / 1e3;
+}
+
+// =====================================================================
+
+static int chunk_done(const chunk_stream_t *stream, const chunk_t *chunk)
+{
+    return stream->opcode == PROTOCOL_PUT ? chunk->nb_written >= stream->client.parsedOpt->W : chunk->found != 0;
+}
+
+// =====================================================================
+
+static error_code chunk_wait(chunk_stream_t *stream)
+{
+    transport_t *transport = stream->client.transport;
+
+    //until the next hedge, or the first chunk to give up
+    double t = now();
+    double until = t + TRANSPORT_TIMEOUT_MS / 1e3;
+    for (size_t c = stream->head; c < stream->next; c++) {
+        const chunk_t *chunk = &stream->chunks[c % NETWORK_CHUNK_WINDOW];
+        if (chunk_done(stream, chunk)) continue;
+
+        double deadline = chunk->start + TRANSPORT_TIMEOUT_MS / 1e3;
+        if (chunk->nb_asked < chunk->nb_nodes && chunk->hedge_at < deadline) deadline = chunk->hedge_at;
+        until = deadline < until ? deadline : until;
+    }
 
-    size_t sizeToSend = strlen(tempKey) + 1 + strlen(tempValue);
+    uint32_t id = 0;
+    if (until > t && transport_wait(transport, (int) ((until - t) * 1e3) + 1, &id) == ERR_NONE) {
+        int matched = 0;
+        for (size_t c = stream->head; c < stream->next; c++) {
+            chunk_t *chunk = &stream->chunks[c % NETWORK_CHUNK_WINDOW];
+
+            for (size_t i = 0; i < chunk->nb_asked; i++) {
+                if (chunk->ids[i] != id) continue;
+
+                //a chunk is only read at the version of the manifest
+                const transport_request_t *request = transport_reply(transport, id);
+                matched = 1;
+                --(chunk->nb_waiting);
+                if (stream->opcode == PROTOCOL_PUT) {
+                    chunk->nb_written += request->status == PROTOCOL_OK;
+                } else if (chunk->found == 0 && request->status == PROTOCOL_OK
+                           && request->reply_size >= PROTOCOL_STAMP_SIZE
+                           && protocol_read_stamp(request->reply) == stream->version) {
+                    chunk->found = id;
+                }
+            }
+        }
 
-    *toSend = calloc(sizeToSend, sizeof(char));
+        //the reply of a request given up on before
+        if (!matched) transport_forget(transport, id);
+    }
 
-    if (*toSend == NULL) {
-        fprintf(stderr, "Memory error: toSend of prepare_put_packet");
-        free(tempKey);
-        free(tempValue);
-        return -1;
+    //the chunks whose servers are late or do not hold them
+    t = now();
+    for (size_t c = stream->head; c < stream->next; c++) {
+        chunk_t *chunk = &stream->chunks[c % NETWORK_CHUNK_WINDOW];
+        if (chunk_done(stream, chunk)) continue;
+
+        if (chunk->nb_asked < chunk->nb_nodes && (chunk->nb_waiting == 0 || t >= chunk->hedge_at)) {
+            chunk_ask(stream, chunk);
+        } else if (chunk->nb_waiting == 0 || t >= chunk->start + TRANSPORT_TIMEOUT_MS / 1e3) {
+            fprintf(stderr, "Could not %s chunk %zu of %.*s\n", stream->opcode == PROTOCOL_PUT ? "write" : "read",
+                    chunk->index, (int) stream->key_len, stream->key);
+            return ERR_NETWORK;
+        }
     }
 
-    //Creating message to send of the form <key\0value>
-    strncpy(*toSend, tempKey, sizeKey);
-    strncpy(*toSend + strlen(tempKey) + 1, tempValue, sizeValue);
+    return ERR_NONE;
+}
 
-    free(tempKey);
-    free(tempValue);
+// =====================================================================
 
-    return sizeToSend;
+static void chunk_release(chunk_stream_t *stream)
+{
+    chunk_t *chunk = &stream->chunks[stream->head++ % NETWORK_CHUNK_WINDOW];
+    forget_requests(stream->client, chunk->ids, chunk->nb_asked);
+    chunk->nb_asked = 0;
 }
@@ -15,10 +15,56 @@
  * @param client client to use
  * @param key key of what we want to find value
  * @param value value to write to, of size MAX_MSG_ELEM_SIZE + 1
- * @return an error code
+ * @return an error code, ERR_BAD_PARAMETER for a large value (see network_get_stream)
  */
 error_code network_get(client_t client, pps_key_t key, pps_value_t *value);
 
+/**
+ * @brief pages of a dump asked at once, each one of up to PROTOCOL_MAX_PAYLOAD
+ *        bytes: within the default receive buffer of a socket
+ */
+#define NETWORK_DUMP_WINDOW 3
+
+/**
+ * @brief function called on the pairs of a dump
+ * @param arg the argument given to network_dump
+ * @param key the key, in the reply (not terminated, it may hold '\0')
+ * @param key_len its length
+ * @param value the value, in the reply (as the key)
+ * @param value_len its length
+ * @param version its version
+ */
+typedef void (*network_visitor_t)(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                                  uint64_t version);
+
+/**
+ * @brief read the whole content of a server, page by page: the pages of
+ *        several streams (see PROTOCOL_SCAN_STREAMS) are asked at once, and
+ *        a page that does not come is asked again
+ * @param client client to use
+ * @param server the server
+ * @param window number of pages asked at once
+ * @param visit the function called on every pair as its page arrives; a pair
+ *        written or compacted during the dump may be visited twice
+ * @param arg its first argument
+ * @return an error code
+ */
+error_code network_dump(client_t client, const node_t *server, size_t window, network_visitor_t visit, void *arg);
+
+/**
+ * @brief get the values of many keys, asking each server for all its keys
+ *        at once (as many as fit in a datagram); R is checked for every key
+ * @param client client to use
+ * @param keys the keys
+ * @param nb_keys number of keys
+ * @param values where to store the values (to be freed), NULL for the keys
+ *        that could not be read on R servers
+ * @return ERR_NONE if all the values were read, ERR_NOT_FOUND if some were not,
+ *         ERR_BAD_PARAMETER if one is a large value (see network_get_stream),
+ *         another error code if none could be
+ */
+error_code network_mget(client_t client, const pps_key_t *keys, size_t nb_keys, pps_value_t *values);
+
 /**
  * @brief put a value in the network
  * @param client client to use
@@ -28,6 +74,117 @@ error_code network_get(client_t client, pps_key_t key, pps_value_t *value);
  */
 error_code network_put(client_t client, pps_key_t key, pps_value_t value);
 
+/**
+ * @brief put many pairs in the network, packing the pairs of each server in
+ *        as few datagrams as possible; W is checked for every pair
+ * @param client client to use
+ * @param pairs the pairs
+ * @param window maximum number of datagrams in flight
+ * @param nb_written where to store the number of pairs written on W servers (may be NULL)
+ * @param latencies where to store the latency in seconds of every datagram
+ *        (may be NULL, at least pairs->size * N entries otherwise)
+ * @param nb_latencies where to store the number of latencies (may be NULL)
+ * @return ERR_NONE if all the pairs were written on W servers, some error code otherwise
+ */
+error_code network_mput(client_t client, const kv_list_t *pairs, size_t window, size_t *nb_written,
+                        double *latencies, size_t *nb_latencies);
+
+/**
+ * @brief bytes of a large value per chunk (see network_put_stream)
+ */
+#define NETWORK_CHUNK_SIZE 16384
+
+/**
+ * @brief chunks of a large value in flight at once: the replies of a window
+ *        fit in the default receive buffer of a socket
+ */
+#define NETWORK_CHUNK_WINDOW 8
+
+/**
+ * @brief function giving the bytes of a large value to write
+ * @param arg the argument given to network_put_stream
+ * @param buffer where to write the next bytes
+ * @param size size of the buffer
+ * @param read where to store the number of bytes written, 0 at the end of the value
+ * @return an error code, the put fails on anything but ERR_NONE
+ */
+typedef error_code (*network_source_t)(void *arg, char *buffer, size_t size, size_t *read);
+
+/**
+ * @brief function receiving the bytes of a large value, in order
+ * @param arg the argument given to network_get_stream
+ * @param data the next bytes, valid during the call
+ * @param size their number
+ * @return an error code, the get fails on anything but ERR_NONE
+ */
+typedef error_code (*network_sink_t)(void *arg, const char *data, size_t size);
+
+/**
+ * @brief put a value of any size: it is read chunk by chunk, and the
+ *        chunks (under keys derived from the key and the version, spread
+ *        over the ring) are written NETWORK_CHUNK_WINDOW at a time, each on
+ *        W of its N servers. The key is then written a manifest of the
+ *        chunks, so that a value is never read before all its chunks are
+ *        written. The chunks of a value replaced are not deleted.
+ * @param client client to use
+ * @param key the key
+ * @param read the function giving the bytes of the value
+ * @param arg its first argument
+ * @param size where to store the size of the value (may be NULL)
+ * @return an error code
+ */
+error_code network_put_stream(client_t client, pps_key_t key, network_source_t read, void *arg, size_t *size);
+
+/**
+ * @brief get a value of any size: the manifest is read with R servers, then
+ *        the chunks of its version are fetched NETWORK_CHUNK_WINDOW at a
+ *        time, each from one of its servers (the next ones are asked if it
+ *        does not hold that version or is late), and given in order. A
+ *        value put with network_put is given at once.
+ * @param client client to use
+ * @param key the key
+ * @param write the function receiving the bytes of the value
+ * @param arg its first argument
+ * @param size where to store the size of the value (may be NULL)
+ * @return an error code
+ */
+error_code network_get_stream(client_t client, pps_key_t key, network_sink_t write, void *arg, size_t *size);
+
+/**
+ * @brief store the concatenation of the values of some keys in a key
+ *        (computed by the servers of dest when they hold all the keys)
+ * @param client client to use
+ * @param keys the keys
+ * @param nb_keys number of keys (the servers compute it for less than MAX_OPERATION_KEYS,
+ *        the client otherwise)
+ * @param dest key where to store the result
+ * @return an error code
+ */
+error_code network_concat(client_t client, const pps_key_t *keys, size_t nb_keys, pps_key_t dest);
+
+/**
+ * @brief store a substring of a value in a key
+ *        (computed by the servers of dest when they hold key)
+ * @param client client to use
+ * @param key key of the value
+ * @param start position of the substring, from the end of the value if negative
+ * @param length length of the substring
+ * @param dest key where to store the result
+ * @return an error code
+ */
+error_code network_substr(client_t client, pps_key_t key, long start, size_t length, pps_key_t dest);
+
+/**
+ * @brief find a value in another one
+ *        (searched by the servers of key1 when they hold key2)
+ * @param client client to use
+ * @param key1 key of the value to search in
+ * @param key2 key of the value to search for
+ * @param index where to store the index of value2 in value1, -1 if it is not in it
+ * @return an error code
+ */
+error_code network_find(client_t client, pps_key_t key1, pps_key_t key2, long *index);
+
 /**
  * @brief delete a key in the network
  * @param client client to use
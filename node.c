@@ -75,7 +75,8 @@ error_code node_init(node_t *node, const char *ip, uint16_t port, size_t _unused
 
 int node_cmp_sha(const node_t *first, const node_t *second){
 
-    return strncmp(first->SHA, second->SHA, strlen(first->SHA));
+    //binary digests: may contain '\0'
+    return memcmp(first->SHA, second->SHA, SHA_DIGEST_LENGTH);
 }
 
 // =====================================================================
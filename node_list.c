@@ -33,6 +33,7 @@ node_list_t *node_list_new() {
 
     list->size = 0;
     list->nodes = NULL;
+    list->index = NULL;
     return list;
 }
 
@@ -19,6 +19,7 @@
 struct node_list {
     size_t size;
     node_t* nodes;
+    struct ring_index* index; // lookup index when the list is a ring (see ring.h), NULL otherwise
 };
 typedef struct node_list node_list_t;
 
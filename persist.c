@@ -0,0 +1,655 @@
+/**
+ * @file persist.c
+ * @brief Implementation of persist.h
+ *
+ * @date 18.10.2026
+ */
+
+#define _DEFAULT_SOURCE // for fdatasync
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "persist.h"
+#include "config.h"
+#include "error.h"
+#include "hashtable.h"
+
+#define PERSIST_IO_BUFFER (1 << 20)
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+#define LOG_MAGIC "PPSLOG01"
+#define SNAPSHOT_MAGIC "PPSSNAP2"
+#define SNAPSHOT_HEADER 40 // magic, entries, slots, heap start, heap end
+#define SNAPSHOT_SLOT 16 // hash, unused, offset of the entry (0 if empty)
+#define SNAPSHOT_ENTRY_HEADER 16 // key length, value length, version
+#define SNAPSHOT_MIN_SLOTS 16
+
+/**
+ * @brief FNV-1a checksum
+ * @param hash checksum of the previous bytes (FNV_OFFSET at first)
+ * @param data bytes to add
+ * @param size number of bytes
+ * @return the updated checksum
+ */
+static uint32_t checksum(uint32_t hash, const void *data, size_t size);
+
+/**
+ * @brief store a 32 bits integer in little endian
+ * @param dst where to write 4 bytes
+ * @param value the integer
+ */
+static void put_u32(unsigned char *dst, uint32_t value);
+
+/**
+ * @brief read a 32 bits little endian integer
+ * @param src 4 bytes to read
+ * @return the integer
+ */
+static uint32_t get_u32(const unsigned char *src);
+
+/**
+ * @brief store a 64 bits integer in little endian
+ * @param dst where to write 8 bytes
+ * @param value the integer
+ */
+static void put_u64(unsigned char *dst, uint64_t value);
+
+/**
+ * @brief read a 64 bits little endian integer
+ * @param src 8 bytes to read
+ * @return the integer
+ */
+static uint64_t get_u64(const unsigned char *src);
+
+/**
+ * @brief hash of a key in the index of a snapshot
+ * @param key the key
+ * @param key_len length of the key
+ * @return the hash
+ */
+static uint32_t snapshot_hash(const char *key, size_t key_len);
+
+/**
+ * @brief append an entry to the heap of a snapshot being written and index it
+ * @param out the snapshot, positioned at the end of the heap
+ * @param index the index, with nb_slots slots
+ * @param nb_slots number of slots of the index (power of two)
+ * @param offset offset of the end of the heap, updated
+ * @param key the key
+ * @param key_len length of the key
+ * @param value the value
+ * @param value_len length of the value
+ * @param version its version
+ * @return an error code
+ */
+static error_code snapshot_add(FILE *out, unsigned char *index, uint64_t nb_slots, uint64_t *offset,
+                               const char *key, size_t key_len, const char *value, size_t value_len,
+                               uint64_t version);
+
+/**
+ * @brief a snapshot being written
+ */
+typedef struct {
+    FILE *out;
+    unsigned char *index;
+    uint64_t nb_slots;
+    uint64_t offset;
+    error_code err;
+} snapshot_writer_t;
+
+/**
+ * @brief append an entry of the table to a snapshot (visitor of scan_Htable)
+ * @param arg the snapshot_writer_t, whose err is set on failure
+ * @param key the key
+ * @param key_len length of the key
+ * @param value the value
+ * @param value_len length of the value
+ * @param version its version
+ * @return 1 to go on, 0 on error
+ */
+static int write_entry(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version);
+
+/**
+ * @brief fill a record header
+ * @param header PERSIST_RECORD_HEADER bytes
+ * @return nothing, the key and value are given as for persist_append
+ */
+static void make_header(unsigned char *header, pps_key_t key, size_t key_len,
+                        pps_value_t value, size_t value_len, uint64_t version);
+
+/**
+ * @brief make the creation or the renaming of a file durable
+ * @param path the file
+ */
+static void sync_dir(const char *path);
+
+// =====================================================================
+
+error_code persist_parse_policy(const char *name, sync_policy_t *policy)
+{
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(policy);
+
+    if (strcmp(name, "always") == 0) {
+        *policy = SYNC_ALWAYS;
+    } else if (strcmp(name, "batch") == 0) {
+        *policy = SYNC_BATCH;
+    } else if (strcmp(name, "off") == 0) {
+        *policy = SYNC_OFF;
+    } else {
+        return ERR_BAD_PARAMETER;
+    }
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+ssize_t persist_append(int fd, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version)
+{
+    unsigned char header[PERSIST_RECORD_HEADER];
+    make_header(header, key, key_len, value, value_len, version);
+
+    //one write for the whole record
+    struct iovec iov[3] = {
+        {header, PERSIST_RECORD_HEADER},
+        {(void *) key, key_len},
+        {(void *) value, value_len}
+    };
+
+    size_t size = PERSIST_RECORD_HEADER + key_len + value_len;
+    ssize_t written = writev(fd, iov, 3);
+
+    return written == (ssize_t) size ? written : -1;
+}
+
+// =====================================================================
+
+error_code persist_log_start(int fd)
+{
+    return write(fd, LOG_MAGIC, PERSIST_LOG_HEADER) == PERSIST_LOG_HEADER ? ERR_NONE : ERR_IO;
+}
+
+// =====================================================================
+
+error_code persist_log_rotate(const char *path, const char *old, int *fd)
+{
+    M_REQUIRE_NON_NULL(path);
+    M_REQUIRE_NON_NULL(old);
+    M_REQUIRE_NON_NULL(fd);
+
+    if (rename(path, old) != 0) return ERR_IO;
+
+    *fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_TRUNC, 0644);
+    if (*fd == -1 || persist_log_start(*fd) != ERR_NONE) {
+        //the writes go on in the log, as if it had not moved
+        if (*fd != -1) close(*fd);
+        *fd = -1;
+        rename(old, path);
+        return ERR_IO;
+    }
+
+    sync_dir(path);
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+ssize_t persist_replay(const char *path, Htable_t table, off_t *valid_size)
+{
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(path, -1);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(table, -1);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(valid_size, -1);
+
+    *valid_size = 0;
+
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        //nothing was ever written
+        return 0;
+    }
+    setvbuf(in, NULL, _IOFBF, PERSIST_IO_BUFFER);
+
+    //a torn header is a log that was never written to, but records of
+    //another format would all look torn and be dropped
+    char magic[PERSIST_LOG_HEADER];
+    size_t magic_len = fread(magic, 1, PERSIST_LOG_HEADER, in);
+    if (memcmp(magic, LOG_MAGIC, magic_len) != 0) {
+        fprintf(stderr, "%s is not a log of version %s\n", path, LOG_MAGIC);
+        fclose(in);
+        return -1;
+    }
+    if (magic_len < PERSIST_LOG_HEADER) {
+        fclose(in);
+        return 0;
+    }
+    *valid_size = PERSIST_LOG_HEADER;
+
+    char *key = malloc(MAX_MSG_ELEM_SIZE + 1);
+    char *value = malloc(MAX_MSG_ELEM_SIZE + 1);
+    if (key == NULL || value == NULL) {
+        free(key);
+        free(value);
+        fclose(in);
+        return -1;
+    }
+
+    ssize_t nb_records = 0;
+    unsigned char header[PERSIST_RECORD_HEADER];
+
+    while (fread(header, PERSIST_RECORD_HEADER, 1, in) == 1) {
+        uint32_t key_len = get_u32(header + 4);
+        uint32_t value_len = get_u32(header + 8);
+        uint64_t version = get_u64(header + 12);
+
+        if (key_len > MAX_MSG_ELEM_SIZE || value_len > MAX_MSG_ELEM_SIZE
+            || fread(key, 1, key_len, in) != key_len
+            || fread(value, 1, value_len, in) != value_len) {
+            break;
+        }
+
+        unsigned char expected[PERSIST_RECORD_HEADER];
+        make_header(expected, key, key_len, value, value_len, version);
+        if (memcmp(expected, header, 4) != 0) {
+            fprintf(stderr, "Corrupted record at offset %ld of %s\n", (long) *valid_size, path);
+            break;
+        }
+
+        if (add_Htable_versioned_value(table, key, key_len, value, value_len, version) != ERR_NONE) {
+            nb_records = -1;
+            break;
+        }
+
+        ++nb_records;
+        *valid_size += PERSIST_RECORD_HEADER + key_len + value_len;
+    }
+
+    free(key);
+    free(value);
+    fclose(in);
+
+    return nb_records;
+}
+
+// =====================================================================
+
+error_code persist_snapshot(const char *path, Htable_t table, const persist_map_t *base)
+{
+    M_REQUIRE_NON_NULL(path);
+    M_REQUIRE_NON_NULL(table);
+
+    //entries of the previous snapshot that are still up to date
+    uint64_t nb_entries = table->nbr_elems;
+    const char *key = NULL, *value = NULL;
+    size_t key_len = 0, value_len = 0;
+    for (size_t pos = 0; base != NULL
+                         && (pos = persist_map_next(base, pos, &key, &key_len, &value, &value_len, NULL)) != 0; ) {
+        if (!has_Htable_key(table, key, key_len)) ++nb_entries;
+    }
+
+    //load factor at most 1/2
+    uint64_t nb_slots = SNAPSHOT_MIN_SLOTS;
+    while (nb_slots < 2 * nb_entries) {
+        nb_slots *= 2;
+    }
+
+    unsigned char *index = calloc(nb_slots, SNAPSHOT_SLOT);
+    size_t path_len = strlen(path);
+    char *tmp = malloc(path_len + 5);
+    FILE *out = NULL;
+
+    error_code err = (index == NULL || tmp == NULL) ? ERR_NOMEM : ERR_NONE;
+    if (err == ERR_NONE) {
+        snprintf(tmp, path_len + 5, "%s.tmp", path);
+        out = fopen(tmp, "wb");
+        err = out == NULL ? ERR_IO : ERR_NONE;
+    }
+
+    //the heap first, the index is only complete at the end
+    uint64_t heap_start = SNAPSHOT_HEADER + nb_slots * SNAPSHOT_SLOT;
+    uint64_t offset = heap_start;
+
+    if (err == ERR_NONE) {
+        setvbuf(out, NULL, _IOFBF, PERSIST_IO_BUFFER);
+        if (fseeko(out, (off_t) heap_start, SEEK_SET) != 0) err = ERR_IO;
+    }
+
+    //the entries of the table are written in place, without a copy of the table
+    if (err == ERR_NONE) {
+        snapshot_writer_t writer = {out, index, nb_slots, offset, ERR_NONE};
+        uint64_t position = 0;
+        err = scan_Htable(table, &position, write_entry, &writer);
+        if (err == ERR_NONE) err = writer.err;
+        offset = writer.offset;
+    }
+
+    uint64_t version = 0;
+    for (size_t pos = 0; err == ERR_NONE && base != NULL
+                         && (pos = persist_map_next(base, pos, &key, &key_len, &value, &value_len, &version)) != 0; ) {
+        if (!has_Htable_key(table, key, key_len)) {
+            err = snapshot_add(out, index, nb_slots, &offset, key, key_len, value, value_len, version);
+        }
+    }
+
+    if (err == ERR_NONE) {
+        unsigned char header[SNAPSHOT_HEADER];
+        memcpy(header, SNAPSHOT_MAGIC, 8);
+        put_u64(header + 8, nb_entries);
+        put_u64(header + 16, nb_slots);
+        put_u64(header + 24, heap_start);
+        put_u64(header + 32, offset);
+
+        if (fseeko(out, 0, SEEK_SET) != 0
+            || fwrite(header, SNAPSHOT_HEADER, 1, out) != 1
+            || fwrite(index, SNAPSHOT_SLOT, nb_slots, out) != nb_slots) {
+            err = ERR_IO;
+        }
+    }
+
+    //the snapshot has to be on disk before it replaces the previous one
+    if (out != NULL) {
+        if (fflush(out) != 0 || fdatasync(fileno(out)) != 0) {
+            err = ERR_IO;
+        }
+        fclose(out);
+    }
+
+    if (err == ERR_NONE && rename(tmp, path) != 0) {
+        err = ERR_IO;
+    }
+
+    if (err == ERR_NONE) {
+        //make the rename itself durable
+        sync_dir(path);
+    } else if (out != NULL) {
+        unlink(tmp);
+    }
+
+    free(index);
+    free(tmp);
+    return err;
+}
+
+// =====================================================================
+
+error_code persist_map_open(const char *path, persist_map_t **map)
+{
+    M_REQUIRE_NON_NULL(path);
+    M_REQUIRE_NON_NULL(map);
+
+    *map = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        //nothing was ever compacted
+        return errno == ENOENT ? ERR_NONE : ERR_IO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < SNAPSHOT_HEADER) {
+        close(fd);
+        return ERR_IO;
+    }
+
+    size_t size = (size_t) st.st_size;
+    unsigned char *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return ERR_IO;
+    }
+
+    uint64_t nb_slots = get_u64(base + 16);
+    uint64_t heap_start = get_u64(base + 24);
+
+    //only the header is checked: the entries are read on demand
+    if (memcmp(base, SNAPSHOT_MAGIC, 8) != 0 || nb_slots == 0 || (nb_slots & (nb_slots - 1)) != 0
+        || heap_start != SNAPSHOT_HEADER + nb_slots * SNAPSHOT_SLOT || heap_start > size
+        || get_u64(base + 32) != size) {
+        fprintf(stderr, "%s is not a valid snapshot\n", path);
+        munmap(base, size);
+        return ERR_IO;
+    }
+
+    //lookups jump around, no need to read ahead
+    madvise(base, size, MADV_RANDOM);
+
+    persist_map_t *m = malloc(sizeof(persist_map_t));
+    if (m == NULL) {
+        munmap(base, size);
+        return ERR_NOMEM;
+    }
+
+    m->base = base;
+    m->size = size;
+    m->refs = 1;
+    m->nb_entries = get_u64(base + 8);
+    m->nb_slots = nb_slots;
+    m->index = base + SNAPSHOT_HEADER;
+    m->heap_start = (size_t) heap_start;
+
+    *map = m;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+void persist_map_unref(persist_map_t *map)
+{
+    if (map == NULL || --(map->refs) > 0) return;
+
+    munmap(map->base, map->size);
+    free(map);
+}
+
+// =====================================================================
+
+error_code persist_map_get(const persist_map_t *map, pps_key_t key, size_t key_len,
+                           const char **value, size_t *value_len, uint64_t *version)
+{
+    M_REQUIRE_NON_NULL(map);
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(value);
+    M_REQUIRE_NON_NULL(value_len);
+    M_REQUIRE_NON_NULL(version);
+
+    uint32_t hash = snapshot_hash(key, key_len);
+    uint64_t mask = map->nb_slots - 1;
+
+    for (uint64_t i = hash & mask, n = 0; n < map->nb_slots; i = (i + 1) & mask, ++n) {
+        const unsigned char *slot = map->index + i * SNAPSHOT_SLOT;
+        uint64_t offset = get_u64(slot + 8);
+
+        if (offset == 0) break;
+        if (get_u32(slot) != hash || offset + SNAPSHOT_ENTRY_HEADER > map->size) continue;
+
+        const unsigned char *entry = map->base + offset;
+        size_t k_len = get_u32(entry);
+        size_t v_len = get_u32(entry + 4);
+
+        if (k_len == key_len && offset + SNAPSHOT_ENTRY_HEADER + k_len + v_len + 2 <= map->size
+            && memcmp(entry + SNAPSHOT_ENTRY_HEADER, key, key_len) == 0) {
+            *value = (const char *) entry + SNAPSHOT_ENTRY_HEADER + k_len + 1;
+            *value_len = v_len;
+            *version = get_u64(entry + 8);
+            return ERR_NONE;
+        }
+    }
+
+    return ERR_NOT_FOUND;
+}
+
+// =====================================================================
+
+size_t persist_map_next(const persist_map_t *map, size_t pos, const char **key, size_t *key_len,
+                        const char **value, size_t *value_len, uint64_t *version)
+{
+    if (map == NULL || key == NULL || key_len == NULL || value == NULL || value_len == NULL) return 0;
+
+    if (pos == 0) pos = map->heap_start;
+    if (pos + SNAPSHOT_ENTRY_HEADER > map->size) return 0;
+
+    const unsigned char *entry = map->base + pos;
+    size_t k_len = get_u32(entry);
+    size_t v_len = get_u32(entry + 4);
+    size_t next = pos + SNAPSHOT_ENTRY_HEADER + k_len + v_len + 2;
+
+    if (next > map->size) return 0;
+
+    *key = (const char *) entry + SNAPSHOT_ENTRY_HEADER;
+    *key_len = k_len;
+    *value = *key + k_len + 1;
+    *value_len = v_len;
+    if (version != NULL) *version = get_u64(entry + 8);
+    return next;
+}
+
+// =====================================================================
+
+static void make_header(unsigned char *header, pps_key_t key, size_t key_len,
+                        pps_value_t value, size_t value_len, uint64_t version)
+{
+    put_u32(header + 4, (uint32_t) key_len);
+    put_u32(header + 8, (uint32_t) value_len);
+    put_u64(header + 12, version);
+
+    uint32_t sum = checksum(FNV_OFFSET, header + 4, PERSIST_RECORD_HEADER - 4);
+    sum = checksum(sum, key, key_len);
+    sum = checksum(sum, value, value_len);
+    put_u32(header, sum);
+}
+
+// =====================================================================
+
+static error_code snapshot_add(FILE *out, unsigned char *index, uint64_t nb_slots, uint64_t *offset,
+                               const char *key, size_t key_len, const char *value, size_t value_len,
+                               uint64_t version)
+{
+    unsigned char header[SNAPSHOT_ENTRY_HEADER];
+    put_u32(header, (uint32_t) key_len);
+    put_u32(header + 4, (uint32_t) value_len);
+    put_u64(header + 8, version);
+
+    if (fwrite(header, SNAPSHOT_ENTRY_HEADER, 1, out) != 1
+        || fwrite(key, 1, key_len + 1, out) != key_len + 1
+        || fwrite(value, 1, value_len + 1, out) != value_len + 1) {
+        return ERR_IO;
+    }
+
+    //linear probing, the index is at most half full
+    uint32_t hash = snapshot_hash(key, key_len);
+    uint64_t i = hash & (nb_slots - 1);
+    while (get_u64(index + i * SNAPSHOT_SLOT + 8) != 0) {
+        i = (i + 1) & (nb_slots - 1);
+    }
+    put_u32(index + i * SNAPSHOT_SLOT, hash);
+    put_u64(index + i * SNAPSHOT_SLOT + 8, *offset);
+
+    *offset += SNAPSHOT_ENTRY_HEADER + key_len + value_len + 2;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static int write_entry(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version)
+{
+    snapshot_writer_t *writer = arg;
+    writer->err = snapshot_add(writer->out, writer->index, writer->nb_slots, &writer->offset,
+                               key, key_len, value, value_len, version);
+    return writer->err == ERR_NONE;
+}
+
+// =====================================================================
+
+static uint32_t snapshot_hash(const char *key, size_t key_len)
+{
+    //FNV-1a spreads poorly in the low bits, mix them (murmur3 finalizer)
+    uint32_t h = checksum(FNV_OFFSET, key, key_len);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// =====================================================================
+
+static uint32_t checksum(uint32_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// =====================================================================
+
+static void put_u32(unsigned char *dst, uint32_t value)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        dst[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+// =====================================================================
+
+static uint32_t get_u32(const unsigned char *src)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value |= (uint32_t) src[i] << (8 * i);
+    }
+    return value;
+}
+
+// =====================================================================
+
+static void put_u64(unsigned char *dst, uint64_t value)
+{
+    for (size_t i = 0; i < 8; ++i) {
+        dst[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+// =====================================================================
+
+static uint64_t get_u64(const unsigned char *src)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        value |= (uint64_t) src[i] << (8 * i);
+    }
+    return value;
+}
+
+// =====================================================================
+
+static void sync_dir(const char *path)
+{
+    char *dir_path = strdup(path);
+    if (dir_path != NULL) {
+        int dir = open(dirname(dir_path), O_RDONLY);
+        if (dir != -1) {
+            fsync(dir);
+            close(dir);
+        }
+        free(dir_path);
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+/**
+ * @file persist.h
+ * @brief On-disk format of the server storage: append-only logs of records
+ *        and snapshots that are used in place through mmap.
+ *        A log record is <checksum><key length><value length><version><key><value>.
+ *        A snapshot is a header, an open addressing index of
+ *        <hash><unused><offset> slots and a heap of
+ *        <key length><value length><version><key>\0<value>\0 entries.
+ *        The versions are the ones of hlc.h.
+ *        All the integers are little endian.
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h> // for uint64_t
+#include <sys/types.h> // for off_t
+
+#include "error.h"
+#include "hashtable.h"
+
+/**
+ * @brief when the log is flushed to disk
+ */
+typedef enum {
+    SYNC_ALWAYS, // after every write, before it is acknowledged
+    SYNC_BATCH,  // once per batch of requests, before the batch is acknowledged (group commit)
+    SYNC_OFF     // never, the kernel writes the log back when it wants
+} sync_policy_t;
+
+/**
+ * @brief size of the header of a record
+ */
+#define PERSIST_RECORD_HEADER 20
+
+/**
+ * @brief size of the header at the start of a log: a magic holding the
+ *        version of the format of its records
+ */
+#define PERSIST_LOG_HEADER 8
+
+/**
+ * @brief a snapshot mapped in memory, shared by the views on its values
+ */
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    size_t refs; // protected by the lock of the owner
+    uint64_t nb_entries;
+    uint64_t nb_slots; // power of two
+    const unsigned char *index;
+    size_t heap_start;
+} persist_map_t;
+
+/**
+ * @brief parse a fsync policy name ("always", "batch" or "off")
+ * @param name the name
+ * @param policy where to store the policy
+ * @return ERR_NONE or ERR_BAD_PARAMETER
+ */
+error_code persist_parse_policy(const char *name, sync_policy_t *policy);
+
+/**
+ * @brief append a record to a log
+ * @param fd the log, opened with O_APPEND
+ * @param key the key
+ * @param key_len length of the key
+ * @param value the value
+ * @param value_len length of the value
+ * @param version version of the value
+ * @return the number of bytes written, -1 on error
+ */
+ssize_t persist_append(int fd, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version);
+
+/**
+ * @brief write the header of an empty log
+ * @param fd the log, opened with O_APPEND and empty
+ * @return an error code
+ */
+error_code persist_log_start(int fd);
+
+/**
+ * @brief move a log aside for a compaction and start a new one in its place
+ *        (both renaming and creation made durable, as for persist_snapshot)
+ * @param path the log
+ * @param old where it moves, replaced if it exists
+ * @param fd where to store the new log, opened with O_APPEND
+ * @return an error code, the log is back in place on error
+ */
+error_code persist_log_rotate(const char *path, const char *old, int *fd);
+
+/**
+ * @brief load all the valid records of a log into a table
+ *        (stops at the first truncated or corrupted record)
+ * @param path the log to read, missing files are empty
+ * @param table the table to fill
+ * @param valid_size where to store the size of the valid part of the file,
+ *        0 if not even its header was written
+ * @return the number of records loaded, or -1 on error
+ *         (among which a log written in another format)
+ */
+ssize_t persist_replay(const char *path, Htable_t table, off_t *valid_size);
+
+/**
+ * @brief atomically replace a snapshot by the content of a table merged
+ *        with a previous snapshot (written to a temporary file, synced, then renamed)
+ * @param path the snapshot to write
+ * @param table the newest values, only read: settled (see settle_Htable), it may be looked up
+ *        by other threads meanwhile, but not written
+ * @param base the previous snapshot, may be NULL
+ * @return an error code
+ */
+error_code persist_snapshot(const char *path, Htable_t table, const persist_map_t *base);
+
+/**
+ * @brief map a snapshot (only its header is read)
+ * @param path the snapshot
+ * @param map where to store the mapping, with one reference,
+ *        or NULL if there is no snapshot yet
+ * @return an error code, ERR_IO if the file is not a valid snapshot
+ */
+error_code persist_map_open(const char *path, persist_map_t **map);
+
+/**
+ * @brief drop a reference to a mapping, unmapped with the last one
+ * @param map the mapping, may be NULL
+ */
+void persist_map_unref(persist_map_t *map);
+
+/**
+ * @brief look a key up in a snapshot
+ * @param map the mapping
+ * @param key the key
+ * @param key_len length of the key
+ * @param value where to store a pointer to the value, in the mapping
+ * @param value_len where to store the length of the value
+ * @param version where to store the version of the value
+ * @return ERR_NONE or ERR_NOT_FOUND
+ */
+error_code persist_map_get(const persist_map_t *map, pps_key_t key, size_t key_len,
+                           const char **value, size_t *value_len, uint64_t *version);
+
+/**
+ * @brief iterate over the entries of a snapshot, in file order
+ * @param map the mapping
+ * @param pos value returned by the previous call, 0 to start
+ * @param key where to store a pointer to the key of the entry
+ * @param key_len where to store the length of the key
+ * @param value where to store a pointer to the value of the entry
+ * @param value_len where to store the length of the value
+ * @param version where to store the version of the value, may be NULL
+ * @return the value for the next call, 0 when there is no more entry
+ *         (key, value and version are then left untouched)
+ */
+size_t persist_map_next(const persist_map_t *map, size_t pos, const char **key, size_t *key_len,
+                        const char **value, size_t *value_len, uint64_t *version);
@@ -0,0 +1,1415 @@
+/**
+ * @file pps-bench.c
+ * @brief micro-benchmarks of the client code paths
+ *
+ *        ./pps-bench ring [<servers> <nodes per server> <lookups>]
+ *            preference lists of random keys on a synthetic ring
+ *        ./pps-bench get [-n N -r R -w W] [--] <operations> [<value size>]
+ *            latency of network_put/network_get on the servers of servers.txt,
+ *            and the bytes received by the gets
+ *        ./pps-bench put [-n N -w W] [--] <operations> [<value size>]
+ *            latency of network_put, and the allocations and copies of the
+ *            client per put (pps-bench is linked with --wrap for the
+ *            allocation and copy functions, see the Makefile)
+ *        ./pps-bench mget [-n N -r R] [--] <keys>
+ *            one network_mget of <keys> keys against as many network_get
+ *        ./pps-bench pipeline [--] <operations> <depth>
+ *            throughput of puts and gets to one replica with up to <depth>
+ *            requests in flight, against one at a time (stop-and-wait)
+ *        ./pps-bench ops [-n N -r R -w W] [--] <operations>
+ *            cat, substr and find computed by the servers, against the
+ *            same operations read, computed and written back by the client
+ *        ./pps-bench large [-n N -r R -w W] [--] <value size> [<operations>]
+ *            throughput of network_put_stream and network_get_stream with
+ *            values of <value size> bytes (1m and 64m are accepted), against
+ *            the value split by hand in pieces put and got one after the other
+ *        ./pps-bench htable [<keys>...]
+ *            puts, gets and misses on the local hash-table against the chained
+ *            table it replaced, as construct_Htable(HTABLE_SIZE) built it and
+ *            with a head per key, with 1K, 1M and 10M keys by default
+ *
+ * @date 18.10.2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "node.h"
+#include "node_list.h"
+#include "ring.h"
+#include "client.h"
+#include "network.h"
+#include "util.h"
+#include "config.h"
+#include "error.h"
+#include "protocol.h"
+#include "hlc.h"
+#include "hashtable.h"
+
+#define DEFAULT_SERVERS 100
+#define DEFAULT_NODES_PER_SERVER 100
+#define DEFAULT_LOOKUPS 1000000
+#define BENCH_N 3
+#define BENCH_KEYS 4096
+#define MAX_KEY_SIZE 32
+#define BENCH_VALUE_SIZE 8192 // of each of the two values of the value operations
+#define BENCH_LARGE_RUNS 3 // default number of puts and gets of a large value
+#define HTABLE_BENCH_OPS 1000000 // operations timed at least, the smaller tables are filled and read again
+#define HTABLE_BENCH_VALUE "value-0123456789"
+#define HTABLE_BENCH_STRIDE 2654435761u // a prime: the gets visit the keys in a scattered order
+#define HTABLE_BENCH_SAMPLE 1000 // operations timed on the table of HTABLE_SIZE heads, whose chains grow with the keys
+
+/**
+ * @brief versions of the puts of the pipeline (see hlc.h)
+ */
+static hlc_t bench_clock = HLC_INITIALIZER;
+
+/**
+ * @brief allocations and copies of the code of the client, counted by the
+ *        wrappers of malloc, calloc, realloc, memcpy, memmove and strncpy
+ */
+static size_t nb_allocations = 0;
+static size_t bytes_allocated = 0;
+static size_t bytes_copied = 0;
+
+/**
+ * @brief the functions wrapped by the linker (--wrap): the objects of
+ *        pps-bench call __wrap_f instead of f, which is __real_f
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_memcpy(void *dest, const void *src, size_t n);
+void *__real_memmove(void *dest, const void *src, size_t n);
+char *__real_strncpy(char *dest, const char *src, size_t n);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void *__wrap_memcpy(void *dest, const void *src, size_t n);
+void *__wrap_memmove(void *dest, const void *src, size_t n);
+char *__wrap_strncpy(char *dest, const char *src, size_t n);
+
+/**
+ * @brief current time in seconds
+ * @return the time of a monotonic clock
+ */
+static double now(void);
+
+/**
+ * @brief benchmark of the ring lookups
+ * @param nb_servers number of servers
+ * @param nodes_per_server number of nodes of every server
+ * @param lookups number of lookups of each kind
+ * @return an error code
+ */
+static error_code bench_ring(size_t nb_servers, size_t nodes_per_server, size_t lookups);
+
+/**
+ * @brief benchmark of the local hash-table against the chained one
+ * @param sizes numbers of keys
+ * @param nb_sizes number of sizes
+ * @return an error code
+ */
+static error_code bench_htable(const size_t *sizes, size_t nb_sizes);
+
+/**
+ * @brief benchmark of the client operations on running servers
+ * @param argc number of arguments, from "get"
+ * @param argv the arguments, from "get"
+ * @return an error code
+ */
+static error_code bench_get(int argc, char *argv[]);
+
+/**
+ * @brief benchmark of the puts on running servers
+ * @param argc number of arguments, from "put"
+ * @param argv the arguments, from "put"
+ * @return an error code
+ */
+static error_code bench_put(int argc, char *argv[]);
+
+/**
+ * @brief benchmark of the multi-get on running servers
+ * @param argc number of arguments, from "mget"
+ * @param argv the arguments, from "mget"
+ * @return an error code
+ */
+static error_code bench_mget(int argc, char *argv[]);
+
+/**
+ * @brief benchmark of pipelined requests on running servers
+ * @param argc number of arguments, from "pipeline"
+ * @param argv the arguments, from "pipeline"
+ * @return an error code
+ */
+static error_code bench_pipeline(int argc, char *argv[]);
+
+/**
+ * @brief benchmark of the value operations on running servers
+ * @param argc number of arguments, from "ops"
+ * @param argv the arguments, from "ops"
+ * @return an error code
+ */
+static error_code bench_ops(int argc, char *argv[]);
+
+/**
+ * @brief benchmark of the large values on running servers
+ * @param argc number of arguments, from "large"
+ * @param argv the arguments, from "large"
+ * @return an error code
+ */
+static error_code bench_large(int argc, char *argv[]);
+
+/**
+ * @brief a large value generated as it is read or checked as it is written:
+ *        byte i is i * 31 + seed (see network_source_t and network_sink_t)
+ */
+typedef struct {
+    size_t size;     // of the value
+    size_t pos;      // bytes read or written so far
+    unsigned seed;
+    int valid;       // whether the bytes written were the expected ones
+} large_value_t;
+
+/**
+ * @brief put and get a large value split in pieces of MAX_MSG_ELEM_SIZE bytes,
+ *        one after the other
+ * @param client the client
+ * @param value_size size of the value
+ * @param put_time where to add the time of the puts
+ * @param get_time where to add the time of the gets
+ * @return the number of failed operations
+ */
+static size_t run_pieces(client_t client, size_t value_size, double *put_time, double *get_time);
+
+/**
+ * @brief give the next bytes of a large value (a network_source_t)
+ */
+static error_code large_read(void *arg, char *buffer, size_t size, size_t *read);
+
+/**
+ * @brief check the next bytes of a large value (a network_sink_t)
+ */
+static error_code large_write(void *arg, const char *data, size_t size);
+
+/**
+ * @brief the chained hash-table of the first versions of the server: a
+ *        bucket per key, its key and its value copied apart, in the list of
+ *        its head (HTABLE_SIZE heads, or one head per key, its best case)
+ */
+typedef struct chained_entry {
+    char *key;
+    char *value;
+    struct chained_entry *next;
+} chained_entry_t;
+
+typedef struct {
+    chained_entry_t **heads;
+    size_t size;
+} chained_table_t;
+
+/**
+ * @brief what a table did with some number of keys
+ */
+typedef struct {
+    double put_ns;      // per put, the table growing from empty
+    double get_ns;      // per get of a key present
+    double miss_ns;     // per get of a key absent
+    double allocations; // per key, while the table is filled
+    double bytes;       // asked to malloc per key while the table is filled, the arrays left behind by a growth included
+} htable_result_t;
+
+/**
+ * @brief fill and read the local hash-table (see hashtable.h)
+ * @param keys 2 * nb_keys keys of MAX_KEY_SIZE bytes, the first half put
+ * @param nb_keys number of keys put
+ * @param rounds times the table is filled and read
+ * @param result where to store the results
+ * @return an error code
+ */
+static error_code run_robin_hood(const char *keys, size_t nb_keys, size_t rounds, htable_result_t *result);
+
+/**
+ * @brief fill and read the chained hash-table
+ * @param keys 2 * nb_keys keys of MAX_KEY_SIZE bytes, the first half put
+ * @param nb_keys number of keys put
+ * @param rounds times the table is filled and read
+ * @param result where to store the results
+ * @return an error code
+ */
+static error_code run_chained(const char *keys, size_t nb_keys, size_t rounds, htable_result_t *result);
+
+/**
+ * @brief fill and read the chained hash-table as construct_Htable(HTABLE_SIZE) built it:
+ *        every put looks for its key in its list first, the lists growing with the keys.
+ *        The table is filled with all the keys, but only HTABLE_BENCH_SAMPLE puts, gets and
+ *        misses spread over them are timed when there are more keys
+ * @param keys 2 * nb_keys keys of MAX_KEY_SIZE bytes, the first half put
+ * @param nb_keys number of keys put
+ * @param rounds times the table is filled and read
+ * @param result where to store the results
+ * @return an error code
+ */
+static error_code run_fixed(const char *keys, size_t nb_keys, size_t rounds, htable_result_t *result);
+
+/**
+ * @brief add a new key to a chained table
+ * @param table the table
+ * @param key the key
+ * @param value its value
+ * @param lookup whether the key is looked for first, as the table did, to replace its value
+ *        (the keys are all new here)
+ * @return an error code
+ */
+static error_code chained_add(chained_table_t *table, const char *key, const char *value, int lookup);
+
+/**
+ * @brief value of a key in a chained table
+ * @param table the table
+ * @param key the key
+ * @return the value, in the table, NULL if the key is absent
+ */
+static const char *chained_get(const chained_table_t *table, const char *key);
+
+/**
+ * @brief free the entries of a chained table and its heads
+ * @param table the table
+ */
+static void chained_free(chained_table_t *table);
+
+/**
+ * @brief one cat, substr and find of the benchmark values
+ * @param client the client
+ * @param on_servers whether the servers compute them, or the client
+ * @param latencies where to store the latency of the three operations
+ * @return the number of failed operations
+ */
+static size_t run_ops(client_t client, int on_servers, double latencies[3]);
+
+/**
+ * @brief send operations alternating puts and gets, keeping up to depth of them in flight
+ * @param client the client
+ * @param operations number of operations
+ * @param depth maximum number of requests in flight
+ * @param failures where to count the failed operations
+ * @return the time it took in seconds
+ */
+static double run_pipeline(client_t *client, size_t operations, size_t depth, size_t *failures);
+
+/**
+ * @brief number of file descriptors opened by the process
+ * @return the number of entries of /proc/self/fd, -1 if unknown
+ */
+static long open_fds(void);
+
+/**
+ * @brief compare two latencies for qsort
+ */
+static int cmp_double(const void *a, const void *b);
+
+// =====================================================================
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "ring") == 0) {
+        size_t nb_servers = DEFAULT_SERVERS;
+        size_t nodes_per_server = DEFAULT_NODES_PER_SERVER;
+        size_t lookups = DEFAULT_LOOKUPS;
+
+        if (argc != 2 && (argc != 5 || sscanf(argv[2], "%zu", &nb_servers) != 1
+                          || sscanf(argv[3], "%zu", &nodes_per_server) != 1
+                          || sscanf(argv[4], "%zu", &lookups) != 1)) {
+            fprintf(stderr, "Usage: %s ring [<servers> <nodes per server> <lookups>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        return bench_ring(nb_servers, nodes_per_server, lookups) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "htable") == 0) {
+        size_t nb_sizes = argc > 2 ? (size_t) argc - 2 : 3;
+        size_t sizes[nb_sizes];
+        sizes[0] = 1000;
+        if (argc == 2) {
+            sizes[1] = 1000000;
+            sizes[2] = 10000000;
+        }
+
+        for (size_t i = 0; argc > 2 && i < nb_sizes; ++i) {
+            if (sscanf(argv[i + 2], "%zu", &sizes[i]) != 1 || sizes[i] == 0) {
+                fprintf(stderr, "Usage: %s htable [<keys>...]\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        return bench_htable(sizes, nb_sizes) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "get") == 0) {
+        return bench_get(argc - 1, argv + 1) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "put") == 0) {
+        return bench_put(argc - 1, argv + 1) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "mget") == 0) {
+        return bench_mget(argc - 1, argv + 1) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "pipeline") == 0) {
+        return bench_pipeline(argc - 1, argv + 1) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "ops") == 0) {
+        return bench_ops(argc - 1, argv + 1) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "large") == 0) {
+        return bench_large(argc - 1, argv + 1) == ERR_NONE ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "Usage: %s ring [<servers> <nodes per server> <lookups>]\n"
+            "       %s get [-n N -r R -w W] [--] <operations>\n"
+            "       %s put [-n N -w W] [--] <operations> [<value size>]\n"
+            "       %s mget [-n N -r R] [--] <keys>\n"
+            "       %s pipeline [--] <operations> <depth>\n"
+            "       %s ops [-n N -r R -w W] [--] <operations>\n"
+            "       %s large [-n N -r R -w W] [--] <value size> [<operations>]\n"
+            "       %s htable [<keys>...]\n", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return EXIT_FAILURE;
+}
+
+// =====================================================================
+
+static error_code bench_ring(size_t nb_servers, size_t nodes_per_server, size_t lookups)
+{
+    M_REQUIRE(nb_servers >= BENCH_N && nb_servers < UINT16_MAX && nodes_per_server > 0, ERR_BAD_PARAMETER,
+              "%zu servers of %zu nodes", nb_servers, nodes_per_server);
+
+    ring_t *ring = ring_alloc();
+    M_EXIT_IF_NULL(ring, sizeof(ring_t), "pps-bench");
+
+    //same nodes as servers.txt lines "127.0.0.1 <port> <nodes per server>"
+    error_code err = ERR_NONE;
+    for (size_t s = 0; err == ERR_NONE && s < nb_servers; ++s) {
+        for (size_t id = 1; err == ERR_NONE && id <= nodes_per_server; ++id) {
+            node_t node;
+            char *ip = strdup(PPS_DEFAULT_IP);
+            err = ip == NULL ? ERR_NOMEM : node_init(&node, ip, (uint16_t) (PPS_DEFAULT_PORT + s), id);
+            if (err == ERR_NONE) {
+                err = node_list_add(ring, node);
+            } else {
+                free(ip);
+            }
+        }
+    }
+
+    double start = now();
+    if (err == ERR_NONE) {
+        node_list_sort(ring, node_cmp_sha);
+        err = ring_build_index(ring);
+    }
+
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Could not build the ring\n");
+        ring_free(ring);
+        return err;
+    }
+
+    printf("ring of %zu nodes on %zu servers, index built in %.3f ms\n",
+           ring->size, nb_servers, (now() - start) * 1e3);
+
+    char keys[BENCH_KEYS][MAX_KEY_SIZE];
+    for (size_t k = 0; k < BENCH_KEYS; ++k) {
+        snprintf(keys[k], MAX_KEY_SIZE, "key-%zu", (size_t) rand());
+    }
+
+    //allocation-free lookup
+    const node_t *nodes[BENCH_N];
+    size_t found = 0;
+    start = now();
+    for (size_t i = 0; i < lookups; ++i) {
+        found += ring_get_preference_list(ring, keys[i % BENCH_KEYS], strlen(keys[i % BENCH_KEYS]), BENCH_N, nodes);
+    }
+    double elapsed = now() - start;
+    printf("ring_get_preference_list: %.0f ns/lookup (N = %d, %zu nodes found)\n",
+           elapsed * 1e9 / (double) lookups, BENCH_N, found);
+
+    //allocating wrapper
+    start = now();
+    for (size_t i = 0; i < lookups; ++i) {
+        node_list_t *list = ring_get_nodes_for_key(ring, BENCH_N, keys[i % BENCH_KEYS]);
+        if (list != NULL) {
+            free(list->nodes);
+            free(list);
+        }
+    }
+    elapsed = now() - start;
+    printf("ring_get_nodes_for_key:   %.0f ns/lookup\n", elapsed * 1e9 / (double) lookups);
+
+    ring_free(ring);
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code bench_htable(const size_t *sizes, size_t nb_sizes)
+{
+    for (size_t i = 0; i < nb_sizes; ++i) {
+        size_t nb_keys = sizes[i];
+        size_t rounds = nb_keys < HTABLE_BENCH_OPS ? HTABLE_BENCH_OPS / nb_keys : 1;
+
+        //the keys put, then as many absent ones, written once out of the timings
+        char *keys = malloc(2 * nb_keys * MAX_KEY_SIZE);
+        M_EXIT_IF_NULL(keys, 2 * nb_keys * MAX_KEY_SIZE, "pps-bench");
+        for (size_t k = 0; k < 2 * nb_keys; ++k) {
+            snprintf(keys + k * MAX_KEY_SIZE, MAX_KEY_SIZE, "%s-%zu", k < nb_keys ? "key" : "miss",
+                     k % nb_keys);
+        }
+
+        //one table at a time, the others are freed
+        htable_result_t results[3];
+        error_code err = run_robin_hood(keys, nb_keys, rounds, &results[0]);
+        if (err == ERR_NONE) err = run_fixed(keys, nb_keys, rounds, &results[1]);
+        if (err == ERR_NONE) err = run_chained(keys, nb_keys, rounds, &results[2]);
+        free(keys);
+
+        if (err != ERR_NONE) {
+            fprintf(stderr, "Could not fill the tables with %zu keys\n", nb_keys);
+            return err;
+        }
+
+        printf("%zu keys (%zu rounds)\n", nb_keys, rounds);
+        const char *names[3] = {"robin hood", "chained", "chained/key"};
+        for (size_t t = 0; t < 3; ++t) {
+            printf("  %-11s put %6.0f ns  get %6.0f ns  miss %6.0f ns  %4.1f allocations and %4.0f bytes per key\n",
+                   names[t], results[t].put_ns, results[t].get_ns, results[t].miss_ns, results[t].allocations,
+                   results[t].bytes);
+        }
+    }
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code bench_get(int argc, char *argv[])
+{
+    client_t client;
+    client_init_args_t client_args = {&client, SIZE_MAX, TOTAL_SERVERS | GET_NEEDED | PUT_NEEDED, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE) {
+        fprintf(stderr, "Usage: pps-bench get [-n N -r R -w W] [--] <operations> [<value size>]\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    if (client_args.argc < 1 || client_args.argc > 2) {
+        fprintf(stderr, "Usage: pps-bench get [-n N -r R -w W] [--] <operations> [<value size>]\n");
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    size_t operations = 0;
+    if (sscanf((*client_args.argv)[0], "%zu", &operations) != 1 || operations == 0) {
+        fprintf(stderr, "Invalid number of operations %s\n", (*client_args.argv)[0]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    //the key itself by default
+    size_t value_size = 0;
+    if (client_args.argc > 1 && (sscanf((*client_args.argv)[1], "%zu", &value_size) != 1
+                                 || value_size > MAX_MSG_ELEM_SIZE)) {
+        fprintf(stderr, "Invalid value size %s\n", (*client_args.argv)[1]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    double *latencies = calloc(2 * operations, sizeof(double));
+    char *big = calloc(value_size + 1, 1);
+    if (latencies == NULL || big == NULL) {
+        free(latencies);
+        free(big);
+        client_end(&client);
+        M_EXIT_ERR_NOMSG(ERR_NOMEM, "pps-bench");
+    }
+
+    long fds_before = open_fds();
+
+    //one put then one get of the same key, each one timed
+    size_t failures = 0;
+    size_t received = 0;
+    double start = now();
+    for (size_t i = 0; i < operations; ++i) {
+        char key[MAX_KEY_SIZE];
+        snprintf(key, MAX_KEY_SIZE, "bench-%zu", i % BENCH_KEYS);
+        if (value_size > 0) memset(big, 'a' + (int) (i % 26), value_size);
+
+        double op_start = now();
+        failures += network_put(client, key, value_size > 0 ? big : key) != ERR_NONE;
+        latencies[2 * i] = now() - op_start;
+
+        pps_value_t value = NULL;
+        size_t before = client.transport->bytes_received;
+        op_start = now();
+        failures += network_get(client, key, &value) != ERR_NONE;
+        latencies[2 * i + 1] = now() - op_start;
+        received += client.transport->bytes_received - before;
+        free_const_ptr(value);
+    }
+    double elapsed = now() - start;
+
+    long fds_after = open_fds();
+
+    qsort(latencies, 2 * operations, sizeof(double), cmp_double);
+    printf("%zu operations in %.3f s (%zu failed): mean %.1f us, p50 %.1f us, p99 %.1f us\n",
+           2 * operations, elapsed, failures, elapsed * 1e6 / (double) (2 * operations),
+           latencies[operations] * 1e6, latencies[(2 * operations * 99) / 100] * 1e6);
+    printf("received by the gets: %.0f bytes per get\n", (double) received / (double) operations);
+    printf("open file descriptors: %ld before, %ld after\n", fds_before, fds_after);
+
+    free(latencies);
+    free(big);
+    client_end(&client);
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code bench_mget(int argc, char *argv[])
+{
+    client_t client;
+    client_init_args_t client_args = {&client, 1, TOTAL_SERVERS | GET_NEEDED, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE) {
+        fprintf(stderr, "Usage: pps-bench mget [-n N -r R] [--] <keys>\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    size_t nb_keys = 0;
+    if (sscanf((*client_args.argv)[0], "%zu", &nb_keys) != 1 || nb_keys == 0) {
+        fprintf(stderr, "Invalid number of keys %s\n", (*client_args.argv)[0]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    char (*keys)[MAX_KEY_SIZE] = calloc(nb_keys, MAX_KEY_SIZE);
+    pps_key_t *key_list = calloc(nb_keys, sizeof(pps_key_t));
+    pps_value_t *values = calloc(nb_keys, sizeof(pps_value_t));
+    if (keys == NULL || key_list == NULL || values == NULL) {
+        free(keys);
+        free(key_list);
+        free(values);
+        client_end(&client);
+        M_EXIT_ERR_NOMSG(ERR_NOMEM, "pps-bench");
+    }
+
+    //the keys are written on all their servers first
+    size_t W = client.parsedOpt->W;
+    client.parsedOpt->W = 1;
+    for (size_t k = 0; k < nb_keys; ++k) {
+        snprintf(keys[k], MAX_KEY_SIZE, "mget-%zu", k);
+        key_list[k] = keys[k];
+        network_put(client, keys[k], keys[k]);
+    }
+    client.parsedOpt->W = W;
+
+    size_t found = 0;
+    double start = now();
+    for (size_t k = 0; k < nb_keys; ++k) {
+        pps_value_t value = NULL;
+        found += network_get(client, keys[k], &value) == ERR_NONE;
+        free_const_ptr(value);
+    }
+    double elapsed = now() - start;
+    printf("%zu network_get: %.3f s, %.0f keys/s (%zu found)\n",
+           nb_keys, elapsed, (double) nb_keys / elapsed, found);
+
+    start = now();
+    network_mget(client, key_list, nb_keys, values);
+    elapsed = now() - start;
+
+    found = 0;
+    for (size_t k = 0; k < nb_keys; ++k) {
+        found += values[k] != NULL && strcmp(values[k], keys[k]) == 0;
+        free_const_ptr(values[k]);
+    }
+    printf("1 network_mget:   %.3f s, %.0f keys/s (%zu found)\n",
+           elapsed, (double) nb_keys / elapsed, found);
+
+    free(keys);
+    free(key_list);
+    free(values);
+    client_end(&client);
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code bench_put(int argc, char *argv[])
+{
+    client_t client;
+    client_init_args_t client_args = {&client, SIZE_MAX, TOTAL_SERVERS | PUT_NEEDED, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE) {
+        fprintf(stderr, "Usage: pps-bench put [-n N -w W] [--] <operations> [<value size>]\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    if (client_args.argc < 1 || client_args.argc > 2) {
+        fprintf(stderr, "Usage: pps-bench put [-n N -w W] [--] <operations> [<value size>]\n");
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    size_t operations = 0;
+    if (sscanf((*client_args.argv)[0], "%zu", &operations) != 1 || operations == 0) {
+        fprintf(stderr, "Invalid number of operations %s\n", (*client_args.argv)[0]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    size_t value_size = 1024;
+    if (client_args.argc > 1 && (sscanf((*client_args.argv)[1], "%zu", &value_size) != 1
+                                 || value_size > MAX_MSG_ELEM_SIZE)) {
+        fprintf(stderr, "Invalid value size %s\n", (*client_args.argv)[1]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    double *latencies = calloc(operations, sizeof(double));
+    char *value = calloc(value_size + 1, 1);
+    if (latencies == NULL || value == NULL) {
+        free(latencies);
+        free(value);
+        client_end(&client);
+        M_EXIT_ERR_NOMSG(ERR_NOMEM, "pps-bench");
+    }
+    memset(value, 'v', value_size);
+
+    //only the puts are counted, not the setup of the client
+    size_t allocations = nb_allocations;
+    size_t allocated = bytes_allocated;
+    size_t copied = bytes_copied;
+    size_t sent = client.transport->bytes_sent;
+
+    size_t failures = 0;
+    double start = now();
+    for (size_t i = 0; i < operations; ++i) {
+        char key[MAX_KEY_SIZE];
+        snprintf(key, MAX_KEY_SIZE, "bench-%zu", i % BENCH_KEYS);
+
+        double op_start = now();
+        failures += network_put(client, key, value) != ERR_NONE;
+        latencies[i] = now() - op_start;
+    }
+    double elapsed = now() - start;
+
+    double ops = (double) operations;
+    qsort(latencies, operations, sizeof(double), cmp_double);
+    printf("%zu puts of %zu bytes in %.3f s (%zu failed): mean %.1f us, p50 %.1f us, p99 %.1f us\n",
+           operations, value_size, elapsed, failures, elapsed * 1e6 / ops, latencies[operations / 2] * 1e6,
+           latencies[(operations * 99) / 100] * 1e6);
+    printf("per put: %.1f allocations (%.0f bytes), %.0f bytes copied, %.0f bytes sent\n",
+           (double) (nb_allocations - allocations) / ops, (double) (bytes_allocated - allocated) / ops,
+           (double) (bytes_copied - copied) / ops, (double) (client.transport->bytes_sent - sent) / ops);
+
+    free(latencies);
+    free(value);
+    client_end(&client);
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code bench_pipeline(int argc, char *argv[])
+{
+    client_t client;
+    client_init_args_t client_args = {&client, 2, TOTAL_SERVERS, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE) {
+        fprintf(stderr, "Usage: pps-bench pipeline [--] <operations> <depth>\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    size_t operations = 0;
+    size_t depth = 0;
+    if (sscanf((*client_args.argv)[0], "%zu", &operations) != 1 || operations == 0
+        || sscanf((*client_args.argv)[1], "%zu", &depth) != 1 || depth == 0 || depth > TRANSPORT_MAX_INFLIGHT) {
+        fprintf(stderr, "Invalid number of operations or depth (at most %d)\n", TRANSPORT_MAX_INFLIGHT);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    size_t depths[2] = {1, depth};
+    for (size_t d = 0; d < 2; ++d) {
+        size_t failures = 0;
+        double elapsed = run_pipeline(&client, operations, depths[d], &failures);
+
+        printf("%4zu in flight: %zu operations in %.3f s (%zu failed), %.0f operations/s\n",
+               depths[d], operations, elapsed, failures, (double) operations / elapsed);
+    }
+
+    client_end(&client);
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code bench_ops(int argc, char *argv[])
+{
+    client_t client;
+    client_init_args_t client_args = {&client, 1, TOTAL_SERVERS | GET_NEEDED | PUT_NEEDED, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE) {
+        fprintf(stderr, "Usage: pps-bench ops [-n N -r R -w W] [--] <operations>\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    size_t operations = 0;
+    if (sscanf((*client_args.argv)[0], "%zu", &operations) != 1 || operations == 0) {
+        fprintf(stderr, "Invalid number of operations %s\n", (*client_args.argv)[0]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    double *latencies = calloc(3 * operations, sizeof(double));
+    char *value = calloc(BENCH_VALUE_SIZE + 1, sizeof(char));
+    if (latencies == NULL || value == NULL) {
+        free(latencies);
+        free(value);
+        client_end(&client);
+        M_EXIT_ERR_NOMSG(ERR_NOMEM, "pps-bench");
+    }
+
+    //the second value is the end of the first one, so that find has to scan it all
+    for (size_t i = 0; i < BENCH_VALUE_SIZE; ++i) {
+        value[i] = (char) ('a' + i % 26);
+    }
+    if (network_put(client, "ops-a", value) != ERR_NONE
+        || network_put(client, "ops-b", value + BENCH_VALUE_SIZE - 64) != ERR_NONE) {
+        fprintf(stderr, "Could not write the values of the benchmark\n");
+        free(latencies);
+        free(value);
+        client_end(&client);
+        return ERR_NETWORK;
+    }
+
+    const char *names[2] = {"client read-modify-write", "server-side"};
+    for (int on_servers = 0; on_servers < 2; ++on_servers) {
+        size_t sent = client.transport->bytes_sent;
+        size_t received = client.transport->bytes_received;
+
+        size_t failures = 0;
+        double start = now();
+        for (size_t i = 0; i < operations; ++i) {
+            failures += run_ops(client, on_servers, latencies + 3 * i);
+        }
+        double elapsed = now() - start;
+
+        sent = client.transport->bytes_sent - sent;
+        received = client.transport->bytes_received - received;
+
+        qsort(latencies, 3 * operations, sizeof(double), cmp_double);
+        printf("%s: %zu operations in %.3f s (%zu failed): mean %.1f us, p50 %.1f us, p99 %.1f us\n",
+               names[on_servers], 3 * operations, elapsed, failures, elapsed * 1e6 / (double) (3 * operations),
+               latencies[(3 * operations) / 2] * 1e6, latencies[(3 * operations * 99) / 100] * 1e6);
+        printf("    %.0f bytes sent, %.0f bytes received per operation\n",
+               (double) sent / (double) (3 * operations), (double) received / (double) (3 * operations));
+    }
+
+    free(latencies);
+    free(value);
+    client_end(&client);
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code bench_large(int argc, char *argv[])
+{
+    client_t client;
+    client_init_args_t client_args = {&client, SIZE_MAX, TOTAL_SERVERS | GET_NEEDED | PUT_NEEDED, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE) {
+        fprintf(stderr, "Usage: pps-bench large [-n N -r R -w W] [--] <value size> [<operations>]\n");
+        return ERR_BAD_PARAMETER;
+    }
+
+    if (client_args.argc < 1 || client_args.argc > 2) {
+        fprintf(stderr, "Usage: pps-bench large [-n N -r R -w W] [--] <value size> [<operations>]\n");
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    //in bytes, or in MiB with a 'm'
+    size_t value_size = 0;
+    char unit = '\0';
+    int fields = sscanf((*client_args.argv)[0], "%zu%c", &value_size, &unit);
+    if (fields < 1 || (fields == 2 && unit != 'm' && unit != 'M')) {
+        fprintf(stderr, "Invalid value size %s\n", (*client_args.argv)[0]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+    if (fields == 2) value_size <<= 20;
+
+    size_t operations = BENCH_LARGE_RUNS;
+    if (client_args.argc > 1 && (sscanf((*client_args.argv)[1], "%zu", &operations) != 1 || operations == 0)) {
+        fprintf(stderr, "Invalid number of operations %s\n", (*client_args.argv)[1]);
+        client_end(&client);
+        return ERR_BAD_PARAMETER;
+    }
+
+    double put_time = 0;
+    double get_time = 0;
+    size_t failures = 0;
+    size_t sent = client.transport->bytes_sent;
+    size_t received = client.transport->bytes_received;
+
+    //a new value every time, checked byte by byte when read
+    for (size_t i = 0; i < operations; ++i) {
+        large_value_t put = {value_size, 0, (unsigned) i, 1};
+        double start = now();
+        error_code err = network_put_stream(client, "bench-large", large_read, &put, NULL);
+        put_time += now() - start;
+
+        large_value_t get = {value_size, 0, (unsigned) i, 1};
+        start = now();
+        if (err == ERR_NONE) err = network_get_stream(client, "bench-large", large_write, &get, NULL);
+        get_time += now() - start;
+
+        failures += err != ERR_NONE || !get.valid || get.pos != value_size;
+    }
+
+    sent = client.transport->bytes_sent - sent;
+    received = client.transport->bytes_received - received;
+
+    double pieces_put = 0;
+    double pieces_get = 0;
+    size_t pieces_failures = 0;
+    for (size_t i = 0; i < operations; ++i) {
+        pieces_failures += run_pieces(client, value_size, &pieces_put, &pieces_get);
+    }
+
+    double mib = (double) (value_size * operations) / (1 << 20);
+    printf("%zu puts and gets of %zu bytes (%zu failed), chunks of %d bytes, %d in flight\n",
+           operations, value_size, failures, NETWORK_CHUNK_SIZE, NETWORK_CHUNK_WINDOW);
+    printf("    put: %.1f MiB/s, %.1f ms per value\n", mib / put_time, put_time * 1e3 / (double) operations);
+    printf("    get: %.1f MiB/s, %.1f ms per value\n", mib / get_time, get_time * 1e3 / (double) operations);
+    if (value_size > 0) {
+        printf("    %.2f bytes sent, %.2f bytes received per byte of value\n",
+               (double) sent / (double) (value_size * operations),
+               (double) received / (double) (value_size * operations));
+    }
+    printf("pieces of %d bytes one after the other (%zu failed)\n", MAX_MSG_ELEM_SIZE, pieces_failures);
+    printf("    put: %.1f MiB/s, get: %.1f MiB/s\n", mib / pieces_put, mib / pieces_get);
+
+    client_end(&client);
+    return failures == 0 ? ERR_NONE : ERR_NETWORK;
+}
+
+// =====================================================================
+
+static size_t run_pieces(client_t client, size_t value_size, double *put_time, double *get_time)
+{
+    char piece[MAX_MSG_ELEM_SIZE + 1];
+    memset(piece, 'p', MAX_MSG_ELEM_SIZE);
+    size_t nb_pieces = (value_size + MAX_MSG_ELEM_SIZE - 1) / MAX_MSG_ELEM_SIZE;
+    size_t failures = 0;
+
+    double start = now();
+    for (size_t p = 0; p < nb_pieces; ++p) {
+        char key[MAX_KEY_SIZE];
+        snprintf(key, MAX_KEY_SIZE, "bench-piece-%zu", p);
+        size_t size = p + 1 < nb_pieces ? MAX_MSG_ELEM_SIZE : value_size - p * MAX_MSG_ELEM_SIZE;
+        piece[size] = '\0';
+        failures += network_put(client, key, piece) != ERR_NONE;
+        piece[size] = 'p';
+    }
+    *put_time += now() - start;
+
+    start = now();
+    for (size_t p = 0; p < nb_pieces; ++p) {
+        char key[MAX_KEY_SIZE];
+        snprintf(key, MAX_KEY_SIZE, "bench-piece-%zu", p);
+        pps_value_t value = NULL;
+        failures += network_get(client, key, &value) != ERR_NONE;
+        free_const_ptr(value);
+    }
+    *get_time += now() - start;
+
+    return failures;
+}
+
+// =====================================================================
+
+static error_code large_read(void *arg, char *buffer, size_t size, size_t *read)
+{
+    large_value_t *value = arg;
+
+    size_t count = value->size - value->pos < size ? value->size - value->pos : size;
+    for (size_t i = 0; i < count; ++i) {
+        buffer[i] = (char) ((value->pos + i) * 31 + value->seed);
+    }
+
+    value->pos += count;
+    *read = count;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code large_write(void *arg, const char *data, size_t size)
+{
+    large_value_t *value = arg;
+
+    for (size_t i = 0; i < size && value->valid; ++i) {
+        value->valid = data[i] == (char) ((value->pos + i) * 31 + value->seed);
+    }
+
+    value->pos += size;
+    return value->valid ? ERR_NONE : ERR_NETWORK;
+}
+
+// =====================================================================
+
+static error_code run_robin_hood(const char *keys, size_t nb_keys, size_t rounds, htable_result_t *result)
+{
+    memset(result, 0, sizeof(htable_result_t));
+    size_t value_len = strlen(HTABLE_BENCH_VALUE);
+    double put_time = 0, get_time = 0, miss_time = 0;
+    size_t found = 0;
+
+    for (size_t r = 0; r < rounds; ++r) {
+        size_t allocations = nb_allocations, bytes = bytes_allocated;
+        Htable_t table = construct_Htable(HTABLE_SIZE);
+        M_EXIT_IF_NULL(table, sizeof(Htable), "pps-bench");
+
+        double start = now();
+        for (size_t k = 0; k < nb_keys; ++k) {
+            const char *key = keys + k * MAX_KEY_SIZE;
+            if (add_Htable_versioned_value(table, key, strlen(key), HTABLE_BENCH_VALUE, value_len, k) != ERR_NONE) {
+                delete_Htable_and_content(&table);
+                return ERR_NOMEM;
+            }
+        }
+        put_time += now() - start;
+        result->allocations = (double) (nb_allocations - allocations) / (double) nb_keys;
+        result->bytes = (double) (bytes_allocated - bytes) / (double) nb_keys;
+
+        //the same scattered order for the keys present and absent
+        for (size_t miss = 0; miss < 2; ++miss) {
+            start = now();
+            for (size_t i = 0; i < nb_keys; ++i) {
+                size_t k = miss * nb_keys + (size_t) ((i * (uint64_t) HTABLE_BENCH_STRIDE) % nb_keys);
+                const char *key = keys + k * MAX_KEY_SIZE;
+                Htable_view_t view;
+                if (get_Htable_view(table, key, strlen(key), &view) == ERR_NONE) {
+                    found += view.length;
+                    release_Htable_view(table, &view);
+                }
+            }
+            *(miss ? &miss_time : &get_time) += now() - start;
+        }
+
+        delete_Htable_and_content(&table);
+    }
+
+    if (found != rounds * nb_keys * strlen(HTABLE_BENCH_VALUE)) {
+        fprintf(stderr, "The hash-table lost keys\n");
+    }
+
+    double operations = (double) (rounds * nb_keys);
+    result->put_ns = put_time * 1e9 / operations;
+    result->get_ns = get_time * 1e9 / operations;
+    result->miss_ns = miss_time * 1e9 / operations;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code run_chained(const char *keys, size_t nb_keys, size_t rounds, htable_result_t *result)
+{
+    memset(result, 0, sizeof(htable_result_t));
+    double put_time = 0, get_time = 0, miss_time = 0;
+    size_t found = 0;
+
+    for (size_t r = 0; r < rounds; ++r) {
+        //the heads count as allocations of the table, as the first slots of the other one
+        size_t allocations = nb_allocations, bytes = bytes_allocated;
+        chained_table_t table = {calloc(nb_keys, sizeof(chained_entry_t *)), nb_keys};
+        M_EXIT_IF_NULL(table.heads, nb_keys * sizeof(chained_entry_t *), "pps-bench");
+
+        double start = now();
+        for (size_t k = 0; k < nb_keys; ++k) {
+            if (chained_add(&table, keys + k * MAX_KEY_SIZE, HTABLE_BENCH_VALUE, 1) != ERR_NONE) {
+                chained_free(&table);
+                return ERR_NOMEM;
+            }
+        }
+        put_time += now() - start;
+        result->allocations = (double) (nb_allocations - allocations) / (double) nb_keys;
+        result->bytes = (double) (bytes_allocated - bytes) / (double) nb_keys;
+
+        for (size_t miss = 0; miss < 2; ++miss) {
+            start = now();
+            for (size_t i = 0; i < nb_keys; ++i) {
+                size_t k = miss * nb_keys + (size_t) ((i * (uint64_t) HTABLE_BENCH_STRIDE) % nb_keys);
+                const char *value = chained_get(&table, keys + k * MAX_KEY_SIZE);
+                if (value != NULL) found += strlen(value);
+            }
+            *(miss ? &miss_time : &get_time) += now() - start;
+        }
+
+        chained_free(&table);
+    }
+
+    if (found != rounds * nb_keys * strlen(HTABLE_BENCH_VALUE)) {
+        fprintf(stderr, "The chained table lost keys\n");
+    }
+
+    double operations = (double) (rounds * nb_keys);
+    result->put_ns = put_time * 1e9 / operations;
+    result->get_ns = get_time * 1e9 / operations;
+    result->miss_ns = miss_time * 1e9 / operations;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code run_fixed(const char *keys, size_t nb_keys, size_t rounds, htable_result_t *result)
+{
+    memset(result, 0, sizeof(htable_result_t));
+    size_t step = nb_keys > HTABLE_BENCH_SAMPLE ? nb_keys / HTABLE_BENCH_SAMPLE : 1;
+    size_t sampled = (nb_keys + step - 1) / step;
+    double put_time = 0, get_time = 0, miss_time = 0;
+    size_t found = 0;
+
+    for (size_t r = 0; r < rounds; ++r) {
+        size_t allocations = nb_allocations, bytes = bytes_allocated;
+        chained_table_t table = {calloc(HTABLE_SIZE, sizeof(chained_entry_t *)), HTABLE_SIZE};
+        M_EXIT_IF_NULL(table.heads, HTABLE_SIZE * sizeof(chained_entry_t *), "pps-bench");
+
+        //the puts not timed skip the lookup, which would not find their new keys either
+        double start = now();
+        for (size_t k = 0; k < nb_keys; ++k) {
+            int timed = k % step == 0;
+            double put_start = step > 1 && timed ? now() : 0;
+            if (chained_add(&table, keys + k * MAX_KEY_SIZE, HTABLE_BENCH_VALUE, timed) != ERR_NONE) {
+                chained_free(&table);
+                return ERR_NOMEM;
+            }
+            if (step > 1 && timed) put_time += now() - put_start;
+        }
+        if (step == 1) put_time += now() - start;
+        result->allocations = (double) (nb_allocations - allocations) / (double) nb_keys;
+        result->bytes = (double) (bytes_allocated - bytes) / (double) nb_keys;
+
+        for (size_t miss = 0; miss < 2; ++miss) {
+            start = now();
+            for (size_t i = 0; i < nb_keys; i += step) {
+                size_t k = miss * nb_keys + (size_t) ((i * (uint64_t) HTABLE_BENCH_STRIDE) % nb_keys);
+                const char *value = chained_get(&table, keys + k * MAX_KEY_SIZE);
+                if (value != NULL) found += strlen(value);
+            }
+            *(miss ? &miss_time : &get_time) += now() - start;
+        }
+
+        chained_free(&table);
+    }
+
+    if (found != rounds * sampled * strlen(HTABLE_BENCH_VALUE)) {
+        fprintf(stderr, "The chained table lost keys\n");
+    }
+
+    double operations = (double) (rounds * sampled);
+    result->put_ns = put_time * 1e9 / operations;
+    result->get_ns = get_time * 1e9 / operations;
+    result->miss_ns = miss_time * 1e9 / operations;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code chained_add(chained_table_t *table, const char *key, const char *value, int lookup)
+{
+    for (chained_entry_t *e = lookup ? table->heads[hash_function(key, table->size)] : NULL; e != NULL; e = e->next) {
+        if (strcmp(e->key, key) == 0) {
+            char *value_copy = strdup(value);
+            if (value_copy == NULL) return ERR_NOMEM;
+            free(e->value);
+            e->value = value_copy;
+            return ERR_NONE;
+        }
+    }
+
+    chained_entry_t *entry = malloc(sizeof(chained_entry_t));
+    char *key_copy = strdup(key);
+    char *value_copy = strdup(value);
+    if (entry == NULL || key_copy == NULL || value_copy == NULL) {
+        free(entry);
+        free(key_copy);
+        free(value_copy);
+        return ERR_NOMEM;
+    }
+
+    size_t head = hash_function(key, table->size);
+    entry->key = key_copy;
+    entry->value = value_copy;
+    entry->next = table->heads[head];
+    table->heads[head] = entry;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static const char *chained_get(const chained_table_t *table, const char *key)
+{
+    for (const chained_entry_t *e = table->heads[hash_function(key, table->size)]; e != NULL; e = e->next) {
+        if (strcmp(e->key, key) == 0) return e->value;
+    }
+    return NULL;
+}
+
+// =====================================================================
+
+static void chained_free(chained_table_t *table)
+{
+    for (size_t h = 0; h < table->size; ++h) {
+        while (table->heads[h] != NULL) {
+            chained_entry_t *next = table->heads[h]->next;
+            free(table->heads[h]->key);
+            free(table->heads[h]->value);
+            free(table->heads[h]);
+            table->heads[h] = next;
+        }
+    }
+    free(table->heads);
+    table->heads = NULL;
+}
+
+// =====================================================================
+
+static size_t run_ops(client_t client, int on_servers, double latencies[3])
+{
+    pps_key_t keys[2] = {"ops-a", "ops-b"};
+    size_t failures = 0;
+
+    //cat ops-a ops-b ops-cat
+    double start = now();
+    if (on_servers) {
+        failures += network_concat(client, keys, 2, "ops-cat") != ERR_NONE;
+    } else {
+        pps_value_t values[2] = {NULL, NULL};
+        error_code err = network_mget(client, keys, 2, values);
+        char *value = err == ERR_NONE ? calloc(strlen(values[0]) + strlen(values[1]) + 1, sizeof(char)) : NULL;
+        if (value != NULL) {
+            strcat(strcpy(value, values[0]), values[1]);
+            err = network_put(client, "ops-cat", value);
+        }
+        failures += value == NULL || err != ERR_NONE;
+        free(value);
+        free_const_ptr(values[0]);
+        free_const_ptr(values[1]);
+    }
+    latencies[0] = now() - start;
+
+    //substr ops-a 0 <half> ops-substr
+    start = now();
+    if (on_servers) {
+        failures += network_substr(client, keys[0], 0, BENCH_VALUE_SIZE / 2, "ops-substr") != ERR_NONE;
+    } else {
+        pps_value_t value = NULL;
+        error_code err = network_get(client, keys[0], &value);
+        if (err == ERR_NONE) {
+            ((char *) value)[BENCH_VALUE_SIZE / 2] = '\0';
+            err = network_put(client, "ops-substr", value);
+        }
+        failures += err != ERR_NONE;
+        free_const_ptr(value);
+    }
+    latencies[1] = now() - start;
+
+    //find ops-a ops-b
+    start = now();
+    if (on_servers) {
+        long index = -1;
+        failures += network_find(client, keys[0], keys[1], &index) != ERR_NONE;
+    } else {
+        pps_value_t values[2] = {NULL, NULL};
+        error_code err = network_mget(client, keys, 2, values);
+        failures += err != ERR_NONE || strstr(values[0], values[1]) == NULL;
+        free_const_ptr(values[0]);
+        free_const_ptr(values[1]);
+    }
+    latencies[2] = now() - start;
+
+    return failures;
+}
+
+// =====================================================================
+
+static double run_pipeline(client_t *client, size_t operations, size_t depth, size_t *failures)
+{
+    uint32_t ids[TRANSPORT_MAX_INFLIGHT];
+    size_t inflight = 0;
+    size_t sent = 0;
+    size_t done = 0;
+
+    double start = now();
+    while (done < operations) {
+
+        //fill the pipeline: even operations are puts, odd ones gets of the same key
+        while (inflight < depth && sent < operations) {
+            //<version><key>\0<key> for a put, <key> for a get
+            char payload[PROTOCOL_STAMP_SIZE + 2 * MAX_KEY_SIZE];
+            char *key = payload + PROTOCOL_STAMP_SIZE;
+            int key_size = snprintf(key, MAX_KEY_SIZE, "bench-%zu", (sent / 2) % BENCH_KEYS);
+
+            const node_t *node = NULL;
+            ring_get_preference_list(client->node, key, strlen(key), 1, &node);
+
+            protocol_opcode_t opcode = PROTOCOL_GET;
+            const char *message = key;
+            size_t size = (size_t) key_size;
+            if (sent % 2 == 0) {
+                opcode = PROTOCOL_PUT;
+                protocol_write_stamp(payload, hlc_now(&bench_clock));
+                memcpy(key + key_size + 1, key, (size_t) key_size);
+                message = payload;
+                size = PROTOCOL_STAMP_SIZE + 2 * (size_t) key_size + 1;
+            }
+
+            uint32_t id = 0;
+            if (node == NULL || transport_request(client->transport, &node->srv_addr, opcode, message, size, &id) != ERR_NONE) {
+                ++(*failures);
+                ++done;
+            } else {
+                ids[inflight++] = id;
+            }
+            ++sent;
+        }
+
+        if (inflight == 0) continue;
+
+        uint32_t id = 0;
+        if (transport_wait(client->transport, TRANSPORT_TIMEOUT_MS, &id) != ERR_NONE) {
+            //lost requests (or replies)
+            for (size_t i = 0; i < inflight; ++i) {
+                transport_forget(client->transport, ids[i]);
+            }
+            *failures += inflight;
+            done += inflight;
+            inflight = 0;
+            continue;
+        }
+
+        uint8_t status = transport_reply(client->transport, id)->status;
+        *failures += status != PROTOCOL_OK && status != PROTOCOL_NOT_FOUND;
+        transport_forget(client->transport, id);
+        ++done;
+
+        //the replies come in any order
+        for (size_t i = 0; i < inflight; ++i) {
+            if (ids[i] == id) {
+                ids[i] = ids[--inflight];
+                break;
+            }
+        }
+    }
+
+    return now() - start;
+}
+
+// =====================================================================
+
+static long open_fds(void)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == NULL) return -1;
+
+    //do not count ".", ".." and the descriptor of dir itself
+    long count = -3;
+    while (readdir(dir) != NULL) {
+        ++count;
+    }
+
+    closedir(dir);
+    return count;
+}
+
+// =====================================================================
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// =====================================================================
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+// =====================================================================
+
+void *__wrap_malloc(size_t size)
+{
+    ++nb_allocations;
+    bytes_allocated += size;
+    return __real_malloc(size);
+}
+
+// =====================================================================
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    ++nb_allocations;
+    bytes_allocated += nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+// =====================================================================
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    ++nb_allocations;
+    bytes_allocated += size;
+    return __real_realloc(ptr, size);
+}
+
+// =====================================================================
+
+void *__wrap_memcpy(void *dest, const void *src, size_t n)
+{
+    bytes_copied += n;
+    return __real_memcpy(dest, src, n);
+}
+
+// =====================================================================
+
+void *__wrap_memmove(void *dest, const void *src, size_t n)
+{
+    bytes_copied += n;
+    return __real_memmove(dest, src, n);
+}
+
+// =====================================================================
+
+char *__wrap_strncpy(char *dest, const char *src, size_t n)
+{
+    bytes_copied += n;
+    return __real_strncpy(dest, src, n);
+}
@@ -0,0 +1,196 @@
+/**
+ * @file pps-bulk-load.c
+ * @brief put the key/value pairs of a file (or stdin), one "<key> <value>"
+ *        line per pair, with many pairs per datagram and many datagrams in flight
+ *
+ * @date 18.10.2026
+ */
+
+#define _POSIX_C_SOURCE 200809L // for getline and clock_gettime
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "client.h"
+#include "network.h"
+#include "hashtable.h"
+#include "util.h"
+
+#include "limits.h"
+
+#define BULK_LOAD_CHUNK 16384 // pairs read before they are sent
+#define BULK_LOAD_WINDOW 16   // datagrams in flight
+
+/**
+ * @brief current time in seconds
+ * @return the time of a monotonic clock
+ */
+static double now(void);
+
+/**
+ * @brief compare two latencies for qsort
+ */
+static int cmp_double(const void *a, const void *b);
+
+/**
+ * @brief read the next pairs of a file
+ * @param in the file
+ * @param chunk where to add the pairs (to be freed with kv_list_free)
+ * @param skipped where to count the invalid lines
+ * @return 0 at the end of the file, 1 otherwise
+ */
+static int read_chunk(FILE *in, kv_list_t *chunk, size_t *skipped);
+
+// =====================================================================
+
+int main(int argc, char *argv[])
+{
+    //initialise client
+    client_t client;
+    client_init_args_t client_args = {&client, SIZE_MAX, TOTAL_SERVERS | PUT_NEEDED, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE || argv_size(*client_args.argv) > 1) {
+        printf("FAIL\n");
+        fprintf(stderr, "Usage: pps-bulk-load [-n N] [-w W] [--] [<file>]\n");
+        return EXIT_FAILURE;
+    }
+
+    client.parsedOpt->R = 1;
+
+    FILE *in = stdin;
+    if (argv_size(*client_args.argv) == 1 && (in = fopen((*client_args.argv)[0], "r")) == NULL) {
+        printf("FAIL\n");
+        fprintf(stderr, "Could not open %s\n", (*client_args.argv)[0]);
+        client_end(&client);
+        return EXIT_FAILURE;
+    }
+
+    kv_list_t chunk = {0, NULL};
+    double *latencies = NULL;
+    size_t nb_latencies = 0;
+    size_t total = 0;
+    size_t written = 0;
+    size_t skipped = 0;
+    int more = 1;
+    error_code err = ERR_NONE;
+
+    double start = now();
+    while (err == ERR_NONE && more) {
+        more = read_chunk(in, &chunk, &skipped);
+        if (chunk.size == 0) continue;
+
+        //room for the latencies of this chunk
+        double *grown = realloc(latencies, (nb_latencies + chunk.size * client.parsedOpt->N) * sizeof(double));
+        if (grown == NULL) {
+            err = ERR_NOMEM;
+            break;
+        }
+        latencies = grown;
+
+        size_t chunk_written = 0;
+        size_t chunk_latencies = 0;
+        error_code put_err = network_mput(client, &chunk, BULK_LOAD_WINDOW, &chunk_written,
+                                          latencies + nb_latencies, &chunk_latencies);
+        if (put_err != ERR_NONE && put_err != ERR_NETWORK) err = put_err;
+
+        total += chunk.size;
+        written += chunk_written;
+        nb_latencies += chunk_latencies;
+
+        for (size_t i = 0; i < chunk.size; i++) {
+            free_const_ptr(chunk.pairs[i].key);
+            free_const_ptr(chunk.pairs[i].value);
+        }
+        chunk.size = 0;
+    }
+    double elapsed = now() - start;
+
+    free(chunk.pairs);
+    if (in != stdin) fclose(in);
+
+    if (err != ERR_NONE) {
+        printf("FAIL\n");
+        fprintf(stderr, "Error while loading the pairs: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+        free(latencies);
+        client_end(&client);
+        return EXIT_FAILURE;
+    }
+
+    double p99 = 0;
+    if (nb_latencies > 0) {
+        qsort(latencies, nb_latencies, sizeof(double), cmp_double);
+        p99 = latencies[(nb_latencies * 99) / 100];
+    }
+
+    printf("%s\n", written == total ? "OK" : "FAIL");
+    printf("%zu/%zu pairs written on W servers (%zu invalid lines) in %.3f s: %.0f keys/s, "
+           "%zu datagrams, p99 latency %.3f ms\n", written, total, skipped, elapsed,
+           elapsed > 0 ? (double) written / elapsed : 0, nb_latencies, p99 * 1e3);
+
+    free(latencies);
+    client_end(&client);
+
+    return written == total ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// =====================================================================
+
+static int read_chunk(FILE *in, kv_list_t *chunk, size_t *skipped)
+{
+    if (chunk->pairs == NULL) {
+        chunk->pairs = calloc(BULK_LOAD_CHUNK, sizeof(kv_pair_t));
+        if (chunk->pairs == NULL) return 0;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length = 0;
+
+    while (chunk->size < BULK_LOAD_CHUNK && (length = getline(&line, &capacity, in)) != -1) {
+        if (length > 0 && line[length - 1] == '\n') line[--length] = '\0';
+        if (length == 0) continue;
+
+        //<key> <value>, the value is the rest of the line
+        char *separator = strpbrk(line, " \t");
+        if (separator == NULL || separator == line
+            || (size_t) (separator - line) > MAX_MSG_ELEM_SIZE || strlen(separator + 1) > MAX_MSG_ELEM_SIZE
+            || (size_t) length + 1 > PROTOCOL_MAX_PAYLOAD) {
+            ++(*skipped);
+            continue;
+        }
+
+        *separator = '\0';
+        kv_pair_t *pair = &chunk->pairs[chunk->size];
+        pair->key = strdup(line);
+        pair->value = strdup(separator + 1);
+        if (pair->key == NULL || pair->value == NULL) {
+            free_const_ptr(pair->key);
+            free_const_ptr(pair->value);
+            free(line);
+            return 0;
+        }
+        ++(chunk->size);
+    }
+
+    free(line);
+    return length != -1;
+}
+
+// =====================================================================
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+// =====================================================================
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
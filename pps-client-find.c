@@ -25,41 +25,16 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    pps_value_t *value1 = calloc(1, sizeof(char*));
-    pps_value_t *value2 = calloc(1, sizeof(char*));
-    
-    //If error whilst allocating the key
-    if(value1 == NULL || value2 == NULL){
-        fprintf(stderr, "Null keys\n");
-		printf("FAIL\n");
-		free(value1);
-        free(value2);
-        client_end(&client);
-        return EXIT_FAILURE;
-	}
+    long index = -1;
 
-    if(network_get(client, (*client_args.argv)[0], value1) != ERR_NONE || network_get(client, (*client_args.argv)[1], value2) != ERR_NONE) {
-        fprintf(stderr, "Get failed\n");
+    if (network_find(client, (*client_args.argv)[0], (*client_args.argv)[1], &index) != ERR_NONE) {
+        fprintf(stderr, "Find failed\n");
         printf("FAIL\n");
-        free(value1);
-        free(value2);
         client_end(&client);
         return EXIT_FAILURE;
     }
 
-    char* ptr = strstr(*value1, *value2);
-    ptrdiff_t index = -1;
-    if(ptr != NULL) {
-        index = ptr - *value1;
-    }
-
-    printf("OK %d\n", (int)index);
-
-    free_const_ptr(*value1);
-    free_const_ptr(*value2);
-
-    free(value1);
-    free(value2);
+    printf("OK %ld\n", index);
 
     client_end(&client);
 
@@ -0,0 +1,62 @@
+/**
+ * @file pps-client-mget.c
+ * @brief allow a client to retreive the values of many keys at once
+ *
+ * @date 18.10.2026
+ */
+
+#include <stdio.h>
+
+#include "node.h"
+#include "client.h"
+#include "network.h"
+#include "hashtable.h"
+#include "util.h"
+
+#include "limits.h"
+
+// =====================================================================
+
+int main(int argc, char *argv[]) {
+
+    //initialise client
+    client_t client;
+    client_init_args_t client_args = {&client, SIZE_MAX, TOTAL_SERVERS | GET_NEEDED, (size_t) argc, &argv};
+
+    if (client_init(&client_args) != ERR_NONE) {
+        printf("FAIL\n");
+        fprintf(stderr, "Erreur : client_init error\n");
+        return EXIT_FAILURE;
+    }
+
+    client.parsedOpt->W = 1;
+
+    size_t nb_keys = argv_size(*client_args.argv);
+    pps_value_t *values = calloc(nb_keys > 0 ? nb_keys : 1, sizeof(pps_value_t));
+
+    if (nb_keys == 0 || values == NULL) {
+        printf("FAIL\n");
+        free(values);
+        client_end(&client);
+        return EXIT_FAILURE;
+    }
+
+    //get all the values with the network, one line per key
+    error_code err = network_mget(client, (const pps_key_t *) *client_args.argv, nb_keys, values);
+
+    for (size_t i = 0; i < nb_keys; i++) {
+        if (err != ERR_NONE && err != ERR_NOT_FOUND) {
+            printf("FAIL\n");
+        } else if (values[i] == NULL) {
+            printf("FAIL\n");
+        } else {
+            printf("OK %s\n", values[i]);
+        }
+        free_const_ptr(values[i]);
+    }
+
+    free(values);
+    client_end(&client);
+
+    return EXIT_SUCCESS;
+}
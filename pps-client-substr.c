@@ -8,7 +8,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 
 #include "node.h"
 #include "client.h"
@@ -29,108 +28,24 @@ int main(int argc, char *argv[])
         fprintf(stderr, "Error : client_init error\n");
         return EXIT_FAILURE;
     }
-    
-    pps_value_t* value = calloc(1, sizeof(char*));
-
-	//Getting the value of the given key
-    if(network_get(client, (*client_args.argv)[0], value) != ERR_NONE) {
-        printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
-        client_end(&client);
-        return EXIT_FAILURE;
-    }
-
-    int starting_pos = 0;
-    int err = sscanf((*client_args.argv)[1], "%d", &starting_pos);
-
-    if(err != 1){
-        fprintf(stderr, "Error: sscanf failed at line %d of %s\n", __LINE__, __FILE__);
-        printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
-        client_end(&client);
-        return EXIT_FAILURE;
-    }
-
-    //check if it is a valid starting position
-    if (starting_pos >= 0 && (size_t)starting_pos >= strlen(*value)) {
-        printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
-        client_end(&client);
-        return EXIT_FAILURE;
-    } else if (starting_pos < 0 && (size_t)abs(starting_pos) > strlen(*value)) {
-        printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
-        client_end(&client);
-        return EXIT_FAILURE;
-    }
 
+    long starting_pos = 0;
     size_t length = 0;
-    err = sscanf((*client_args.argv)[2], "%zu", &length);
 
-    if(err != 1){
+    if (sscanf((*client_args.argv)[1], "%ld", &starting_pos) != 1 || sscanf((*client_args.argv)[2], "%zu", &length) != 1) {
         fprintf(stderr, "Error: sscanf failed at line %d of %s\n", __LINE__, __FILE__);
         printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
         client_end(&client);
         return EXIT_FAILURE;
     }
 
-    //check if it is a valid length
-    if (starting_pos >= 0 && starting_pos + length > strlen(*value)) {
-        printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
-        client_end(&client);
-        return EXIT_FAILURE;
-    } else if (starting_pos < 0 && length > (size_t)abs(starting_pos)) {
-        printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
-        client_end(&client);
-        return EXIT_FAILURE;
-    }
-
-
-
-    char *new_value = calloc(length + 1, sizeof(char));
-
-    if (new_value == NULL) {
-        printf("FAIL\n");
-        free_const_ptr(*value);
-        free(value);
-        client_end(&client);
-        return EXIT_FAILURE;
-    }
-
-    new_value[length] = '\0';
-
-    //copy the new string;
-    if (starting_pos >= 0) {
-        strncpy(new_value, *value + starting_pos, length);
-    } else {
-        strncpy(new_value, *value + strlen(*value) + starting_pos, length);
-    }
-
-    if (network_put(client, (*client_args.argv)[3], new_value) == ERR_NONE) {
-        printf("OK\n");
-
-    } else {
+    if (network_substr(client, (*client_args.argv)[0], starting_pos, length, (*client_args.argv)[3]) != ERR_NONE) {
         printf("FAIL\n");
-        free(new_value);
-        free_const_ptr(*value);
-        free(value);
         client_end(&client);
         return EXIT_FAILURE;
     }
 
-    free(new_value);
-    free_const_ptr(*value);
-    free(value);
+    printf("OK\n");
     client_end(&client);
 
     return EXIT_SUCCESS;
@@ -12,7 +12,17 @@
 #include "network.h"
 #include "util.h"
 
-#define UDP_SIZE 65507
+/**
+ * @brief print a pair of the dump (visitor of network_dump)
+ * @param arg unused
+ * @param key the key
+ * @param key_len its length
+ * @param value the value
+ * @param value_len its length
+ * @param version unused
+ */
+static void print_pair(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version);
 
 int main(int argc, char *argv[]) {
 	
@@ -74,77 +84,27 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    //send message \0 to get all pairs key/value of the server's hashtable
-    pps_key_t key = calloc(1, sizeof(char));
-    pps_value_t* result = calloc(1, sizeof(char*));
-
-    if(key == NULL || result == NULL){
-        client_end(&client);
-        node_end(&serverNode);
-        fprintf(stderr, "Memory error when allocating memory for the key and the result\n");
-        printf("FAIL\n");
-        return EXIT_FAILURE;
-    }
-
-    if(network_get(client, key, result) != ERR_NONE){
-        free_const_ptr(key);
-        free_const_ptr(*result);
-        free(result);
+    //the pairs are printed page by page, as they arrive
+    if (network_dump(client, &client.node->nodes[0], NETWORK_DUMP_WINDOW, print_pair, NULL) != ERR_NONE) {
         client_end(&client);
         fprintf(stderr, "Could not get result from network\n");
         printf("FAIL\n");
         return EXIT_FAILURE;
     }
 
-
-    //compute the number of pairs with the 4 first bytes of result
-    size_t nbr_pairs_exp = 0;
-    memcpy(&nbr_pairs_exp, *result, sizeof(int));
-    nbr_pairs_exp = ntohl(nbr_pairs_exp);
-
-    size_t nbr_pairs_act = 0;
-
-    int isKey = 1;
-
-    pps_value_t ptr = *result;
-
-    *result += sizeof(int);
-    size_t read_bytes = 0;
-
-    //if the hashtable was empty
-    if(nbr_pairs_exp == 0){
-        free_const_ptr(ptr);
-        free(result);
-        client_end(&client);
-        return EXIT_SUCCESS;
-    }
-
-    //print all pairs
-    while(nbr_pairs_act < nbr_pairs_exp){
-
-        if(isKey == 1){
-            nbr_pairs_act++;
-            printf("%s = ", *result+read_bytes);
-
-        }else{
-            printf("%s\n", *result+read_bytes);
-        }
-
-        while((*result)[read_bytes] != '\0'){
-            read_bytes++;
-        }
-
-        read_bytes++;
-
-        isKey = !isKey;
-
-    }
-    printf("%s\n", *result+read_bytes);
-
-    free_const_ptr(key);
-    free_const_ptr(ptr);
-    free(result);
     client_end(&client);
 
     return EXIT_SUCCESS;
 }
+
+// =====================================================================
+
+static void print_pair(void _unused *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t _unused version)
+{
+    //the keys and the values may hold '\0'
+    fwrite(key, 1, key_len, stdout);
+    fputs(" = ", stdout);
+    fwrite(value, 1, value_len, stdout);
+    putchar('\n');
+}
@@ -5,19 +5,34 @@
  * @date 21.03.2018
  */
 
+#define _GNU_SOURCE // for recvmmsg, sendmmsg and sigaction
+
 #include <stdio.h>
 #include <stdlib.h>        //for exit
 #include <errno.h>            //for errno
 #include <stdint.h>            //for int32_t
 #include <ctype.h>       //isspace
 #include <string.h>            //strtok
+#include <signal.h>            //for sigaction
+#include <pthread.h>           //for the worker threads
+#include <time.h>              //for nanosleep
 
 #include <sys/socket.h>    //for revfrom
+#include <sys/uio.h>       //for struct iovec
 
 #include "system.h"
 #include "config.h"
 #include "hashtable.h"
+#include "store.h"
+#include "persist.h"
+#include "protocol.h"
+#include "util.h"
 #include "node.h"
+#include "hints.h"
+#include "ring.h"
+#include "antientropy.h"
+#include "transport.h"
+#include "hlc.h"
 
 #define SIZE_PAIR_OCTET 5
 #define SIZE_KEY_OCTET 1
@@ -26,21 +41,304 @@
 #define MAX_PORT_LENGTH 5
 #define MAX_SIZE_LINE 22
 #define MAX_PORT_LENGTH 5
-#define UDP_SIZE 65507
+
+#define MAX_THREADS 256
+#define BATCH_SIZE 32 // datagrams received (and answered) per syscall
+#define RECEIVE_BUFFER (4 << 20) // socket buffer of a worker, for the bursts of bulk loads
+#define BUFFER_SIZE (PROTOCOL_HEADER_SIZE + MAX_MSG_SIZE + 1) // one request and its '\0'
+
+/**
+ * @brief set by SIGUSR1: print the memory usage of the table
+ */
+static volatile sig_atomic_t print_stats = 0;
+
+/**
+ * @brief versions of the writes of the first protocol, which come without one
+ */
+static hlc_t server_clock = HLC_INITIALIZER;
+
+/**
+ * @brief arguments of a worker thread
+ */
+typedef struct {
+    store_t *store;
+    hints_t *hints;
+    antientropy_t *antientropy; // NULL without ring
+    size_t period_ms;           // between two rounds of anti-entropy, 0 for none
+    const char *ip;
+    uint16_t port;
+    int reuseport;
+} worker_args_t;
+
+/**
+ * @brief datagrams received by one recvmmsg and their replies, sent by one sendmmsg.
+ *        All the buffers are allocated once per worker.
+ */
+typedef struct {
+    char *buffers;                          // BATCH_SIZE buffers of BUFFER_SIZE bytes
+    struct mmsghdr in[BATCH_SIZE];
+    struct iovec in_iov[BATCH_SIZE];
+    struct sockaddr_in addrs[BATCH_SIZE];
+    struct mmsghdr out[BATCH_SIZE];
+    struct iovec out_iov[BATCH_SIZE][2];    // header (empty for the first protocol) and payload
+    protocol_header_t headers[BATCH_SIZE];  // headers of the replies
+    char *replies;                          // BATCH_SIZE buffers of PROTOCOL_MAX_PAYLOAD bytes, for packed replies
+    char header_bytes[BATCH_SIZE][PROTOCOL_HEADER_SIZE + PROTOCOL_STAMP_SIZE]; // and the version of a value
+    store_view_t views[BATCH_SIZE];         // values borrowed until the replies are sent
+    size_t nb_views;
+    char status[BATCH_SIZE];                // one byte replies
+    size_t nb_out;
+    size_t puts[BATCH_SIZE];                // replies acknowledging a write
+    size_t nb_puts;
+    uint64_t dirty;                         // shards written by the batch, synced before replying
+} batch_t;
+
+/**
+ * @brief SIGUSR1 handler
+ * @param sig the signal number
+ */
+static void on_sigusr1(int _unused sig)
+{
+    print_stats = 1;
+}
+
+/**
+ * @brief receive loop of a worker: its own socket, bound to the server address
+ * @param arg the worker_args_t of the worker
+ * @return NULL
+ */
+static void *worker(void *arg);
+
+/**
+ * @brief hand the hinted writes over to their owners, every HINTS_REPLAY_MS
+ * @param arg the worker_args_t of the server
+ * @return NULL
+ */
+static void *handoff(void *arg);
+
+/**
+ * @brief compare the content of the server with the one of its peers, every period_ms
+ * @param arg the worker_args_t of the server
+ * @return NULL
+ */
+static void *reconcile(void *arg);
+
+/**
+ * @brief allocate the buffers of a batch and point the receive headers to them
+ * @param batch the batch to initialize
+ * @return ERR_NONE or ERR_NOMEM
+ */
+static error_code batch_init(batch_t *batch);
+
+/**
+ * @brief group commit of the writes of a batch, which are answered with
+ *        an error if they could not be made durable
+ * @param store the local storage
+ * @param batch the batch whose writes are synced
+ */
+static void batch_sync(store_t *store, batch_t *batch);
+
+/**
+ * @brief send all the replies of a batch at once and release the borrowed values
+ * @param store the local storage
+ * @param hints the writes accepted in place of other servers
+ * @param s socket to answer on
+ * @param batch the batch to flush
+ */
+static void batch_flush(store_t *store, int s, batch_t *batch);
+
+/**
+ * @brief handle one request, queueing its reply in the batch
+ * @param store the local storage
+ * @param hints the writes accepted in place of other servers
+ * @param antientropy the peers of the server, may be NULL
+ * @param batch the current batch
+ * @param i index of the request in the batch
+ */
+static void handle_request(store_t *store, hints_t *hints, antientropy_t *antientropy, batch_t *batch, size_t i);
+
+/**
+ * @brief handle one request with a header, queueing its reply in the batch
+ * @param store the local storage
+ * @param hints the writes accepted in place of other servers
+ * @param antientropy the peers of the server, may be NULL
+ * @param batch the current batch
+ * @param i index of the request in the batch
+ * @param header header of the request, becomes the one of the reply
+ * @param payload payload of the request
+ * @param size size of the payload
+ */
+static void handle_versioned(store_t *store, hints_t *hints, antientropy_t *antientropy, batch_t *batch, size_t i,
+                             protocol_header_t *header, const char *payload, size_t size);
+
+/**
+ * @brief queue the reply of a GET: <version><value>, the value sent straight from the table
+ * @param batch the current batch
+ * @param i index of the request in the batch
+ * @param header header of the reply
+ * @param view the value, released once the batch is sent
+ */
+static void batch_reply_value(batch_t *batch, size_t i, const protocol_header_t *header, const store_view_t *view);
+
+/**
+ * @brief write a pair sent with its version
+ * @param store the local storage
+ * @param batch the current batch, whose dirty shards are updated
+ * @param reader the payload at <version><key><value>, moved past the pair
+ * @param key where to store the key, in the payload
+ * @param key_len where to store the length of the key
+ * @return 1 if the pair was written, 0 if it could not be (too large, see protocol_pair_fits,
+ *         or a version too far ahead, see hlc_observe), -1 if the payload ends before a whole pair
+ */
+static int put_stamped(store_t *store, batch_t *batch, protocol_reader_t *reader, const char **key, size_t *key_len);
+
+/**
+ * @brief whether a hint is for a server of its key: the handoff would send the value anywhere else
+ * @param antientropy the anti-entropy, with the ring (NULL without ring, then no hint is taken)
+ * @param owner the server the hint is for
+ * @param pair the payload at <version><key><value>, not moved
+ * @return 1 if the owner is in the preference list of the key
+ */
+static int hint_for_server(const antientropy_t *antientropy, const struct sockaddr_in *owner,
+                           const protocol_reader_t *pair);
+
+/**
+ * @brief pack the values of many keys in one reply
+ * @param store the local storage
+ * @param keys the keys, one field each
+ * @param size size of the keys
+ * @param reply where to write the reply, of PROTOCOL_MAX_PAYLOAD bytes
+ * @return size of the reply
+ */
+static size_t pack_values(store_t *store, const char *keys, size_t size, char *reply);
+
+/**
+ * @brief write many pairs
+ * @param store the local storage
+ * @param batch the current batch, whose dirty shards are updated
+ * @param pairs the pairs, <version><key><value>...
+ * @param size size of the pairs
+ * @param reply where to write a status byte per pair
+ * @param written where to store the number of pairs written
+ * @return number of pairs (size of the reply)
+ */
+static size_t put_pairs(store_t *store, batch_t *batch, const char *pairs, size_t size, char *reply, size_t *written);
+
+/**
+ * @brief read the keys at the start of a payload
+ * @param reader the payload, moved past the keys
+ * @param keys where to store the keys, in the payload
+ * @param lengths where to store their lengths
+ * @param max maximum number of keys
+ * @return number of keys read, before the end of the payload, max, or a field that does not fit
+ */
+static size_t read_keys(protocol_reader_t *reader, const char **keys, size_t *lengths, size_t max);
+
+/**
+ * @brief value operations: CONCAT, SUBSTR and FIND on the local values
+ * @param store the local storage
+ * @param batch the current batch, whose dirty shards are updated
+ * @param opcode the operation
+ * @param payload the payload of the request, after its version (none for FIND), see protocol_opcode_t
+ * @param size size of the payload
+ * @param reply where to write the reply (FIND), of PROTOCOL_MAX_PAYLOAD bytes
+ * @param reply_size where to store the size of the reply
+ * @param version version of the value written (CONCAT and SUBSTR)
+ * @return the status of the reply
+ */
+static protocol_status_t value_operation(store_t *store, batch_t *batch, uint8_t opcode, const char *payload,
+                                         size_t size, char *reply, size_t *reply_size, uint64_t version);
+
+/**
+ * @brief a page of a scan being written
+ */
+typedef struct {
+    char *buffer; // PROTOCOL_MAX_PAYLOAD bytes, starting with the next cursor
+    size_t used;
+    int too_large; // a pair did not fit in a page alone
+} scan_page_t;
+
+_Static_assert(PROTOCOL_SCAN_START(1) == STORE_SCAN_START(1) && PROTOCOL_SCAN_END == STORE_SCAN_END,
+               "the cursors of the scans are positions in the store");
+
+/**
+ * @brief add a pair to a page of a scan (visitor of store_scan)
+ * @param arg the scan_page_t
+ * @param key the key
+ * @param key_len its length
+ * @param value the value
+ * @param value_len its length
+ * @param version its version
+ * @return 0 if the page is full, or if the pair does not fit in a page alone
+ */
+static int add_to_page(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version);
 
 // =====================================================================
 
-int main(void) {
+int main(int argc, char *argv[]) {
 
-    Htable_t table = construct_Htable(HTABLE_SIZE);
+    //optional number of worker threads (-t <threads>), data directory (-d <dir>),
+    //fsync policy of its logs (-f always|batch|off), number of servers of a key (-n <N>)
+    //and seconds between two rounds of anti-entropy (-a <seconds>, 0 for none)
+    size_t nb_threads = 1;
+    const char *dir = NULL;
+    sync_policy_t policy = SYNC_BATCH;
+    size_t N = 3;
+    size_t period_ms = ANTIENTROPY_PERIOD_MS;
 
-    //We bind the socket to s (without timeout)
-    int s = get_socket(0);
-    if (s == -1) {
-        fprintf(stderr, "Error : get_socket in pps-launch-server");
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Usage: %s [-t <threads>] [-d <dir>] [-f always|batch|off] [-n <N>] [-a <seconds>]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        } else if (strcmp(argv[i], "-t") == 0) {
+            if (sscanf(argv[i + 1], "%zu", &nb_threads) != 1 || nb_threads == 0 || nb_threads > MAX_THREADS) {
+                fprintf(stderr, "Error: the number of threads must be in [1..%d]\n", MAX_THREADS);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-d") == 0) {
+            dir = argv[i + 1];
+        } else if (strcmp(argv[i], "-f") == 0) {
+            if (persist_parse_policy(argv[i + 1], &policy) != ERR_NONE) {
+                fprintf(stderr, "Error: the fsync policy must be always, batch or off\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-n") == 0) {
+            if (sscanf(argv[i + 1], "%zu", &N) != 1 || N == 0) {
+                fprintf(stderr, "Error: N must be at least 1\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-a") == 0) {
+            double seconds = 0;
+            if (sscanf(argv[i + 1], "%lf", &seconds) != 1 || seconds < 0) {
+                fprintf(stderr, "Error: the period of the anti-entropy must be a number of seconds\n");
+                return EXIT_FAILURE;
+            }
+            period_ms = (size_t) (seconds * 1000);
+        } else {
+            fprintf(stderr, "Usage: %s [-t <threads>] [-d <dir>] [-f always|batch|off] [-n <N>] [-a <seconds>]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    store_t *store = store_new();
+    hints_t *hints = hints_new();
+    if (store == NULL || hints == NULL) {
+        fprintf(stderr, "Error : could not create the store in pps-launch-server");
+        store_free(store);
+        hints_free(hints);
         return EXIT_FAILURE;
     }
 
+    //no SA_RESTART: the signal interrupts recvfrom so that stats are printed right away
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_sigusr1;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+
     printf("IP port? ");
 
     char line[MAX_SIZE_LINE+1];
@@ -48,169 +346,815 @@ int main(void) {
 
     if(fgets(line, MAX_SIZE_LINE+1, stdin) == NULL){
         fprintf(stderr, "Error: could not get the input (IP/Port) from stdin\n");
+        store_free(store);
         return EXIT_FAILURE;
     }
 
     char IP[MAX_IP_SIZE+1];
     memset(IP, 0, (MAX_IP_SIZE+1)* sizeof(char));
     uint16_t port = 0;
-    int args = sscanf(line,"%s %hu", IP, &port);
+    int args = sscanf(line,"%15s %hu", IP, &port);
 
     if(args != 2){
         fprintf(stderr,"Error: sscanf failed\n");
+        store_free(store);
         return EXIT_FAILURE;
     }
 
-    //Bind the socket to PPS_DEFAULT_IP and PPS_DEFAULT_PORT
-    if (bind_server(s, IP, port) != 0) {
-        fprintf(stderr, "Error : bind_server in pps-launch-server");
+    //the peers are found on the ring of the clients; without it, the server only misses the anti-entropy
+    ring_t *ring = ring_alloc();
+    antientropy_t *antientropy = NULL;
+    struct sockaddr_in self;
+    if (ring != NULL && ring_init(ring) == ERR_NONE && get_server_addr(IP, port, &self) == ERR_NONE) {
+        antientropy = antientropy_new(store, ring, N, &self);
+    }
+    if (antientropy == NULL) {
+        fprintf(stderr, "Could not find the peers of the server in %s, no anti-entropy\n", PPS_SERVERS_LIST_FILENAME);
+    }
+
+    //recover the content of the previous runs before answering anything,
+    //once the tree of the anti-entropy is cut at the nodes of the ring
+    if (dir != NULL && store_open(store, dir, policy) != ERR_NONE) {
+        fprintf(stderr, "Error : could not open the data directory %s\n", dir);
+        antientropy_free(antientropy);
+        ring_free(ring);
+        store_free(store);
+        hints_free(hints);
         return EXIT_FAILURE;
     }
 
+    //every worker binds its own socket to IP:port
+    worker_args_t wargs = {store, hints, antientropy, period_ms, IP, port, nb_threads > 1};
+    pthread_t threads[MAX_THREADS];
+    size_t started = 0;
+
+    //detached: it only sleeps and sends
+    pthread_t handoff_thread;
+    if (pthread_create(&handoff_thread, NULL, handoff, &wargs) != 0 || pthread_detach(handoff_thread) != 0) {
+        fprintf(stderr, "Error : could not start the hinted handoff in pps-launch-server\n");
+    }
+
+    pthread_t reconcile_thread;
+    if (antientropy != NULL && period_ms > 0 && (pthread_create(&reconcile_thread, NULL, reconcile, &wargs) != 0
+                                                 || pthread_detach(reconcile_thread) != 0)) {
+        fprintf(stderr, "Error : could not start the anti-entropy in pps-launch-server\n");
+    }
+
+    for (; started < nb_threads; ++started) {
+        if (pthread_create(&threads[started], NULL, worker, &wargs) != 0) {
+            fprintf(stderr, "Error : could not start worker %zu in pps-launch-server\n", started);
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    antientropy_free(antientropy);
+    ring_free(ring);
+    store_free(store);
+    hints_free(hints);
+
+    return started == nb_threads ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// =====================================================================
+
+static void *handoff(void *arg)
+{
+    worker_args_t *wargs = arg;
+
+    transport_t *transport = transport_new(NULL, NULL);
+    if (transport == NULL) {
+        fprintf(stderr, "Error : could not create the sockets of the hinted handoff\n");
+        return NULL;
+    }
+
+    struct timespec period = {HINTS_REPLAY_MS / 1000, (HINTS_REPLAY_MS % 1000) * 1000000L};
+    while (1) {
+        nanosleep(&period, NULL);
+        hints_replay(wargs->hints, wargs->store, transport);
+    }
+
+    transport_free(transport);
+    return NULL;
+}
+
+// =====================================================================
+
+static void *reconcile(void *arg)
+{
+    worker_args_t *wargs = arg;
+
+    transport_t *transport = transport_new(NULL, NULL);
+    if (transport == NULL) {
+        fprintf(stderr, "Error : could not create the sockets of the anti-entropy\n");
+        return NULL;
+    }
 
+    struct timespec period = {wargs->period_ms / 1000, (wargs->period_ms % 1000) * 1000000L};
     while (1) {
+        nanosleep(&period, NULL);
 
-        struct sockaddr_in cli_addr;
-        socklen_t addr_len = sizeof(cli_addr);
-        memset(&cli_addr, 0, addr_len);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        antientropy_stats_t stats;
+        error_code err = antientropy_round(wargs->antientropy, transport, &stats);
+        clock_gettime(CLOCK_MONOTONIC, &end);
 
-        //Allocate memory for incoming message
-        char *in_msg = calloc(MAX_MSG_SIZE+1, sizeof(char));
-        if (in_msg == NULL) {
-            fprintf(stderr, "Could not allocate in_msg");
-            return EXIT_FAILURE;
+        //a peer that does not answer is tried again at its next round
+        if (err == ERR_NONE && stats.pushed > 0) {
+            fprintf(stderr, "Anti-entropy: %zu leaves differ, %zu keys compared, %zu values pushed, "
+                    "%zu bytes in %.3f s\n", stats.leaves, stats.compared, stats.pushed, stats.bytes,
+                    (double) (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+        }
+    }
+
+    transport_free(transport);
+    return NULL;
+}
+
+// =====================================================================
+
+static void *worker(void *arg)
+{
+    worker_args_t *wargs = arg;
+
+    //We bind the socket to s (without timeout)
+    int s = get_socket(0);
+    if (s == -1) {
+        fprintf(stderr, "Error : get_socket in pps-launch-server");
+        return NULL;
+    }
+
+    if (wargs->reuseport && enable_reuseport(s) != ERR_NONE) {
+        fprintf(stderr, "Error : could not set SO_REUSEPORT in pps-launch-server");
+        return NULL;
+    }
+
+    //best effort: the default buffer only holds a few full datagrams
+    if (set_receive_buffer(s, RECEIVE_BUFFER) != ERR_NONE) {
+        fprintf(stderr, "Could not enlarge the receive buffer in pps-launch-server\n");
+    }
+
+    if (bind_server(s, wargs->ip, wargs->port) != 0) {
+        fprintf(stderr, "Error : bind_server in pps-launch-server");
+        return NULL;
+    }
+
+    batch_t *batch = calloc(1, sizeof(batch_t));
+    if (batch == NULL || batch_init(batch) != ERR_NONE) {
+        fprintf(stderr, "Could not allocate the receive buffers");
+        free(batch);
+        return NULL;
+    }
+
+    while (1) {
+
+        //wait for at least one datagram, then take all those already there
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            batch->in[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
         }
 
-        ssize_t sizeMsg = recvfrom(s, in_msg, MAX_MSG_SIZE, 0, (struct sockaddr *) &cli_addr, &addr_len);
+        int received = recvmmsg(s, batch->in, BATCH_SIZE, MSG_WAITFORONE, NULL);
 
-        ssize_t sendto_err = -1;
-        char *get0;
+        if (print_stats) {
+            print_stats = 0;
+            store_print_stats(wargs->store, stderr);
+        }
 
-        //Get a pointeur to the position of the first '\0' if any
-        if (sizeMsg < 0) {
-            fprintf(stderr, "recvfrom didn't work");
+        if (received < 0) {
+            if (errno != EINTR) fprintf(stderr, "recvmmsg didn't work");
             continue;
+        }
+
+        for (size_t i = 0; i < (size_t) received; ++i) {
+            handle_request(wargs->store, wargs->hints, wargs->antientropy, batch, i);
+        }
+
+        batch_sync(wargs->store, batch);
+        batch_flush(wargs->store, s, batch);
+    }
+
+    free(batch->buffers);
+    free(batch->replies);
+    free(batch);
+    return NULL;
+}
+
+// =====================================================================
+
+static error_code batch_init(batch_t *batch)
+{
+    batch->buffers = calloc(BATCH_SIZE, BUFFER_SIZE);
+    M_EXIT_IF_NULL(batch->buffers, BATCH_SIZE * BUFFER_SIZE, "pps-launch-server");
+
+    batch->replies = malloc(BATCH_SIZE * PROTOCOL_MAX_PAYLOAD);
+    if (batch->replies == NULL) {
+        free(batch->buffers);
+        M_EXIT_IF_NULL(batch->replies, BATCH_SIZE * PROTOCOL_MAX_PAYLOAD, "pps-launch-server");
+    }
+
+    for (size_t i = 0; i < BATCH_SIZE; ++i) {
+        batch->in_iov[i].iov_base = batch->buffers + i * BUFFER_SIZE;
+        batch->in_iov[i].iov_len = BUFFER_SIZE - 1;
+        batch->in[i].msg_hdr.msg_name = &batch->addrs[i];
+        batch->in[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+        batch->in[i].msg_hdr.msg_iov = &batch->in_iov[i];
+        batch->in[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    batch->nb_views = 0;
+    batch->nb_out = 0;
+    batch->nb_puts = 0;
+    batch->dirty = 0;
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static void batch_sync(store_t *store, batch_t *batch)
+{
+    if (batch->dirty != 0 && store_sync(store, batch->dirty) != ERR_NONE) {
+        fprintf(stderr, "Could not sync the logs, %zu writes are not acknowledged\n", batch->nb_puts);
+
+        //same reply as a failed add_Htable_value
+        static char error_reply = '\0';
+        for (size_t p = 0; p < batch->nb_puts; ++p) {
+            size_t o = batch->puts[p];
+            if (batch->out_iov[o][0].iov_len != 0) {
+                batch->headers[o].status = PROTOCOL_ERROR;
+                protocol_write_header(batch->header_bytes[o], &batch->headers[o]);
+            } else {
+                batch->out_iov[o][1].iov_base = &error_reply;
+                batch->out_iov[o][1].iov_len = 1;
+            }
+        }
+    }
+
+    batch->nb_puts = 0;
+    batch->dirty = 0;
+}
+
+// =====================================================================
+
+static void batch_flush(store_t *store, int s, batch_t *batch)
+{
+    size_t sent = 0;
+
+    while (sent < batch->nb_out) {
+        int n = sendmmsg(s, batch->out + sent, batch->nb_out - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            //skip the datagram that failed, as sendto used to
+            ++sent;
         } else {
-            get0 = memchr(in_msg, '\0', sizeMsg);
+            sent += n;
         }
+    }
+
+    for (size_t i = 0; i < batch->nb_views; ++i) {
+        store_release_view(store, &batch->views[i]);
+    }
+
+    batch->nb_views = 0;
+    batch->nb_out = 0;
+}
+
+// =====================================================================
+
+/**
+ * @brief queue a reply in a batch
+ * @param batch the batch
+ * @param i index of the request being answered
+ * @param header header of the reply, NULL for a request of the first protocol
+ * @param data the reply (has to stay valid until the batch is flushed)
+ * @param size size of the reply
+ */
+static void batch_reply(batch_t *batch, size_t i, const protocol_header_t *header, const void *data, size_t size)
+{
+    size_t o = batch->nb_out++;
+
+    batch->out_iov[o][0].iov_base = batch->header_bytes[o];
+    batch->out_iov[o][0].iov_len = 0;
+    if (header != NULL) {
+        batch->headers[o] = *header;
+        protocol_write_header(batch->header_bytes[o], header);
+        batch->out_iov[o][0].iov_len = PROTOCOL_HEADER_SIZE;
+    }
+
+    batch->out_iov[o][1].iov_base = (void *) data;
+    batch->out_iov[o][1].iov_len = size;
+
+    memset(&batch->out[o], 0, sizeof(batch->out[o]));
+    batch->out[o].msg_hdr.msg_name = &batch->addrs[i];
+    batch->out[o].msg_hdr.msg_namelen = batch->in[i].msg_hdr.msg_namelen;
+    batch->out[o].msg_hdr.msg_iov = batch->out_iov[o];
+    batch->out[o].msg_hdr.msg_iovlen = 2;
+}
+
+// =====================================================================
+
+static void handle_request(store_t *store, hints_t *hints, antientropy_t *antientropy, batch_t *batch, size_t i)
+{
+    char *in_msg = batch->in_iov[i].iov_base;
+    size_t sizeMsg = batch->in[i].msg_len;
+
+    protocol_header_t header;
+    if (protocol_read_header(in_msg, sizeMsg, &header)) {
+        handle_versioned(store, hints, antientropy, batch, i, &header, in_msg + PROTOCOL_HEADER_SIZE,
+                         sizeMsg - PROTOCOL_HEADER_SIZE);
+        return;
+    }
+
+    //first protocol, without header
+    if (sizeMsg == 0) {
+        batch_reply(batch, i, NULL, NULL, 0);
+        return;
+    }
 
+    //Get a pointeur to the position of the first '\0' if any
+    char *get0 = memchr(in_msg, '\0', sizeMsg);
+    in_msg[sizeMsg] = '\0';
 
-        if (sizeMsg == 0) {
-            sendto_err = sendto(s, NULL, 0, 0, (struct sockaddr *) &cli_addr, addr_len);
+    //handle client get
+    if (get0 == NULL) {
+        //the value is sent straight from the table, once the whole batch is handled
+        store_view_t *view = &batch->views[batch->nb_views];
+
+        //key is not in the hashtable
+        if (store_get_view(store, in_msg, sizeMsg, view) != ERR_NONE) {
+            batch->status[i] = '\0';
+            batch_reply(batch, i, NULL, &batch->status[i], 1);
         } else {
-            //handle client get
-            if (get0 == NULL && sizeMsg >= 0) {
-                pps_value_t datagram = get_Htable_value(table, in_msg);
-
-                //key is not in the hashtable
-                if (datagram == NULL) {
-                    pps_value_t d = calloc(1, sizeof(char));
-                    sendto_err = sendto(s, d, 1, 0, (struct sockaddr *) &cli_addr, addr_len);
-                    free_const_ptr(d);
-                    //the value that is associated with the key is empty
-                } else {
-                    sendto_err = sendto(s, datagram, strlen(datagram), 0, (struct sockaddr *) &cli_addr, addr_len);
-                }
-                free_const_ptr(datagram);
+            ++(batch->nb_views);
+            batch_reply(batch, i, NULL, view->view.value, view->view.length);
+        }
 
-            } else if (get0 != NULL && sizeMsg == 1 && in_msg[0] == '\0') {
-                //get content from table
-                kv_list_t *content = get_Htable_content(table);
+    } else if (sizeMsg == 1) {
+        //dumps are paged by PROTOCOL_SCAN, the whole content no longer fits in memory twice;
+        //a lone '\0' would read as a dump of no pair, the header as a count of pairs that never come
+        protocol_header_t refused = {PROTOCOL_VERSION, PROTOCOL_SCAN, PROTOCOL_ERROR, 0};
+        batch_reply(batch, i, &refused, NULL, 0);
 
+        //handle client put: <key>\0<value>
+    } else {
+        //Send '\0' if there was a problem in adding the value to the HTable, send NULL otherwise
+        size_t key_len = (size_t) (get0 - in_msg);
+        size_t value_len = strlen(get0 + 1);
+        if (!protocol_pair_fits(key_len, value_len)
+            || store_put(store, in_msg, key_len, get0 + 1, value_len, hlc_now(&server_clock)) != ERR_NONE) {
+            batch->status[i] = '\0';
+            batch_reply(batch, i, NULL, &batch->status[i], 1);
+        } else {
+            batch->dirty |= (uint64_t) 1 << store_shard_of(in_msg, key_len);
+            batch->puts[batch->nb_puts++] = batch->nb_out;
+            batch_reply(batch, i, NULL, NULL, 0);
+        }
+    }
+}
 
+// =====================================================================
 
+static void handle_versioned(store_t *store, hints_t *hints, antientropy_t *antientropy, batch_t *batch, size_t i,
+                             protocol_header_t *header, const char *payload, size_t size)
+{
+    //no flag is defined yet: a request with one would not be understood
+    uint8_t flags = header->status;
+    header->status = PROTOCOL_OK;
 
+    if (header->version != PROTOCOL_VERSION) {
+        header->version = PROTOCOL_VERSION;
+        header->status = PROTOCOL_BAD_VERSION;
+        batch_reply(batch, i, header, NULL, 0);
+        return;
+    }
 
-                char *toSend = calloc(UDP_SIZE, sizeof(char));
+    if (flags != 0) {
+        header->status = PROTOCOL_ERROR;
+        batch_reply(batch, i, header, NULL, 0);
+        return;
+    }
 
-                if (toSend == NULL) {
-                    fprintf(stderr, "Could not allocate memory for the message in server\n");
-                    return EXIT_FAILURE;
-                }
+    //the key of a GET or a DIGEST, read in place
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, payload, size);
+    const char *key = NULL;
+    size_t key_len = 0;
+    int single_key = protocol_next_field(&reader, &key, &key_len) && protocol_reader_done(&reader);
+    protocol_reader_init(&reader, payload, size);
 
-                size_t used = sizeof(int);
-
-                size_t content_size = htonl(content->size);
-                memcpy(toSend,&content_size, sizeof(int));
-
-
-                if (content->size == 0){
-                    sendto(s, toSend, used, 0, (struct sockaddr *) &cli_addr, addr_len);
-                    free(toSend);
-                    toSend = NULL;
-                }else{
-                    for (size_t i = 0; i < content->size; ++i) {
-                        //compute size of <key>\0<value>
-                        size_t new_bytes = strlen(content->pairs[i].key) + strlen(content->pairs[i].value) + 2;
-
-                        //if we add the new pair to the string, check if the length exceeds UDP_SIZE (and send message if it's the case)
-                        if (used + new_bytes > UDP_SIZE) {
-                            if (i > 0) {
-                                used--;
-                            }
-                            //send the the message without the new pair and prepare new message
-                            sendto_err = sendto(s, toSend, used, 0, (struct sockaddr *) &cli_addr, addr_len);
-                            used = 0;
-                            memset(toSend, 0, UDP_SIZE * sizeof(char));
-                        }
-
-                        //copy <key>\0<value>\0 at the end of toSend
-                        strncpy(toSend + used, content->pairs[i].key, strlen(content->pairs[i].key));
-                        used = used + strlen(content->pairs[i].key) + 1; //for \0
-                        strncpy(toSend + used, content->pairs[i].value, strlen(content->pairs[i].value));
-                        used = used + strlen(content->pairs[i].value) + 1;
-
-                    }
-
-                    //if the last chunk of key/value was not sent
-                    if (used != 0) {
-                        sendto_err = sendto(s, toSend, used - 1, 0, (struct sockaddr *) &cli_addr, addr_len);
-                    }
-
-                    free(toSend);
-                    toSend = NULL;}
-
-                //handle client put
-            } else if (get0 != NULL && sizeMsg >= 0) {
-                char *key = calloc(MAX_MSG_SIZE, sizeof(char));
-                if (key == NULL) {
-                    fprintf(stderr, "Could not alloc key");
-                    free(key);
-                    return EXIT_FAILURE;
-                }
+    switch (header->opcode) {
+    case PROTOCOL_PING:
+        batch_reply(batch, i, header, NULL, 0);
+        break;
 
-                //Adding the key with a \0 at the end
-                strncpy(key, in_msg, strlen(in_msg) + 1);
+    case PROTOCOL_GET: {
+        //the value is sent straight from the table, once the whole batch is handled
+        store_view_t *view = &batch->views[batch->nb_views];
 
-                char *value = calloc(MAX_MSG_SIZE, sizeof(char));
-                if (value == NULL) {
-                    fprintf(stderr, "Could not alloc value");
-                    free(key);
-                    free(value);
-                    return EXIT_FAILURE;
-                }
+        if (!single_key) {
+            header->status = PROTOCOL_ERROR;
+            batch_reply(batch, i, header, NULL, 0);
+        } else if (store_get_view(store, key, key_len, view) != ERR_NONE) {
+            header->status = PROTOCOL_NOT_FOUND;
+            batch_reply(batch, i, header, NULL, 0);
+        } else {
+            ++(batch->nb_views);
+            batch_reply_value(batch, i, header, view);
+        }
+        break;
+    }
+
+    case PROTOCOL_DIGEST: {
+        //<version><digest>: the client compares it with the value another server sent
+        char *reply = batch->replies + i * PROTOCOL_MAX_PAYLOAD;
+        store_view_t view;
+
+        if (!single_key) {
+            header->status = PROTOCOL_ERROR;
+            batch_reply(batch, i, header, NULL, 0);
+        } else if (store_get_view(store, key, key_len, &view) != ERR_NONE) {
+            header->status = PROTOCOL_NOT_FOUND;
+            batch_reply(batch, i, header, NULL, 0);
+        } else {
+            protocol_write_stamp(reply, view.view.version);
+            protocol_write_stamp(reply + PROTOCOL_STAMP_SIZE, protocol_digest(view.view.value, view.view.length));
+            store_release_view(store, &view);
+            batch_reply(batch, i, header, reply, PROTOCOL_STAMP_SIZE + PROTOCOL_DIGEST_SIZE);
+        }
+        break;
+    }
+
+    case PROTOCOL_PUT:
+        if (put_stamped(store, batch, &reader, &key, &key_len) != 1) {
+            header->status = PROTOCOL_ERROR;
+            batch_reply(batch, i, header, NULL, 0);
+        } else {
+            batch->puts[batch->nb_puts++] = batch->nb_out;
+            batch_reply(batch, i, header, NULL, 0);
+        }
+        break;
+
+    case PROTOCOL_HINT: {
+        //<owner><version><key><value>: stored here as a PUT, and handed over to the owner later
+        struct sockaddr_in owner;
+        const char *addr = protocol_next_bytes(&reader, PROTOCOL_ADDR_SIZE);
+        if (addr != NULL) protocol_read_addr(addr, &owner);
+        int written = addr != NULL && hint_for_server(antientropy, &owner, &reader)
+                      && put_stamped(store, batch, &reader, &key, &key_len) == 1;
+
+        if (!written || hints_add(hints, &owner, key, key_len) != ERR_NONE) {
+            header->status = PROTOCOL_ERROR;
+            batch_reply(batch, i, header, NULL, 0);
+        } else {
+            batch->puts[batch->nb_puts++] = batch->nb_out;
+            batch_reply(batch, i, header, NULL, 0);
+        }
+        break;
+    }
+
+    case PROTOCOL_MGET: {
+        char *reply = batch->replies + i * PROTOCOL_MAX_PAYLOAD;
+        batch_reply(batch, i, header, reply, pack_values(store, payload, size, reply));
+        break;
+    }
+
+    case PROTOCOL_MPUT: {
+        char *reply = batch->replies + i * PROTOCOL_MAX_PAYLOAD;
+        size_t written = 0;
+        size_t nb_pairs = put_pairs(store, batch, payload, size, reply, &written);
+
+        //acknowledged once synced, as a PUT
+        if (written > 0) batch->puts[batch->nb_puts++] = batch->nb_out;
+        batch_reply(batch, i, header, reply, nb_pairs);
+        break;
+    }
+
+    case PROTOCOL_CONCAT:
+    case PROTOCOL_SUBSTR:
+    case PROTOCOL_FIND: {
+        char *reply = batch->replies + i * PROTOCOL_MAX_PAYLOAD;
+        size_t reply_size = 0;
+
+        //<version> first, but for FIND which writes nothing
+        uint64_t version = 0;
+        if (header->opcode != PROTOCOL_FIND && protocol_next_stamp(&reader, &version)
+            && !hlc_observe(&server_clock, version)) {
+            header->status = PROTOCOL_ERROR;
+        } else {
+            header->status = value_operation(store, batch, header->opcode, reader.pos,
+                                             (size_t) (reader.end - reader.pos), reply, &reply_size, version);
+        }
+
+        //a new value is acknowledged once synced, as a PUT
+        if (header->status == PROTOCOL_OK && header->opcode != PROTOCOL_FIND) {
+            batch->puts[batch->nb_puts++] = batch->nb_out;
+        }
+        batch_reply(batch, i, header, reply, reply_size);
+        break;
+    }
+
+    case PROTOCOL_SCAN: {
+        //<next cursor>, then as many pairs as fit, read in place from the store
+        char *reply = batch->replies + i * PROTOCOL_MAX_PAYLOAD;
+        scan_page_t page = {reply, PROTOCOL_STAMP_SIZE, 0};
+        uint64_t cursor = size == PROTOCOL_STAMP_SIZE ? protocol_read_stamp(payload) : PROTOCOL_SCAN_END;
+
+        if (size != PROTOCOL_STAMP_SIZE
+            || store_scan(store, &cursor, PROTOCOL_SCAN_STREAMS, add_to_page, &page) != ERR_NONE
+            || page.too_large) {
+            header->status = PROTOCOL_ERROR;
+            batch_reply(batch, i, header, NULL, 0);
+        } else {
+            protocol_write_stamp(reply, cursor);
+            batch_reply(batch, i, header, reply, page.used);
+        }
+        break;
+    }
+
+    case PROTOCOL_MERKLE: {
+        char *reply = batch->replies + i * PROTOCOL_MAX_PAYLOAD;
+        size_t reply_size = 0;
+        header->status = antientropy_reply_tree(antientropy, payload, size, reply, &reply_size);
+        batch_reply(batch, i, header, reply, reply_size);
+        break;
+    }
+
+    case PROTOCOL_DIFF: {
+        char *reply = batch->replies + i * PROTOCOL_MAX_PAYLOAD;
+        batch_reply(batch, i, header, reply, antientropy_reply_diff(store, payload, size, reply));
+        break;
+    }
+
+    default:
+        header->status = PROTOCOL_BAD_OPCODE;
+        batch_reply(batch, i, header, NULL, 0);
+        break;
+    }
+}
+
+// =====================================================================
+
+static void batch_reply_value(batch_t *batch, size_t i, const protocol_header_t *header, const store_view_t *view)
+{
+    size_t o = batch->nb_out;
+    batch_reply(batch, i, header, view->view.value, view->view.length);
 
-                strncpy(value, (get0 + 1), sizeMsg - strlen(key));
+    //the version goes right after the header
+    protocol_write_stamp(batch->header_bytes[o] + PROTOCOL_HEADER_SIZE, view->view.version);
+    batch->out_iov[o][0].iov_len += PROTOCOL_STAMP_SIZE;
+}
+
+// =====================================================================
+
+static int put_stamped(store_t *store, batch_t *batch, protocol_reader_t *reader, const char **key, size_t *key_len)
+{
+    uint64_t version = 0;
+    const char *value = NULL;
+    size_t value_len = 0;
+
+    if (!protocol_next_stamp(reader, &version) || !protocol_next_field(reader, key, key_len)
+        || !protocol_next_field(reader, &value, &value_len)) {
+        return -1;
+    }
+
+    //longer fields could not be replayed from the log, nor sent back in a page of a dump,
+    //and a version from a clock too far ahead would win over all the writes to come
+    if (*key_len == 0 || !protocol_pair_fits(*key_len, value_len) || !hlc_observe(&server_clock, version)
+        || store_put(store, *key, *key_len, value, value_len, version) != ERR_NONE) {
+        return 0;
+    }
+
+    batch->dirty |= (uint64_t) 1 << store_shard_of(*key, *key_len);
+    return 1;
+}
+
+// =====================================================================
+
+static int hint_for_server(const antientropy_t *antientropy, const struct sockaddr_in *owner,
+                           const protocol_reader_t *pair)
+{
+    protocol_reader_t reader = *pair;
+    uint64_t version = 0;
+    const char *key = NULL;
+    size_t key_len = 0;
+    if (antientropy == NULL || !protocol_next_stamp(&reader, &version)
+        || !protocol_next_field(&reader, &key, &key_len)) {
+        return 0;
+    }
+
+    const node_t *servers[antientropy->N];
+    size_t nb_servers = ring_get_preference_list(antientropy->ring, key, key_len, antientropy->N, servers);
+
+    for (size_t s = 0; s < nb_servers; s++) {
+        if (servers[s]->srv_addr.sin_addr.s_addr == owner->sin_addr.s_addr
+            && servers[s]->srv_addr.sin_port == owner->sin_port) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// =====================================================================
+
+static size_t pack_values(store_t *store, const char *keys, size_t size, char *reply)
+{
+    size_t used = 0;
+
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, keys, size);
+
+    const char *key = NULL;
+    size_t key_len = 0;
+    while (used < PROTOCOL_MAX_PAYLOAD && protocol_next_field(&reader, &key, &key_len)) {
+        store_view_t view;
+        if (store_get_view(store, key, key_len, &view) != ERR_NONE) {
+            reply[used++] = PROTOCOL_NOT_FOUND;
+            continue;
+        }
+
+        //the keys that do not fit are left for another request
+        size_t length = view.view.length;
+        if (used + 1 + PROTOCOL_STAMP_SIZE + protocol_field_size(length) > PROTOCOL_MAX_PAYLOAD) {
+            store_release_view(store, &view);
+            break;
+        }
+
+        reply[used++] = PROTOCOL_OK;
+        protocol_write_stamp(reply + used, view.view.version);
+        used += PROTOCOL_STAMP_SIZE;
+        used += protocol_write_field(reply + used, view.view.value, length);
+
+        store_release_view(store, &view);
+    }
+
+    return used;
+}
+
+// =====================================================================
+
+static size_t put_pairs(store_t *store, batch_t *batch, const char *pairs, size_t size, char *reply, size_t *written)
+{
+    size_t nb_pairs = 0;
+
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, pairs, size);
+
+    //a truncated pair ends the request
+    const char *key = NULL;
+    size_t key_len = 0;
+    int put = 0;
+    while ((put = put_stamped(store, batch, &reader, &key, &key_len)) >= 0) {
+        reply[nb_pairs++] = put ? PROTOCOL_OK : PROTOCOL_ERROR;
+        *written += (size_t) put;
+    }
+
+    return nb_pairs;
+}
 
-                //Send '\0' if there was a problem in adding the value to the HTable, send NULL otherwise
-                if (add_Htable_value(table, key, value) != ERR_NONE) {
-                    char *datagram = calloc(1, sizeof(char));
-                    datagram[0] = '\0';
-                    sendto_err = sendto(s, datagram, 1, 0, (struct sockaddr *) &cli_addr, addr_len);
-                    free(datagram);
+// =====================================================================
+
+static size_t read_keys(protocol_reader_t *reader, const char **keys, size_t *lengths, size_t max)
+{
+    size_t nb_keys = 0;
+
+    while (nb_keys < max && !protocol_reader_done(reader)
+           && protocol_next_field(reader, &keys[nb_keys], &lengths[nb_keys])) {
+        ++nb_keys;
+    }
+
+    return nb_keys;
+}
+
+// =====================================================================
+
+static protocol_status_t value_operation(store_t *store, batch_t *batch, uint8_t opcode, const char *payload,
+                                         size_t size, char *reply, size_t *reply_size, uint64_t version)
+{
+    const char *keys[MAX_OPERATION_KEYS];
+    size_t lengths[MAX_OPERATION_KEYS];
+
+    uint64_t versions[MAX_OPERATION_KEYS] = {0};
+
+    protocol_reader_t reader;
+    protocol_reader_init(&reader, payload, size);
+    size_t nb_keys = 0;
+    if (opcode == PROTOCOL_FIND) {
+        nb_keys = read_keys(&reader, keys, lengths, 2);
+    } else if (protocol_next_field(&reader, &keys[0], &lengths[0])) {
+        //<dest>, then each key read after the version the client read of it
+        size_t max = opcode == PROTOCOL_CONCAT ? MAX_OPERATION_KEYS : 2;
+        nb_keys = 1;
+        while (nb_keys < max && !protocol_reader_done(&reader) && protocol_next_stamp(&reader, &versions[nb_keys])
+               && protocol_next_field(&reader, &keys[nb_keys], &lengths[nb_keys])) {
+            ++nb_keys;
+        }
+    }
+
+    //SUBSTR ends with <start><length>
+    uint64_t start = 0, length = 0;
+    if (opcode == PROTOCOL_SUBSTR && nb_keys == 2
+        && (!protocol_next_varint(&reader, &start) || !protocol_next_varint(&reader, &length))) {
+        return PROTOCOL_ERROR;
+    }
+
+    if (nb_keys < 2 || lengths[0] == 0 || !protocol_reader_done(&reader)) {
+        return PROTOCOL_ERROR;
+    }
+
+    //the keys read: all but the destination, FIND reads both of its keys
+    size_t first = opcode == PROTOCOL_FIND ? 0 : 1;
+
+    store_view_t views[MAX_OPERATION_KEYS];
+    size_t nb_views = 0;
+    for (size_t k = first; k < nb_keys; ++k) {
+        if (store_get_view(store, keys[k], lengths[k], &views[nb_views]) != ERR_NONE) break;
+        ++nb_views;
+    }
+
+    protocol_status_t status = nb_views == nb_keys - first ? PROTOCOL_OK : PROTOCOL_NOT_FOUND;
+
+    //a replica behind the ones the client read would write another value under the same version
+    for (size_t v = 0; status == PROTOCOL_OK && opcode != PROTOCOL_FIND && v < nb_views; ++v) {
+        if (views[v].view.version != versions[v + first]) status = PROTOCOL_NOT_FOUND;
+    }
+
+    //a manifest stands for a large value, whose chunks are not read here (see network_put_stream)
+    for (size_t v = 0; status == PROTOCOL_OK && v < nb_views; ++v) {
+        if (views[v].view.length > 0 && views[v].view.value[0] == '\0') status = PROTOCOL_ERROR;
+    }
+
+    if (status == PROTOCOL_OK && opcode == PROTOCOL_FIND) {
+        const char *found = memmem(views[0].view.value, views[0].view.length,
+                                   views[1].view.value, views[1].view.length);
+        int64_t index = found == NULL ? -1 : (int64_t) (found - views[0].view.value);
+        *reply_size = protocol_write_varint(reply, PROTOCOL_ZIGZAG(index));
+
+    } else if (status == PROTOCOL_OK) {
+        //the new value is built in the reply buffer, which is not sent
+        size_t value_len = 0;
+
+        if (opcode == PROTOCOL_CONCAT) {
+            for (size_t v = 0; status == PROTOCOL_OK && v < nb_views; ++v) {
+                if (value_len + views[v].view.length > MAX_MSG_ELEM_SIZE) {
+                    status = PROTOCOL_ERROR;
                 } else {
-                    sendto_err = sendto(s, NULL, 0, 0, (struct sockaddr *) &cli_addr, addr_len);
+                    memcpy(reply + value_len, views[v].view.value, views[v].view.length);
+                    value_len += views[v].view.length;
                 }
-                free(in_msg);
-                free(key);
-                free(value);
-
+            }
+        } else {
+            size_t offset = 0;
+            if (length > MAX_MSG_ELEM_SIZE
+                || substring_offset(views[0].view.length, (long) PROTOCOL_UNZIGZAG(start), (size_t) length,
+                                    &offset) != ERR_NONE) {
+                status = PROTOCOL_ERROR;
+            } else {
+                value_len = (size_t) length;
+                memcpy(reply, views[0].view.value + offset, value_len);
             }
         }
 
+        if (status == PROTOCOL_OK && (!protocol_pair_fits(lengths[0], value_len)
+                                      || store_put(store, keys[0], lengths[0], reply, value_len, version) != ERR_NONE)) {
+            status = PROTOCOL_ERROR;
+        }
+        if (status == PROTOCOL_OK) {
+            batch->dirty |= (uint64_t) 1 << store_shard_of(keys[0], lengths[0]);
+        }
+    }
+
+    for (size_t v = 0; v < nb_views; ++v) {
+        store_release_view(store, &views[v]);
     }
 
-    delete_Htable_and_content(&table);
+    return status;
+}
+
+// =====================================================================
+
+static int add_to_page(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version)
+{
+    scan_page_t *page = arg;
+    size_t size = PROTOCOL_STAMP_SIZE + protocol_field_size(key_len) + protocol_field_size(value_len);
+
+    if (page->used + size > PROTOCOL_MAX_PAYLOAD) {
+        //such a pair is refused when written (see protocol_pair_fits), the dump fails rather than missing it
+        if (page->used == PROTOCOL_STAMP_SIZE) {
+            fprintf(stderr, "The pair of key %.*s is too large for a page of a scan\n", (int) key_len, key);
+            page->too_large = 1;
+        }
+        return 0;
+    }
 
-    return EXIT_SUCCESS;
+    protocol_write_stamp(page->buffer + page->used, version);
+    page->used += PROTOCOL_STAMP_SIZE;
+    page->used += protocol_write_field(page->buffer + page->used, key, key_len);
+    page->used += protocol_write_field(page->buffer + page->used, value, value_len);
+    return 1;
 }
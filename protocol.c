@@ -0,0 +1,224 @@
+/**
+ * @file protocol.c
+ * @brief Implementation of protocol.h
+ *
+ * @date 18.10.2026
+ */
+
+#include <string.h>
+#include <arpa/inet.h> // for htonl
+
+#include "protocol.h"
+
+// =====================================================================
+
+void protocol_write_header(void *buffer, const protocol_header_t *header)
+{
+    uint8_t *bytes = buffer;
+    uint32_t id = htonl(header->id);
+
+    bytes[0] = PROTOCOL_MAGIC;
+    bytes[1] = header->version;
+    bytes[2] = header->opcode;
+    bytes[3] = header->status;
+    memcpy(bytes + 4, &id, sizeof(id));
+}
+
+// =====================================================================
+
+int protocol_read_header(const void *buffer, size_t size, protocol_header_t *header)
+{
+    const uint8_t *bytes = buffer;
+
+    if (size < PROTOCOL_HEADER_SIZE || bytes[0] != PROTOCOL_MAGIC) return 0;
+
+    uint32_t id = 0;
+    memcpy(&id, bytes + 4, sizeof(id));
+
+    header->version = bytes[1];
+    header->opcode = bytes[2];
+    header->status = bytes[3];
+    header->id = ntohl(id);
+
+    return 1;
+}
+
+// =====================================================================
+
+void protocol_write_addr(void *buffer, const struct sockaddr_in *addr)
+{
+    uint8_t *bytes = buffer;
+
+    memcpy(bytes, &addr->sin_addr.s_addr, 4);
+    memcpy(bytes + 4, &addr->sin_port, 2);
+}
+
+// =====================================================================
+
+void protocol_read_addr(const void *buffer, struct sockaddr_in *addr)
+{
+    const uint8_t *bytes = buffer;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    memcpy(&addr->sin_addr.s_addr, bytes, 4);
+    memcpy(&addr->sin_port, bytes + 4, 2);
+}
+
+// =====================================================================
+
+void protocol_write_stamp(void *buffer, uint64_t version)
+{
+    uint8_t *bytes = buffer;
+
+    for (size_t i = 0; i < PROTOCOL_STAMP_SIZE; ++i) {
+        bytes[i] = (uint8_t) (version >> (8 * (PROTOCOL_STAMP_SIZE - 1 - i)));
+    }
+}
+
+// =====================================================================
+
+uint64_t protocol_read_stamp(const void *buffer)
+{
+    const uint8_t *bytes = buffer;
+
+    uint64_t version = 0;
+    for (size_t i = 0; i < PROTOCOL_STAMP_SIZE; ++i) {
+        version = (version << 8) | bytes[i];
+    }
+    return version;
+}
+
+// =====================================================================
+
+uint64_t protocol_digest(const char *value, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *) value;
+
+    uint64_t digest = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        digest = (digest ^ bytes[i]) * 1099511628211ULL;
+    }
+    return digest;
+}
+
+// =====================================================================
+
+size_t protocol_varint_size(uint64_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+// =====================================================================
+
+size_t protocol_write_varint(void *buffer, uint64_t value)
+{
+    uint8_t *bytes = buffer;
+
+    size_t i = 0;
+    while (value >= 0x80) {
+        bytes[i++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    bytes[i++] = (uint8_t) value;
+    return i;
+}
+
+// =====================================================================
+
+size_t protocol_field_size(size_t length)
+{
+    return protocol_varint_size(length) + length;
+}
+
+// =====================================================================
+
+int protocol_pair_fits(size_t key_len, size_t value_len)
+{
+    return key_len <= MAX_MSG_ELEM_SIZE && value_len <= MAX_MSG_ELEM_SIZE
+           && 2 * PROTOCOL_STAMP_SIZE + protocol_field_size(key_len) + protocol_field_size(value_len)
+              <= PROTOCOL_MAX_PAYLOAD;
+}
+
+// =====================================================================
+
+size_t protocol_write_field(void *buffer, const void *data, size_t length)
+{
+    uint8_t *bytes = buffer;
+
+    size_t prefix = protocol_write_varint(bytes, length);
+    if (length > 0) memcpy(bytes + prefix, data, length);
+    return prefix + length;
+}
+
+// =====================================================================
+
+void protocol_reader_init(protocol_reader_t *reader, const void *payload, size_t size)
+{
+    reader->pos = payload;
+    reader->end = reader->pos + size;
+}
+
+// =====================================================================
+
+int protocol_next_varint(protocol_reader_t *reader, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < PROTOCOL_VARINT_MAX && reader->pos < reader->end; ++i) {
+        uint8_t byte = (uint8_t) *reader->pos++;
+        result |= (uint64_t) (byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// =====================================================================
+
+int protocol_next_field(protocol_reader_t *reader, const char **data, size_t *length)
+{
+    uint64_t field_length = 0;
+    if (!protocol_next_varint(reader, &field_length)) return 0;
+    if (field_length > (uint64_t) (reader->end - reader->pos)) return 0;
+
+    *data = reader->pos;
+    *length = (size_t) field_length;
+    reader->pos += field_length;
+    return 1;
+}
+
+// =====================================================================
+
+const char *protocol_next_bytes(protocol_reader_t *reader, size_t size)
+{
+    if (size > (size_t) (reader->end - reader->pos)) return NULL;
+
+    const char *bytes = reader->pos;
+    reader->pos += size;
+    return bytes;
+}
+
+// =====================================================================
+
+int protocol_next_stamp(protocol_reader_t *reader, uint64_t *version)
+{
+    const char *bytes = protocol_next_bytes(reader, PROTOCOL_STAMP_SIZE);
+    if (bytes == NULL) return 0;
+
+    *version = protocol_read_stamp(bytes);
+    return 1;
+}
+
+// =====================================================================
+
+int protocol_reader_done(const protocol_reader_t *reader)
+{
+    return reader->pos == reader->end;
+}
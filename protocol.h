@@ -0,0 +1,268 @@
+#pragma once
+
+/**
+ * @file protocol.h
+ * @brief Header of the datagrams exchanged by the clients and the servers.
+ *
+ *        A request is a header followed by its payload, and its reply is a
+ *        header with the same request ID followed by the reply payload:
+ *
+ *            magic (1 byte) | version (1) | opcode (1) | flags or status (1) | request ID (4, big endian)
+ *
+ *        The fourth byte holds the flags of a request (none is defined yet,
+ *        they must be 0) and the status of a reply. The magic byte (0xFF) can
+ *        not start a key, so the servers still understand the datagrams
+ *        without header of the first protocol, but for its dump: they answer
+ *        it with the header of a PROTOCOL_SCAN of status PROTOCOL_ERROR.
+ *
+ *        The keys and the values are fields: their length as a varint (LEB128,
+ *        7 bits per byte, least significant first, the high bit set on all
+ *        but the last byte) followed by their bytes, which may hold any byte,
+ *        '\0' included. A payload is thus read in one pass, without searching
+ *        the end of its keys (see protocol_reader_t). The values are written
+ *        and read with their version (<version>, PROTOCOL_STAMP_SIZE bytes,
+ *        big endian, see hlc.h).
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h>
+#include <netinet/in.h> // for struct sockaddr_in
+
+#include "config.h"
+
+#define PROTOCOL_MAGIC 0xFF
+#define PROTOCOL_VERSION 4
+#define PROTOCOL_HEADER_SIZE 8
+#define PROTOCOL_ADDR_SIZE 6 // IPv4 address and port of a server, network order
+#define PROTOCOL_STAMP_SIZE 8 // version of a value
+#define PROTOCOL_DIGEST_SIZE 8 // digest of a value
+#define PROTOCOL_VARINT_MAX 10 // bytes of the longest varint (64 bits)
+
+/**
+ * @brief maximum size of a payload (a datagram is at most MAX_MSG_SIZE bytes)
+ */
+#define PROTOCOL_MAX_PAYLOAD (MAX_MSG_SIZE - PROTOCOL_HEADER_SIZE)
+
+/**
+ * @brief a scan of the content of a server is split in independent streams,
+ *        the cursor of each one starting at PROTOCOL_SCAN_START(stream) and
+ *        going on until a reply gives PROTOCOL_SCAN_END as next cursor: a client
+ *        asks the pages of several streams at once
+ */
+#define PROTOCOL_SCAN_STREAMS 64
+#define PROTOCOL_SCAN_START(stream) ((uint64_t) (stream) << 56)
+#define PROTOCOL_SCAN_END UINT64_MAX
+
+/**
+ * @brief maximum number of keys of a CONCAT, destination included
+ */
+#define MAX_OPERATION_KEYS 256
+
+/**
+ * @brief operations of the versioned protocol, <key> and <value> being fields
+ */
+typedef enum {
+    PROTOCOL_PING = 1, // no payload, no reply payload
+    PROTOCOL_GET,      // <key>, replies <version><value>
+    PROTOCOL_PUT,      // <version><key><value>, no reply payload; an older version than the
+                       // one stored is acknowledged but not written
+    PROTOCOL_MGET,     // <key1><key2>...<keyK>, replies for each key in order
+                       // a status byte followed by <version><value> if it is PROTOCOL_OK;
+                       // a full reply stops early, the missing keys have to be asked again
+    PROTOCOL_MPUT,     // <version1><key1><value1><version2><key2><value2>..., replies a status byte per pair
+    PROTOCOL_CONCAT,   // <version><dest><version1><src1>...<versionK><srcK>, stores the concatenation of the
+                       // local values if they are of the versions the client read, replies PROTOCOL_NOT_FOUND otherwise
+    PROTOCOL_SUBSTR,   // <version><dest><version1><src><start><length>, stores a substring of the local value,
+                       // likewise (start a zigzag varint, negative from the end, length a varint)
+    PROTOCOL_FIND,     // <key1><key2>, replies the index of value2 in value1 (-1 if none), as a zigzag varint
+    PROTOCOL_HINT,     // <owner><version><key><value>: a PUT in place of the server <owner>
+                       // (PROTOCOL_ADDR_SIZE bytes), which the server hands over to it later (see hints.h);
+                       // refused unless <owner> is in the preference list of the key on the ring of the server
+    PROTOCOL_MERKLE,   // <peer><level><index1><index2>... (level 1 byte, indices 4 bytes big endian), replies the
+                       // MERKLE_FANOUT child hashes (8 bytes big endian) of each node, in the hash tree over the
+                       // leaves shared with the server <peer> (see antientropy.h); the root rebuilds the tree
+    PROTOCOL_DIFF,     // <version1><key1><version2><key2>..., replies a status byte per key: PROTOCOL_OK if the
+                       // server holds that version or a newer one, PROTOCOL_NOT_FOUND if it needs the value
+    PROTOCOL_DIGEST,   // <key>, replies <version><digest> (PROTOCOL_DIGEST_SIZE bytes, big endian, see
+                       // protocol_digest): a GET of the replicas whose value is only compared
+    PROTOCOL_SCAN      // <cursor> (8 bytes big endian), replies a page of the content of the server,
+                       // <next cursor><version1><key1><value1><version2><key2><value2>...
+                       // (see PROTOCOL_SCAN_STREAMS); asking the same cursor again replies the same page
+} protocol_opcode_t;
+
+/**
+ * @brief status of a reply (the flags of a request, 0)
+ */
+typedef enum {
+    PROTOCOL_OK = 0,
+    PROTOCOL_NOT_FOUND,
+    PROTOCOL_ERROR,
+    PROTOCOL_BAD_VERSION, // the reply carries the version of the server
+    PROTOCOL_BAD_OPCODE,
+    PROTOCOL_UNREACHABLE  // never sent: the server could not be reached
+} protocol_status_t;
+
+/**
+ * @brief decoded header
+ */
+typedef struct {
+    uint8_t version;
+    uint8_t opcode;
+    uint8_t status; // flags of a request
+    uint32_t id;
+} protocol_header_t;
+
+/**
+ * @brief a signed integer as a varint: 0, -1, 1, -2... become 0, 1, 2, 3...
+ */
+#define PROTOCOL_ZIGZAG(n) (((uint64_t) (n) << 1) ^ (uint64_t) -((uint64_t) (n) >> 63))
+#define PROTOCOL_UNZIGZAG(u) ((int64_t) (((u) >> 1) ^ -((u) & 1)))
+
+/**
+ * @brief position in a payload being decoded
+ */
+typedef struct {
+    const char *pos;
+    const char *end;
+} protocol_reader_t;
+
+/**
+ * @brief encode a header
+ * @param buffer where to write the PROTOCOL_HEADER_SIZE bytes
+ * @param header the header
+ */
+void protocol_write_header(void *buffer, const protocol_header_t *header);
+
+/**
+ * @brief decode the header of a datagram
+ * @param buffer the datagram
+ * @param size its size
+ * @param header where to store the header
+ * @return 1 if the datagram has a header, 0 if it is a datagram of the first protocol
+ */
+int protocol_read_header(const void *buffer, size_t size, protocol_header_t *header);
+
+/**
+ * @brief encode the address of a server
+ * @param buffer where to write the PROTOCOL_ADDR_SIZE bytes
+ * @param addr the address
+ */
+void protocol_write_addr(void *buffer, const struct sockaddr_in *addr);
+
+/**
+ * @brief decode the address of a server
+ * @param buffer the PROTOCOL_ADDR_SIZE bytes
+ * @param addr where to store the address
+ */
+void protocol_read_addr(const void *buffer, struct sockaddr_in *addr);
+
+/**
+ * @brief encode the version of a value
+ * @param buffer where to write the PROTOCOL_STAMP_SIZE bytes
+ * @param version the version
+ */
+void protocol_write_stamp(void *buffer, uint64_t version);
+
+/**
+ * @brief decode the version of a value
+ * @param buffer the PROTOCOL_STAMP_SIZE bytes
+ * @return the version
+ */
+uint64_t protocol_read_stamp(const void *buffer);
+
+/**
+ * @brief digest of a value, sent instead of the value by PROTOCOL_DIGEST
+ * @param value the value
+ * @param length its length
+ * @return the digest (FNV-1a, 64 bits)
+ */
+uint64_t protocol_digest(const char *value, size_t length);
+
+/**
+ * @brief size of a varint
+ * @param value the integer
+ * @return the number of bytes protocol_write_varint writes, at most PROTOCOL_VARINT_MAX
+ */
+size_t protocol_varint_size(uint64_t value);
+
+/**
+ * @brief encode a varint
+ * @param buffer where to write it
+ * @param value the integer
+ * @return the number of bytes written
+ */
+size_t protocol_write_varint(void *buffer, uint64_t value);
+
+/**
+ * @brief size of a field
+ * @param length length of its content
+ * @return the size of the field, length prefix included
+ */
+size_t protocol_field_size(size_t length);
+
+/**
+ * @brief whether a pair may be written: its key and its value are at most
+ *        MAX_MSG_ELEM_SIZE bytes (the longest fields read back from a log),
+ *        and with its version it fits in a page of a scan after the cursor
+ * @param key_len length of the key
+ * @param value_len length of the value
+ * @return 1 if it fits, 0 otherwise
+ */
+int protocol_pair_fits(size_t key_len, size_t value_len);
+
+/**
+ * @brief encode a field
+ * @param buffer where to write the protocol_field_size(length) bytes
+ * @param data its content
+ * @param length length of the content
+ * @return the number of bytes written
+ */
+size_t protocol_write_field(void *buffer, const void *data, size_t length);
+
+/**
+ * @brief start decoding a payload
+ * @param reader the reader
+ * @param payload the payload
+ * @param size its size
+ */
+void protocol_reader_init(protocol_reader_t *reader, const void *payload, size_t size);
+
+/**
+ * @brief decode a varint
+ * @param reader the reader, moved past the varint
+ * @param value where to store the integer
+ * @return 1 on success, 0 if the payload ends or the varint is too long
+ */
+int protocol_next_varint(protocol_reader_t *reader, uint64_t *value);
+
+/**
+ * @brief decode a field, in place
+ * @param reader the reader, moved past the field
+ * @param data where to store a pointer to its content, in the payload (not terminated)
+ * @param length where to store the length of the content
+ * @return 1 on success, 0 if the payload ends before the field
+ */
+int protocol_next_field(protocol_reader_t *reader, const char **data, size_t *length);
+
+/**
+ * @brief decode bytes of a fixed size (address, stamp...), in place
+ * @param reader the reader, moved past the bytes
+ * @param size number of bytes
+ * @return a pointer to the bytes in the payload, NULL if the payload ends before them
+ */
+const char *protocol_next_bytes(protocol_reader_t *reader, size_t size);
+
+/**
+ * @brief decode the version of a value
+ * @param reader the reader, moved past the version
+ * @param version where to store the version
+ * @return 1 on success, 0 if the payload ends before it
+ */
+int protocol_next_stamp(protocol_reader_t *reader, uint64_t *version);
+
+/**
+ * @brief whether a payload is decoded
+ * @param reader the reader
+ * @return 1 if nothing is left
+ */
+int protocol_reader_done(const protocol_reader_t *reader);
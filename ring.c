@@ -12,9 +12,47 @@
 #include "hashtable.h"
 #include "node_list.h"
 
-#define MAX_IP_SIZE 15
-#define MAX_PORT_LENGTH 5
-#define MAX_SIZE_IP_PORT 20
+/**
+ * @brief first 8 bytes of a digest, as an integer ordered like the digests
+ * @param sha the digest
+ * @return the prefix
+ */
+static uint64_t sha_prefix(const unsigned char *sha);
+
+/**
+ * @brief index of the first node whose digest is not smaller than a digest
+ *        (0 after the last one: the ring wraps)
+ * @param index the index
+ * @param sha the digest
+ * @return the position in the index
+ */
+static size_t index_find(const struct ring_index *index, const unsigned char *sha);
+
+/**
+ * @brief free an index
+ * @param index the index, may be NULL
+ */
+static void index_free(struct ring_index *index);
+
+/**
+ * @brief a node of the index being built and its server
+ */
+typedef struct {
+    const unsigned char *server_SHA;
+    uint32_t node;
+} server_ref_t;
+
+/**
+ * @brief compare two server_ref_t by server (for qsort)
+ */
+static int cmp_server(const void *a, const void *b);
+
+/**
+ * @brief compare two nodes by digest (for qsort)
+ */
+static int cmp_sha(const void *a, const void *b);
+
+// =====================================================================
 
 ring_t *ring_alloc(){
     ring_t* ring = node_list_new();
@@ -42,17 +80,149 @@ error_code ring_init(ring_t *ring){
     *ring = *newRing;
     free(newRing);
 
-    return ERR_NONE;
+    return ring_build_index(ring);
 }
 
 
 void ring_free(ring_t *ring){
+    if (ring != NULL) {
+        index_free(ring->index);
+        ring->index = NULL;
+    }
     node_list_free(ring);
 }
 
+// =====================================================================
+
+error_code ring_build_index(ring_t *ring){
+    M_REQUIRE_NON_NULL(ring);
+    M_REQUIRE(ring->size > 0 && ring->size <= UINT32_MAX, ERR_BAD_PARAMETER, "ring of %zu nodes", ring->size);
+
+    struct ring_index *index = calloc(1, sizeof(struct ring_index));
+    M_EXIT_IF_NULL(index, sizeof(struct ring_index), "ring_build_index");
+
+    size_t n = ring->size;
+    index->nb_nodes = n;
+    index->prefixes = calloc(n, sizeof(uint64_t));
+    index->nodes = calloc(n, sizeof(node_t));
+    server_ref_t *by_server = calloc(n, sizeof(server_ref_t));
+    uint32_t *server_of = calloc(n, sizeof(uint32_t));
+    uint32_t *seen = calloc(n, sizeof(uint32_t));
+
+    if (index->prefixes == NULL || index->nodes == NULL || by_server == NULL || server_of == NULL || seen == NULL) {
+        free(by_server);
+        free(server_of);
+        free(seen);
+        index_free(index);
+        return ERR_NOMEM;
+    }
+
+    //the ring order, whatever the order of the list
+    memcpy(index->nodes, ring->nodes, n * sizeof(node_t));
+    qsort(index->nodes, n, sizeof(node_t), cmp_sha);
+
+    for (size_t i = 0; i < n; ++i) {
+        index->prefixes[i] = sha_prefix(index->nodes[i].SHA);
+        by_server[i].server_SHA = index->nodes[i].server_SHA;
+        by_server[i].node = (uint32_t) i;
+    }
+
+    //number the servers: nodes of the same server are next to each other once sorted
+    qsort(by_server, n, sizeof(server_ref_t), cmp_server);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (i > 0 && cmp_server(&by_server[i], &by_server[i - 1]) != 0) {
+            ++(index->nb_servers);
+        }
+        server_of[by_server[i].node] = (uint32_t) index->nb_servers;
+    }
+    ++(index->nb_servers);
+
+    index->nb_successors = index->nb_servers < RING_MAX_PREFERENCE ? index->nb_servers : RING_MAX_PREFERENCE;
+    index->successors = calloc(n * index->nb_successors, sizeof(uint32_t));
+
+    //servers already in the list of a node, stamped with the node
+    for (size_t i = 0; i < n; ++i) seen[i] = UINT32_MAX;
+
+    for (size_t i = 0; index->successors != NULL && i < n; ++i) {
+        uint32_t *succ = &index->successors[i * index->nb_successors];
+        size_t found = 0;
+
+        for (size_t j = i; found < index->nb_successors; j = (j + 1) % n) {
+            if (seen[server_of[j]] != i) {
+                seen[server_of[j]] = (uint32_t) i;
+                succ[found++] = (uint32_t) j;
+            }
+        }
+    }
+
+    free(by_server);
+    free(server_of);
+    free(seen);
+
+    if (index->successors == NULL) {
+        index_free(index);
+        return ERR_NOMEM;
+    }
+
+    index_free(ring->index);
+    ring->index = index;
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+size_t ring_get_preference_list(const ring_t *ring, pps_key_t key, size_t key_len, size_t wanted,
+                                const node_t **nodes){
+    if (ring == NULL || ring->index == NULL || key == NULL || nodes == NULL) return 0;
+
+    const struct ring_index *index = ring->index;
+
+    //compute the SHA-1 of the key
+    unsigned char SHA_key[SHA_DIGEST_LENGTH];
+    SHA1((const unsigned char *) key, key_len, SHA_key);
+
+    size_t start = index_find(index, SHA_key);
+
+    if (wanted > index->nb_servers) {
+        wanted = index->nb_servers;
+    }
+
+    //precomputed
+    if (wanted <= index->nb_successors) {
+        const uint32_t *succ = &index->successors[start * index->nb_successors];
+        for (size_t i = 0; i < wanted; ++i) {
+            nodes[i] = &index->nodes[succ[i]];
+        }
+        return wanted;
+    }
+
+    //longer lists: walk the ring
+    size_t found = 0;
+    for (size_t j = start; found < wanted; j = (j + 1) % index->nb_nodes) {
+        const node_t *node = &index->nodes[j];
+        int seen = 0;
+        for (size_t k = 0; !seen && k < found; ++k) {
+            seen = memcmp(nodes[k]->server_SHA, node->server_SHA, SHA_DIGEST_LENGTH) == 0;
+        }
+        if (!seen) {
+            nodes[found++] = node;
+        }
+    }
+
+    return found;
+}
+
+// =====================================================================
 
 node_list_t *ring_get_nodes_for_key(const ring_t *ring, size_t wanted_list_size, pps_key_t key){
 
+    if (ring == NULL || ring->index == NULL || key == NULL) {
+        fprintf(stderr, "Error: ring without index in ring_get_nodes_for_key\n");
+        return NULL;
+    }
+
     node_list_t* list = node_list_new();
 
     if(list == NULL){
@@ -60,70 +230,84 @@ node_list_t *ring_get_nodes_for_key(const ring_t *ring, size_t wanted_list_size,
         return NULL;
     }
 
-    //compute the SHA-1 of the key
-    char SHA_key[SHA_DIGEST_LENGTH];
-    memset(SHA_key, 0, SHA_DIGEST_LENGTH*sizeof(char));
-    SHA1(key, strlen(key), SHA_key);
-
-    //construct an hashtable that stores the strings <IP><port> with a value "seen"
-    const char seen[] = "seen";
-    Htable_t ip_port_table = construct_Htable(wanted_list_size);
-    if(ip_port_table == NULL){
-        node_list_free(list);
-        fprintf(stderr, "Could not construct a hashtable in ring_get_nodes_for_key\n");
+    size_t max = wanted_list_size < ring->index->nb_servers ? wanted_list_size : ring->index->nb_servers;
+    const node_t **nodes = calloc(max + 1, sizeof(node_t *));
+    list->nodes = calloc(max + 1, sizeof(node_t));
+
+    if (nodes == NULL || list->nodes == NULL) {
+        fprintf(stderr, "Error: could not allocate the nodes in ring_get_nodes_for_key\n");
+        free(nodes);
+        free(list->nodes);
+        free(list);
         return NULL;
     }
 
-    //skip the nodes s.t SHA_node < SHA_key
-    size_t i = 0;
-
-    while(i < ring->size && strcmp(ring->nodes[i].SHA, SHA_key) < 0){
-        i++;
+    list->size = ring_get_preference_list(ring, key, strlen(key), wanted_list_size, nodes);
+    for (size_t i = 0; i < list->size; ++i) {
+        list->nodes[i] = *nodes[i];
     }
 
-    //find the N wand_list_size servers
-    size_t nbr_servers = 0;
-    while(nbr_servers < wanted_list_size){
+    free(nodes);
+    return list;
 
-        //build the key of the hashtable
-        char ip_port[MAX_SIZE_IP_PORT+1];
-        memset(ip_port, 0, (MAX_SIZE_IP_PORT+1)*sizeof(char));
-        strncpy(ip_port, ring->nodes[i].ip, MAX_IP_SIZE);
-        char port_str[MAX_PORT_LENGTH + 1];
-        memset(port_str, 0, (MAX_PORT_LENGTH+1)*sizeof(char));
+}
 
-        if(sprintf(port_str, "%hu",ring->nodes[i].port ) < 0){
-            fprintf(stderr, "Error: could not convert the port into a string\n");
-            delete_Htable_and_content(&ip_port_table);
-            node_list_free(list);
-            return NULL;
-        }
-        strncat(ip_port, port_str, MAX_PORT_LENGTH);
-
-        //the server has not been seen yet
-        if(get_Htable_value(ip_port_table, ip_port) == NULL){
-            nbr_servers++;
-            if(node_list_add(list, ring->nodes[i]) != ERR_NONE){
-                fprintf(stderr, "Error: could add a new node to the list in ring_get_nodes_for_key\n");
-                delete_Htable_and_content(&ip_port_table);
-                node_list_free(list);
-                return NULL;
-            }
+// =====================================================================
 
-            if(add_Htable_value(ip_port_table,ip_port, seen) != ERR_NONE){
-                    fprintf(stderr, "Error: could add a new pair IP/port to the hashtable in ring_get_nodes_for_key\n");
-                    delete_Htable_and_content(&ip_port_table);
-                    node_list_free(list);
-                    return NULL;
-            }
+static uint64_t sha_prefix(const unsigned char *sha){
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        prefix = (prefix << 8) | sha[i];
+    }
+    return prefix;
+}
+
+// =====================================================================
 
+static size_t index_find(const struct ring_index *index, const unsigned char *sha){
+    uint64_t prefix = sha_prefix(sha);
+
+    //first prefix >= the one of the key
+    size_t low = 0, high = index->nb_nodes;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->prefixes[mid] < prefix) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
+    }
 
-        i = (i+1)%ring->size;
+    //same prefix: compare the whole digests
+    while (low < index->nb_nodes && index->prefixes[low] == prefix
+           && memcmp(index->nodes[low].SHA, sha, SHA_DIGEST_LENGTH) < 0) {
+        ++low;
     }
 
-    delete_Htable_and_content(&ip_port_table);
+    return low == index->nb_nodes ? 0 : low;
+}
+
+// =====================================================================
 
-    return list;
+static void index_free(struct ring_index *index){
+    if (index == NULL) return;
+
+    free(index->prefixes);
+    free(index->nodes);
+    free(index->successors);
+    free(index);
+}
+
+// =====================================================================
+
+static int cmp_server(const void *a, const void *b){
+    const server_ref_t *first = a;
+    const server_ref_t *second = b;
+    return memcmp(first->server_SHA, second->server_SHA, SHA_DIGEST_LENGTH);
+}
+
+// =====================================================================
 
+static int cmp_sha(const void *a, const void *b){
+    return node_cmp_sha(a, b);
 }
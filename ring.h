@@ -19,6 +19,24 @@
  */
 typedef node_list_t ring_t;
 
+/**
+ * @brief number of distinct servers precomputed after each node of the ring
+ *        (longer preference lists are computed by walking the ring)
+ */
+#define RING_MAX_PREFERENCE 32
+
+/**
+ * @brief lookup index of a ring, built once by ring_init
+ */
+struct ring_index {
+    size_t nb_nodes;
+    uint64_t *prefixes;      // first 8 bytes of the digests, sorted, for the binary search
+    node_t *nodes;           // copies of the nodes in digest order (their strings belong to the ring)
+    size_t nb_servers;       // number of distinct servers
+    size_t nb_successors;    // min(nb_servers, RING_MAX_PREFERENCE)
+    uint32_t *successors;    // for each node, the nodes of the next nb_successors distinct servers (itself first)
+};
+
 /**
  * @brief creates a new ring of nodes
  * @return a newly created ring
@@ -32,17 +50,40 @@ ring_t *ring_alloc();
  */
 error_code ring_init(ring_t *ring);
 
+/**
+ * @brief (re)build the lookup index of a ring from its nodes
+ *        (done by ring_init, the nodes may be reordered afterwards)
+ * @param ring the ring (modified)
+ * @return some error code
+ */
+error_code ring_build_index(ring_t *ring);
+
 /**
  * @brief destroy a ring of nodes
  * @param ring the ring to be destroyed
  */
 void ring_free(ring_t *ring);
 
+/**
+ * @brief preference list of a key, without allocating: the first node whose
+ *        digest follows the one of the key, then the next nodes of other servers
+ * @param ring the ring, with its index
+ * @param key the key
+ * @param key_len length of the key
+ * @param wanted number of distinct servers wanted
+ * @param nodes where to store pointers to the nodes (room for wanted pointers),
+ *        valid as long as the ring
+ * @return the number of nodes stored, less than wanted if there are not enough servers
+ */
+size_t ring_get_preference_list(const ring_t *ring, pps_key_t key, size_t key_len, size_t wanted,
+                                const node_t **nodes);
+
 /**
  * @brief search nodes storing for a key
  * @param  ring the ring of nodes to search into
  * @param  wanted_list_size minimum of nodes wanted
  * @param  key the key for which we are looking for
- * @return the list of all nodes storing the key
+ * @return the list of all nodes storing the key (copies sharing their strings
+ *         with the ring: free them with free(list->nodes) and free(list))
  */
 node_list_t *ring_get_nodes_for_key(const ring_t *ring, size_t wanted_list_size, pps_key_t key);
@@ -0,0 +1,234 @@
+/**
+ * @file slab.c
+ * @brief Implementation of slab.h
+ *
+ * @date 18.10.2026
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "slab.h"
+
+#define SLAB_ALIGN 8
+
+/**
+ * @brief find the size class for a chunk size
+ * @param slab the allocator
+ * @param size number of bytes needed
+ * @return the index of the smallest class that fits, nb_classes if none fits
+ */
+static size_t class_of(const slab_t* slab, size_t size);
+
+/**
+ * @brief allocate a new page for a class and carve it into free chunks
+ * @param class the class to refill
+ * @return 1 on success, 0 if there is no memory left
+ */
+static int refill(slab_class_t* class);
+
+// =====================================================================
+
+void slab_init(slab_t* slab)
+{
+    if (slab == NULL) return;
+
+    size_t size = SLAB_MIN_CHUNK;
+    size_t nb = 0;
+
+    //each class is 1.125 times bigger than the previous one (8 bytes aligned)
+    while (nb < SLAB_NB_CLASSES - 1 && size < SLAB_MAX_CHUNK) {
+        slab_class_t class = {size, 0, 0, 0, SLAB_FIRST_PAGE, NULL, NULL};
+        slab->classes[nb++] = class;
+        size = (size + size / 8 + SLAB_ALIGN - 1) & ~((size_t) SLAB_ALIGN - 1);
+    }
+
+    slab_class_t last = {SLAB_MAX_CHUNK, 0, 0, 0, SLAB_FIRST_PAGE, NULL, NULL};
+    slab->classes[nb++] = last;
+
+    slab->nb_classes = nb;
+    slab->large_chunks = 0;
+    slab->large_bytes = 0;
+}
+
+// =====================================================================
+
+void slab_destroy(slab_t* slab)
+{
+    if (slab == NULL) return;
+
+    for (size_t i = 0; i < slab->nb_classes; ++i) {
+        void* page = slab->classes[i].pages;
+        while (page != NULL) {
+            void* next = *(void**) page;
+            free(page);
+            page = next;
+        }
+        slab->classes[i].pages = NULL;
+        slab->classes[i].free_list = NULL;
+        slab->classes[i].total_chunks = 0;
+        slab->classes[i].used_chunks = 0;
+        slab->classes[i].used_bytes = 0;
+    }
+}
+
+// =====================================================================
+
+void* slab_alloc(slab_t* slab, size_t size, size_t* usable)
+{
+    if (slab == NULL || usable == NULL) return NULL;
+
+    size_t c = class_of(slab, size);
+
+    if (c == slab->nb_classes) {
+        void* ptr = malloc(size);
+        if (ptr != NULL) {
+            *usable = size;
+            ++(slab->large_chunks);
+            slab->large_bytes += size;
+        }
+        return ptr;
+    }
+
+    slab_class_t* class = &slab->classes[c];
+
+    if (class->free_list == NULL && !refill(class)) {
+        return NULL;
+    }
+
+    void* chunk = class->free_list;
+    class->free_list = *(void**) chunk;
+    ++(class->used_chunks);
+    class->used_bytes += size;
+    *usable = class->chunk_size;
+
+    return chunk;
+}
+
+// =====================================================================
+
+void slab_free(slab_t* slab, void* ptr, size_t usable, size_t size)
+{
+    if (slab == NULL || ptr == NULL) return;
+
+    size_t c = class_of(slab, usable);
+
+    if (c == slab->nb_classes) {
+        free(ptr);
+        --(slab->large_chunks);
+        slab->large_bytes -= usable;
+        return;
+    }
+
+    slab_class_t* class = &slab->classes[c];
+    *(void**) ptr = class->free_list;
+    class->free_list = ptr;
+    --(class->used_chunks);
+    class->used_bytes -= size;
+}
+
+// =====================================================================
+
+void slab_resize(slab_t* slab, size_t usable, size_t old_size, size_t new_size)
+{
+    if (slab == NULL) return;
+
+    size_t c = class_of(slab, usable);
+    if (c == slab->nb_classes) return;
+
+    slab->classes[c].used_bytes = slab->classes[c].used_bytes - old_size + new_size;
+}
+
+// =====================================================================
+
+void slab_print_stats(const slab_t* slab, FILE* out)
+{
+    if (slab == NULL || out == NULL) return;
+
+    fprintf(out, "%8s %10s %10s %7s %12s %12s %7s\n",
+            "chunk", "used", "total", "occup.", "requested", "reserved", "util.");
+
+    size_t requested = 0;
+    size_t reserved = 0;
+
+    for (size_t i = 0; i < slab->nb_classes; ++i) {
+        const slab_class_t* class = &slab->classes[i];
+        if (class->total_chunks == 0) continue;
+
+        size_t class_reserved = class->total_chunks * class->chunk_size;
+        fprintf(out, "%8zu %10zu %10zu %6.1f%% %12zu %12zu %6.1f%%\n",
+                class->chunk_size, class->used_chunks, class->total_chunks,
+                100.0 * class->used_chunks / class->total_chunks,
+                class->used_bytes, class_reserved,
+                100.0 * class->used_bytes / class_reserved);
+
+        requested += class->used_bytes;
+        reserved += class_reserved;
+    }
+
+    if (slab->large_chunks > 0) {
+        fprintf(out, "%8s %10zu %10s %7s %12zu %12zu\n", "large",
+                slab->large_chunks, "-", "-", slab->large_bytes, slab->large_bytes);
+        requested += slab->large_bytes;
+        reserved += slab->large_bytes;
+    }
+
+    fprintf(out, "total: %zu bytes requested, %zu bytes reserved (%.1f%%)\n",
+            requested, reserved, reserved == 0 ? 0.0 : 100.0 * requested / reserved);
+}
+
+// =====================================================================
+
+static size_t class_of(const slab_t* slab, size_t size)
+{
+    if (size > SLAB_MAX_CHUNK) return slab->nb_classes;
+
+    //binary search of the smallest class holding size bytes
+    size_t lo = 0;
+    size_t hi = slab->nb_classes - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (slab->classes[mid].chunk_size < size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+// =====================================================================
+
+static int refill(slab_class_t* class)
+{
+    //the first bytes of a page link it to the previous one
+    size_t header = SLAB_ALIGN > sizeof(void*) ? SLAB_ALIGN : sizeof(void*);
+    size_t page_size = class->page_size;
+    if (page_size < header + class->chunk_size) {
+        page_size = header + class->chunk_size;
+    }
+
+    char* page = malloc(page_size);
+    if (page == NULL) return 0;
+
+    *(void**) page = class->pages;
+    class->pages = page;
+
+    size_t nb_chunks = (page_size - header) / class->chunk_size;
+    for (size_t i = nb_chunks; i > 0; --i) {
+        void* chunk = page + header + (i - 1) * class->chunk_size;
+        *(void**) chunk = class->free_list;
+        class->free_list = chunk;
+    }
+    class->total_chunks += nb_chunks;
+
+    //bigger pages for classes that keep growing
+    if (class->page_size < SLAB_MAX_PAGE) {
+        class->page_size *= 2;
+    }
+
+    return 1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+/**
+ * @file slab.h
+ * @brief Slab allocator with size classes, used to store the entries of the
+ *        local hash-tables (key, value and metadata in one chunk).
+ *        Not thread-safe: the owner of the slab has to serialize the calls.
+ */
+
+#include <stddef.h> // for size_t
+#include <stdio.h>  // for FILE
+
+/**
+ * @brief smallest chunk handed out by the allocator
+ */
+#define SLAB_MIN_CHUNK 32
+
+/**
+ * @brief biggest chunk handed out by the allocator, larger requests go to malloc
+ */
+#define SLAB_MAX_CHUNK (1 << 17)
+
+/**
+ * @brief maximum number of size classes (each class is ~1.125 times the previous one)
+ */
+#define SLAB_NB_CLASSES 96
+
+/**
+ * @brief bytes of the first page of a class, pages then double up to SLAB_MAX_PAGE
+ */
+#define SLAB_FIRST_PAGE 4096
+#define SLAB_MAX_PAGE (1 << 20)
+
+/**
+ * @brief one size class: all its chunks have the same size
+ */
+typedef struct{
+	size_t chunk_size;
+	size_t total_chunks;   // chunks carved from the pages
+	size_t used_chunks;    // chunks currently handed out
+	size_t used_bytes;     // bytes actually requested for the used chunks
+	size_t page_size;      // size of the next page to allocate
+	void* free_list;       // free chunks, linked through their first bytes
+	void* pages;           // allocated pages, linked through their first bytes
+} slab_class_t;
+
+/**
+ * @brief slab allocator
+ */
+typedef struct{
+	size_t nb_classes;
+	slab_class_t classes[SLAB_NB_CLASSES];
+	size_t large_chunks;   // allocations bigger than SLAB_MAX_CHUNK
+	size_t large_bytes;
+} slab_t;
+
+/**
+ * @brief initialize an empty slab allocator
+ * @param slab the allocator to initialize
+ */
+void slab_init(slab_t* slab);
+
+/**
+ * @brief free all the pages of an allocator
+ *    Note: chunks bigger than SLAB_MAX_CHUNK have to be freed with slab_free before.
+ * @param slab the allocator to destroy
+ */
+void slab_destroy(slab_t* slab);
+
+/**
+ * @brief allocate a chunk
+ * @param slab the allocator
+ * @param size number of bytes needed
+ * @param usable where to store the actual size of the chunk (>= size)
+ * @return the chunk, or NULL if there is no memory left
+ */
+void* slab_alloc(slab_t* slab, size_t size, size_t* usable);
+
+/**
+ * @brief give back a chunk to the allocator
+ * @param slab the allocator
+ * @param ptr the chunk
+ * @param usable size of the chunk, as returned by slab_alloc
+ * @param size number of bytes in use in the chunk
+ */
+void slab_free(slab_t* slab, void* ptr, size_t usable, size_t size);
+
+/**
+ * @brief record that the number of bytes in use in a chunk changed (in-place update)
+ * @param slab the allocator
+ * @param usable size of the chunk, as returned by slab_alloc
+ * @param old_size previous number of bytes in use
+ * @param new_size new number of bytes in use
+ */
+void slab_resize(slab_t* slab, size_t usable, size_t old_size, size_t new_size);
+
+/**
+ * @brief print the utilization of every size class in use
+ * @param slab the allocator
+ * @param out where to print
+ */
+void slab_print_stats(const slab_t* slab, FILE* out);
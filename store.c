@@ -0,0 +1,863 @@
+/**
+ * @file store.c
+ * @brief Implementation of store.h
+ *
+ * @date 18.10.2026
+ */
+
+#define _DEFAULT_SOURCE // for fdatasync
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "store.h"
+#include "config.h"
+#include "error.h"
+#include "hashtable.h"
+#include "persist.h"
+#include "hlc.h"
+
+/**
+ * @brief position of a scan (see store_scan): the shard, its generation when
+ *        the position was left, the part of the shard visited (the snapshot,
+ *        the frozen table, then the table), and where to resume in it (an
+ *        offset in the snapshot, a hash in a table)
+ */
+#define SCAN_SNAPSHOT 0
+#define SCAN_FROZEN 1
+#define SCAN_TABLE 2
+#define SCAN_SHARD(p) ((size_t) ((p) >> 56))
+#define SCAN_GENERATION(p) ((uint32_t) (((p) >> 40) & 0xFFFF))
+#define SCAN_PART(p) ((int) (((p) >> 38) & 3))
+#define SCAN_OFFSET(p) ((p) & (((uint64_t) 1 << 38) - 1))
+#define SCAN_POSITION(shard, generation, part, offset) \
+    (STORE_SCAN_START(shard) | ((uint64_t) ((generation) & 0xFFFF) << 40) | ((uint64_t) (part) << 38) | (offset))
+
+/**
+ * @brief a visitor of the entries of the frozen table of a shard that were not overwritten since
+ */
+typedef struct {
+    Htable_t table; // the table of the shard
+    Htable_visitor_t visit;
+    void *arg;
+} frozen_visitor_t;
+
+_Static_assert(STORE_NB_SHARDS <= 64, "store_sync takes the shards as a 64 bits mask");
+
+/**
+ * @brief path of a file of a shard
+ * @param store the store
+ * @param shard index of the shard
+ * @param ext extension of the file ("log" or "snap")
+ * @return the path, to be freed, or NULL
+ */
+static char *shard_path(const store_t *store, size_t shard, const char *ext);
+
+/**
+ * @brief map the snapshot of a shard and replay its log, then open the log;
+ *        the log of a compaction that did not end is replayed as the frozen
+ *        table, to be compacted again
+ * @param store the store
+ * @param i index of the shard
+ * @param nb_entries incremented by the number of entries of the snapshot
+ * @param nb_records incremented by the number of records of the log
+ * @return an error code
+ */
+static error_code shard_recover(store_t *store, size_t i, size_t *nb_entries, size_t *nb_records);
+
+/**
+ * @brief start a compaction: the log moves to shard-NN.old, its table becomes
+ *        the frozen one, and the writes go on in a new log and the spare table
+ *        (shard locked)
+ * @param store the store
+ * @param i index of the shard
+ * @return an error code, the writes go on in the same log and table on error
+ */
+static error_code shard_rotate(store_t *store, size_t i);
+
+/**
+ * @brief merge the frozen table of a shard into a new snapshot, the shard
+ *        locked only to swap the snapshots, then remove shard-NN.old
+ * @param store the store
+ * @param i index of the shard
+ * @return an error code, the frozen table and shard-NN.old stay on error
+ */
+static error_code shard_compact(store_t *store, size_t i);
+
+/**
+ * @brief hand a shard over to the compactor
+ * @param store the store
+ * @param i index of the shard
+ */
+static void queue_compaction(store_t *store, size_t i);
+
+/**
+ * @brief thread of the compactions of a store, until store_free
+ * @param arg the store
+ * @return NULL
+ */
+static void *compactor(void *arg);
+
+/**
+ * @brief whether a write is newer than the value a shard holds (shard locked)
+ * @param shard the shard
+ * @param key the key
+ * @param key_len length of the key
+ * @param value the value written
+ * @param value_len length of the value
+ * @param version its version
+ * @param key_hash hash of the key (see merkle_position_of)
+ * @param held where to store the hash of the entry held, 0 if there is none
+ * @return 1 if the write wins (or the key is new), 0 otherwise
+ */
+static int newer_than_held(store_shard_t *shard, pps_key_t key, size_t key_len, pps_value_t value,
+                           size_t value_len, uint64_t version, uint64_t key_hash, uint64_t *held);
+
+/**
+ * @brief add an entry to the hash tree (visitor of store_for_each)
+ * @param arg the tree
+ * @param key the key
+ * @param key_len length of the key
+ * @param value the value
+ * @param value_len length of the value
+ * @param version its version
+ * @return 1, the whole store is visited
+ */
+static int add_to_tree(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version);
+
+/**
+ * @brief visit the entries of the frozen table of a shard that were not overwritten since
+ * @param shard the shard, locked
+ * @param position where to start, 0 for the first entry; where the visitor stopped,
+ *        HTABLE_SCAN_END once every entry was visited (see scan_Htable)
+ * @param visit the visitor
+ * @param arg its first argument
+ * @return an error code
+ */
+static error_code scan_frozen(store_shard_t *shard, uint64_t *position, Htable_visitor_t visit, void *arg);
+
+/**
+ * @brief call a visitor on an entry of a frozen table, unless the table of the
+ *        shard overwrote it (visitor of scan_Htable)
+ * @param arg the frozen_visitor_t
+ * @param key the key
+ * @param key_len length of the key
+ * @param value the value
+ * @param value_len length of the value
+ * @param version its version
+ * @return 0 if the visitor stopped, 1 otherwise
+ */
+static int visit_frozen(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                        uint64_t version);
+
+/**
+ * @brief visit the entries of the snapshot of a shard that were not overwritten since
+ * @param shard the shard, locked
+ * @param offset where to start, 0 for the first entry; where the visitor stopped
+ * @param visit the visitor
+ * @param arg its first argument
+ * @return 1 if the visitor stopped, 0 once every entry was visited
+ */
+static int scan_snapshot(store_shard_t *shard, size_t *offset, Htable_visitor_t visit, void *arg);
+
+// =====================================================================
+
+store_t *store_new(void)
+{
+    store_t *store = calloc(1, sizeof(store_t));
+    if (store == NULL) {
+        fprintf(stderr, "Could not allocate memory for the store\n");
+        return NULL;
+    }
+
+    store->merkle = merkle_new();
+    if (store->merkle == NULL) {
+        fprintf(stderr, "Could not allocate the hash tree of the store\n");
+        free(store);
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&store->compact_lock, NULL) != 0) {
+        fprintf(stderr, "Could not initialize the lock of the compactions\n");
+        merkle_free(store->merkle);
+        free(store);
+        return NULL;
+    }
+    if (pthread_cond_init(&store->compact_wake, NULL) != 0) {
+        fprintf(stderr, "Could not initialize the lock of the compactions\n");
+        pthread_mutex_destroy(&store->compact_lock);
+        merkle_free(store->merkle);
+        free(store);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < STORE_NB_SHARDS; ++i) {
+        store->shards[i].log_fd = -1;
+        store->shards[i].table = construct_Htable(HTABLE_SIZE);
+        store->shards[i].spare = construct_Htable(HTABLE_SIZE);
+
+        if (store->shards[i].table == NULL || store->shards[i].spare == NULL
+            || pthread_mutex_init(&store->shards[i].lock, NULL) != 0) {
+            fprintf(stderr, "Could not initialize shard %zu of the store\n", i);
+            delete_Htable_and_content(&store->shards[i].table);
+            delete_Htable_and_content(&store->shards[i].spare);
+            for (size_t j = 0; j < i; ++j) {
+                delete_Htable_and_content(&store->shards[j].table);
+                delete_Htable_and_content(&store->shards[j].spare);
+                pthread_mutex_destroy(&store->shards[j].lock);
+            }
+            pthread_cond_destroy(&store->compact_wake);
+            pthread_mutex_destroy(&store->compact_lock);
+            merkle_free(store->merkle);
+            free(store);
+            return NULL;
+        }
+    }
+
+    return store;
+}
+
+// =====================================================================
+
+void store_free(store_t *store)
+{
+    if (store == NULL) return;
+
+    //the compaction in progress ends, the queued ones are done at the next start
+    if (store->compactor_started) {
+        pthread_mutex_lock(&store->compact_lock);
+        store->stopping = 1;
+        pthread_cond_signal(&store->compact_wake);
+        pthread_mutex_unlock(&store->compact_lock);
+        pthread_join(store->compactor, NULL);
+    }
+
+    for (size_t i = 0; i < STORE_NB_SHARDS; ++i) {
+        if (store->shards[i].log_fd != -1) {
+            close(store->shards[i].log_fd);
+        }
+        persist_map_unref(store->shards[i].snapshot);
+        delete_Htable_and_content(&store->shards[i].table);
+        delete_Htable_and_content(&store->shards[i].frozen);
+        delete_Htable_and_content(&store->shards[i].spare);
+        pthread_mutex_destroy(&store->shards[i].lock);
+    }
+
+    pthread_cond_destroy(&store->compact_wake);
+    pthread_mutex_destroy(&store->compact_lock);
+    merkle_free(store->merkle);
+    free(store->dir);
+    free(store);
+}
+
+// =====================================================================
+
+error_code store_open(store_t *store, const char *dir, sync_policy_t policy)
+{
+    M_REQUIRE_NON_NULL(store);
+    M_REQUIRE_NON_NULL(dir);
+    M_REQUIRE(store->dir == NULL, ERR_BAD_PARAMETER, "store already opened on %s", store->dir);
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create directory %s\n", dir);
+        return ERR_IO;
+    }
+
+    store->dir = strdup(dir);
+    M_EXIT_IF_NULL(store->dir, strlen(dir) + 1, "store_open");
+    store->policy = policy;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t nb_entries = 0, nb_records = 0;
+    for (size_t i = 0; i < STORE_NB_SHARDS; ++i) {
+        error_code err = shard_recover(store, i, &nb_entries, &nb_records);
+        if (err != ERR_NONE) {
+            fprintf(stderr, "Could not recover shard %zu from %s\n", i, dir);
+            return err;
+        }
+    }
+
+    //the tree of what was recovered, the next writes update it
+    error_code err = store_for_each(store, add_to_tree, store->merkle);
+    if (err != ERR_NONE) return err;
+
+    if (pthread_create(&store->compactor, NULL, compactor, store) != 0) {
+        fprintf(stderr, "Could not start the compactions of %s\n", dir);
+        return ERR_NOMEM;
+    }
+    store->compactor_started = 1;
+
+    //the compactions that did not end before
+    for (size_t i = 0; i < STORE_NB_SHARDS; ++i) {
+        if (store->shards[i].compacting) queue_compaction(store, i);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "Mapped %zu entries and replayed %zu records from %s in %.3f s\n",
+            nb_entries, nb_records, dir,
+            (double) (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+error_code store_sync(store_t *store, uint64_t shards)
+{
+    M_REQUIRE_NON_NULL(store);
+
+    if (store->dir == NULL || store->policy != SYNC_BATCH) return ERR_NONE;
+
+    error_code err = ERR_NONE;
+    for (size_t i = 0; shards != 0; ++i, shards >>= 1) {
+        if ((shards & 1) == 0) continue;
+
+        store_shard_t *shard = &store->shards[i];
+
+        //one fdatasync covers every write of the batch (and of concurrent batches)
+        pthread_mutex_lock(&shard->lock);
+        if (fdatasync(shard->log_fd) != 0) {
+            err = ERR_IO;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return err;
+}
+
+// =====================================================================
+
+size_t store_shard_of(pps_key_t key, size_t key_len)
+{
+    return hash_bytes(key, key_len, STORE_NB_SHARDS);
+}
+
+// =====================================================================
+
+error_code store_put(store_t *store, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                     uint64_t version)
+{
+    M_REQUIRE_NON_NULL(store);
+    M_REQUIRE_NON_NULL(key);
+
+    M_REQUIRE_NON_NULL(value);
+    //a longer field would be logged, but read back as a torn record on restart (see persist_replay)
+    M_REQUIRE(key_len <= MAX_MSG_ELEM_SIZE && value_len <= MAX_MSG_ELEM_SIZE, ERR_BAD_PARAMETER,
+              "field longer than %d", MAX_MSG_ELEM_SIZE);
+
+    size_t i = store_shard_of(key, key_len);
+    store_shard_t *shard = &store->shards[i];
+    error_code err = ERR_NONE;
+
+    //the SHA-1 of the key out of the lock
+    uint64_t key_hash = 0;
+    uint64_t position = merkle_position_of(key, key_len, &key_hash);
+    uint64_t held = 0;
+
+    pthread_mutex_lock(&shard->lock);
+
+    //a late replica of an older write, or a repair already applied
+    if (!newer_than_held(shard, key, key_len, value, value_len, version, key_hash, &held)) {
+        pthread_mutex_unlock(&shard->lock);
+        return ERR_NONE;
+    }
+
+    if (shard->log_fd != -1) {
+        //write ahead: a write that is not in the log is not applied
+        ssize_t written = persist_append(shard->log_fd, key, key_len, value, value_len, version);
+        if (written < 0 || (store->policy == SYNC_ALWAYS && fdatasync(shard->log_fd) != 0)) {
+            //the log is cut back after its last record: a torn record would stop the replay before
+            //the next ones, a record not synced would bring back a write that failed
+            if (ftruncate(shard->log_fd, (off_t) shard->log_size) != 0 && written >= 0) {
+                shard->log_size += (size_t) written;
+            }
+            err = ERR_IO;
+        } else {
+            shard->log_size += (size_t) written;
+        }
+    }
+
+    if (err == ERR_NONE) {
+        err = add_Htable_versioned_value(shard->table, key, key_len, value, value_len, version);
+    }
+
+    if (err == ERR_NONE) {
+        merkle_toggle(store->merkle, position, held ^ merkle_entry_hash(key_hash, value, value_len, version));
+    }
+
+    if (err == ERR_NONE && shard->log_fd != -1 && !shard->compacting && shard->log_size > STORE_SNAPSHOT_THRESHOLD
+        && (shard->snapshot == NULL || shard->log_size > shard->snapshot->size)) {
+        //only the log moves under the lock, the compactor writes the snapshot; the frozen
+        //table of a failed compaction is compacted again, the log goes on meanwhile
+        if (shard->frozen == NULL && shard_rotate(store, i) != ERR_NONE) {
+            fprintf(stderr, "Could not start the compaction of shard %zu\n", i);
+        } else {
+            shard->compacting = 1;
+            queue_compaction(store, i);
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return err;
+}
+
+// =====================================================================
+
+error_code store_get_view(store_t *store, pps_key_t key, size_t key_len, store_view_t *view)
+{
+    M_REQUIRE_NON_NULL(store);
+    M_REQUIRE_NON_NULL(key);
+    M_REQUIRE_NON_NULL(view);
+
+    view->shard = store_shard_of(key, key_len);
+    view->map = NULL;
+    store_shard_t *shard = &store->shards[view->shard];
+
+    pthread_mutex_lock(&shard->lock);
+
+    //the latest writes first, then the ones being compacted
+    error_code err = get_Htable_view(shard->table, key, key_len, &view->view);
+    view->table = shard->table;
+
+    if (err == ERR_NOT_FOUND && shard->frozen != NULL) {
+        err = get_Htable_view(shard->frozen, key, key_len, &view->view);
+        view->table = shard->frozen;
+    }
+
+    if (err == ERR_NOT_FOUND && shard->snapshot != NULL) {
+        err = persist_map_get(shard->snapshot, key, key_len, &view->view.value, &view->view.length,
+                              &view->view.version);
+        if (err == ERR_NONE) {
+            //the mapping outlives a compaction until the view is released
+            view->view.pin = NULL;
+            view->map = shard->snapshot;
+            ++(view->map->refs);
+        }
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return err;
+}
+
+// =====================================================================
+
+void store_release_view(store_t *store, store_view_t *view)
+{
+    if (store == NULL || view == NULL || (view->view.pin == NULL && view->map == NULL)) return;
+
+    store_shard_t *shard = &store->shards[view->shard];
+
+    //the entry may go back to the slab of its table: same lock as the tables
+    pthread_mutex_lock(&shard->lock);
+    if (view->map != NULL) {
+        persist_map_unref(view->map);
+        view->map = NULL;
+    } else {
+        release_Htable_view(view->table, &view->view);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// =====================================================================
+
+error_code store_scan(store_t *store, uint64_t *position, size_t stride, Htable_visitor_t visit, void *arg)
+{
+    M_REQUIRE_NON_NULL(store);
+    M_REQUIRE_NON_NULL(position);
+    M_REQUIRE_NON_NULL(visit);
+    M_REQUIRE(stride > 0, ERR_BAD_PARAMETER, "stride == %d", 0);
+
+    while (*position != STORE_SCAN_END) {
+        size_t i = SCAN_SHARD(*position);
+        if (i >= STORE_NB_SHARDS) {
+            *position = STORE_SCAN_END;
+            break;
+        }
+
+        store_shard_t *shard = &store->shards[i];
+        pthread_mutex_lock(&shard->lock);
+
+        //the snapshot first: a pair written meanwhile moves to the table, which comes last;
+        //once the table is frozen or merged into a new snapshot, the shard starts again
+        int part = SCAN_PART(*position);
+        uint64_t offset = SCAN_OFFSET(*position);
+        if ((part != SCAN_SNAPSHOT || offset != 0) && SCAN_GENERATION(*position) != (shard->generation & 0xFFFF)) {
+            part = SCAN_SNAPSHOT;
+            offset = 0;
+        }
+
+        int stopped = 0;
+        if (part == SCAN_SNAPSHOT) {
+            size_t at = (size_t) offset;
+            stopped = scan_snapshot(shard, &at, visit, arg);
+            part = stopped ? SCAN_SNAPSHOT : SCAN_FROZEN;
+            offset = stopped ? at : 0;
+        }
+
+        error_code err = ERR_NONE;
+        if (!stopped && part == SCAN_FROZEN) {
+            err = scan_frozen(shard, &offset, visit, arg);
+            stopped = offset != HTABLE_SCAN_END;
+            part = stopped ? SCAN_FROZEN : SCAN_TABLE;
+            offset = stopped ? offset : 0;
+        }
+
+        if (err == ERR_NONE && !stopped) {
+            err = scan_Htable(shard->table, &offset, visit, arg);
+            stopped = offset != HTABLE_SCAN_END;
+        }
+
+        uint32_t generation = shard->generation;
+        pthread_mutex_unlock(&shard->lock);
+
+        if (err != ERR_NONE) return err;
+
+        if (stopped) {
+            *position = SCAN_POSITION(i, generation, part, offset);
+            break;
+        }
+        *position = i + stride < STORE_NB_SHARDS ? STORE_SCAN_START(i + stride) : STORE_SCAN_END;
+    }
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+error_code store_for_each(store_t *store, Htable_visitor_t visit, void *arg)
+{
+    M_REQUIRE_NON_NULL(store);
+    M_REQUIRE_NON_NULL(visit);
+
+    for (size_t i = 0; i < STORE_NB_SHARDS; ++i) {
+        store_shard_t *shard = &store->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        //the entries of the table in place, then the ones of the frozen table and of the snapshot
+        //not overwritten since
+        uint64_t position = 0, frozen = 0;
+        error_code err = scan_Htable(shard->table, &position, visit, arg);
+        if (err == ERR_NONE && position == HTABLE_SCAN_END) {
+            err = scan_frozen(shard, &frozen, visit, arg);
+        }
+
+        size_t offset = 0;
+        int stopped = position != HTABLE_SCAN_END || frozen != HTABLE_SCAN_END
+                      || (err == ERR_NONE && scan_snapshot(shard, &offset, visit, arg));
+
+        pthread_mutex_unlock(&shard->lock);
+        if (err != ERR_NONE || stopped) return err;
+    }
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+void store_print_stats(store_t *store, FILE *out)
+{
+    if (store == NULL || out == NULL) return;
+
+    for (size_t i = 0; i < STORE_NB_SHARDS; ++i) {
+        store_shard_t *shard = &store->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        if (shard->snapshot != NULL) {
+            fprintf(out, "shard %zu: snapshot of %zu entries (%zu bytes mapped)\n", i,
+                    (size_t) shard->snapshot->nb_entries, shard->snapshot->size);
+        }
+        if (shard->frozen != NULL && shard->frozen->nbr_elems > 0) {
+            fprintf(out, "shard %zu, being compacted: ", i);
+            print_Htable_stats(shard->frozen, out);
+        }
+        if (shard->table->nbr_elems > 0) {
+            fprintf(out, "shard %zu: ", i);
+            print_Htable_stats(shard->table, out);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+// =====================================================================
+
+static char *shard_path(const store_t *store, size_t shard, const char *ext)
+{
+    size_t size = strlen(store->dir) + strlen(ext) + 16;
+    char *path = malloc(size);
+    if (path != NULL) {
+        snprintf(path, size, "%s/shard-%02zu.%s", store->dir, shard, ext);
+    }
+    return path;
+}
+
+// =====================================================================
+
+static error_code shard_recover(store_t *store, size_t i, size_t *nb_entries, size_t *nb_records)
+{
+    store_shard_t *shard = &store->shards[i];
+    char *snap = shard_path(store, i, "snap");
+    char *log = shard_path(store, i, "log");
+    char *old = shard_path(store, i, "old");
+    error_code err = (snap == NULL || log == NULL || old == NULL) ? ERR_NOMEM : ERR_NONE;
+
+    //the snapshot is not read, only mapped: startup does not depend on its size
+    if (err == ERR_NONE) {
+        err = persist_map_open(snap, &shard->snapshot);
+    }
+
+    //the logs only hold what came after the snapshot, the one moved aside first
+    off_t old_size = 0, log_size = 0;
+    ssize_t from_old = err ? -1 : persist_replay(old, shard->spare, &old_size);
+    ssize_t from_log = from_old < 0 ? -1 : persist_replay(log, shard->table, &log_size);
+
+    if (err == ERR_NONE && from_log < 0) {
+        err = ERR_IO;
+    }
+
+    //the compaction starts over from the same point, once the store is open
+    if (err == ERR_NONE && old_size > 0) {
+        shard->frozen = shard->spare;
+        shard->spare = NULL;
+        shard->compacting = 1;
+        err = settle_Htable(shard->frozen);
+    }
+
+    if (err == ERR_NONE) {
+        shard->log_fd = open(log, O_WRONLY | O_APPEND | O_CREAT, 0644);
+
+        //drop a partially written record, the next ones would not be readable
+        if (shard->log_fd == -1 || ftruncate(shard->log_fd, log_size) != 0
+            || (log_size == 0 && persist_log_start(shard->log_fd) != ERR_NONE)) {
+            err = ERR_IO;
+        } else {
+            shard->log_size = log_size == 0 ? PERSIST_LOG_HEADER : (size_t) log_size;
+            *nb_entries += shard->snapshot == NULL ? 0 : (size_t) shard->snapshot->nb_entries;
+            *nb_records += (size_t) (from_old + from_log);
+        }
+    }
+
+    free(snap);
+    free(log);
+    free(old);
+    return err;
+}
+
+// =====================================================================
+
+static error_code shard_rotate(store_t *store, size_t i)
+{
+    store_shard_t *shard = &store->shards[i];
+
+    //the frozen table is only read by the compactor, without the lock
+    error_code err = settle_Htable(shard->table);
+    if (err != ERR_NONE) return err;
+
+    //the writes of the batch in progress are acknowledged once synced (see store_sync)
+    if (store->policy == SYNC_BATCH && fdatasync(shard->log_fd) != 0) return ERR_IO;
+
+    char *log = shard_path(store, i, "log");
+    char *old = shard_path(store, i, "old");
+    int fd = -1;
+    err = (log == NULL || old == NULL) ? ERR_NOMEM : persist_log_rotate(log, old, &fd);
+    free(log);
+    free(old);
+    if (err != ERR_NONE) return err;
+
+    close(shard->log_fd);
+    shard->log_fd = fd;
+    shard->log_size = PERSIST_LOG_HEADER;
+
+    shard->frozen = shard->table;
+    shard->table = shard->spare;
+    shard->spare = NULL;
+    ++(shard->generation);
+
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+static error_code shard_compact(store_t *store, size_t i)
+{
+    store_shard_t *shard = &store->shards[i];
+    char *snap = shard_path(store, i, "snap");
+    char *old = shard_path(store, i, "old");
+    error_code err = (snap == NULL || old == NULL) ? ERR_NOMEM : ERR_NONE;
+
+    //only the compactor swaps them, the workers only read them meanwhile
+    pthread_mutex_lock(&shard->lock);
+    Htable_t frozen = shard->frozen;
+    persist_map_t *base = shard->snapshot;
+    pthread_mutex_unlock(&shard->lock);
+
+    persist_map_t *map = NULL;
+    if (err == ERR_NONE) {
+        err = persist_snapshot(snap, frozen, base);
+    }
+    if (err == ERR_NONE) {
+        //if this fails, the old mapping and the frozen table are still right
+        err = persist_map_open(snap, &map);
+    }
+
+    pthread_mutex_lock(&shard->lock);
+    if (err == ERR_NONE) {
+        //borrowed values keep the old mapping (or their entry) alive
+        persist_map_unref(shard->snapshot);
+        shard->snapshot = map;
+        ++(shard->generation);
+
+        //the table takes the writes of the next log
+        clear_Htable(shard->frozen);
+        shard->spare = shard->frozen;
+        shard->frozen = NULL;
+
+        //replaying the old log over the new snapshot would only redo the same writes,
+        //so a crash before the removal is harmless; the next rotation waits for it
+        if (unlink(old) != 0) err = ERR_IO;
+    } else {
+        persist_map_unref(map);
+    }
+    shard->compacting = 0;
+    pthread_mutex_unlock(&shard->lock);
+
+    free(snap);
+    free(old);
+    return err;
+}
+
+// =====================================================================
+
+static void queue_compaction(store_t *store, size_t i)
+{
+    pthread_mutex_lock(&store->compact_lock);
+    store->to_compact |= (uint64_t) 1 << i;
+    pthread_cond_signal(&store->compact_wake);
+    pthread_mutex_unlock(&store->compact_lock);
+}
+
+// =====================================================================
+
+static void *compactor(void *arg)
+{
+    store_t *store = arg;
+
+    pthread_mutex_lock(&store->compact_lock);
+    while (!store->stopping) {
+        if (store->to_compact == 0) {
+            pthread_cond_wait(&store->compact_wake, &store->compact_lock);
+            continue;
+        }
+
+        size_t i = 0;
+        while ((store->to_compact & ((uint64_t) 1 << i)) == 0) {
+            ++i;
+        }
+        store->to_compact &= ~((uint64_t) 1 << i);
+
+        //the shards are queued meanwhile
+        pthread_mutex_unlock(&store->compact_lock);
+        if (shard_compact(store, i) != ERR_NONE) {
+            fprintf(stderr, "Could not compact the log of shard %zu\n", i);
+        }
+        pthread_mutex_lock(&store->compact_lock);
+    }
+    pthread_mutex_unlock(&store->compact_lock);
+
+    return NULL;
+}
+
+// =====================================================================
+
+static int newer_than_held(store_shard_t *shard, pps_key_t key, size_t key_len, pps_value_t value,
+                           size_t value_len, uint64_t version, uint64_t key_hash, uint64_t *held)
+{
+    *held = 0;
+
+    //the table, then the frozen one, then the snapshot
+    Htable_t tables[2] = {shard->table, shard->frozen};
+    Htable_view_t view;
+    for (size_t t = 0; t < 2; ++t) {
+        if (tables[t] != NULL && get_Htable_view(tables[t], key, key_len, &view) == ERR_NONE) {
+            int newer = hlc_newer(version, value, value_len, view.version, view.value, view.length);
+            if (newer) *held = merkle_entry_hash(key_hash, view.value, view.length, view.version);
+            release_Htable_view(tables[t], &view);
+            return newer;
+        }
+    }
+
+    if (shard->snapshot != NULL && persist_map_get(shard->snapshot, key, key_len, &view.value,
+                                                   &view.length, &view.version) == ERR_NONE) {
+        int newer = hlc_newer(version, value, value_len, view.version, view.value, view.length);
+        if (newer) *held = merkle_entry_hash(key_hash, view.value, view.length, view.version);
+        return newer;
+    }
+
+    return 1;
+}
+
+// =====================================================================
+
+static int add_to_tree(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                       uint64_t version)
+{
+    uint64_t key_hash = 0;
+    uint64_t position = merkle_position_of(key, key_len, &key_hash);
+    merkle_toggle(arg, position, merkle_entry_hash(key_hash, value, value_len, version));
+    return 1;
+}
+
+// =====================================================================
+
+static int scan_snapshot(store_shard_t *shard, size_t *offset, Htable_visitor_t visit, void *arg)
+{
+    const char *key = NULL, *value = NULL;
+    size_t key_len = 0, value_len = 0;
+    uint64_t version = 0;
+
+    for (size_t next = 0; (next = persist_map_next(shard->snapshot, *offset, &key, &key_len, &value, &value_len,
+                                                   &version)) != 0; *offset = next) {
+        if (has_Htable_key(shard->table, key, key_len) || has_Htable_key(shard->frozen, key, key_len)) continue;
+
+        if (!visit(arg, key, key_len, value, value_len, version)) return 1;
+    }
+
+    return 0;
+}
+
+// =====================================================================
+
+static error_code scan_frozen(store_shard_t *shard, uint64_t *position, Htable_visitor_t visit, void *arg)
+{
+    if (shard->frozen == NULL) {
+        *position = HTABLE_SCAN_END;
+        return ERR_NONE;
+    }
+
+    frozen_visitor_t frozen = {shard->table, visit, arg};
+    return scan_Htable(shard->frozen, position, visit_frozen, &frozen);
+}
+
+// =====================================================================
+
+static int visit_frozen(void *arg, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                        uint64_t version)
+{
+    frozen_visitor_t *frozen = arg;
+    return has_Htable_key(frozen->table, key, key_len) || frozen->visit(frozen->arg, key, key_len, value, value_len,
+                                                                          version);
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+/**
+ * @file store.h
+ * @brief Local storage of a server: hash-tables sharded by key, each shard
+ *        behind its own lock so that worker threads rarely contend.
+ *        Once opened on a directory, every shard logs its writes to
+ *        shard-NN.log and compacts the log into shard-NN.snap when it grows:
+ *        the log moves to shard-NN.old and a thread of the store merges its
+ *        writes into a new snapshot, while the next writes go to a new log.
+ *        The snapshot is mapped and read in place: only the writes since the
+ *        last compaction are in the hash-tables.
+ *        The store keeps the hash tree of its content up to date with every
+ *        write (see merkle.h).
+ */
+
+#include <stddef.h> // for size_t
+#include <stdint.h> // for uint64_t
+#include <stdio.h>  // for FILE
+#include <pthread.h>
+
+#include "error.h"
+#include "hashtable.h"
+#include "persist.h"
+#include "merkle.h"
+
+/**
+ * @brief number of shards (independent of the number of worker threads)
+ */
+#define STORE_NB_SHARDS 64
+
+/**
+ * @brief a log is compacted once it is larger than this and than the mapped
+ *        snapshot: a compaction rewrites the whole snapshot, so each logged
+ *        byte is written at most twice more, while the replay at startup
+ *        stays bounded by the size of the snapshot
+ */
+#define STORE_SNAPSHOT_THRESHOLD (2 * 1024 * 1024)
+
+/**
+ * @brief one shard: a hash-table, its lock, its log and its snapshot
+ */
+typedef struct{
+	pthread_mutex_t lock;
+	Htable_t table; // the writes of the log
+	Htable_t frozen; // the writes of shard-NN.old, being compacted, NULL otherwise: only read (settled)
+	Htable_t spare; // the table of the last compaction, the writes of the next log, NULL meanwhile
+	int log_fd; // -1 when the store is not persistent
+	size_t log_size;
+	persist_map_t *snapshot; // NULL until the first compaction
+	uint32_t generation; // number of rotations of the log and compactions, for the scans (see store_scan)
+	int compacting; // frozen is queued for the compactor or being compacted
+} store_shard_t;
+
+/**
+ * @brief sharded local storage
+ */
+typedef struct{
+	store_shard_t shards[STORE_NB_SHARDS];
+	char *dir; // NULL when the store is not persistent
+	sync_policy_t policy;
+	merkle_t *merkle; // leaves of the hash tree of the content
+	pthread_t compactor; // writes the snapshots, started by store_open
+	int compactor_started;
+	pthread_mutex_t compact_lock; // for the fields below, taken after a lock of a shard
+	pthread_cond_t compact_wake;
+	uint64_t to_compact; // bit i for shard i
+	int stopping;
+} store_t;
+
+/**
+ * @brief borrowed view on a value of the store (see Htable_view_t),
+ *        either in a hash-table or in a snapshot
+ */
+typedef struct{
+	Htable_view_t view;
+	size_t shard;
+	Htable_t table; // the hash-table holding the value, if not in a snapshot
+	persist_map_t *map; // the snapshot holding the value, or NULL
+} store_view_t;
+
+/**
+ * @brief create an empty store
+ * @return the new store, NULL on error
+ */
+store_t *store_new(void);
+
+/**
+ * @brief make a new store persistent: load the snapshots and replay the logs
+ *        found in a directory (created if needed), then log every write there
+ * @param store the store, still empty
+ * @param dir the directory
+ * @param policy when to flush the logs to disk
+ * @return an error code
+ */
+error_code store_open(store_t *store, const char *dir, sync_policy_t policy);
+
+/**
+ * @brief group commit: flush the logs of some shards to disk
+ *        (does nothing unless the policy is SYNC_BATCH)
+ * @param store the store
+ * @param shards bitmask of the shards written since the last call,
+ *        bit i for shard i
+ * @return an error code
+ */
+error_code store_sync(store_t *store, uint64_t shards);
+
+/**
+ * @brief free a store and its content, once its compactions are over
+ * @param store the store to free
+ */
+void store_free(store_t *store);
+
+/**
+ * @brief index of the shard holding a key
+ * @param key the key
+ * @param key_len length of the key
+ * @return the shard index in [0..STORE_NB_SHARDS-1]
+ */
+size_t store_shard_of(pps_key_t key, size_t key_len);
+
+/**
+ * @brief add or update a key:value pair, unless the store already holds
+ *        a newer version of the key (see hlc_newer)
+ *        (logged first if the store is persistent, see store_sync for SYNC_BATCH)
+ * @param store the store
+ * @param key the key (it may hold '\0', as the value)
+ * @param key_len length of the key
+ * @param value the value
+ * @param value_len length of the value
+ * @param version the version of the value
+ * @return an error code, ERR_NONE if the write was older than the value kept,
+ *         ERR_BAD_PARAMETER if the key or the value is longer than MAX_MSG_ELEM_SIZE
+ */
+error_code store_put(store_t *store, pps_key_t key, size_t key_len, pps_value_t value, size_t value_len,
+                     uint64_t version);
+
+/**
+ * @brief borrow the value of a key (the shard lock is NOT held afterwards)
+ * @param store the store
+ * @param key the key
+ * @param key_len length of the key
+ * @param view where to store the view
+ * @return ERR_NONE, ERR_NOT_FOUND or another error code
+ */
+error_code store_get_view(store_t *store, pps_key_t key, size_t key_len, store_view_t *view);
+
+/**
+ * @brief release a view obtained from store_get_view
+ * @param store the store
+ * @param view the view to release
+ */
+void store_release_view(store_t *store, store_view_t *view);
+
+/**
+ * @brief position of a scan at the start of a shard, and once it is over
+ */
+#define STORE_SCAN_START(shard) ((uint64_t) (shard) << 56)
+#define STORE_SCAN_END UINT64_MAX
+
+/**
+ * @brief visit the pairs of some shards in place, from a position, until the
+ *        visitor stops (the shard is locked meanwhile: the visitor must not
+ *        use the store). A scan resumed from the position left visits the
+ *        pairs present all along at least once, whatever was written since;
+ *        the start or the end of a compaction of the shard makes it visit the
+ *        shard again.
+ * @param store the store
+ * @param position where to start, STORE_SCAN_START or the value left by a previous
+ *        scan; where to resume once the visitor stopped, STORE_SCAN_END at the end
+ * @param stride shards between two shards of the scan, 1 to visit them all
+ * @param visit the visitor (see Htable_visitor_t)
+ * @param arg its first argument
+ * @return an error code
+ */
+error_code store_scan(store_t *store, uint64_t *position, size_t stride, Htable_visitor_t visit, void *arg);
+
+/**
+ * @brief visit every key:value pair of the store, shard by shard, until the
+ *        visitor stops (the shard is locked meanwhile: the visitor must not use the store)
+ * @param store the store
+ * @param visit the visitor (see Htable_visitor_t)
+ * @param arg its first argument
+ * @return an error code
+ */
+error_code store_for_each(store_t *store, Htable_visitor_t visit, void *arg);
+
+/**
+ * @brief print the memory usage of every non empty shard
+ * @param store the store
+ * @param out where to print
+ */
+void store_print_stats(store_t *store, FILE *out);
@@ -5,6 +5,8 @@
  * @author Luis D. Pedrosa
  */
 
+#define _DEFAULT_SOURCE // for SO_REUSEPORT
+
 #include <string.h> // for memset
 #include <sys/socket.h> // for sockets
 #include <netinet/in.h> // for IPPROTO_UDP
@@ -68,3 +70,22 @@ error_code bind_server(int socket, const char *ip, uint16_t port)
 
     return ERR_NONE;
 }
+
+// ======================================================================
+error_code enable_reuseport(int socket)
+{
+    int on = 1;
+    if (setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
+        return ERR_NETWORK;
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+error_code set_receive_buffer(int socket, int size)
+{
+    if (setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == -1)
+        return ERR_NETWORK;
+
+    return ERR_NONE;
+}
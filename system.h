@@ -37,3 +37,20 @@ error_code get_server_addr(const char *ip, uint16_t port, struct sockaddr_in *ad
  * @return an error code != ERR_NONE if anything went wrong
  */
 error_code bind_server(int socket, const char *ip, uint16_t port);
+
+/** ======================================================================
+ * @brief allow several sockets to be bound to the same IP address and port
+ *        (the kernel then spreads the incoming datagrams among them)
+ * @param socket socket to be configured, before binding it
+ * @return an error code != ERR_NONE if anything went wrong
+ */
+error_code enable_reuseport(int socket);
+
+/** ======================================================================
+ * @brief ask for a bigger receive buffer, so that bursts of datagrams are
+ *        queued instead of dropped (the kernel caps it to net.core.rmem_max)
+ * @param socket socket to be configured
+ * @param size size of the buffer in bytes
+ * @return an error code != ERR_NONE if anything went wrong
+ */
+error_code set_receive_buffer(int socket, int size);
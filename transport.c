@@ -0,0 +1,522 @@
+/**
+ * @file transport.c
+ * @brief Implementation of transport.h
+ *
+ * @date 18.10.2026
+ */
+
+#define _DEFAULT_SOURCE // for struct pollfd
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "transport.h"
+#include "system.h"
+#include "error.h"
+#include "node_list.h"
+#include "config.h"
+
+/**
+ * @brief order of the peers
+ * @param a first address
+ * @param b second address
+ * @return <0, 0 or >0 as memcmp
+ */
+static int addr_cmp(const struct sockaddr_in *a, const struct sockaddr_in *b);
+
+/**
+ * @brief position of a server in the pool, or where to insert it
+ * @param transport the transport
+ * @param addr address of the server
+ * @return the first peer whose address is not smaller
+ */
+static size_t find_peer(const transport_t *transport, const struct sockaddr_in *addr);
+
+/**
+ * @brief peer of a socket of the pool
+ * @param transport the transport
+ * @param socket the socket
+ * @return the peer, NULL if the socket is not in the pool
+ */
+static transport_peer_t *peer_of_socket(transport_t *transport, int socket);
+
+/**
+ * @brief slot of a request in the table of requests in flight
+ * @param transport the transport
+ * @param id ID of the request
+ * @return the slot (which may hold another request)
+ */
+static transport_request_t *request_slot(const transport_t *transport, uint32_t id);
+
+/**
+ * @brief handle the datagram (or error) waiting on a socket
+ * @param transport the transport
+ * @param peer the peer of the socket
+ * @return the request that it completes, NULL if none (late or invalid reply)
+ */
+static transport_request_t *receive_reply(transport_t *transport, transport_peer_t *peer);
+
+/**
+ * @brief add a round-trip time to a smoothed estimate (RFC 6298)
+ * @param srtt the smoothed round-trip time, 0 if there is no sample yet
+ * @param rttvar its mean deviation
+ * @param sample the new round-trip time, in ms
+ */
+static void update_rtt(double *srtt, double *rttvar, double sample);
+
+/**
+ * @brief time between two instants
+ * @param from the first one
+ * @param to the second one
+ * @return the time, in ms
+ */
+static double elapsed_ms(const struct timespec *from, const struct timespec *to);
+
+/**
+ * @brief milliseconds left until a deadline
+ * @param deadline the deadline, of the monotonic clock
+ * @return the time left, 0 if it is over
+ */
+static int time_left_ms(const struct timespec *deadline);
+
+// =====================================================================
+
+transport_t *transport_new(const node_list_t *nodes, const char *health_path)
+{
+    transport_t *transport = calloc(1, sizeof(transport_t));
+    if (transport == NULL) {
+        fprintf(stderr, "Could not allocate memory for the transport\n");
+        return NULL;
+    }
+
+    transport->requests = calloc(TRANSPORT_MAX_INFLIGHT, sizeof(transport_request_t));
+    transport->buffer = malloc(PROTOCOL_HEADER_SIZE + MAX_MSG_SIZE);
+    transport->health = health_open(health_path);
+    if (transport->requests == NULL || transport->buffer == NULL || transport->health == NULL) {
+        fprintf(stderr, "Could not allocate memory for the transport\n");
+        transport_free(transport);
+        return NULL;
+    }
+
+    for (size_t i = 0; nodes != NULL && i < nodes->size; ++i) {
+        if (transport_socket(transport, &nodes->nodes[i].srv_addr) == -1) {
+            fprintf(stderr, "Could not create a socket for %s %hu\n", nodes->nodes[i].ip, nodes->nodes[i].port);
+            transport_free(transport);
+            return NULL;
+        }
+    }
+
+    return transport;
+}
+
+// =====================================================================
+
+void transport_free(transport_t *transport)
+{
+    if (transport == NULL) return;
+
+    for (size_t i = 0; i < transport->nb_peers; ++i) {
+        close(transport->peers[i].socket);
+    }
+
+    for (size_t i = 0; transport->requests != NULL && i < TRANSPORT_MAX_INFLIGHT; ++i) {
+        free(transport->requests[i].reply);
+    }
+
+    health_close(transport->health);
+    free(transport->requests);
+    free(transport->buffer);
+    free(transport->peers);
+    free(transport);
+}
+
+// =====================================================================
+
+int transport_socket(transport_t *transport, const struct sockaddr_in *addr)
+{
+    if (transport == NULL || addr == NULL) return -1;
+
+    size_t pos = find_peer(transport, addr);
+    if (pos < transport->nb_peers && addr_cmp(&transport->peers[pos].addr, addr) == 0) {
+        return transport->peers[pos].socket;
+    }
+
+    //new server: no receive timeout, replies are waited for with poll
+    int s = get_socket(0);
+    if (s == -1) return -1;
+
+    if (connect(s, (const struct sockaddr *) addr, sizeof(*addr)) == -1) {
+        close(s);
+        return -1;
+    }
+
+    transport_peer_t *peers = realloc(transport->peers, (transport->nb_peers + 1) * sizeof(transport_peer_t));
+    if (peers == NULL) {
+        close(s);
+        return -1;
+    }
+
+    memmove(&peers[pos + 1], &peers[pos], (transport->nb_peers - pos) * sizeof(transport_peer_t));
+    peers[pos].addr = *addr;
+    peers[pos].socket = s;
+    peers[pos].inflight = 0;
+    peers[pos].health = health_find(transport->health, addr);
+    health_rtt(transport->health, peers[pos].health, &peers[pos].srtt, &peers[pos].rttvar);
+    transport->peers = peers;
+    ++(transport->nb_peers);
+
+    return s;
+}
+
+// =====================================================================
+
+size_t transport_peer_index(const transport_t *transport, const struct sockaddr_in *addr)
+{
+    size_t pos = find_peer(transport, addr);
+    return pos < transport->nb_peers && addr_cmp(&transport->peers[pos].addr, addr) == 0 ? pos : transport->nb_peers;
+}
+
+// =====================================================================
+
+error_code transport_request(transport_t *transport, const struct sockaddr_in *addr, protocol_opcode_t opcode,
+                             const void *payload, size_t size, uint32_t *id)
+{
+    struct iovec part = {(void *) payload, size};
+    return transport_request_parts(transport, addr, opcode, &part, size > 0 ? 1 : 0, id);
+}
+
+// =====================================================================
+
+error_code transport_request_parts(transport_t *transport, const struct sockaddr_in *addr, protocol_opcode_t opcode,
+                                   const struct iovec *parts, size_t nb_parts, uint32_t *id)
+{
+    M_REQUIRE_NON_NULL(transport);
+    M_REQUIRE_NON_NULL(id);
+    M_REQUIRE(nb_parts <= TRANSPORT_MAX_PARTS, ERR_BAD_PARAMETER, "Too many parts in a request (%zu)", nb_parts);
+
+    int s = transport_socket(transport, addr);
+    if (s == -1) return ERR_NETWORK;
+
+    //next ID whose slot is free (0 marks the free slots), a request that
+    //is never answered only holds its own slot
+    transport_request_t *request = NULL;
+    for (size_t tries = 0; request == NULL && tries < TRANSPORT_MAX_INFLIGHT; ++tries) {
+        if (++(transport->next_id) == 0) ++(transport->next_id);
+        request = request_slot(transport, transport->next_id);
+        if (request->id != 0) request = NULL;
+    }
+
+    if (request == NULL) {
+        fprintf(stderr, "Too many requests in flight\n");
+        return ERR_NETWORK;
+    }
+
+    char header[PROTOCOL_HEADER_SIZE];
+    protocol_header_t h = {PROTOCOL_VERSION, (uint8_t) opcode, PROTOCOL_OK, transport->next_id};
+    protocol_write_header(header, &h);
+
+    //the header on the stack, then the parts where they are
+    struct iovec iov[1 + TRANSPORT_MAX_PARTS] = {{header, sizeof(header)}};
+    size_t size = 0;
+    for (size_t p = 0; p < nb_parts; ++p) {
+        iov[1 + p] = parts[p];
+        size += parts[p].iov_len;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1 + nb_parts;
+
+    if (sendmsg(s, &msg, 0) != (ssize_t) (sizeof(header) + size)) return ERR_NETWORK;
+    transport->bytes_sent += sizeof(header) + size;
+
+    memset(request, 0, sizeof(transport_request_t));
+    request->id = transport->next_id;
+    request->opcode = (uint8_t) opcode;
+    request->socket = s;
+    request->addr = *addr;
+    clock_gettime(CLOCK_MONOTONIC, &request->sent);
+    ++(peer_of_socket(transport, s)->inflight);
+
+    *id = request->id;
+    return ERR_NONE;
+}
+
+// =====================================================================
+
+error_code transport_wait(transport_t *transport, int timeout_ms, uint32_t *id)
+{
+    M_REQUIRE_NON_NULL(transport);
+    M_REQUIRE_NON_NULL(id);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    struct pollfd fds[transport->nb_peers > 0 ? transport->nb_peers : 1];
+
+    while (1) {
+        //requests that failed with their socket
+        for (size_t i = 0; transport->nb_unreported > 0 && i < TRANSPORT_MAX_INFLIGHT; ++i) {
+            transport_request_t *request = &transport->requests[i];
+            if (request->id != 0 && request->done && !request->reported) {
+                request->reported = 1;
+                --(transport->nb_unreported);
+                *id = request->id;
+                return ERR_NONE;
+            }
+        }
+
+        //only the sockets with requests in flight
+        size_t nb_fds = 0;
+        for (size_t i = 0; i < transport->nb_peers; ++i) {
+            if (transport->peers[i].inflight > 0) {
+                fds[nb_fds].fd = transport->peers[i].socket;
+                fds[nb_fds].events = POLLIN;
+                fds[nb_fds].revents = 0;
+                ++nb_fds;
+            }
+        }
+
+        if (nb_fds == 0) return ERR_NETWORK;
+
+        int ready = poll(fds, nb_fds, time_left_ms(&deadline));
+        if (ready == -1 && errno == EINTR) continue;
+        if (ready <= 0) return ERR_NETWORK;
+
+        for (size_t i = 0; i < nb_fds; ++i) {
+            if (fds[i].revents == 0) continue;
+
+            transport_request_t *request = receive_reply(transport, peer_of_socket(transport, fds[i].fd));
+            if (request != NULL) {
+                request->reported = 1;
+                *id = request->id;
+                return ERR_NONE;
+            }
+        }
+    }
+}
+
+// =====================================================================
+
+int transport_timeout_ms(const transport_t *transport, const struct sockaddr_in *addr)
+{
+    if (transport == NULL || addr == NULL) return TRANSPORT_TIMEOUT_MS;
+
+    size_t pos = transport_peer_index(transport, addr);
+    const transport_peer_t *peer = pos < transport->nb_peers ? &transport->peers[pos] : NULL;
+
+    double timeout = TRANSPORT_TIMEOUT_MS;
+    if (peer != NULL && peer->srtt > 0) {
+        timeout = peer->srtt + 4 * peer->rttvar;
+    } else if (transport->srtt > 0) {
+        timeout = transport->srtt + 4 * transport->rttvar;
+    }
+
+    if (timeout < TRANSPORT_MIN_TIMEOUT_MS) return TRANSPORT_MIN_TIMEOUT_MS;
+    if (timeout > TRANSPORT_TIMEOUT_MS) return TRANSPORT_TIMEOUT_MS;
+    return (int) timeout + 1;
+}
+
+// =====================================================================
+
+int transport_suspected(transport_t *transport, const struct sockaddr_in *addr)
+{
+    if (transport == NULL || addr == NULL) return 0;
+
+    size_t pos = transport_peer_index(transport, addr);
+    if (pos == transport->nb_peers) return 0;
+
+    return health_suspected(transport->health, transport->peers[pos].health);
+}
+
+// =====================================================================
+
+const transport_request_t *transport_reply(const transport_t *transport, uint32_t id)
+{
+    if (transport == NULL || id == 0) return NULL;
+
+    const transport_request_t *request = request_slot(transport, id);
+    return request->id == id ? request : NULL;
+}
+
+// =====================================================================
+
+void transport_forget(transport_t *transport, uint32_t id)
+{
+    if (transport == NULL || id == 0) return;
+
+    transport_request_t *request = request_slot(transport, id);
+    if (request->id != id) return;
+
+    if (!request->done) {
+        transport_peer_t *peer = peer_of_socket(transport, request->socket);
+        if (peer != NULL && peer->inflight > 0) --(peer->inflight);
+
+        //given up after the server had all the time it should need: a miss
+        //(not when the operation was done without it)
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (peer != NULL && elapsed_ms(&request->sent, &now) >= transport_timeout_ms(transport, &peer->addr)) {
+            health_miss(transport->health, peer->health, 0);
+        }
+    } else if (!request->reported) {
+        --(transport->nb_unreported);
+    }
+
+    free(request->reply);
+    memset(request, 0, sizeof(transport_request_t));
+}
+
+// =====================================================================
+
+static int addr_cmp(const struct sockaddr_in *a, const struct sockaddr_in *b)
+{
+    if (a->sin_addr.s_addr != b->sin_addr.s_addr) {
+        return a->sin_addr.s_addr < b->sin_addr.s_addr ? -1 : 1;
+    }
+    if (a->sin_port != b->sin_port) {
+        return a->sin_port < b->sin_port ? -1 : 1;
+    }
+    return 0;
+}
+
+// =====================================================================
+
+static size_t find_peer(const transport_t *transport, const struct sockaddr_in *addr)
+{
+    size_t low = 0, high = transport->nb_peers;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (addr_cmp(&transport->peers[mid].addr, addr) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// =====================================================================
+
+static transport_peer_t *peer_of_socket(transport_t *transport, int socket)
+{
+    for (size_t i = 0; socket >= 0 && i < transport->nb_peers; ++i) {
+        if (transport->peers[i].socket == socket) return &transport->peers[i];
+    }
+    return NULL;
+}
+
+// =====================================================================
+
+static transport_request_t *request_slot(const transport_t *transport, uint32_t id)
+{
+    return &transport->requests[id & (TRANSPORT_MAX_INFLIGHT - 1)];
+}
+
+// =====================================================================
+
+static transport_request_t *receive_reply(transport_t *transport, transport_peer_t *peer)
+{
+    ssize_t size = recv(peer->socket, transport->buffer, PROTOCOL_HEADER_SIZE + MAX_MSG_SIZE, MSG_DONTWAIT);
+
+    if (size < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return NULL;
+
+        //an ICMP error (nobody listening): none of its requests will be answered
+        for (size_t i = 0; i < TRANSPORT_MAX_INFLIGHT; ++i) {
+            transport_request_t *request = &transport->requests[i];
+            if (request->id != 0 && !request->done && request->socket == peer->socket) {
+                request->done = 1;
+                request->status = PROTOCOL_UNREACHABLE;
+                ++(transport->nb_unreported);
+            }
+        }
+        peer->inflight = 0;
+        health_miss(transport->health, peer->health, 1);
+        return NULL;
+    }
+
+    transport->bytes_received += (size_t) size;
+
+    protocol_header_t header;
+    if (!protocol_read_header(transport->buffer, (size_t) size, &header)) return NULL;
+
+    //late reply of a request that was given up, or garbage
+    transport_request_t *request = request_slot(transport, header.id);
+    if (request->id != header.id || header.id == 0 || request->done || request->socket != peer->socket) {
+        return NULL;
+    }
+
+    size_t payload_size = (size_t) size - PROTOCOL_HEADER_SIZE;
+    request->reply = malloc(payload_size + 1);
+    if (request->reply == NULL) {
+        request->status = PROTOCOL_ERROR;
+    } else {
+        memcpy(request->reply, transport->buffer + PROTOCOL_HEADER_SIZE, payload_size);
+        request->reply[payload_size] = '\0';
+        request->reply_size = payload_size;
+        request->status = header.status;
+    }
+
+    request->done = 1;
+    if (peer->inflight > 0) --(peer->inflight);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double rtt = elapsed_ms(&request->sent, &now);
+    update_rtt(&peer->srtt, &peer->rttvar, rtt);
+    update_rtt(&transport->srtt, &transport->rttvar, rtt);
+    health_reply(transport->health, peer->health, peer->srtt, peer->rttvar);
+
+    return request;
+}
+
+// =====================================================================
+
+static void update_rtt(double *srtt, double *rttvar, double sample)
+{
+    if (sample <= 0) sample = 1e-3; // below the resolution of the clock
+
+    if (*srtt <= 0) {
+        *srtt = sample;
+        *rttvar = sample / 2;
+        return;
+    }
+
+    double deviation = *srtt > sample ? *srtt - sample : sample - *srtt;
+    *rttvar = 0.75 * *rttvar + 0.25 * deviation;
+    *srtt = 0.875 * *srtt + 0.125 * sample;
+}
+
+// =====================================================================
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to)
+{
+    return (double) (to->tv_sec - from->tv_sec) * 1e3 + (double) (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+// =====================================================================
+
+static int time_left_ms(const struct timespec *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long left = (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+    return left > 0 ? (int) left : 0;
+}
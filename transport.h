@@ -0,0 +1,195 @@
+#pragma once
+
+/**
+ * @file transport.h
+ * @brief Sockets of a client, created once and reused by all its operations:
+ *        one UDP socket per server, connected to it, so that the kernel
+ *        only delivers the datagrams of that server on it.
+ *
+ *        Requests carry an ID (see protocol.h) and wait in a table of
+ *        requests in flight until their reply comes, so that a socket can
+ *        carry many requests at once and answered out of order; the late
+ *        replies of requests that were given up are dropped.
+ *
+ *        The round-trip time of every server is smoothed as TCP does (RFC
+ *        6298): a reply is late once it exceeds srtt + 4 * rttvar, which
+ *        tells the client when to ask one more server. Replies and requests
+ *        given up after that long are also recorded in the health table
+ *        shared by the clients (see health.h).
+ */
+
+#include <stddef.h> // for size_t
+#include <sys/types.h> // for ssize_t
+#include <stdint.h>
+#include <netinet/in.h> // for struct sockaddr_in
+#include <sys/uio.h> // for struct iovec
+#include <time.h> // for struct timespec
+
+#include "error.h"
+#include "node_list.h"
+#include "protocol.h"
+#include "health.h"
+
+/**
+ * @brief how long to wait for a reply at most (as the former 1 second SO_RCVTIMEO)
+ */
+#define TRANSPORT_TIMEOUT_MS 1000
+
+/**
+ * @brief smallest timeout derived from the round-trip times (poll counts in milliseconds)
+ */
+#define TRANSPORT_MIN_TIMEOUT_MS 2
+
+/**
+ * @brief maximum number of requests in flight (a power of 2)
+ */
+#define TRANSPORT_MAX_INFLIGHT 1024
+
+/**
+ * @brief maximum number of parts of the payload of a request (see transport_request_parts)
+ */
+#define TRANSPORT_MAX_PARTS 8
+
+/**
+ * @brief a server and the socket connected to it
+ */
+typedef struct {
+    struct sockaddr_in addr;
+    int socket;
+    size_t inflight; // requests sent on the socket and not answered yet
+    double srtt;     // smoothed round-trip time in ms (from the health table at first), 0 if unknown
+    double rttvar;   // its mean deviation
+    size_t health;   // its entry in the health table
+} transport_peer_t;
+
+/**
+ * @brief a request in flight, then its reply
+ */
+typedef struct {
+    uint32_t id;             // 0 if the slot is free
+    uint8_t opcode;
+    uint8_t status;          // a protocol_status_t once done
+    int done;
+    int reported;            // already returned by transport_wait
+    int socket;
+    struct sockaddr_in addr; // the server it was sent to
+    struct timespec sent;    // when, of the monotonic clock
+    char *reply;             // payload of the reply, '\0' terminated
+    size_t reply_size;
+} transport_request_t;
+
+/**
+ * @brief the sockets of a client and its requests in flight
+ */
+typedef struct {
+    size_t nb_peers;
+    transport_peer_t *peers;       // sorted by address
+    transport_request_t *requests; // TRANSPORT_MAX_INFLIGHT slots, indexed by the low bits of the IDs
+    uint32_t next_id;
+    size_t nb_unreported;          // requests that failed with their socket, not returned yet
+    char *buffer;                  // receive buffer
+    size_t bytes_sent;             // datagrams sent and received, headers included
+    size_t bytes_received;
+    double srtt;                   // round-trip time of all the servers, for the ones not heard of yet
+    double rttvar;
+    health_t *health;              // what the clients know of the servers
+} transport_t;
+
+/**
+ * @brief create the sockets to the servers of a list of nodes
+ *        (one per server, whatever its number of nodes)
+ * @param nodes the nodes, may be NULL
+ * @param health_path file of the health table shared by the clients, NULL to not share it
+ * @return the new transport, NULL on error
+ */
+transport_t *transport_new(const node_list_t *nodes, const char *health_path);
+
+/**
+ * @brief close all the sockets of a transport and free it
+ * @param transport the transport, may be NULL
+ */
+void transport_free(transport_t *transport);
+
+/**
+ * @brief socket connected to a server, created if it is not in the pool yet
+ * @param transport the transport
+ * @param addr address of the server
+ * @return the socket, -1 on error
+ */
+int transport_socket(transport_t *transport, const struct sockaddr_in *addr);
+
+/**
+ * @brief position of a server in the pool
+ * @param transport the transport
+ * @param addr address of the server
+ * @return its index in transport->peers, transport->nb_peers if it has no socket yet
+ */
+size_t transport_peer_index(const transport_t *transport, const struct sockaddr_in *addr);
+
+/**
+ * @brief send a request to a server
+ * @param transport the transport
+ * @param addr address of the server
+ * @param opcode the operation
+ * @param payload the payload of the request
+ * @param size its size
+ * @param id where to store the ID of the request
+ * @return ERR_NONE, ERR_NETWORK if it could not be sent or too many requests are in flight
+ */
+error_code transport_request(transport_t *transport, const struct sockaddr_in *addr, protocol_opcode_t opcode,
+                             const void *payload, size_t size, uint32_t *id);
+
+/**
+ * @brief send a request whose payload is gathered from several buffers, by
+ *        the kernel: they are sent as they are, without being copied first
+ * @param transport the transport
+ * @param addr address of the server
+ * @param opcode the operation
+ * @param parts the parts of the payload, in order
+ * @param nb_parts their number, TRANSPORT_MAX_PARTS at most
+ * @param id where to store the ID of the request
+ * @return ERR_NONE, ERR_NETWORK if it could not be sent or too many requests are in flight
+ */
+error_code transport_request_parts(transport_t *transport, const struct sockaddr_in *addr, protocol_opcode_t opcode,
+                                   const struct iovec *parts, size_t nb_parts, uint32_t *id);
+
+/**
+ * @brief wait until a request in flight is answered (or its server found unreachable)
+ * @param transport the transport
+ * @param timeout_ms how long to wait at most
+ * @param id where to store the ID of the request, whose reply is then given by transport_reply
+ * @return ERR_NONE, ERR_NETWORK on timeout or if no request is in flight
+ */
+error_code transport_wait(transport_t *transport, int timeout_ms, uint32_t *id);
+
+/**
+ * @brief how long a reply of a server may take before it is late
+ * @param transport the transport
+ * @param addr address of the server
+ * @return srtt + 4 * rttvar of the server (of all the servers if it never
+ *         replied), between TRANSPORT_MIN_TIMEOUT_MS and TRANSPORT_TIMEOUT_MS
+ */
+int transport_timeout_ms(const transport_t *transport, const struct sockaddr_in *addr);
+
+/**
+ * @brief whether a server recently missed its requests (see health.h)
+ * @param transport the transport
+ * @param addr address of the server
+ * @return 1 if it is better to ask another server
+ */
+int transport_suspected(transport_t *transport, const struct sockaddr_in *addr);
+
+/**
+ * @brief a request in flight or answered
+ * @param transport the transport
+ * @param id ID of the request
+ * @return the request, NULL if it is unknown
+ */
+const transport_request_t *transport_reply(const transport_t *transport, uint32_t id);
+
+/**
+ * @brief release a request: its reply, or any reply to come
+ * @param transport the transport
+ * @param id ID of the request
+ */
+void transport_forget(transport_t *transport, uint32_t id);
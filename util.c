@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "util.h"
+
 // ======================================================================
 
 char *strdup(const char *str)
@@ -31,3 +33,20 @@ size_t argv_size(char **argv)
     while (*ptr != NULL) ++ptr;
     return (size_t) (ptr - argv); // we know ptr >= argv
 }
+
+// ======================================================================
+error_code substring_offset(size_t size, long start, size_t length, size_t *offset)
+{
+    M_REQUIRE_NON_NULL(offset);
+
+    if (start >= 0) {
+        if ((size_t) start >= size || length > size - (size_t) start) return ERR_BAD_PARAMETER;
+        *offset = (size_t) start;
+    } else {
+        size_t from_end = (size_t) -start;
+        if (from_end > size || length > from_end) return ERR_BAD_PARAMETER;
+        *offset = size - from_end;
+    }
+
+    return ERR_NONE;
+}
@@ -9,6 +9,8 @@
 
 #include <stddef.h> // for size_t
 
+#include "error.h"
+
 
 /**
  * @brief tag a variable as POTENTIALLY unused, to avoid compiler warnings
@@ -34,4 +36,12 @@ char *strdup(const char *str);
  */
 size_t argv_size(char **argv);
 
-
+/**
+ * @brief offset of a substring, as given to pps-client-substr
+ * @param size length of the string
+ * @param start position of the substring, from the end of the string if negative
+ * @param length length of the substring
+ * @param offset where to store the offset of the substring in the string
+ * @return ERR_NONE, ERR_BAD_PARAMETER if the substring is not within the string
+ */
+error_code substring_offset(size_t size, long start, size_t length, size_t *offset);